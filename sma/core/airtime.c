@@ -0,0 +1,350 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ * 
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ * 
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+/**************************************************************************
+*         SMA Technologie AG, 34266 Niestetal, Germany
+***************************************************************************
+* Project       : yasdi
+***************************************************************************
+* Project-no.   :
+***************************************************************************
+* Filename      : airtime.c
+***************************************************************************
+* Description   : Airtime model of the bus drivers: time of frames on the
+*                 wire, timeouts of requests and the load of each bus
+***************************************************************************
+* Preconditions : 
+***************************************************************************
+* Changes       : Author, Date, Version, Reason
+*                 *********************************************************
+**************************************************************************/
+#include "os.h"
+
+#include "debug.h"
+#include "device.h"
+#include "driver_layer.h"
+#include "prot_layer.h"
+#include "repository.h"
+#include "airtime.h"
+
+
+/**************************************************************************
+********** L O C A L E ****************************************************
+**************************************************************************/
+
+//The airtime account of one bus driver
+typedef struct
+{
+   TMinNode Node;
+   TDevice * dev;                    //the bus driver
+   DWORD dBaudrate;                  //line speed of the bus (0 => unknown)
+   DWORD dReplyDelay;                //time (ms) a device needs before it answers
+   DWORD dMinTimeout;                //min. timeout (ms) of an request
+   DWORD dLastSec;                   //second of the last accounting
+   DWORD Busy[AIRTIME_LOAD_WINDOW];  //airtime (ms) of each second (ring buffer)
+} TBusAirtime;
+
+static TMinList BusList;             //airtime accounts of all bus drivers
+                                     //(load is requested by the application
+                                     //threads => "BusList.Mutex")
+
+
+
+/**************************************************************************
+***** IMPLEMENTATION ******************************************************
+**************************************************************************/
+
+void TAirtime_Constructor( void )
+{
+   INITLIST( &BusList );
+}
+
+void TAirtime_Destructor( void )
+{
+   TBusAirtime * bus;
+
+   os_thread_MutexLock( &BusList.Mutex );
+   while(!ISLISTEMPTY( &BusList ))
+   {
+      bus = (TBusAirtime*)GETFIRST( &BusList );
+      REMOVE( &bus->Node );
+      os_free( bus );
+   }
+   os_thread_MutexUnlock( &BusList.Mutex );
+}
+
+
+/**************************************************************************
+   Description   : [private] Finds the airtime account of an bus driver.
+                   Creates it on the first call (config "<driver>.ReplyDelay"
+                   and "<driver>.MinTimeout"). The line speed is read from 
+                   the driver on each call (it may change, e.g. by the 
+                   autodetection of the serial driver). Call it with the 
+                   mutex "BusList.Mutex" locked!
+   Parameter     : dev = the bus driver
+   Return-Value  : the account or NULL (no memory)
+**************************************************************************/
+static TBusAirtime * TAirtime_FindBus( TDevice * dev )
+{
+   TBusAirtime * bus;
+   TBusAirtime * found = NULL;
+   DWORD dBaudrate;
+   char ConfigPath[70];
+
+   //Only drivers which know their line speed do have an airtime...
+   if (!dev->IoCtrl || dev->IoCtrl(dev, IOCTRL_GET_BAUDRATE, (BYTE*)&dBaudrate) != 0)
+      dBaudrate = 0;
+
+   foreach_f( &BusList, bus )
+   {
+      if (bus->dev == dev) found = bus;
+   }
+
+   bus = found;
+   if (!bus)
+   {
+      bus = os_malloc( sizeof(TBusAirtime) );
+      if (!bus) return NULL;
+      memset( bus, 0, sizeof(TBusAirtime) );
+      bus->dev = dev;
+
+      sprintf(ConfigPath, "%s.ReplyDelay", dev->cName);
+      bus->dReplyDelay = TRepository_GetElementInt( ConfigPath, AIRTIME_REPLY_DELAY );
+      sprintf(ConfigPath, "%s.MinTimeout", dev->cName);
+      bus->dMinTimeout = TRepository_GetElementInt( ConfigPath, AIRTIME_MIN_TIMEOUT );
+
+      ADDTAIL( &BusList, &bus->Node );
+   }
+
+   if (bus->dBaudrate != dBaudrate)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "TAirtime: Bus '%s': %lu bit/s, reply delay %lu ms\n",
+                   dev->cName, (unsigned long)dBaudrate, 
+                   (unsigned long)bus->dReplyDelay ));
+      bus->dBaudrate = dBaudrate;
+   }
+
+   return bus;
+}
+
+//! [private] Airtime (ms, rounded up) of some chars at an line speed
+static DWORD TAirtime_CalcCharTime( DWORD dBaudrate, DWORD dChars )
+{
+   if (!dBaudrate) return 0;
+   return (dChars * AIRTIME_BITS_PER_CHAR * 1000 + dBaudrate - 1) / dBaudrate;
+}
+
+//! [private] Clears the seconds of the load window which are over...
+static void TAirtime_AdvanceWindow( TBusAirtime * bus, DWORD dNow )
+{
+   if (dNow < bus->dLastSec || dNow - bus->dLastSec >= AIRTIME_LOAD_WINDOW)
+   {
+      memset( bus->Busy, 0, sizeof(bus->Busy) );
+   }
+   else
+   {
+      DWORD sec;
+      for(sec = bus->dLastSec + 1; sec <= dNow; sec++)
+         bus->Busy[ sec % AIRTIME_LOAD_WINDOW ] = 0;
+   }
+   bus->dLastSec = dNow;
+}
+
+
+/**************************************************************************
+   Description   : Returns the line speed of an bus driver
+   Parameter     : dev = the bus driver
+   Return-Value  : bit/s, 0 => the bus has no airtime model (e.g. IP)
+**************************************************************************/
+DWORD TAirtime_GetBaudrate( TDevice * dev )
+{
+   TBusAirtime * bus;
+   DWORD dBaudrate = 0;
+
+   assert( dev );
+   os_thread_MutexLock( &BusList.Mutex );
+   bus = TAirtime_FindBus( dev );
+   if (bus) dBaudrate = bus->dBaudrate;
+   os_thread_MutexUnlock( &BusList.Mutex );
+
+   return dBaudrate;
+}
+
+/**************************************************************************
+   Description   : Time some chars need on the wire of the bus
+   Parameter     : dev    = the bus driver
+                   dChars = count of chars (as sent, with framing)
+   Return-Value  : time in ms, 0 => unknown
+**************************************************************************/
+DWORD TAirtime_GetCharTime( TDevice * dev, DWORD dChars )
+{
+   return TAirtime_CalcCharTime( TAirtime_GetBaudrate( dev ), dChars );
+}
+
+/**************************************************************************
+   Description   : Max. time of one SMAData packet on the wire (with
+                   SMAData head and protocol frame). The byte stuffing 
+                   is worst case: every char may be escaped
+   Parameter     : dev      = the bus driver
+                   dDataLen = size of the packet data
+   Return-Value  : time in ms, 0 => unknown
+**************************************************************************/
+DWORD TAirtime_GetPacketTime( TDevice * dev, DWORD dDataLen )
+{
+   return TAirtime_GetCharTime( dev, (AIRTIME_PKT_OVERHEAD + dDataLen) * 
+                                     AIRTIME_STUFFING_MAX );
+}
+
+//! [private] Request time (see below) on one bus...
+static DWORD TAirtime_GetBusRequestTime( TDevice * dev, DWORD dTxLength, DWORD dRxLength )
+{
+   DWORD dReplyDelay = 0;
+   DWORD dMinTimeout = 0;
+   DWORD dBaudrate = 0;
+   DWORD dMTU, dTime;
+   TBusAirtime * bus;
+
+   os_thread_MutexLock( &BusList.Mutex );
+   bus = TAirtime_FindBus( dev );
+   if (bus)
+   {
+      dBaudrate   = bus->dBaudrate;
+      dReplyDelay = bus->dReplyDelay;
+      dMinTimeout = bus->dMinTimeout;
+   }
+   os_thread_MutexUnlock( &BusList.Mutex );
+
+   //no airtime model or switched off...
+   if (!dBaudrate || !dReplyDelay) return 0;
+
+   //Requests larger than the MTU are sent in more than one packet, the 
+   //answer timer runs for each packet of the answer...
+   dMTU = TProtLayer_GetMTU( dev->DriverID );
+   if (!dMTU) dMTU = 255;
+   dRxLength = min(dRxLength, dMTU);
+
+   dTime = TAirtime_GetPacketTime( dev, dTxLength ) +
+           TAirtime_CalcCharTime( dBaudrate, (dTxLength / dMTU) * AIRTIME_PKT_OVERHEAD ) +
+           dReplyDelay +
+           TAirtime_GetPacketTime( dev, dRxLength );
+   return max( dTime, dMinTimeout );
+}
+
+/**************************************************************************
+   Description   : Max. time from sending an request until its answer
+                   is completely received: airtime of the request + 
+                   reply delay of the devices + airtime of the answer
+                   (at least "<driver>.MinTimeout")
+   Parameter     : DriverID  = the bus driver. INVALID_DRIVER_ID => the 
+                               request goes to all buses (the slowest counts)
+                   dTxLength = data size of the request
+                   dRxLength = (expected) data size of the answer
+   Return-Value  : time in ms, 0 => unknown. At least one bus has no
+                   airtime model
+**************************************************************************/
+DWORD TAirtime_GetRequestTime( DWORD DriverID, DWORD dTxLength, DWORD dRxLength )
+{
+   TDevice * dev;
+   DWORD dTime, dMaxTime = 0;
+
+   if (DriverID != INVALID_DRIVER_ID)
+   {
+      dev = TDriverLayer_FindDriverID( DriverID );
+      return dev ? TAirtime_GetBusRequestTime( dev, dTxLength, dRxLength ) : 0;
+   }
+
+   foreach_f( TDriverLayer_GetDeviceList(), dev )
+   {
+      if (dev->DeviceState != DS_ONLINE) continue;
+      dTime = TAirtime_GetBusRequestTime( dev, dTxLength, dRxLength );
+      if (!dTime) return 0;
+      dMaxTime = max( dMaxTime, dTime );
+   }
+
+   return dMaxTime;
+}
+
+
+/**************************************************************************
+   Description   : Accounts chars sent or received on an bus
+   Parameter     : dev    = the bus driver
+                   dChars = count of chars (as on the wire)
+   Return-Value  : ---
+**************************************************************************/
+void TAirtime_AddBusTime( TDevice * dev, DWORD dChars )
+{
+   TBusAirtime * bus;
+   DWORD dNow = os_GetSystemTime( NULL );
+
+   assert( dev );
+   os_thread_MutexLock( &BusList.Mutex );
+   bus = TAirtime_FindBus( dev );
+   if (bus && bus->dBaudrate)
+   {
+      TAirtime_AdvanceWindow( bus, dNow );
+      bus->Busy[ dNow % AIRTIME_LOAD_WINDOW ] += 
+                           TAirtime_CalcCharTime( bus->dBaudrate, dChars );
+   }
+   os_thread_MutexUnlock( &BusList.Mutex );
+}
+
+/**************************************************************************
+   Description   : Returns the utilisation of an bus: the airtime of the
+                   last AIRTIME_LOAD_WINDOW seconds
+   Parameter     : DriverID = the bus driver
+   Return-Value  : 0...100 (percent), 
+                   -1 => unknown driver or bus without airtime model
+**************************************************************************/
+int TAirtime_GetBusLoad( DWORD DriverID )
+{
+   TBusAirtime * bus;
+   TDevice * dev = TDriverLayer_FindDriverID( DriverID );
+   int iLoad = -1;
+
+   if (!dev) return -1;
+
+   os_thread_MutexLock( &BusList.Mutex );
+   bus = TAirtime_FindBus( dev );
+   if (bus && bus->dBaudrate)
+   {
+      DWORD dBusy = 0;
+      int i;
+      TAirtime_AdvanceWindow( bus, os_GetSystemTime( NULL ) );
+      for(i = 0; i < AIRTIME_LOAD_WINDOW; i++)
+         dBusy += bus->Busy[i];
+      iLoad = (int)min( (DWORD)100, dBusy / (AIRTIME_LOAD_WINDOW * 10) );
+   }
+   os_thread_MutexUnlock( &BusList.Mutex );
+
+   return iLoad;
+}
+
+//! The load of the busiest bus (statistic "BusLoad")
+int TAirtime_GetMaxBusLoad( void )
+{
+   TDevice * dev;
+   int iMax = 0;
+   foreach_f( TDriverLayer_GetDeviceList(), dev )
+   {
+      iMax = max( iMax, TAirtime_GetBusLoad( dev->DriverID ) );
+   }
+   return iMax;
+}
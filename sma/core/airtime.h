@@ -0,0 +1,53 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ * 
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ * 
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+#ifndef AIRTIME_H
+#define AIRTIME_H
+
+#include "device.h"
+
+/*
+** Airtime model of the bus drivers: How long does a frame need on the wire
+** at the line speed of the bus (only buses which know their baud rate, see
+** ioctrl "IOCTRL_GET_BAUDRATE")? Used for the timeouts of the IORequests
+** and for the utilisation ("load") of each bus...
+*/
+
+#define AIRTIME_BITS_PER_CHAR   10  /* 8N1: start bit + 8 data bits + stop bit    */
+#define AIRTIME_PKT_OVERHEAD    15  /* SMAData head (7) + SMANet frame (8)         */
+#define AIRTIME_STUFFING_MAX     2  /* worst case: every char is escaped (2 chars) */
+#define AIRTIME_LOAD_WINDOW     10  /* bus load is measured over the last x seconds*/
+#define AIRTIME_REPLY_DELAY   1000  /* default time (ms) a device needs to answer  */
+#define AIRTIME_MIN_TIMEOUT    500  /* default min. timeout (ms) of an request     */
+
+void  TAirtime_Constructor( void );
+void  TAirtime_Destructor( void );
+
+DWORD TAirtime_GetBaudrate( TDevice * dev );
+DWORD TAirtime_GetCharTime( TDevice * dev, DWORD dChars );
+DWORD TAirtime_GetPacketTime( TDevice * dev, DWORD dDataLen );
+DWORD TAirtime_GetRequestTime( DWORD DriverID, DWORD dTxLength, DWORD dRxLength );
+
+void  TAirtime_AddBusTime( TDevice * dev, DWORD dChars );
+int   TAirtime_GetBusLoad( DWORD DriverID );
+int   TAirtime_GetMaxBusLoad( void );
+
+#endif
@@ -109,6 +109,7 @@
 #include "driver_layer.h"
 
 #include "netpacket.h"
+#include "mempool.h"
 
 
 /**************************************************************************
@@ -124,6 +125,7 @@
 ***************************************************************************/
 
 TMinList FragQueues;               /* enthaelt alle Folgepaket-Serien */
+static TMemPool FragQueuePool;     /* thread save pool of the entries of "FragQueues" */
 
 
 /**************************************************************************
@@ -143,12 +145,13 @@ void TDefrag_Constructor()
 {
    //Listen initialisieren
    INITLIST( &FragQueues );
-
+   TMemPool_Init( &FragQueuePool, 1, MP_INFINITE_COUNT, sizeof(TFragQueue), TRUE );
 }
 
 void TDefrag_Destructor()
 {
-   
+   //(queues still in use are lost here)
+   TMemPool_Free( &FragQueuePool );
 }
 
 
@@ -208,8 +211,7 @@ struct TNetPacket * TDeFrag_Defrag(struct TSMADataHead * smadata,
 
       TIORequest * Req = NULL;
 
-      FoundQueue = os_malloc(sizeof(TFragQueue));
-      memset(FoundQueue, 0, sizeof(TFragQueue) );
+      FoundQueue = TMemPool_AllocElem( &FragQueuePool, MP_CLEAR );
       FoundQueue->BufferList         = TNetPacketManagement_GetPacket();
       FoundQueue->BusDriverID        = (BYTE)frame->RouteInfo.BusDriverID;
       FoundQueue->smadata.SourceAddr = smadata->SourceAddr;
@@ -309,7 +311,7 @@ struct TNetPacket * TDeFrag_Defrag(struct TSMADataHead * smadata,
       /* PaketQueue loeschen*/
       REMOVE( &FoundQueue->Node );
       TNetPacketManagement_FreeBuffer( FoundQueue->BufferList );
-      os_free( FoundQueue );
+      TMemPool_FreeElem( &FragQueuePool, FoundQueue );
 
       /* das zusammengefuegte Paket zurueckgeben  */
       *prozent = 100;
@@ -400,7 +402,7 @@ void TDeFrag_OnTimer( TFragQueue * queue )
       /* PaketQueue loeschen, da Inhalt nicht mehr gltig... */
       REMOVE( &queue->Node );
       TNetPacketManagement_FreeBuffer( queue->BufferList );
-      os_free( queue );
+      TMemPool_FreeElem( &FragQueuePool, queue );
    }
    else
    {
@@ -52,6 +52,7 @@
 #include "repository.h"
 #include "smadata_layer.h"
 #include "scheduler.h"
+#include "airtime.h"
 
 
 /**************************************************************************
@@ -70,6 +71,23 @@ SHARED_FUNCTION void (*FktInitYasdiModule)( void * RegistFuncPtr,
 
 SHARED_FUNCTION void (*_CleanupYasdiModule)( void );
 
+#ifdef YASDI_STATIC_DRIVER_SERIAL
+int  serial_InitYasdiModule( void * RegFuncPtr, TOnDriverEvent eventCallback );
+void serial_CleanupYasdiModule( void );
+#endif
+#ifdef YASDI_STATIC_DRIVER_IP
+int  ip_InitYasdiModule( void * RegFuncPtr, TOnDriverEvent eventCallback );
+void ip_CleanupYasdiModule( void );
+#endif
+#ifdef YASDI_STATIC_DRIVER_TCP
+int  tcp_InitYasdiModule( void * RegFuncPtr, TOnDriverEvent eventCallback );
+void tcp_CleanupYasdiModule( void );
+#endif
+#ifdef YASDI_STATIC_DRIVER_RECORDER
+int  recorder_InitYasdiModule( void * RegFuncPtr, TOnDriverEvent eventCallback );
+void recorder_CleanupYasdiModule( void );
+#endif
+
 
 /**************************************************************************
 ***** Global Constants ****************************************************
@@ -91,6 +109,27 @@ static DWORD NextUniqueDriverID;  /* Next unique driver ID for Driver registrati
 
 static T_MUTEX DriverAccessMutex; //Access to drivers...
 
+/*
+** The driver modules which are linked into YASDI (no "dlopen" needed).
+** Modules not found here are loaded as shared library...
+*/
+static struct TStaticDriverModule StaticDriverTable[] =
+{
+#ifdef YASDI_STATIC_DRIVER_SERIAL
+   { "yasdi_drv_serial",   serial_InitYasdiModule,   serial_CleanupYasdiModule   },
+#endif
+#ifdef YASDI_STATIC_DRIVER_IP
+   { "yasdi_drv_ip",       ip_InitYasdiModule,       ip_CleanupYasdiModule       },
+#endif
+#ifdef YASDI_STATIC_DRIVER_TCP
+   { "yasdi_drv_tcp",      tcp_InitYasdiModule,      tcp_CleanupYasdiModule      },
+#endif
+#ifdef YASDI_STATIC_DRIVER_RECORDER
+   { "yasdi_drv_recorder", recorder_InitYasdiModule, recorder_CleanupYasdiModule },
+#endif
+   { NULL,                 NULL,                     NULL                        }
+};
+
 
 /**************************************************************************
 ***** IMPLEMENTATION ******************************************************
@@ -131,6 +170,9 @@ void TDriverLayer_Constructor( void )
    //init Buffer management...
    TNetPacketManagement_Init();
 
+   //airtime and load of the buses...
+   TAirtime_Constructor();
+
    //begin Driver ID counting at ZERO...
    NextUniqueDriverID = 0;
 
@@ -142,19 +184,30 @@ void TDriverLayer_Constructor( void )
       TRepository_GetElementStr(ConfigPath, "?", DriverPath, sizeof(DriverPath) );
       if (strcmp(DriverPath,"?")==0) break; /* all drivers parsed ? */
       
+      NewModule = os_malloc( sizeof(TSharedLibElem) );
+      NewModule->Handle = (DLLHANDLE)NULL;
+
+      /* built-in driver? Then there is nothing to load... */
+      NewModule->Static = TDriverLayer_FindStaticModule( DriverPath );
+      if (NewModule->Static)
+      {
+         YASDI_DEBUG((VERBOSE_HWL,
+                      "TDriverLayer::Constructor(): Using built-in module '%s'\n",
+                      NewModule->Static->ModuleName ));
+         (*NewModule->Static->InitModule)( TDriverLayer_RegisterDevice, TSMAData_OnNewEvent );
+         ADDTAIL( &ModulList, &NewModule->Node );
+         continue;
+      }
+
       /**
        * Load the driver module and call the init function "InitYasdiModule"
        * of it...
        * 
-       * If your system have no dynamic libaries overload the functions
+       * If your system have no dynamic libaries build YASDI with 
+       * "YASDI_STATIC_DRIVERS" (see above) or overload the functions
        * "os_LoadLibrary()" and "os_FindLibrarySymbol()"
-       * in the "os specific include file"
-       * to use an static version where all modules are already linked
-       * to the main program...
-       * 
-      * So, we do not need to change something here to use static libs...
+       * in the "os specific include file"...
       */
-      NewModule = os_malloc( sizeof(TSharedLibElem) );
       NewModule->Handle = os_LoadLibrary( DriverPath );
       if (NewModule->Handle != (DLLHANDLE)NULL)
       {
@@ -191,6 +244,7 @@ void TDriverLayer_Constructor( void )
 
    /* Task zum Empfang von Frames einHaengen */
    RxService.TaskFunc = TDriverLayer_ReceiverThreadExecute;
+   TTask_SetDeadlineClass( &RxService, TDC_RESPONSE );
    TSchedule_AddTask( &RxService );
 
 }
@@ -221,6 +275,13 @@ void TDriverLayer_Destructor()
    //Unload all loaded Modules (shared libraries)
    foreach_f(&ModulList, CurDLL )
    {
+      //built-in module? Nothing to unload...
+      if (CurDLL->Static)
+      {
+         (*CurDLL->Static->CleanupModule)( );
+         continue;
+      }
+
       //Call Modul cleanup...
       _CleanupYasdiModule = os_GetSymbolRef( CurDLL->Handle, CleanupYasdiModule );
       if (_CleanupYasdiModule)
@@ -237,11 +298,47 @@ void TDriverLayer_Destructor()
    //free Buffer management...
    TNetPacketManagement_Destructor();
 
+   TAirtime_Destructor();
+
    //Free mutext for access to drivers...
    os_thread_MutexDestroy( &DriverAccessMutex );
 }
 
 
+/**************************************************************************
+   Description   : Searches a driver module which is linked into YASDI.
+                   Paths, the "lib" prefix and the file extension of the
+                   module name are ignored (e.g. "libyasdi_drv_ip.so"
+                   matches "yasdi_drv_ip")
+   Parameter     : ModuleName = name of the module from the config file
+   Return-Value  : the module or NULL if it must be loaded as shared library
+**************************************************************************/
+SHARED_FUNCTION struct TStaticDriverModule * TDriverLayer_FindStaticModule( char * ModuleName )
+{
+   struct TStaticDriverModule * module;
+   char * sep;
+   size_t len;
+
+   //skip the path...
+   if ((sep = strrchr( ModuleName, '/'  )) != NULL) ModuleName = sep + 1;
+   if ((sep = strrchr( ModuleName, '\\' )) != NULL) ModuleName = sep + 1;
+
+   //...the "lib" prefix and the extension
+   if (strncmp( ModuleName, "lib", 3 ) == 0) ModuleName += 3;
+   sep = strchr( ModuleName, '.' );
+   len = sep ? (size_t)(sep - ModuleName) : strlen( ModuleName );
+
+   for(module = StaticDriverTable; module->ModuleName; module++)
+   {
+      if (strlen( module->ModuleName ) == len &&
+          strncmp( module->ModuleName, ModuleName, len ) == 0)
+         return module;
+   }
+
+   return NULL;
+}
+
+
 
 /**************************************************************************
    Description   : Registriert einen Geraetetreiber aus Schicht 1
@@ -449,6 +546,9 @@ void TDriverLayer_write( struct TNetPacket * Frame )
                   Frame->RouteInfo.BusDriverPeer,
                   Frame->RouteInfo.Flags );
 
+   //the bus is busy while the frame is sent...
+   TAirtime_AddBusTime( driver, TNetPacket_GetFrameLength( Frame ) );
+
    //Access to driver ended
    os_thread_MutexUnlock( &DriverAccessMutex );
 }
@@ -471,6 +571,7 @@ DWORD TDriverLayer_read( TDevice * dev, BYTE * Buffer, DWORD dBufferSize, DWORD
 
    //Read from...
    dres = dev->Read(dev, Buffer, dBufferSize, DriverDeviceHandle);
+   if (dres > 0) TAirtime_AddBusTime( dev, dres );
 
    return dres;
 }
@@ -636,6 +737,15 @@ DWORD TDriverLayer_GetDriverMTU(DWORD DriverID)
 */
 
 
+//! An driver has signaled new input (event "DRE_NEW_INPUT", e.g. an 
+//! complete frame). Scan the drivers now and do not wait for the next 
+//! scheduler pass. Called from the driver's receive thread...
+void TDriverLayer_OnNewInput( void )
+{
+   TTask_Signal( &RxService );
+   TSchedule_WakeUp();
+}
+
 //! scans all bus drivers for input...
 SHARED_FUNCTION void TDriverLayer_ReceiverThreadExecute( void * ignore )
 {
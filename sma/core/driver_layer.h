@@ -63,9 +63,23 @@ typedef struct
 {
    TMinNode Node;
    DLLHANDLE Handle;
+   struct TStaticDriverModule * Static; //!= NULL => built-in module (no shared lib)
 } TSharedLibElem;
 
 
+/*
+** A driver module linked into YASDI itself (build option "YASDI_STATIC_DRIVERS").
+** The entries are resolved by module name ("DriverModules.DriverX") before
+** any shared library is searched...
+*/
+struct TStaticDriverModule
+{
+   char * ModuleName;
+   int  (*InitModule)( void * RegFuncPtr, TOnDriverEvent eventCallback );
+   void (*CleanupModule)( void );
+};
+
+
 
 /*
 ** Oeffentliche Prototypen ("public")
@@ -94,6 +108,9 @@ void TDriverLayer_SetAllDriversOffline( void );
 
 void TDriverLayer_OnNewEvent( TDevice * newdev,
                               TGenDriverEvent * event );
+void TDriverLayer_OnNewInput( void );
+
+SHARED_FUNCTION struct TStaticDriverModule * TDriverLayer_FindStaticModule( char * ModuleName );
 
 #define TDriverLayer_GetDriverName2(BusDriver) (BusDriver)->cName
 
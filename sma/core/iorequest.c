@@ -28,6 +28,7 @@
 SHARED_FUNCTION TIORequest * TIORequest_Constructor()
 {
    TIORequest * req = os_malloc( sizeof(TIORequest) );
+   if (req) memset( req, 0, sizeof(TIORequest) );
    return req;
 
 }
@@ -42,6 +42,9 @@ typedef enum
 	RT_NORCV							/* Es wird auf keine Antwort gewartet     (z.B. CMD_SYN_ONLINE) */
 } TReqType;	
 
+/* unknown size of the answer ("RxLength"): expect one full packet */
+#define IOREQ_RXLENGTH_UNKNOWN 0xffff
+
 
 
 //structure with all infos about the received message...
@@ -79,6 +82,9 @@ typedef struct _TIORequest
 		TMinNode Node;					/* Zum Verketten mehrerer IORequests */
 		TMinTimer Timer;				/* Timer fuer den Empfang der Antwort(en);
 											bei Folgepaketen die Zeit fuerr das ERSTE Paket! */
+		DWORD RouteBusDriverID;    /* path of the last sending (for the route statistic)... */
+		DWORD RouteBusDriverPeer;
+		DWORD dRouteTxTime;        /* ...and its time (os_GetMonotonicTime(), ms) */
 	//public
 		/* verschiedenes */
 		TReqStatus Status;		/* Status des IORequests: RS_FINISH, RS_BUSY, RS_TIMEOUT */
@@ -101,6 +107,9 @@ typedef struct _TIORequest
 		/* Empfangsbereich */
 		DWORD TimeOut;				/* Timeout fuer das Empfangen der Antwort */
 		DWORD Repeats;				/* Sendewiederholgungen bei Empfangstimeout */
+		DWORD RxLength;			/* expected size of the answer: The timeout is 
+                                    derived from the airtime of the bus (if known). 
+                                    0 => always use "TimeOut" */
 
 
 		/* Ereignishandler ( callback handler ) */
@@ -23,6 +23,10 @@
 #include "lists.h"
 #include "mempool.h"
 
+//! Lock the pool (only if it was created thread save)
+#define MP_LOCK(me)   { if ((me)->threading) os_thread_MutexLock(&(me)->poolList.Mutex);   }
+#define MP_UNLOCK(me) { if ((me)->threading) os_thread_MutexUnlock(&(me)->poolList.Mutex); }
+
 /*
 TMemPool * TMemPool_Constructor(int mincount, 
                                 int maxcount, 
@@ -44,19 +48,23 @@ void TMemPool_Init(TMemPool * me,
 {
    int i;
    
-   //all elements must be aligned to 4 bytes boundary to be save...
-   //the smalest size is now 4 bytes...
-   if ((elementsize & 0x3))
+   //An unused element holds the list node of the pool list, so it can't be
+   //smaller. All elements must be aligned (the pre allocated ones are one 
+   //block), so round the size up to the next multiple of MP_ALIGNMENT...
+   if (elementsize < (int)sizeof(TMinNode))
    {
-      elementsize = (elementsize & 0x03)+4;
+      elementsize = sizeof(TMinNode);
    }
+   elementsize = MP_ALIGN(elementsize);
    
    me->mincount = mincount;    
    me->maxcount = maxcount;
    me->elementsize = elementsize;
    me->threading  = threading;
    me->currcount = 0;
-   INITLIST(&me->poolList);
+   me->usedmax   = 0;
+   me->syscount  = 0;
+   INITLIST(&me->poolList); //(the list mutex is the mutex of the pool)
    
    //allocate the minimum selements whiche were only freed when destructing
    //...as one block....
@@ -81,10 +89,11 @@ void TMemPool_Free(TMemPool * me)
    //which are not freed at once...
    size_t lowptr  = (size_t)me->preAllocElems;
    size_t highptr = (size_t)(me->preAllocElems + (me->mincount * me->elementsize));
+   TMinNode * n;
    
+   MP_LOCK(me);
    
    //Free all memory from list of unsed elements...
-   TMinNode * n = (TMinNode*)GETFIRST(&me->poolList );
    while( ISELEMENTVALID ( n = (TMinNode*)GETFIRST(&me->poolList ) ) )
    {
       //remove from list
@@ -99,7 +108,16 @@ void TMemPool_Free(TMemPool * me)
    }
    
    //Free the bloc of pre allocated elements...
-   os_free( me->preAllocElems );
+   if (me->preAllocElems)
+   {
+      os_free( me->preAllocElems );
+      me->preAllocElems = NULL;
+   }
+   me->mincount = 0;
+   
+   MP_UNLOCK(me);
+   
+   os_thread_MutexDestroy( &me->poolList.Mutex );
 }
 
 /*
@@ -115,34 +133,102 @@ void TMemPool_Destructor(TMemPool * me)
 
 void * TMemPool_AllocElem( TMemPool * me, BYTE flags )
 {
-   void * e;
+   void * e = NULL;
+   
+   MP_LOCK(me);
+   
    //too much elements in use?
-   if (me->currcount >= me->maxcount)
-      return NULL;
-   me->currcount++;
-
-   //something in unsed elements list?
-   e = GETFIRST(&me->poolList);
-   if (ISELEMENTVALID(e) )
+   if (me->currcount < me->maxcount)
    {
-      REMOVE((TMinNode*)e);
+      //something in unsed elements list?
+      e = GETFIRST(&me->poolList);
+      if (ISELEMENTVALID(e) )
+      {
+         REMOVE((TMinNode*)e);
+      }
+      else
+      {
+         //alloc an new element...
+         e = os_malloc(me->elementsize);
+         assert(e);
+         me->syscount++;
+      }
       
-      if (flags == MP_CLEAR)
-         memset(e, me->elementsize, 0);
-   }
-   else
-   {
-      //alloc an new element...
-      e = os_malloc(me->elementsize);
-      assert(e);
+      //statistic...
+      me->currcount++;
+      if (me->currcount > me->usedmax) me->usedmax = me->currcount;
    }
+   
+   MP_UNLOCK(me);
+   
+   if (e && flags == MP_CLEAR)
+      memset(e, 0, me->elementsize);
+
    return e;
 }
 
 void TMemPool_FreeElem(TMemPool * me, void * elem )
 {
+   assert(elem);
+   
    //lay it back to list...
+   MP_LOCK(me);
    ADDHEAD(&me->poolList, ((TMinNode*)elem));
    me->currcount--;
+   MP_UNLOCK(me);
+}
+
+int TMemPool_GetUsedCount(TMemPool * me)
+{
+   return me->currcount;
 }
 
+int TMemPool_GetUsedMax(TMemPool * me)
+{
+   return me->usedmax;
+}
+
+
+
+void TMemArena_Init(TMemArena * me, DWORD size)
+{
+   me->used  = 0;
+   me->size  = 0;
+   me->mem   = NULL;
+   me->block = NULL;
+   
+   //(os_malloc can't allocate more than 64k in debug builds)
+   if (size && size + MP_ALIGNMENT - 1 <= 0xffff)
+   {
+      //os_malloc is not aligned in debug builds (size in front of the block), 
+      //so allocate a bit more and align the start of the block...
+      //(the whole block is zeroed here (once) by os_malloc)
+      me->mem = os_malloc( size + MP_ALIGNMENT - 1 );
+      if (me->mem)
+      {
+         me->block = (BYTE*)MP_ALIGN( (size_t)me->mem );
+         me->size  = size;
+      }
+   }
+}
+
+void TMemArena_Free(TMemArena * me)
+{
+   if (me->mem) os_free( me->mem );
+   me->mem   = NULL;
+   me->block = NULL;
+   me->size  = 0;
+   me->used  = 0;
+}
+
+void * TMemArena_Alloc(TMemArena * me, DWORD size)
+{
+   void * e;
+   size = MP_ALIGN(size);
+   if (me->used + size > me->size)
+      return NULL;
+   
+   e = me->block + me->used;
+   me->used += size;
+   return e;
+}
@@ -33,7 +33,10 @@ enum {
        MP_CLEAR=1,                  //!< clear the memory
        MP_NOFLAGS=0                 //!< dummy flag for "no flags"...
 };
-#define  MP_INFINITE_COUNT  0xffffL  //!< unlimited count of allocating elements...
+#define  MP_INFINITE_COUNT  0xffffL  //!< unlimited count of allocating elements...
+#define  MP_ALIGNMENT       8        //!< alignment (and size granularity) of elements
+                                     //!< (pool elements: relative to the os_malloc result)
+#define  MP_ALIGN(size)     (((size) + MP_ALIGNMENT - 1) & ~(MP_ALIGNMENT - 1))
 
 typedef struct
 {
@@ -42,8 +45,10 @@ typedef struct
    int mincount;     //count of elements which are allocated in the beginning...
    int maxcount;     //the maximum count of elements
    int currcount;    //current count of used elements
+   int usedmax;      //high-water mark of "currcount"
+   int syscount;     //count of elements allocated from the system (os_malloc)
    int elementsize;  //the size of an element...
-   BOOL threading;  //Make the pool threadsave
+   BOOL threading;  //Make the pool threadsave (using the mutex of "poolList")
      
 } TMemPool;
 
@@ -72,7 +77,29 @@ SHARED_FUNCTION void TMemPool_Destructor(TMemPool * me);
 SHARED_FUNCTION void TMemPool_Free(TMemPool * me);
 
 SHARED_FUNCTION void * TMemPool_AllocElem( TMemPool * me, BYTE flags );
-SHARED_FUNCTION void TMemPool_FreeElem(TMemPool * me, void * elem );
+SHARED_FUNCTION void TMemPool_FreeElem(TMemPool * me, void * elem );
+
+//! statistic: count of elements in use and the maximum of it
+SHARED_FUNCTION int TMemPool_GetUsedCount(TMemPool * me);
+SHARED_FUNCTION int TMemPool_GetUsedMax(TMemPool * me);
+
+
+/** An memory arena: One block of memory (sized up front) where objects of
+*   different sizes are taken from one after another. They can't be freed 
+*   alone, only the whole arena at once. Not thread save.
+*/
+typedef struct
+{
+   BYTE * mem;       //the memory as allocated (for freeing it)
+   BYTE * block;     //the memory block, aligned to MP_ALIGNMENT (NULL if none)
+   DWORD size;       //size of the block
+   DWORD used;       //bytes already taken from the block
+} TMemArena;
+
+SHARED_FUNCTION void TMemArena_Init(TMemArena * me, DWORD size);
+SHARED_FUNCTION void TMemArena_Free(TMemArena * me);
+//! returns NULL if there is not enough space left (use os_malloc then)
+SHARED_FUNCTION void * TMemArena_Alloc(TMemArena * me, DWORD size);
 
 /** @} */ // end of mempool
 
@@ -44,6 +44,8 @@
 #include "statistic_writer.h"
 #include "tools.h"
 #include "minqueue.h"
+#include "repository.h"
+#include "mempool.h"
 
 
 /*******************************************************************************
@@ -55,8 +57,14 @@ enum
    DEFAULT_HEAD_ROOM = 10,  // Default: 10 bytes for headroom
    DEFAULT_TAIL_ROOM = 20,  // Default: 20 bytes place for tailroom
    DEFAULT_TAIL_ROOM_MAX = 255, // Max packet: 255 bytes place for tailroom   
+   SHARE_MIN_SIZE = 16,     // Copy: fragments with at least x bytes are shared, not copied
+   FRAG_CLASS_MIN_SHIFT = 5,// smallest size class of fragments: 32 bytes
+   FRAG_CLASS_COUNT = 5,    // size classes of 32, 64, 128, 256 and 512 bytes
 };
 
+//!size of the data area of the fragments of a size class
+#define FRAG_CLASS_SIZE(iClass) ((WORD)(1 << ((iClass) + FRAG_CLASS_MIN_SHIFT)))
+
 
 
 /*
@@ -67,6 +75,18 @@ enum
  --------------------      <---- pData + offset.tail ---- |
  |     tailroom     |                                     |
  --------------------      <---- pData + offset.end -------
+
+ Copying a packet does not copy the data of its (bigger) fragments. The copy
+ gets "reference fragments" instead (no own data area, "Shared" points to
+ the fragment with the data). As long as a fragment is shared it is read only
+ (copy on write): it has no headroom and no tailroom, so data added to the
+ packet goes to new fragments. A shared fragment freed by its packet is kept
+ until the last reference is freed.
+
+ The data area of a fragment (headroom + tailroom) is always the size of its
+ size class (a power of two, see FRAG_CLASS_SIZE). Unused fragments are kept
+ in a list per size class, so getting and freeing one takes no search and a
+ small fragment never takes the buffer of a big one.
  */
 
 
@@ -74,7 +94,7 @@ enum
 /*
  ** structure for NetBuffer fragments
  */
-typedef struct 
+typedef struct _TNetPacketFrag
 {
    TMinNode Node;         /* Zum Verketten von Pufferfragmenten */
    WORD BufferSize;    /* die Groessee des nachfolgenden Dateninhalts */
@@ -84,14 +104,17 @@ typedef struct
       WORD tail;       //Offset to tail area
       WORD end;        //Offset to end of the packet
    } offset;
+   struct _TNetPacketFrag * Shared; //reference fragment: the fragment with the data (else NULL)
+   WORD RefCount;      //count of reference fragments to this one
+   BOOL bOrphan;       //freed by its packet, but still referenced
 } TNetPacketFrag;
 
 void TNetPacketFrag_Destructor(TNetPacketFrag * frag);
-void TNetPacketFrag_Init ( TNetPacketFrag * frag, BYTE headroom, BYTE tailroom);
+void TNetPacketFrag_Init ( TNetPacketFrag * frag, BYTE headroom, WORD tailroom);
 void TNetPacketFrag_Clear( TNetPacketFrag * frag );
 WORD TNetPacketFrag_GetHeadRoomSize(TNetPacketFrag * frag);
 WORD TNetPacketFrag_GetTailRoomSize(TNetPacketFrag * frag);
-TNetPacketFrag * TNetPacketFrag_Constructor(BYTE headroom, BYTE tailroom);
+TNetPacketFrag * TNetPacketFrag_Constructor(BYTE headroom, WORD tailroom);
 void TNetPacketFrag_ResizeHeadroom(TNetPacketFrag * frag, BYTE headroom);
 
 
@@ -100,13 +123,27 @@ void TNetPacketFrag_ResizeHeadroom(TNetPacketFrag * frag, BYTE headroom);
 //!Get the data pointer to the memory behind the NetBufferFragemnt 
 #define TNetPacketFrag_GetBufferPtrBehind(frag) (BYTE*)(((BYTE*)frag) + sizeof(TNetPacketFrag ))
 
+//!Is the data of the fragment shared with other packets (read only)?
+#define TNetPacketFrag_IsShared(frag) ((frag)->Shared || (frag)->RefCount)
+
 
 void TNetPacketManagement_FreeFragment(TNetPacketFrag * frag);
 int TNetPacketManagement_GetFragmentCount( void );
 
 int unusedFragmentsCount=0;
 
-TMinList unusedFragments;        //list of currently unused fragments...
+//! the unused fragments of one size class
+typedef struct
+{
+   TMinList unusedFragments;     //list of currently unused fragments...
+   int iUnused;                  //count of them
+   int iUsed;                    //count of fragments in use
+   int iUsedMax;                 //high-water mark of "iUsed"
+} TFragSizeClass;
+
+TFragSizeClass fragSizeClasses[FRAG_CLASS_COUNT];
+int iMaxUnusedFragments = 0;     //max. unused fragments per size class (0 = no limit)
+TMemPool refFragmentPool;        //thread save pool of reference fragments...
 TMinQueue  unsedPacketsQueue;    //queue of currently unsed packets...
 
 
@@ -118,14 +155,45 @@ TMinQueue  unsedPacketsQueue;    //queue of currently unsed packets...
 
 void TNetPacketManagement_Init( void )
 {
-   INITLIST(&unusedFragments);
+   int i;
+   for(i = 0; i < FRAG_CLASS_COUNT; i++)
+   {
+      INITLIST(&fragSizeClasses[i].unusedFragments);
+      fragSizeClasses[i].iUnused  = 0;
+   }
+   unusedFragmentsCount = 0;
+   //(a reference fragment needs no data area behind)
+   TMemPool_Init(&refFragmentPool, 0, MP_INFINITE_COUNT, sizeof(TNetPacketFrag), TRUE);
    TMinQueue_Init( &unsedPacketsQueue );
+
+   //keep not more unused fragments (per size class) than this. The rest is freed
+   iMaxUnusedFragments = TRepository_GetElementInt("Misc.MaxUnusedBufferFrags", 0);
 }
 
 void TNetPacketManagement_Destructor( void )
 {
+   TNetPacketFrag * frag;
+   int i;
 
-   
+   //free all unused fragments (the ones in use are freed with their packets)
+   for(i = 0; i < FRAG_CLASS_COUNT; i++)
+   {
+      YASDI_DEBUG((VERBOSE_BUFMANAGEMENT,
+                   "Fragments of %u bytes: used max. %d, unused %d\n",
+                   FRAG_CLASS_SIZE(i), fragSizeClasses[i].iUsedMax, 
+                   fragSizeClasses[i].iUnused));
+      while(ISELEMENTVALID(frag = (TNetPacketFrag *)GETFIRST(&fragSizeClasses[i].unusedFragments)))
+      {
+         REMOVE(&frag->Node);
+         TNetPacketFrag_Destructor( frag );
+      }
+      fragSizeClasses[i].iUnused = 0;
+   }
+   unusedFragmentsCount = 0;
+
+   YASDI_DEBUG((VERBOSE_BUFMANAGEMENT, "Reference fragments: used max. %d\n",
+                TMemPool_GetUsedMax(&refFragmentPool)));
+   TMemPool_Free(&refFragmentPool);
 }
 
 
@@ -134,6 +202,29 @@ int TNetPacketManagement_GetFragmentCount( void )
    return unusedFragmentsCount;
 }
 
+//! high-water mark of the fragments in use (all size classes)
+int TNetPacketManagement_GetFragmentHighWater( void )
+{
+   int i, iMax = 0;
+   for(i = 0; i < FRAG_CLASS_COUNT; i++)
+      iMax += fragSizeClasses[i].iUsedMax;
+   return iMax;
+}
+
+//! Get the size class for fragments with "size" bytes of data area
+static TFragSizeClass * TNetPacketManagement_GetSizeClass(WORD size, int * piClass)
+{
+   //size class of the sizes 1..32, 33..64, 65..96,...,481..512
+   static const BYTE sizeClassOf[16] = { 0, 1, 2, 2, 3, 3, 3, 3, 
+                                         4, 4, 4, 4, 4, 4, 4, 4 };
+   int iClass;
+
+   assert(size <= FRAG_CLASS_SIZE(FRAG_CLASS_COUNT - 1));
+   iClass = size ? sizeClassOf[ (size - 1) >> FRAG_CLASS_MIN_SHIFT ] : 0;
+   if (piClass) *piClass = iClass;
+   return &fragSizeClasses[iClass];
+}
+
 //! Get an new unused packet...
 struct TNetPacket * TNetPacketManagement_GetPacket( void )
 {
@@ -176,7 +267,8 @@ void TNetPacketManagement_FreeBuffer(struct TNetPacket * frame)
       if (!ISELEMENTVALID( firstFrag) ) break;
 
       //is this the last fragment in buffer? => End...
-      if (lastFrag == firstFrag)
+      //(shared ones are freed too, they can't be reused in place)
+      if (lastFrag == firstFrag && !TNetPacketFrag_IsShared(firstFrag))
       {
          //only clear last fragment...
          TNetPacketFrag_Clear(firstFrag);
@@ -193,48 +285,110 @@ void TNetPacketManagement_FreeBuffer(struct TNetPacket * frame)
    return;
 }
 
-TNetPacketFrag * TNetPacketManagement_GetFragment(BYTE headroom, BYTE tailroom)
+TNetPacketFrag * TNetPacketManagement_GetFragment(BYTE headroom, WORD tailroom)
 {
-   TNetPacketFrag * frag;
-   foreach_f(&unusedFragments, frag)
+   int iClass;
+   TFragSizeClass * sizeClass = TNetPacketManagement_GetSizeClass( 
+                                   (WORD)(headroom + tailroom), &iClass );
+   TNetPacketFrag * frag = (TNetPacketFrag *)GETFIRST(&sizeClass->unusedFragments);
+   if (ISELEMENTVALID(frag))
    {
-      //is fragment big enough?
-      if (TNetPacketFrag_GetTailRoomSize(frag)+TNetPacketFrag_GetHeadRoomSize(frag) >= 
-          tailroom+headroom )
-      {
-         //clear fragent contant
-         TNetPacketFrag_Clear(frag);
-         //resize headroom..
-         TNetPacketFrag_ResizeHeadroom(frag, headroom);
-         //remove fragment from list of unsed fragments...
-         REMOVE(&frag->Node);
-         unusedFragmentsCount--;
-         //..and return fragment...
-         return frag;
-      }
+      //remove fragment from list of unsed fragments...
+      REMOVE(&frag->Node);
+      sizeClass->iUnused--;
+      unusedFragmentsCount--;
+      //clear fragent contant and resize headroom..
+      TNetPacketFrag_Clear(frag);
+      TNetPacketFrag_ResizeHeadroom(frag, headroom);
    }
-   
-   //no fragments fits the needed size...get an new one...
-   return TNetPacketFrag_Constructor(headroom,tailroom);
+   else
+   {
+      //no unused fragment of that size...get an new one (the rest is tailroom)
+      frag = TNetPacketFrag_Constructor(headroom, 
+                                        (WORD)(FRAG_CLASS_SIZE(iClass) - headroom));
+      if (!frag) return NULL;
+   }
+
+   if (++sizeClass->iUsed > sizeClass->iUsedMax) 
+      sizeClass->iUsedMax = sizeClass->iUsed;
+   return frag;
 }
 
 void TNetPacketManagement_FreeFragment(TNetPacketFrag * frag)
 {
+   TNetPacketFrag * owner = frag->Shared;
+
+   if (owner)
+   {
+      //reference fragment: free it and the referenced one with the last reference
+      frag->Shared = NULL;
+      TMemPool_FreeElem(&refFragmentPool, frag);
+      if (--owner->RefCount == 0 && owner->bOrphan)
+      {
+         owner->bOrphan = FALSE;
+         TNetPacketManagement_FreeFragment( owner );
+      }
+      return;
+   }
+
+   if (frag->RefCount)
+   {
+      //still referenced by other packets, keep the data until they are freed...
+      frag->bOrphan = TRUE;
+      return;
+   }
+
+   {
+   //the data area ("end") is the size of the size class...
+   TFragSizeClass * sizeClass = TNetPacketManagement_GetSizeClass(frag->offset.end, NULL);
+   sizeClass->iUsed--;
+   if (iMaxUnusedFragments > 0 && sizeClass->iUnused >= iMaxUnusedFragments)
+   {
+      //enough unused fragments of that size...
+      TNetPacketFrag_Destructor( frag );
+      return;
+   }
+
    TNetPacketFrag_Clear(frag);
-   ADDHEAD(&unusedFragments, &frag->Node);
+   ADDHEAD(&sizeClass->unusedFragments, &frag->Node);
+   sizeClass->iUnused++;
    unusedFragmentsCount++;
+   }
+}
+
+//! Get an reference fragment to the data of "frag" (without copying it)
+static TNetPacketFrag * TNetPacketManagement_GetRefFragment(TNetPacketFrag * frag)
+{
+   TNetPacketFrag * owner = frag->Shared ? frag->Shared : frag;
+   TNetPacketFrag * ref = TMemPool_AllocElem(&refFragmentPool, MP_NOFLAGS);
+   assert(ref);
+
+   //the offsets of an reference are relative to the data area of the owner
+   ref->offset.data = frag->offset.data;
+   ref->offset.tail = (WORD)(frag->offset.data + frag->BufferSize);
+   ref->offset.end  = ref->offset.tail;
+   ref->BufferSize  = frag->BufferSize;
+   ref->Shared      = owner;
+   ref->RefCount    = 0;
+   ref->bOrphan     = FALSE;
+   owner->RefCount++;
+
+   return ref;
 }
 
 
 
 
 
-void TNetPacketFrag_Init(TNetPacketFrag * frag, BYTE headroom, BYTE tailroom)
+void TNetPacketFrag_Init(TNetPacketFrag * frag, BYTE headroom, WORD tailroom)
 {
    frag->offset.data = headroom;
    frag->offset.tail = headroom;
    frag->offset.end  = (WORD)((WORD)headroom + (WORD)tailroom);
    frag->BufferSize  = 0; //noch nichts drin, nur Platz fuer tailroom und headroom
+   frag->Shared      = NULL;
+   frag->RefCount    = 0;
+   frag->bOrphan     = FALSE;
 }
 
 void TNetPacketFrag_Clear( TNetPacketFrag * frag )
@@ -253,7 +407,7 @@ void TNetPacketFrag_ResizeHeadroom(TNetPacketFrag * frag, BYTE headroom)
    frag->offset.tail = headroom;
 }
 
-TNetPacketFrag * TNetPacketFrag_Constructor(BYTE headroom, BYTE tailroom)
+TNetPacketFrag * TNetPacketFrag_Constructor(BYTE headroom, WORD tailroom)
 {
    int size = sizeof(TNetPacketFrag ) + headroom + tailroom;
    TNetPacketFrag * frag = os_malloc( size );
@@ -280,11 +434,15 @@ void TNetPacketFrag_Destructor(TNetPacketFrag * frag)
 
 WORD TNetPacketFrag_GetHeadRoomSize(TNetPacketFrag * frag)
 {
+   //shared data is read only...
+   if (TNetPacketFrag_IsShared(frag)) return 0;
    return frag->offset.data;
 }
 
 WORD TNetPacketFrag_GetTailRoomSize(TNetPacketFrag * frag)
 {
+   //shared data is read only...
+   if (TNetPacketFrag_IsShared(frag)) return 0;
    return (WORD)(frag->offset.end - frag->offset.tail);
 }
 
@@ -295,7 +453,8 @@ WORD TNetPacketFrag_GetDataSize(TNetPacketFrag * frag)
 
 BYTE * TNetPacketFrag_GetDataPtr(TNetPacketFrag * frag)
 {
-   return TNetPacketFrag_GetBufferPtrBehind(frag) + frag->offset.data;
+   TNetPacketFrag * owner = frag->Shared ? frag->Shared : frag;
+   return TNetPacketFrag_GetBufferPtrBehind(owner) + frag->offset.data;
 }
 
 void TNetPacketFrag_AddHead(TNetPacketFrag * frag, BYTE * data, WORD len)
@@ -350,7 +509,7 @@ BOOL TNetPacketFrag_RemHead(TNetPacketFrag * frag, WORD iCount, BYTE * linearDst
    
    //if someone wants to know what I remove now, here ist it...
    if (linearDstbuffer)
-      os_memcpy(linearDstbuffer, TNetPacketFrag_GetBufferPtrBehind(frag) + frag->offset.data, iCount );
+      os_memcpy(linearDstbuffer, TNetPacketFrag_GetDataPtr(frag), iCount );
    frag->offset.data += iCount;
    frag->BufferSize -= iCount;
    return TRUE;
@@ -586,7 +745,7 @@ SHARED_FUNCTION BOOL TNetPacket_RemHead(struct TNetPacket * frame,
          bres = TNetPacketFrag_RemHead(FirstFrameFrag, bufSizeToRemove, (BYTE*)Buffer);
 
          iCount -= bufSizeToRemove; //decrement byte count
-         Buffer += bufSizeToRemove; //move ahead data pointer...
+         if (Buffer) Buffer += bufSizeToRemove; //move ahead data pointer...
 
          //TODO: maybe remove Fragment from buffer...
          if ( 0 == TNetPacketFrag_GetDataSize(FirstFrameFrag) )
@@ -600,10 +759,24 @@ SHARED_FUNCTION BOOL TNetPacket_RemHead(struct TNetPacket * frame,
 }
 
 
+//! Has the packet already an fragment with the data of "frag"?
+static BOOL TNetPacket_IsSharingWith(struct TNetPacket * frame, TNetPacketFrag * frag)
+{
+   TNetPacketFrag * owner = frag->Shared ? frag->Shared : frag;
+   TNetPacketFrag * CurFrag;
+   foreach_f( &frame->Fragments, CurFrag )
+   {
+      if (CurFrag == owner || CurFrag->Shared == owner) return TRUE;
+   }
+   return FALSE;
+}
+
 /**************************************************************************
    Description   : Haenge den Inhalt eines Frames in einen anderen Frame an.
                    Der Source-Frame wird nicht veraendert. Der Zielframe
                    wird vorher nicht geLoescht (anfuegen).
+                   Bigger fragments are not copied but shared with the
+                   source frame (see above).
    Parameter     : Destframe   = Zielframe
                    Sourceframe = Quellframe
    Return-Value  : ---
@@ -618,9 +791,20 @@ SHARED_FUNCTION void TNetPacket_Copy(struct TNetPacket * DestFrame,
 
    foreach_f( &SourceFrame->Fragments, FrameFrag )
    {
-      TNetPacket_AddTail( DestFrame, 
-                          TNetPacketFrag_GetDataPtr(FrameFrag), 
-                          TNetPacketFrag_GetDataSize(FrameFrag)  );
+      //share it, but the same data only once in a packet: the fragments are
+      //identified by their data pointer (TNetPacket_GetNextFragment())
+      if (TNetPacketFrag_GetDataSize(FrameFrag) >= SHARE_MIN_SIZE &&
+          !TNetPacket_IsSharingWith(DestFrame, FrameFrag))
+      {
+         TNetPacketFrag * ref = TNetPacketManagement_GetRefFragment( FrameFrag );
+         ADDTAIL( &DestFrame->Fragments, &ref->Node );
+      }
+      else
+      {
+         TNetPacket_AddTail( DestFrame, 
+                             TNetPacketFrag_GetDataPtr(FrameFrag), 
+                             TNetPacketFrag_GetDataSize(FrameFrag)  );
+      }
    }
    
    /* Clone rest of the packet... */
@@ -679,6 +863,82 @@ SHARED_FUNCTION void TNetPacket_CopyFromBuffer( struct TNetPacket * frame,
    }
 }
 
+/**************************************************************************
+   Description   : Get the data of the packet in place, if it is in one
+                   piece (one fragment). Nothing is copied.
+   Parameter     : frame = "this"-Pointer
+                   size  = returns the size of the data
+   Return-Value  : pointer to the data or NULL if the packet consists of
+                   several fragments (use "TNetPacket_CopyFromBuffer()")
+**************************************************************************/
+SHARED_FUNCTION BYTE * TNetPacket_GetContiguousData( struct TNetPacket * frame,
+                                                     DWORD * size )
+{
+   TNetPacketFrag * CurFrag;
+   TNetPacketFrag * DataFrag = NULL;
+
+   foreach_f( &frame->Fragments, CurFrag  )
+   {
+      if (TNetPacketFrag_GetDataSize(CurFrag) == 0) continue;
+      if (DataFrag) return NULL; //data in more than one fragment
+      DataFrag = CurFrag;
+   }
+
+   if (!DataFrag) return NULL;
+   *size = TNetPacketFrag_GetDataSize(DataFrag);
+   return TNetPacketFrag_GetDataPtr(DataFrag);
+}
+
+/**************************************************************************
+   Description   : Get a contiguous area of at least "size" bytes behind 
+                   the data of the packet. A receiver can write into it
+                   directly and add the written bytes to the packet with
+                   "TNetPacket_ExtendTail()" (no copy of the data).
+                   The area stays valid until the packet is changed.
+   Parameter     : frame = "this"-Pointer
+                   size  = needed size (max. 512 bytes)
+   Return-Value  : pointer to the area or NULL (no memory)
+**************************************************************************/
+SHARED_FUNCTION BYTE * TNetPacket_GetTailRoom( struct TNetPacket * frame,
+                                               WORD size )
+{
+   TNetPacketFrag * frag = (TNetPacketFrag *)GETLAST(&frame->Fragments);
+   if (ISELEMENTVALID(frag))
+   {
+      if (TNetPacketFrag_GetTailRoomSize(frag) >= size)
+         return TNetPacketFrag_GetBufferPtrBehind(frag) + frag->offset.tail;
+
+      //an empty fragment which is to small: replace it
+      if (TNetPacketFrag_GetDataSize(frag) == 0)
+      {
+         REMOVE( &frag->Node );
+         TNetPacketManagement_FreeFragment( frag );
+      }
+   }
+
+   frag = TNetPacketManagement_GetFragment( 0, size );
+   if (!frag) return NULL;
+   ADDTAIL( &frame->Fragments, &frag->Node );
+   return TNetPacketFrag_GetBufferPtrBehind(frag) + frag->offset.tail;
+}
+
+/**************************************************************************
+   Description   : Adds "size" bytes written into the area returned by
+                   "TNetPacket_GetTailRoom()" to the packet
+   Parameter     : frame = "this"-Pointer
+                   size  = count of bytes written
+   Return-Value  : ---
+**************************************************************************/
+SHARED_FUNCTION void TNetPacket_ExtendTail( struct TNetPacket * frame,
+                                            WORD size )
+{
+   TNetPacketFrag * frag = (TNetPacketFrag *)GETLAST(&frame->Fragments);
+   assert(ISELEMENTVALID(frag));
+   assert(TNetPacketFrag_GetTailRoomSize(frag) >= size);
+   frag->offset.tail += size;
+   frag->BufferSize  += size;
+}
+
 
 //! Get next buffer fragment...
 SHARED_FUNCTION BYTE * TNetPacket_GetNextFragment( struct TNetPacket * frame, 
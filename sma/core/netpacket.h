@@ -69,6 +69,8 @@ typedef struct
                                YASDI core ignore the content of it...                         */
    TDriverSendFlags Flags;  /* The sending flags for the frame (Broadcast/Monocast)           */
    BYTE bTransProtID;       /* The packet should be sended or received in this transport protocol */
+   DWORD dRxTime;           /* Receive time (os_GetMonotonicTime(), ms). Set by the protocol 
+                               layer for received packets                                     */
 } TNetPacketRouteInfo;
 
 
@@ -88,6 +90,7 @@ SHARED_FUNCTION void TNetPacketManagement_Destructor( void );
 SHARED_FUNCTION struct TNetPacket * TNetPacketManagement_GetPacket( void );
 SHARED_FUNCTION void TNetPacketManagement_FreeBuffer(struct TNetPacket * buf);
 SHARED_FUNCTION int TNetPacketManagement_GetFragmentCount( void );
+SHARED_FUNCTION int TNetPacketManagement_GetFragmentHighWater( void );
 
 
 SHARED_FUNCTION void TNetPacket_AddHead(struct TNetPacket * frame, BYTE * Buffer, WORD size);
@@ -110,6 +113,9 @@ SHARED_FUNCTION BOOL TNetPacket_RemHead(struct TNetPacket * frame, DWORD iCount
 SHARED_FUNCTION void TNetPacket_Copy(struct TNetPacket * DestFrame, struct TNetPacket * SourceFrame );
 SHARED_FUNCTION void TNetPacket_Clear(struct TNetPacket * );
 SHARED_FUNCTION void TNetPacket_CopyFromBuffer( struct TNetPacket * frame, BYTE * Buffer );
+SHARED_FUNCTION BYTE * TNetPacket_GetContiguousData( struct TNetPacket * frame, DWORD * size );
+SHARED_FUNCTION BYTE * TNetPacket_GetTailRoom( struct TNetPacket * frame, WORD size );
+SHARED_FUNCTION void TNetPacket_ExtendTail( struct TNetPacket * frame, WORD size );
 
 
 SHARED_FUNCTION BYTE * TNetPacket_GetNextFragment( struct TNetPacket * frame, BYTE * lastDataBuffer, WORD * bufferSize );
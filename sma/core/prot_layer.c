@@ -53,6 +53,7 @@
 #include "driver_layer.h"
 #include "sunnynet.h"
 #include "smanet.h"
+#include "speedwire.h"
 #include "frame_listener.h"
 #include "smadata_layer.h"
 
@@ -69,8 +70,17 @@
 **************************************************************************/
 
 enum {  
-   AMOUNT_TO_READ = 40 /* The this count of bytes (in one step) to read
+   AMOUNT_TO_READ = 40, /* The this count of bytes (in one step) to read
                           in one step from driver                        */
+   PROT_SCAN_AFTER_TX = 60, /* A protocol which is not used by the devices of
+                              a bus is scanned for x seconds after sending
+                              with it (for the answers)                  */
+   FRAME_CACHE_SIZE    = 8,  /* count of cached encoded frames per protocol
+                                of a bus                                 */
+   FRAME_CACHE_MAX_RAW = 32, /* only packets up to x bytes are cached
+                                (the recurring requests)                 */
+   FRAME_CACHE_MAX_ENC = 2 * FRAME_CACHE_MAX_RAW + 16 /* max. size of an
+                                cached encoded frame                     */
 };
 
 /**************************************************************************
@@ -86,14 +96,31 @@ TMinList FrameListener;   /* Liste der zu benachrichtigenden Objekte beim
 ** Table of all available transport protocols with the constructors and
 ** destructors for it
 */
-struct TProtocolTable ProtocolTable[2] =
+struct TProtocolTable ProtocolTable[3] =
 {
-   { PROT_SMANET,   "SMANet",   TSMANet_constructor,   TSMANet_destructor   },
-   { PROT_SUNNYNET, "SunnyNet", TSunnyNet_Constructor, TSunnyNet_Destructor }
+   { PROT_SMANET,    "SMANet",    TSMANet_constructor,    TSMANet_destructor    },
+   { PROT_SUNNYNET,  "SunnyNet",  TSunnyNet_Constructor,  TSunnyNet_Destructor  },
+   { PROT_SPEEDWIRE, "Speedwire", TSpeedwire_constructor, TSpeedwire_destructor }
 };
 
 
 
+/*
+** An encoded frame: The same requests (e.g. GET_DATA of the spot values) are
+** send again and again. Their encoded frames are kept to send them again
+** without encapsulating them every time...
+*/
+typedef struct
+{
+   WORD protid;                     //the protocol ID of the packet (SMADATA1...)
+   BYTE bRawLen;                    //size of the packet (0 = unused entry)
+   BYTE bUsed;                      //used since the last replacement round?
+   WORD wEncLen;                    //size of the encoded frame
+   BYTE Raw[FRAME_CACHE_MAX_RAW];   //the packet
+   BYTE Enc[FRAME_CACHE_MAX_ENC];   //the packet encapsulated by the protocol
+} TFrameCacheEntry;
+
+
 /*
 ** Zuweisungstabelle "BusDevice" => "Protokoll-Objekt"
 ** Dies ist eine Multimap. Es koennen mehrere Protokollobjekte zu einem
@@ -111,6 +138,17 @@ typedef struct
    //the protocol object assign to that bus device
    struct TProtocol * protocol;
 
+   //the transport protocols the devices on that bus answered with
+   //(learned by the router, 0 = unknown, use all)
+   WORD wBusProts;
+
+   //time of the last send with this protocol on that bus
+   DWORD dLastTx;
+
+   //encoded frames of this protocol (NULL if the protocol can't reuse them)
+   TFrameCacheEntry * FrameCache;
+   BYTE bCacheHand; //next entry to check for replacement
+
 } TProtocolMapEntry; //En entry of that list...
 
 TMinList ProtocolMap; //The real map ("multimap": 1=>M )
@@ -119,6 +157,9 @@ TMinList ProtocolMap; //The real map ("multimap": 1=>M )
 DWORD dwPacketWrite = 0;                     /* overall count of packets write */
 DWORD dwPacketRead  = 0;                     /* overall cound of packets read */
 
+static DWORD dInputRxTime = 0;               /* receive time of the input being scanned 
+                                                (monotonic, ms; 0 = not scanning)       */
+
 /**************************************************************************
 ***** IMPLEMENTATION ******************************************************
 **************************************************************************/
@@ -154,6 +195,18 @@ void TProtLayer_CreateProtocol(TDevice * device)
    sprintf(ConfigPath,"%s.Protocol",device->cName);
    TRepository_GetElementStr(ConfigPath, "SMANet", cProtName, sizeof(cProtName));
 
+   //protocol is detected by the bus driver itself?
+   if (stricmp(cProtName, "auto") == 0)
+   {
+      if (!device->IoCtrl ||
+          device->IoCtrl(device, IOCTRL_GET_PROTOCOL, (BYTE*)cProtName) != 0)
+      {
+         YASDI_DEBUG((VERBOSE_WARNING,"No protocol detected for device '%s'. Using 'SMANet'...\n", 
+                      device->cName ));
+         strcpy(cProtName, "SMANet");
+      }
+   }
+
    /* Rufe den richtigen Konstruktor zum Erzeugen des Protokolls auf...*/
    for(i = 0; i < iProtCount; i++)
    {
@@ -168,6 +221,16 @@ void TProtLayer_CreateProtocol(TDevice * device)
          assert(newentry);
          newentry->device   = device;
          newentry->protocol = prot;
+         newentry->wBusProts = 0;
+         newentry->dLastTx   = 0;
+         newentry->bCacheHand = 0;
+         newentry->FrameCache = NULL;
+         if (prot->bCacheFrames)
+         {
+            newentry->FrameCache = os_malloc(sizeof(TFrameCacheEntry) * FRAME_CACHE_SIZE);
+            if (newentry->FrameCache)
+               memset(newentry->FrameCache, 0, sizeof(TFrameCacheEntry) * FRAME_CACHE_SIZE);
+         }
          ADDHEAD( &ProtocolMap, &newentry->node );
       }
    }
@@ -213,6 +276,7 @@ void TProtLayer_Destructor()
    foreach_f(&ProtocolMap, entry)
    {
       REMOVE( &entry->node );
+      if (entry->FrameCache) os_free( entry->FrameCache );
       os_free( entry );
       goto restart;      
    }
@@ -251,6 +315,130 @@ SHARED_FUNCTION WORD TProtLayer_GetAllProtocols( void )
    return prot;
 }
 
+/**************************************************************************
+   Description   : Returns the name of an transport protocol (from the
+                   protocol table)
+   Parameter     : protid = the protocol (PROT_SMANET, ...)
+   Return-Value  : the name, "?" if unknown
+**************************************************************************/
+SHARED_FUNCTION char * TProtLayer_GetProtocolName( WORD protid )
+{
+   int iProtCount = sizeof(ProtocolTable) / sizeof(struct TProtocolTable);
+   int i;
+
+   for(i = 0; i < iProtCount; i++)
+   {
+      if (ProtocolTable[i].prodid == protid) 
+         return ProtocolTable[i].ProtName;
+   }
+   return "?";
+}
+
+/**************************************************************************
+   Description   : Sets the transport protocols which are used by the
+                   devices on a bus. Packets without an specific
+                   transport protocol are only send with these and
+                   the input of the bus is only scanned with these.
+   Parameter     : dev    = the bus driver
+                   wProts = the protocols (PROT_SMANET, ...) or 0 if unknown
+   Return-Value  : ---
+**************************************************************************/
+SHARED_FUNCTION void TProtLayer_SetBusProtocols(TDevice * dev, WORD wProts)
+{
+   TProtocolMapEntry * entry;
+   foreach_f(&ProtocolMap, entry)
+   {
+      if (entry->device == dev && entry->wBusProts != wProts)
+      {
+         YASDI_DEBUG((VERBOSE_MESSAGE,
+                      "Protocol '%s' on bus '%s': %s\n",
+                      TProtLayer_GetProtocolName( entry->protocol->TransportProtID ),
+                      dev->cName,
+                      (!wProts || (wProts & entry->protocol->TransportProtID)) ? "in use" : "not used"));
+         entry->wBusProts = wProts;
+      }
+   }
+}
+
+/**************************************************************************
+   Description   : (PRIVATE) Is the protocol needed on its bus?
+                   Yes if the devices on the bus are using it (or this
+                   is not known yet) or if it was used for sending
+                   a short time ago (answers expected)
+   Parameter     : entry = protocol of the bus
+                   dNow  = current time (s)
+   Return-Value  : true if needed
+**************************************************************************/
+static BOOL TProtLayer_IsProtocolInUse(TProtocolMapEntry * entry, DWORD dNow)
+{
+   return (entry->wBusProts == 0) ||
+          (entry->wBusProts & entry->protocol->TransportProtID) ||
+          (dNow - entry->dLastTx < PROT_SCAN_AFTER_TX);
+}
+
+/**************************************************************************
+   Description   : (PRIVATE) Search the encoded frame of an packet
+   Parameter     : entry  = protocol of the bus
+                   raw    = the packet (linear)
+                   bLen   = size of the packet
+                   protid = protocol id of the packet
+   Return-Value  : the cache entry or NULL if not found
+**************************************************************************/
+static TFrameCacheEntry * TProtLayer_FindCachedFrame(TProtocolMapEntry * entry,
+                                                     BYTE * raw, BYTE bLen,
+                                                     WORD protid)
+{
+   int i;
+   TFrameCacheEntry * ce = entry->FrameCache;
+
+   for(i = 0; i < FRAME_CACHE_SIZE; i++, ce++)
+   {
+      if (ce->bRawLen == bLen && ce->protid == protid && 
+          memcmp(ce->Raw, raw, bLen) == 0)
+      {
+         ce->bUsed = true;
+         return ce;
+      }
+   }
+   return NULL;
+}
+
+/**************************************************************************
+   Description   : (PRIVATE) Store the encoded frame of an packet. 
+                   Replaces an entry which was not used since the last 
+                   round ("clock"), so frames send only once (e.g. with
+                   an time in it) are replaced first.
+   Parameter     : entry  = protocol of the bus
+                   raw    = the packet (linear)
+                   bLen   = size of the packet
+                   protid = protocol id of the packet
+                   enc    = the encapsulated packet
+   Return-Value  : ---
+**************************************************************************/
+static void TProtLayer_StoreCachedFrame(TProtocolMapEntry * entry,
+                                        BYTE * raw, BYTE bLen, WORD protid,
+                                        struct TNetPacket * enc)
+{
+   TFrameCacheEntry * ce;
+   int iEncLen = TNetPacket_GetFrameLength( enc );
+
+   if (iEncLen > FRAME_CACHE_MAX_ENC) return;
+
+   for(;;)
+   {
+      ce = &entry->FrameCache[ entry->bCacheHand ];
+      entry->bCacheHand = (BYTE)((entry->bCacheHand + 1) % FRAME_CACHE_SIZE);
+      if (!ce->bUsed) break;
+      ce->bUsed = false; //second chance...
+   }
+
+   ce->protid  = protid;
+   ce->bRawLen = bLen;
+   ce->wEncLen = (WORD)iEncLen;
+   os_memcpy(ce->Raw, raw, bLen);
+   TNetPacket_CopyFromBuffer( enc, ce->Enc );
+}
+
 /**************************************************************************
    Description   : Sendet einen Frame an die naechst untere Schicht
 
@@ -267,6 +455,7 @@ SHARED_FUNCTION WORD TProtLayer_GetAllProtocols( void )
 SHARED_FUNCTION void TProtLayer_WriteFrame(struct TNetPacket * frame, WORD protid)
 {
    TDevice * driver = TDriverLayer_FindDriverID( frame->RouteInfo.BusDriverID );
+   DWORD dNow = os_GetSystemTime(NULL);
 
    /*
    ** Zum Uebergebenen BusDriver wird das entprechende Protokoll-Objekt gesucht.
@@ -277,11 +466,21 @@ SHARED_FUNCTION void TProtLayer_WriteFrame(struct TNetPacket * frame, WORD proti
    assert(frame);
       
    //forced to use an specific transport protocol? If not send it with
-   //all available protocols for the bus driver...
+   //all available protocols for the bus driver which are used by the 
+   //devices on that bus...
    if (frame->RouteInfo.bTransProtID == 0)
    {
+      TProtocolMapEntry * entry;
       frame->RouteInfo.bTransProtID = PROT_ALL_AVAILABLE;
-      YASDI_DEBUG((VERBOSE_MESSAGE,"No transportprot. specified. Using all...\n"));
+      foreach_f(&ProtocolMap, entry)
+      {
+         if (entry->device == driver && entry->wBusProts)
+         {
+            frame->RouteInfo.bTransProtID = (BYTE)entry->wBusProts;
+            break;
+         }
+      }
+      YASDI_DEBUG((VERBOSE_MESSAGE,"No transportprot. specified. Using all used ones...\n"));
    }
    
    /* Try to find out if the packet should be encapsulated in one specific
@@ -289,6 +488,14 @@ SHARED_FUNCTION void TProtLayer_WriteFrame(struct TNetPacket * frame, WORD proti
    {
       BOOL onePktEncaps = false;
       struct TNetPacket * tmpPkt = TNetPacketManagement_GetPacket();  //Tmp netbuffer...
+      BYTE raw[FRAME_CACHE_MAX_RAW];  //small packets linear (for the frame cache)
+      int iRawLen = TNetPacket_GetFrameLength( frame );
+      TFrameCacheEntry * cached;
+
+      if (iRawLen <= FRAME_CACHE_MAX_RAW)
+         TNetPacket_CopyFromBuffer( frame, raw );
+      else
+         iRawLen = -1; //not cached
 
       //Fuer jede Protokollvariante muss genau ein Paket gesendet werden,
       //halt zeitlich moeglichst dicht (jeweils separat ein Paket)...
@@ -304,14 +511,35 @@ SHARED_FUNCTION void TProtLayer_WriteFrame(struct TNetPacket * frame, WORD proti
              frame->RouteInfo.bTransProtID & entry->protocol->TransportProtID )
          {
             onePktEncaps = true; //pkt is encapsulated in at least one prot...
-            //Kopie des originalen Pkts erzeugen und einpacken lassen
+            entry->dLastTx = dNow; //answers expected with this prot...
             TNetPacket_Clear(tmpPkt);
-            TNetPacket_Copy(tmpPkt, frame);
-            
-            entry->protocol->encapsulate(entry->protocol, tmpPkt, protid );
-            /* Frame an naechste untere Schicht weiterleiten (synchrones Senden) */
-            TDriverLayer_write( tmpPkt );
-            ++dwPacketWrite;
+
+            cached = NULL;
+            if (entry->FrameCache && iRawLen >= 0)
+               cached = TProtLayer_FindCachedFrame(entry, raw, (BYTE)iRawLen, protid);
+            if (cached)
+            {
+               //the same packet was encapsulated before, send it again...
+               TNetPacket_AddTail(tmpPkt, cached->Enc, cached->wEncLen);
+               tmpPkt->RouteInfo = frame->RouteInfo;
+            }
+            else
+            {
+               //Kopie des originalen Pkts erzeugen und einpacken lassen
+               TNetPacket_Copy(tmpPkt, frame);
+               
+               entry->protocol->encapsulate(entry->protocol, tmpPkt, protid );
+
+               if (entry->FrameCache && iRawLen >= 0)
+                  TProtLayer_StoreCachedFrame(entry, raw, (BYTE)iRawLen, protid, tmpPkt);
+            }
+            /* Frame an naechste untere Schicht weiterleiten (synchrones Senden).
+               Empty: the protocol has nothing to send (Speedwire) */
+            if (TNetPacket_GetFrameLength( tmpPkt ) > 0)
+            {
+               TDriverLayer_write( tmpPkt );
+               ++dwPacketWrite;
+            }
          }
       }
 
@@ -346,16 +574,25 @@ BOOL TProtLayer_ScanInput(TDevice * dev)
    DWORD DriverDeviceHandel=0; 
    DWORD dwBytesRead;
    BYTE Buffer[AMOUNT_TO_READ];
+   DWORD dNow = os_GetSystemTime(NULL);
 
    while( (dwBytesRead = TDriverLayer_read(dev, Buffer, sizeof(Buffer), &DriverDeviceHandel )) > 0 )
    {
+      //when were these bytes received? (the driver knows it best)
+      if (!dev->IoCtrl || 
+          dev->IoCtrl(dev, IOCTRL_GET_RX_TIMESTAMP, (BYTE*)&dInputRxTime) != 0 ||
+          !dInputRxTime)
+      {
+         dInputRxTime = os_GetMonotonicTime();
+      }
+
       //Verteile den Eigabestrom des Busses auf alle Empfangsinterpretierer...
       //Ein Bustreiber kann mehrere Protokoll gleichzeitig fahren...
       TProtocolMapEntry * entry;
       foreach_f(&ProtocolMap, entry)
       {
-         //Prot. ist Bus zugeordnet ?
-         if (entry->device == dev)
+         //Prot. ist Bus zugeordnet und wird dort gebraucht?
+         if (entry->device == dev && TProtLayer_IsProtocolInUse(entry, dNow))
          {
             entry->protocol->Scan(entry->protocol, 
                                   dev, 
@@ -365,6 +602,7 @@ BOOL TProtLayer_ScanInput(TDevice * dev)
          }
       }      
    }
+   dInputRxTime = 0;
 
    return false;
 }
@@ -402,6 +640,9 @@ void TProtLayer_NotifyFrameListener(struct TNetPacket * frame, WORD protid)
    
    ++dwPacketRead;
 
+   //receive time of the input the frame was found in (see TProtLayer_ScanInput)
+   frame->RouteInfo.dRxTime = dInputRxTime ? dInputRxTime : os_GetMonotonicTime();
+
    /* Alle Listener ueber das Eintreffen eines neuen Paketes informieren */
    foreach_f( &FrameListener, CurListener)
    {
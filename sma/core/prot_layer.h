@@ -53,6 +53,8 @@ enum
 {
    PROT_SMANET        = 8, /* internal protcol ID of the SMANet */
    PROT_SUNNYNET      = 16,/* internal protcol ID of the SunnyNet */
+   PROT_SPEEDWIRE     = 32,/* internal protcol ID of the Speedwire (its packets
+                              are seen as SMANet packets by the upper layer) */
    PROT_ALL_AVAILABLE = PROT_SMANET | PROT_SUNNYNET, /* Flag: Means all available prots (SUNNYNET and SMANET) */
 };
 
@@ -75,6 +77,8 @@ struct TProtocolTable
 SHARED_FUNCTION void TProtLayer_WriteFrame(struct TNetPacket * frame, WORD protid);
 SHARED_FUNCTION void TProtLayer_AddFrameListener(TFrameListener *);
 SHARED_FUNCTION WORD TProtLayer_GetAllProtocols( void );
+SHARED_FUNCTION char * TProtLayer_GetProtocolName( WORD protid );
+SHARED_FUNCTION void TProtLayer_SetBusProtocols(TDevice * dev, WORD wProts);
 
 void TProtLayer_Constructor(TMinList * DeviceList);
 void TProtLayer_Destructor( void );
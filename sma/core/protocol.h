@@ -57,6 +57,8 @@ struct TProtocol
    struct TProtocol * next;                        /* Zur verkettung mehrerer Protokolle */
    WORD TransportProtID;                           /* the transport protocol ID of this protocol */
    void * priv;                                    /* Zeiger auf private Daten der Instanz */
+   BOOL bCacheFrames;                              /* "encapsulate" depends only on the packet and
+                                                      "protid": encoded frames may be reused */
 };
 
 #endif
@@ -44,6 +44,8 @@
 #include "scheduler.h"
 #include "device.h"
 #include "mempool.h"
+#include "repository.h"
+#include "prot_layer.h"
 
 //pre allocate 10 route infos...
 enum { COUNT_PRE_ALLOC_ROUTES= 3 };
@@ -53,6 +55,14 @@ static TMinList LookupTable;         /* Routing table                          *
 static WORD dwTabEntries;            /* Current count of route entries in list */
 static TTask RouterTask;             /* task for removing old entries          */
 static TMemPool pooledEntries;       /* Memory pool of route entries...        */ 
+static DWORD dProbeInterval;         /* re-probe interval of demoted paths (s) */
+
+static void TRouteTabEntry_SelectPath(TRouteTabEntry * me);
+static void TRouteTabEntry_SetActivePath(TRouteTabEntry * me, BYTE bPath);
+static void TRouteTabEntry_RemovePath(TRouteTabEntry * me, BYTE bPath);
+static TRoutePath * TRouteTabEntry_FindPath(TRouteTabEntry * me, DWORD dwBusDriverID,
+                                            DWORD dwBusDriverPeer, BYTE * bIndex);
+static void TRouter_UpdateBusProtocols( void );
 
 
 
@@ -63,10 +73,14 @@ void TRouter_constructor()
    TTask_Init           ( &RouterTask );
    TTask_SetTimeInterval( &RouterTask, 10 ); 
    TTask_SetEntryPoint  ( &RouterTask, TRouter_TaskEntryPoint, NULL);
+   TTask_SetDeadlineClass( &RouterTask, TDC_HOUSEKEEPING );
    TSchedule_AddTask    ( &RouterTask );
 
    //currently no entries...
    dwTabEntries = 0;
+
+   //devices reachable over several buses: how often to try the slower ones (0 => never)
+   dProbeInterval = TRepository_GetElementInt("Router.ProbeInterval", ROUTE_PROBE_INTERVAL);
    
    //Init the an routeinfo entry pool...
    TMemPool_Init(&pooledEntries, 
@@ -99,6 +113,8 @@ SHARED_FUNCTION void TRouter_ClearTable( void )
 
    //now no map entries anymore...
    dwTabEntries = 0;
+
+   TRouter_UpdateBusProtocols();
 }
 
 /**************************************************************************
@@ -114,12 +130,22 @@ SHARED_FUNCTION void TRouter_ClearTable( void )
 void TRouter_TaskEntryPoint()
 {
    TRouteTabEntry * CurEntry;
+   DWORD dNow = os_GetSystemTime(NULL);
+   int i;
 
 next:
    foreach_f(&LookupTable, CurEntry)
    {
-      if ((CurEntry->RouteType == RT_DYNAMIC) &&
-          ((CurEntry->Time + MAX_TIME_ROUTE) < os_GetSystemTime(NULL)))
+      if (CurEntry->RouteType != RT_DYNAMIC) continue;
+
+      //remove the paths on which the device was not heard for a long time...
+      for(i = CurEntry->bPathCount - 1; i >= 0 && CurEntry->bPathCount > 1; i--)
+      {
+         if ((CurEntry->Paths[i].Time + MAX_TIME_ROUTE) < dNow)
+            TRouteTabEntry_RemovePath( CurEntry, (BYTE)i );
+      }
+
+      if ((CurEntry->Time + MAX_TIME_ROUTE) < dNow)
       {
          YASDI_DEBUG((VERBOSE_ROUTER,
                       "TRouter::TaskEntryPoint: Free "
@@ -144,6 +170,7 @@ SHARED_FUNCTION void TRouter_RemoveRoute(WORD Addr)
       {
          REMOVE( &CurEntry->Node );
          TRouteTabEntry_destructor( CurEntry );
+         TRouter_UpdateBusProtocols();
          break;
       }
    }
@@ -179,6 +206,7 @@ BOOL TRouter_DoTxRoute(TSMAData * smadata,
                        struct TNetPacket * frame)
 {
    TRouteTabEntry * entry = NULL;
+   BYTE bProt;
 
    //If SD1 broadcast than send it to all YASDI Bus Drivers..
    if(smadata->Flags & TS_BROADCAST)
@@ -195,6 +223,14 @@ BOOL TRouter_DoTxRoute(TSMAData * smadata,
       frame->RouteInfo.BusDriverID        = entry->BusDriverID;
       frame->RouteInfo.BusDriverPeer      = entry->BusDriverPeer;
       frame->RouteInfo.Flags              = DSF_MONOCAST;
+
+      //Send it only with the transport protocol the device answered with
+      //on this path (SMANet wins over SunnyNet), if the caller allows it
+      bProt = entry->Paths[ entry->bActivePath ].bTransProtID;
+      if (bProt & PROT_SMANET) bProt = PROT_SMANET;
+      if (bProt && (frame->RouteInfo.bTransProtID == 0 || 
+                    (frame->RouteInfo.bTransProtID & bProt)))
+         frame->RouteInfo.bTransProtID = bProt;
       return true;
    }
    
@@ -214,20 +250,57 @@ BOOL TRouter_DoTxRoute(TSMAData * smadata,
 }
 
 
-void TRouter_AddRoute(WORD Addr, TRouteType type, BYTE bBusDriverID, DWORD dwBusDriverPeer)
+void TRouter_AddRoute(WORD Addr, TRouteType type, BYTE bBusDriverID, DWORD dwBusDriverPeer,
+                      BYTE bTransProtID)
 {
    TRouteTabEntry * tabentry;
+   TRoutePath * path;
+   DWORD dNow = os_GetSystemTime(NULL);
+   BYTE i, bOldest;
 
    tabentry = TRoute_FindRouteEntry(Addr);
    if (tabentry)
    {
-      //Entry already present, update route and time of use only
-      tabentry->Time                = os_GetSystemTime(NULL);
-      tabentry->BusDriverID         = bBusDriverID;
-      tabentry->BusDriverPeer       = dwBusDriverPeer;
+      //Entry already present, update time of use 
+      tabentry->Time = dNow;
 
-      YASDI_DEBUG(( VERBOSE_ROUTER,
-         "TRouter::AddRoute(): Update route: Addr=0x%x :=> BusID=%d\n", Addr, bBusDriverID));
+      //...and the path on which the device was heard. An further path does not 
+      //replace the active one. Which one is used decides the request statistic...
+      path = TRouteTabEntry_FindPath( tabentry, bBusDriverID, dwBusDriverPeer, NULL );
+      if (!path)
+      {
+         if (tabentry->bPathCount < ROUTE_MAX_PATHS)
+         {
+            path = &tabentry->Paths[ tabentry->bPathCount++ ];
+         }
+         else
+         {
+            //all used: replace the (inactive) one not heard for the longest time
+            bOldest = (tabentry->bActivePath == 0) ? 1 : 0;
+            for(i = 0; i < tabentry->bPathCount; i++)
+            {
+               if (i != tabentry->bActivePath && 
+                   tabentry->Paths[i].Time < tabentry->Paths[bOldest].Time)
+                  bOldest = i;
+            }
+            path = &tabentry->Paths[ bOldest ];
+         }
+         memset( path, 0, sizeof(TRoutePath) );
+         path->BusDriverID   = bBusDriverID;
+         path->BusDriverPeer = dwBusDriverPeer;
+
+         YASDI_DEBUG(( VERBOSE_ROUTER,
+            "TRouter::AddRoute(): Additional path: Addr=0x%x :=> BusID=%d (%d paths)\n",
+            Addr, bBusDriverID, tabentry->bPathCount));
+      }
+      path->Time = dNow;
+
+      //new transport protocol on this path? 
+      if ((path->bTransProtID | bTransProtID) != path->bTransProtID)
+      {
+         path->bTransProtID |= bTransProtID;
+         TRouter_UpdateBusProtocols();
+      }
    }
    else
    {
@@ -245,9 +318,11 @@ void TRouter_AddRoute(WORD Addr, TRouteType type, BYTE bBusDriverID, DWORD dwBus
                                                type, 
                                                bBusDriverID,
                                                dwBusDriverPeer,
-                                               os_GetSystemTime(NULL) );
+                                               os_GetSystemTime(NULL),
+                                               bTransProtID );
          ADDHEAD(&LookupTable, &tabentry->Node);
          dwTabEntries++;
+         TRouter_UpdateBusProtocols();
       }
    }
 }
@@ -272,7 +347,8 @@ TRouteTabEntry * TRouteTabEntry_constructor(  WORD Addr,
                                               TRouteType type,
                                               BYTE bBusDriverID,
                                               DWORD dwBusDriverPeer,
-                                              DWORD time
+                                              DWORD time,
+                                              BYTE bTransProtID
                                               )
 {
    TRouteTabEntry * me;
@@ -286,6 +362,15 @@ TRouteTabEntry * TRouteTabEntry_constructor(  WORD Addr,
    me->Time          = time;
    me->RouteType     = type;
 
+   //the first path is the active one...
+   me->Paths[0].BusDriverID   = bBusDriverID;
+   me->Paths[0].BusDriverPeer = dwBusDriverPeer;
+   me->Paths[0].Time          = time;
+   me->Paths[0].bTransProtID  = bTransProtID;
+   me->bPathCount            = 1;
+   me->bActivePath           = 0;
+   me->dNextProbe            = time + dProbeInterval;
+
    return me;
 }
 
@@ -322,8 +407,7 @@ SHARED_FUNCTION BOOL TRoute_FindAddrByDriverDevicePeer(DWORD dwBusDriver, DWORD
    TRouteTabEntry * CurEntry;
    foreach_f(&LookupTable, CurEntry)
    {
-      if ( (CurEntry->BusDriverID == dwBusDriver) &&
-         (CurEntry->BusDriverPeer == dwBusDriverPeer) )
+      if ( TRouteTabEntry_FindPath( CurEntry, dwBusDriver, dwBusDriverPeer, NULL ) )
       {
          *sd1addr = CurEntry->Addr;
          return TRUE;
@@ -334,6 +418,232 @@ SHARED_FUNCTION BOOL TRoute_FindAddrByDriverDevicePeer(DWORD dwBusDriver, DWORD
 }
 
 
+/**************************************************************************
+***** Multipath: path statistic and selection *****************************
+**************************************************************************/
+
+//! Find an path of an route entry (index optional)
+static TRoutePath * TRouteTabEntry_FindPath(TRouteTabEntry * me, DWORD dwBusDriverID,
+                                            DWORD dwBusDriverPeer, BYTE * bIndex)
+{
+   BYTE i;
+   for(i = 0; i < me->bPathCount; i++)
+   {
+      if (me->Paths[i].BusDriverID   == dwBusDriverID &&
+          me->Paths[i].BusDriverPeer == dwBusDriverPeer)
+      {
+         if (bIndex) *bIndex = i;
+         return &me->Paths[i];
+      }
+   }
+   return NULL;
+}
+
+//! Route all packets to the device over this path 
+static void TRouteTabEntry_SetActivePath(TRouteTabEntry * me, BYTE bPath)
+{
+   if (bPath != me->bActivePath)
+   {
+      YASDI_DEBUG(( VERBOSE_ROUTER,
+         "TRouter: Device [0x%04x]: BusID=%d => BusID=%d (rtt=%ldms, loss=%d/1000)\n",
+         me->Addr, me->Paths[me->bActivePath].BusDriverID, me->Paths[bPath].BusDriverID,
+         me->Paths[bPath].dRtt, me->Paths[bPath].wLoss ));
+   }
+   me->bActivePath   = bPath;
+   me->BusDriverID   = me->Paths[bPath].BusDriverID;
+   me->BusDriverPeer = me->Paths[bPath].BusDriverPeer;
+}
+
+//! Remove an path of an route entry (not the last one)
+static void TRouteTabEntry_RemovePath(TRouteTabEntry * me, BYTE bPath)
+{
+   BYTE bActive = me->bActivePath;
+
+   YASDI_DEBUG((VERBOSE_ROUTER, "TRouter: Device [0x%04x]: Free unused path to BusID=%d\n",
+                me->Addr, me->Paths[bPath].BusDriverID ));
+
+   memmove( &me->Paths[bPath], &me->Paths[bPath+1], 
+            (me->bPathCount - bPath - 1) * sizeof(TRoutePath) );
+   me->bPathCount--;
+   me->bProbing = FALSE;
+
+   if (bActive == bPath)
+   {
+      //lost the active path, use the best of the others...
+      me->bActivePath = 0;
+      TRouteTabEntry_SelectPath( me );
+   }
+   else if (bActive > bPath)
+   {
+      me->bActivePath = bActive - 1;
+   }
+
+   TRouter_UpdateBusProtocols();
+}
+
+/**************************************************************************
+   Description   : Collects the transport protocols the devices answered
+                   with on each bus driver and tells it the protocol layer.
+                   It sends and scans only with these protocols then.
+                   Called only if a route or a path has changed.
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+static void TRouter_UpdateBusProtocols( void )
+{
+   TDevice * BusDriver;
+   TRouteTabEntry * CurEntry;
+   WORD wProts;
+   int i;
+
+   foreach_f(TDriverLayer_GetDeviceList(), BusDriver)
+   {
+      wProts = 0;
+      foreach_f(&LookupTable, CurEntry)
+      {
+         for(i = 0; i < CurEntry->bPathCount; i++)
+         {
+            if (CurEntry->Paths[i].BusDriverID == BusDriver->DriverID)
+               wProts |= CurEntry->Paths[i].bTransProtID;
+         }
+      }
+      TProtLayer_SetBusProtocols( BusDriver, wProts );
+   }
+}
+
+//! Score of an path: the estimated time to an answer (ms), lower is better.
+//! Each lost request costs "ROUTE_LOSS_PENALTY", unmeasured paths are rated 
+//! as an path which has lost one request
+static DWORD TRoutePath_GetScore(TRoutePath * path)
+{
+   if (!path->wSamples) return ROUTE_LOSS_PENALTY;
+   return path->dRtt + 
+          ((DWORD)path->wLoss * ROUTE_LOSS_PENALTY) / 1000 +
+          (DWORD)path->bLostInRow * ROUTE_LOSS_PENALTY;
+}
+
+//! Choose the best path of an device. An other path replaces the active
+//! one only if it is clearly better (hysteresis). An active path which
+//! just lost requests gets the penalty for that, so the others take over (failover)
+static void TRouteTabEntry_SelectPath(TRouteTabEntry * me)
+{
+   DWORD dBest, dScore;
+   BYTE i, bBest = me->bActivePath;
+
+   dBest = TRoutePath_GetScore( &me->Paths[me->bActivePath] ) * ROUTE_SWITCH_HYSTERESIS / 100;
+   for(i = 0; i < me->bPathCount; i++)
+   {
+      if (i == me->bActivePath) continue;
+      dScore = TRoutePath_GetScore( &me->Paths[i] );
+      if (dScore < dBest)
+      {
+         dBest = dScore;
+         bBest = i;
+      }
+   }
+   TRouteTabEntry_SetActivePath( me, bBest );
+}
+
+
+/**************************************************************************
+   Description   : An IORequest to an device is sent (again). Chooses the
+                   path of the device for this request: the best one,
+                   or from time to time one of the demoted paths to 
+                   measure it again ("probe")
+   Parameter     : Addr = SMAData1 network address of the device
+                   bProbeAllowed = the request can be repeated on an 
+                                   other path if the probe fails
+   Return-Value  : ---
+**************************************************************************/
+void TRouter_OnRequestStart(WORD Addr, BOOL bProbeAllowed)
+{
+   TRouteTabEntry * entry = TRoute_FindRouteEntry( Addr );
+   DWORD dNow;
+
+   if (!entry || entry->bPathCount < 2) return;
+
+   //the last request was an probe: decide from the regular path...
+   if (entry->bProbing)
+   {
+      entry->bProbing = FALSE;
+      entry->bActivePath = entry->bHomePath;
+   }
+   TRouteTabEntry_SelectPath( entry );
+
+   //time to probe the next demoted path?
+   dNow = os_GetSystemTime(NULL);
+   if (bProbeAllowed && dProbeInterval && dNow >= entry->dNextProbe)
+   {
+      entry->dNextProbe = dNow + dProbeInterval;
+      entry->bProbePath = (BYTE)((entry->bProbePath + 1) % entry->bPathCount);
+      if (entry->bProbePath == entry->bActivePath)
+         entry->bProbePath = (BYTE)((entry->bProbePath + 1) % entry->bPathCount);
+
+      YASDI_DEBUG(( VERBOSE_ROUTER, "TRouter: Device [0x%04x]: Probing path to BusID=%d\n",
+                    Addr, entry->Paths[entry->bProbePath].BusDriverID ));
+      entry->bHomePath = entry->bActivePath;
+      entry->bProbing  = TRUE;
+      TRouteTabEntry_SetActivePath( entry, entry->bProbePath );
+   }
+}
+
+
+/**************************************************************************
+   Description   : Result of an IORequest (or one of its repetitions) on
+                   an path: Feeds the round trip time and loss statistic
+                   of the path
+   Parameter     : Addr = SMAData1 network address of the device
+                   dwBusDriverID, dwBusDriverPeer = path the request was sent to
+                   bAnswered = the device has answered (else timeout)
+                   dRtt = time to the (first) answer in ms
+   Return-Value  : ---
+**************************************************************************/
+void TRouter_OnRequestResult(WORD Addr, DWORD dwBusDriverID, DWORD dwBusDriverPeer,
+                             BOOL bAnswered, DWORD dRtt)
+{
+   TRouteTabEntry * entry = TRoute_FindRouteEntry( Addr );
+   TRoutePath * path;
+
+   if (!entry) return;
+   path = TRouteTabEntry_FindPath( entry, dwBusDriverID, dwBusDriverPeer, NULL );
+   if (!path) return;
+
+   //smoothed values (1/8 weight of the new sample)...
+   if (bAnswered)
+   {
+      //Answer before the request (wraps to a huge value) or far beyond any 
+      //timeout? That's no round trip time: keep only the "answered" of the sample...
+      if (dRtt <= ROUTE_RTT_MAX)
+      {
+         //...and one outlier must not spoil the average...
+         if (path->dRtt && dRtt > path->dRtt * ROUTE_RTT_CLAMP)
+            dRtt = path->dRtt * ROUTE_RTT_CLAMP;
+         path->dRtt = path->dRtt ? (path->dRtt * 7 + dRtt) / 8 : dRtt;
+      }
+      else
+      {
+         YASDI_DEBUG((VERBOSE_ROUTER, "Router: Implausible rtt (%ld ms) of device 0x%x ignored\n", 
+                      (long)(int)dRtt, Addr));
+      }
+      path->wLoss = (WORD)((path->wLoss * 7) / 8);
+      path->bLostInRow = 0;
+   }
+   else
+   {
+      path->wLoss = (WORD)((path->wLoss * 7 + 1000) / 8);
+      if (path->bLostInRow < 0xff) path->bLostInRow++;
+
+      //probe failed: try this path less often...
+      if (entry->bProbing && path == &entry->Paths[entry->bProbePath])
+      {
+         entry->dNextProbe = os_GetSystemTime(NULL) + 
+                             dProbeInterval * min(path->bLostInRow, ROUTE_PROBE_BACKOFF);
+      }
+   }
+   if (path->wSamples < 0xffff) path->wSamples++;
+}
+
+
 
 
    
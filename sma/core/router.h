@@ -32,18 +32,48 @@
 #define MAX_TIME_ROUTE (5*60)      /* die Zeit, die ein unbenutzter Routingeintrag in
                                       der Tabelle hoechstens verweilt... */
 
+#define ROUTE_MAX_PATHS        4     /* max. count of paths (bus driver/peer) to one device */
+#define ROUTE_PROBE_INTERVAL   60    /* default re-probe interval of demoted paths (s) */
+#define ROUTE_PROBE_BACKOFF    8     /* max. factor of the interval for failing paths */
+#define ROUTE_LOSS_PENALTY     2000  /* cost of an lost request in the path score (ms) */
+#define ROUTE_SWITCH_HYSTERESIS 80   /* an other path must have an score below x% of 
+                                        the current one to become active */
+#define ROUTE_RTT_MAX          30000 /* round trip times above are not plausible (ms) */
+#define ROUTE_RTT_CLAMP        4     /* one sample may raise the smoothed rtt only up to 
+                                        x times the current value */
+
 
 typedef enum { RT_DYNAMIC, RT_STATIC }	/* Routentyp */
 TRouteType; 
 
+//One path (bus driver and peer) to the device with its statistics 
+typedef struct
+{
+   BYTE  BusDriverID;      // the YASDI bus driver ("adapter")
+   DWORD BusDriverPeer;    // the YASDI handle of the peer of the device driver
+   DWORD Time;             // the time the device was heard last on this path
+   DWORD dRtt;             // smoothed round trip time of requests (ms)
+   WORD  wLoss;            // smoothed loss of requests (1/1000)
+   WORD  wSamples;         // count of requests measured on this path (saturated)
+   BYTE  bLostInRow;       // requests lost since the last answer
+   BYTE  bTransProtID;     // transport protocol(s) the device answered with on this path
+} TRoutePath;
+
 typedef struct 
 {
 	TMinNode Node;          // for linking 
 	WORD  Addr;             // SMAData1 network address
-   BYTE  BusDriverID;      // the YASDI bus driver ("adapter") => destination
+   BYTE  BusDriverID;      // the YASDI bus driver ("adapter") => destination (active path)
    DWORD BusDriverPeer;    // the YASDI handle of the peer of the device driver (optional)
    DWORD Time;             // the time of last access of this route
    TRouteType RouteType;   // static or dynamic route?
+   TRoutePath Paths[ROUTE_MAX_PATHS]; // all known paths to the device
+   BYTE  bPathCount;       // count of paths in "Paths"
+   BYTE  bActivePath;      // index of the path the packets are routed to
+   BYTE  bProbePath;       // index of the path probed last
+   BYTE  bHomePath;        // the active path before the current probe
+   BOOL  bProbing;         // current request is an probe of an demoted path?
+   DWORD dNextProbe;       // time to probe the demoted paths again
 } TRouteTabEntry;
  
  
@@ -51,10 +81,14 @@ typedef struct
 void TRouter_constructor( void );
 void TRouter_destructor( void );
 BOOL TRouter_DoTxRoute(TSMAData * smadata, struct TNetPacket * frame);
-void TRouter_AddRoute (WORD Addr, TRouteType type, BYTE bBusDriverID, DWORD dwBusDriverPeer);
+void TRouter_AddRoute (WORD Addr, TRouteType type, BYTE bBusDriverID, DWORD dwBusDriverPeer,
+                       BYTE bTransProtID);
 void TRouter_TaskEntryPoint( void );
 SHARED_FUNCTION void TRouter_RemoveRoute(WORD Addr);
 SHARED_FUNCTION void TRouter_ClearTable( void );
+void TRouter_OnRequestStart(WORD Addr, BOOL bProbeAllowed);
+void TRouter_OnRequestResult(WORD Addr, DWORD dwBusDriverID, DWORD dwBusDriverPeer,
+                             BOOL bAnswered, DWORD dRtt);
 
 /* private: */
 TRouteTabEntry * TRoute_FindRouteEntry(WORD Addr);
@@ -64,7 +98,8 @@ TRouteTabEntry * TRouteTabEntry_constructor(WORD Addr,
                                             TRouteType type, 
                                             BYTE bBusDriverID,
                                             DWORD dwBusDriverPeer,
-                                            DWORD time 
+                                            DWORD time,
+                                            BYTE bTransProtID
                                              );
 void TRouteTabEntry_destructor( TRouteTabEntry * );
 SHARED_FUNCTION BOOL TRoute_FindAddrByDriverDevicePeer(DWORD dwBusDriver, DWORD dwBusDriverPeer, WORD * sd1addr);
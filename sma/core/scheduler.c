@@ -44,6 +44,7 @@
 #include "scheduler.h"
 #include "lists.h"
 #include "repository.h"
+#include "vclock.h"
 
 int getch ( void );
 
@@ -61,6 +62,19 @@ BOOL bScheduling = true;                  /* Verarbeitung der Tasks nicht erlaub
 static TMinList TaskList;
 static THREAD_HANDLE dScheduleThread = 0; /* das Handle des EINEN Yasdi-Threads */
 static TMinList TimerList;                   /* Liste aller laufenden Yasdi-Timer... */
+static DWORD dwPass = 0;                     /* counter of the scheduler passes */
+
+/*
+** Allowed delay (in milliseconds) of an task after it became due, per 
+** deadline class (see "TTaskDeadlineClass"). The due task with the earliest
+** deadline is executed first...
+*/
+static const DWORD DeadlineSlack[] = 
+{
+   100,  /* TDC_NORMAL       */
+   0,    /* TDC_RESPONSE     */
+   2000  /* TDC_HOUSEKEEPING */
+};
 BOOL bThreadSupport;                      //Thread Support ?(runtime)
 
 
@@ -74,6 +88,8 @@ SHARED_FUNCTION void TSchedule_MainExecute( void );
 void TSchedule_CheckForRecFrames( void );
 void TSchedule_ReceiverThreadMain( void );
 int CheckNextTimer( void );
+static BOOL TSchedule_GetNextDeadline( DWORD * sec, DWORD * msec );
+static TTask * TSchedule_GetNextDueTask( void );
 void TSchedule_SchedulerMainThreadLoop( DWORD param );
 
 
@@ -91,6 +107,13 @@ SHARED_FUNCTION void TSchedule_Constructor ( void )
    //Check for thread support ("NoThread" is set when no threads used...)
    bThreadSupport = !TRepository_GetElementInt("Misc.NoThread",FALSE);
 
+   //Simulation: use an virtual clock instead of the system time?
+   //("VirtualClockStart" is the start time in seconds since 1970, 0 => now)
+   if (TRepository_GetElementInt("Misc.VirtualClock",FALSE))
+   {
+      TVirtualClock_Enable( TRepository_GetElementInt("Misc.VirtualClockStart",0) );
+   }
+
    //start scheduling   
    TSchedule_DoScheduling();
 }
@@ -171,11 +194,23 @@ void TSchedule_SchedulerMainThreadLoop( DWORD param )
    {
       //YASDI_DEBUG((VERBOSE_MASTER,".\n"));
       TSchedule_MainExecute();
+      
+      //with the virtual clock there is no need to wait: 
+      //just jump to the next deadline...
+      if (TVirtualClock_IsEnabled())
+      {
+         TSchedule_FastForward();
+         os_thread_sleep( 0 );
+         continue;
+      }
+      
       /*
       ** Delay YASDI schulder to save cpu time
       ** (YASDI_SCHEDULER_DELAY_TIME must be defined in your "os/os_xxx.h"
+      ** Drivers can end the delay when new input is available 
+      ** (see "TSchedule_WakeUp")
       */
-      os_thread_sleep( YASDI_SCHEDULER_DELAY_TIME );
+      os_thread_SleepWakeable( YASDI_SCHEDULER_DELAY_TIME );
    }
    YASDI_DEBUG((VERBOSE_MASTER,"ServiceThread ends...\n"));
    return;
@@ -189,28 +224,24 @@ SHARED_FUNCTION void TSchedule_MainExecute( void )
 {
    BYTE iCalledTasks;
    TTask * CurService;
-   DWORD curTime;
    do
    {
       /*
-      ** check yasdi tasks and execute
+      ** check yasdi tasks and execute (earliest deadline first). 
+      ** Every task is called only once in a pass. The next task is selected
+      ** again after each call, so an task signaled in between (e.g. 
+      ** an received answer) is called before waiting housekeeping tasks...
       */
       iCalledTasks = 0;
-      foreach_f(&TaskList, CurService)
+      dwPass++;
+      while( (CurService = TSchedule_GetNextDueTask()) != NULL )
       {
-         curTime = os_GetSystemTime(NULL);
-         /* this task must be scheduled? (is signaled or in timeslice ?) */
-         if (  CurService->signaled ||
-               TTask_GetTimeInterval( CurService ) == 0 || //ZERO=> schedule as soon as possible.. 
-               ( TTask_GetLastActivate( CurService ) +
-                TTask_GetTimeInterval( CurService ) ) <= curTime )
-         {
-            iCalledTasks++;
-            CurService->signaled = FALSE;
-            TTask_SetLastActivate( CurService, curTime );
-            (CurService->TaskFunc)( NULL );
-         }
-      };
+         iCalledTasks++;
+         CurService->signaled = FALSE;
+         CurService->dwPass   = dwPass;
+         TTask_SetLastActivate( CurService, os_GetSystemTime(NULL) );
+         (CurService->TaskFunc)( NULL );
+      }
       
       /*
        * if timer was scheduled start execution loop again to check tasks or timer
@@ -226,6 +257,132 @@ SHARED_FUNCTION void TSchedule_MainExecute( void )
    while(iCalledTasks); //if something was done start loop again until nothing was done...             
 }
 
+/**************************************************************************
+   Description   : Finds the due task with the earliest deadline which
+                   was not called in the current pass. The deadline is 
+                   the time the task became due plus the allowed delay
+                   of it's deadline class. 
+   Parameter     : ---
+   Return-Value  : the task or NULL if nothing is to do
+**************************************************************************/
+static TTask * TSchedule_GetNextDueTask( void )
+{
+   TTask * CurService;
+   TTask * NextTask = NULL;
+   DWORD curMSec = 0;
+   DWORD curTime = os_GetSystemTime(&curMSec);
+   DWORD dueTime;
+   long deadline, nextDeadline = 0;
+
+   foreach_f(&TaskList, CurService)
+   {
+      if (CurService->dwPass == dwPass) continue; //already called in this pass
+
+      dueTime = TTask_GetLastActivate( CurService ) + TTask_GetTimeInterval( CurService );
+
+      /* this task must be scheduled? (is signaled or in timeslice ?) */
+      if (  CurService->signaled ||
+            TTask_GetTimeInterval( CurService ) == 0 || //ZERO=> schedule as soon as possible.. 
+            dueTime <= curTime )
+      {
+         //milliseconds since the task is due (periodic tasks may be overdue)...
+         deadline = 0;
+         if (!CurService->signaled &&
+             TTask_GetTimeInterval( CurService ) != 0 &&
+             TTask_GetTimeInterval( CurService ) != TF_INTERVAL_ETERNITY)
+         {
+            deadline = -(long)((curTime - dueTime) * 1000 + curMSec);
+         }
+         deadline += DeadlineSlack[ CurService->dDeadlineClass ];
+
+         if (!NextTask || deadline < nextDeadline)
+         {
+            NextTask     = CurService;
+            nextDeadline = deadline;
+         }
+      }
+   }
+
+   return NextTask;
+}
+
+/**************************************************************************
+   Description   : Virtual clock only: Advance the clock to the next
+                   pending deadline (timer or periodic task), so that
+                   the next call of "TSchedule_MainExecute" has something 
+                   to do. When nothing is pending the clock runs for one
+                   scheduler delay. Must be called from extern when no
+                   system threads are used...
+   Parameter     : ---
+   Return-Value  : the milliseconds the clock was advanced
+**************************************************************************/
+SHARED_FUNCTION DWORD TSchedule_FastForward( void )
+{
+   DWORD curSec, curMSec = 0, nextSec, nextMSec;
+
+   if (!TVirtualClock_IsEnabled()) return 0;
+
+   curSec = os_GetSystemTime( &curMSec );
+   if (!TSchedule_GetNextDeadline( &nextSec, &nextMSec ))
+   {
+      TVirtualClock_Advance( YASDI_SCHEDULER_DELAY_TIME );
+      return YASDI_SCHEDULER_DELAY_TIME;
+   }
+
+   //deadline already reached?
+   if ( (nextSec < curSec) || ((nextSec == curSec) && (nextMSec <= curMSec)) )
+      return 0;
+
+   TVirtualClock_AdvanceTo( nextSec, nextMSec );
+   return (nextSec - curSec) * 1000 + nextMSec - curMSec;
+}
+
+//!Finds the earliest time something must be done by the scheduler
+//!(signaled tasks are due immediately). FALSE => nothing pending...
+static BOOL TSchedule_GetNextDeadline( DWORD * sec, DWORD * msec )
+{
+   TTask * CurService;
+   TMinTimer * CurTimer;
+   DWORD s, ms;
+   BOOL bFound = FALSE;
+
+   *sec = *msec = 0;
+
+   foreach_f(&TaskList, CurService)
+   {
+      //tasks with interval "0" are always due. Ignore them here, 
+      //otherwise the clock will never run...
+      if (CurService->signaled) return TRUE;
+      if (TTask_GetTimeInterval( CurService ) == 0 ||
+          TTask_GetTimeInterval( CurService ) == TF_INTERVAL_ETERNITY) continue;
+
+      s  = TTask_GetLastActivate( CurService ) + TTask_GetTimeInterval( CurService );
+      ms = 0;
+      if (!bFound || s < *sec || (s == *sec && ms < *msec))
+      {
+         *sec = s; *msec = ms; bFound = TRUE;
+      }
+   }
+
+   foreach_f(&TimerList, CurTimer)
+   {
+      TMinTimer_GetEndTime(CurTimer, &s, &ms);
+      if (!bFound || s < *sec || (s == *sec && ms < *msec))
+      {
+         *sec = s; *msec = ms; bFound = TRUE;
+      }
+   }
+
+   return bFound;
+}
+
+//!Ends the delay of the scheduler thread. The next pass starts at once.
+//!May be called from every thread (e.g. from an driver receive thread)
+SHARED_FUNCTION void TSchedule_WakeUp( void )
+{
+   os_thread_WakeUp();
+}
+
 //!Signal Task: Task will be scheduled (he wakes up) as fast as possible...
 //function is also called with other thread!
 void TTask_Signal(TTask * me)
@@ -434,6 +591,21 @@ SHARED_FUNCTION void TTask_SetTimeInterval(TTask * me, DWORD time)
    me->dwTimeInterval = time;
 }
 
+/**************************************************************************
+   Description   : Setze die Deadline-Klasse des Tasks. Von allen faelligen
+                   Tasks wird der mit der fruehesten Deadline zuerst 
+                   aufgerufen...
+   Parameter     : deadlineClass = TDC_NORMAL, TDC_RESPONSE oder 
+                                   TDC_HOUSEKEEPING
+   Return-Value  : ---
+**************************************************************************/
+SHARED_FUNCTION void TTask_SetDeadlineClass(TTask * me, TTaskDeadlineClass deadlineClass)
+{
+   assert(me);
+   assert(deadlineClass <= TDC_HOUSEKEEPING);
+   me->dDeadlineClass = deadlineClass;
+}
+
 /**************************************************************************
    Description   : Setze den Eintrittspunkt des Tasks
    Parameter     : TaskFunc = Eintrittspunkt des Tasks
@@ -29,6 +29,14 @@ enum {
    TF_INTERVAL_ETERNITY = 0xffffffff  //Task will not be schedules periodic 
                                       //will only be waken up when signaled... 
 };
+
+//Deadline classes of tasks. Due tasks are called earliest deadline first
+typedef enum
+{
+   TDC_NORMAL       = 0, //default: e.g. master state machines
+   TDC_RESPONSE     = 1, //frame receiving and sending, starting of IORequests
+   TDC_HOUSEKEEPING = 2  //statistics, route aging,...
+} TTaskDeadlineClass;
  
 
 struct _TTask
@@ -46,6 +54,8 @@ struct _TTask
 		void (*TaskFunc)(void * UserVal);
 		DWORD dFlags;
       BOOL signaled;                //Is Thread signaled?
+      TTaskDeadlineClass dDeadlineClass; //allowed delay when due (see above)
+      DWORD dwPass;                 //scheduler pass of the last call
 };
 typedef struct _TTask TTask;
 
@@ -56,6 +66,7 @@ SHARED_FUNCTION void TTask_SetTimeInterval (TTask * me, DWORD time);
 SHARED_FUNCTION void TTask_SetEntryPoint   (TTask * me, void * TaskFunc, void * UserVal);
 DWORD TTask_GetLastActivate(TTask * me);
 SHARED_FUNCTION DWORD TTask_GetTimeInterval(TTask * me);
+SHARED_FUNCTION void TTask_SetDeadlineClass(TTask * me, TTaskDeadlineClass deadlineClass);
 void TTask_Signal          (TTask * me);
 SHARED_FUNCTION void TTask_Init2(TTask * me, 
                                  void * TaskFunction, 
@@ -77,6 +88,8 @@ SHARED_FUNCTION void TSchedule_AddTimer( TMinTimer * );
 SHARED_FUNCTION void TSchedule_RemTimer( TMinTimer * );
 SHARED_FUNCTION BOOL TSchedule_Freeze(BOOL bval);
 SHARED_FUNCTION BOOL TSchedule_IsFreeze( void );
+SHARED_FUNCTION DWORD TSchedule_FastForward( void );
+SHARED_FUNCTION void TSchedule_WakeUp( void );
 
 
 
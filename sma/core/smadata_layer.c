@@ -62,6 +62,7 @@
 #include "sunnynet.h"
 #include "minqueue.h"
 #include "mempool.h"
+#include "airtime.h"
 
 
 /**************************************************************************
@@ -72,6 +73,7 @@ static TMinQueue SendFrameQueue = {{0}};  //Queue of frames (packets) to send...
 
 static TMinQueue EventQueue = {{0}};  //Queue of incomming Bus Driver Events...
 static TMemPool EventMemPool;      //Memory pool with event elements
+static TMemPool LinearBufPool;     //Memory pool of linear buffers for defragmented frames
 
 static TMinList PacketRcvListener;     /* List of all Listener to inform when an
                                           packet is received (assembled packet) */
@@ -93,6 +95,8 @@ static TFrameListener SMADataFrameListener = {{0}}; /* SMADataLayer Listener Int
 
 
 enum { MAX_EVENT_COUNT = 65000 }; //maximal count of running bus events
+enum { LINEAR_BUFFER_SIZE = 1024 }; //size of the pooled linear buffers (bigger 
+                                    //frames, e.g. channel lists, use os_malloc)
 
 
 
@@ -102,6 +106,7 @@ enum { MAX_EVENT_COUNT = 65000 }; //maximal count of running bus events
 
 
 void TSMAData_StartIORequestNow( TIORequest * reqToStart );
+DWORD TSMAData_GetAirtimeTimeout( TIORequest * req );
 void TSMAData_IOReqScheduler(TMinList * IORequestList);
 void TSMAData_EventTask(void * nix);
 void TSMAData_RequestServiceTask(void * nix);
@@ -172,6 +177,8 @@ SHARED_FUNCTION void TSMAData_constructor()
    
    //An Threadsave mempool for driver events
    TMemPool_Init(&EventMemPool,1, MAX_EVENT_COUNT, sizeof(TGenDriverEvent), TRUE);
+   //...and one for the linear copies of defragmented frames
+   TMemPool_Init(&LinearBufPool, 1, MP_INFINITE_COUNT, LINEAR_BUFFER_SIZE, TRUE);
    //init an signal listener Task. Waked up when new evens arrives...
    TTask_Init2(&EventListenerTask, TSMAData_EventTask, TF_INTERVAL_ETERNITY);
    TSchedule_AddTask( &EventListenerTask );
@@ -179,6 +186,7 @@ SHARED_FUNCTION void TSMAData_constructor()
 
    //An Service Task for new IORequests, listening on input queue of iorequests only
    TTask_Init2(&RequestServiceTask,TSMAData_RequestServiceTask,TF_INTERVAL_ETERNITY);
+   TTask_SetDeadlineClass( &RequestServiceTask, TDC_RESPONSE );
    TSchedule_AddTask( &RequestServiceTask );
    TMinQueue_AddListenerTask( &NewIORequestQueue, &RequestServiceTask );
 
@@ -202,6 +210,7 @@ SHARED_FUNCTION void TSMAData_constructor()
 
    //Insert Task for sending packets, waked up only when signaled by new packets
    TTask_Init2(&TxService, TSMAData_SendThreadExecute, TF_INTERVAL_ETERNITY);
+   TTask_SetDeadlineClass( &TxService, TDC_RESPONSE );
    TMinQueue_AddListenerTask( &SendFrameQueue, &TxService );
    TSchedule_AddTask( &TxService );
 
@@ -234,8 +243,11 @@ SHARED_FUNCTION void TSMAData_destructor()
    //delete Protocoll Layer
    TProtLayer_Destructor();
 
-   /* Defractionizer Objekt erzeugen...*/
-   TDefrag_Constructor();
+   //free the memory pool of linear buffers
+   TMemPool_Free(&LinearBufPool);
+
+   /* delete Defractionizer...*/
+   TDefrag_Destructor();
 
    /* delete Defractionizer...*/
    TFrag_Constructor();
@@ -622,7 +634,9 @@ SHARED_FUNCTION void TSMAData_ReceiverThreadExecute( void * ignore )
 **************************************************************************/
 SHARED_FUNCTION void TSMAData_OnFrameReceived(struct TNetPacket * frame)
 {
-   WORD src, dst;
+   BYTE headcopy[7];
+   BYTE * head;
+   DWORD dHeadSize;
    DWORD Flags = 0;
    struct TSMADataHead smadata;
    TIORequest * req;
@@ -632,20 +646,23 @@ SHARED_FUNCTION void TSMAData_OnFrameReceived(struct TNetPacket * frame)
    //SMAData1 Packets must be 7 bytes or longer...
    if (TNetPacket_GetFrameLength(frame) < 7) goto err_small;
  
+   //The SMAData1 Protocol head (7 bytes): read it in place if the frame
+   //is in one piece (as received), else copy it...
+   head = TNetPacket_GetContiguousData( frame, &dHeadSize );
+   if (!head)
+   {
+      if (!TNetPacket_RemHead(frame, sizeof(headcopy), headcopy)) goto err_small;
+      head = headcopy;
+   }
+
+   smadata.SourceAddr = le16ToHost( &head[0] );  //byteorder!! Swap the bytes if needed...
+   smadata.DestAddr   = le16ToHost( &head[2] );
+   smadata.Ctrl       = head[4];
+   smadata.PktCnt     = head[5];
+   smadata.Cmd        = head[6];
 
-   //Extract the SMAData1 Protocol head: all in all: 7 bytes
-   // the Source address 
-   if (!TNetPacket_RemHead(frame,2, &src))            goto err_small;
-   smadata.SourceAddr = le16ToHost( (BYTE*)&src );    //byteorder!! Swap the bytes if needed...
-   // the Destination Address
-   if (!TNetPacket_RemHead(frame,2, &dst))            goto err_small;
-   smadata.DestAddr   = le16ToHost( (BYTE*)&dst );    //byteorder!! Swap the bytes if needed...
-   // the ctrl byte
-   if (!TNetPacket_RemHead(frame,1, &smadata.Ctrl))   goto err_small;
-   //the Packet counter
-   if (!TNetPacket_RemHead(frame,1, &smadata.PktCnt)) goto err_small;
-   // the SMAData1 command
-   if (!TNetPacket_RemHead(frame,1, &smadata.Cmd))    goto err_small;
+   //remove the head from the frame (if not already)
+   if (head != headcopy) TNetPacket_RemHead(frame, sizeof(headcopy), NULL);
    
 
    /* Is it an Broadcast? */
@@ -718,7 +735,8 @@ SHARED_FUNCTION void TSMAData_OnFrameReceived(struct TNetPacket * frame)
    TRouter_AddRoute(smadata.SourceAddr,       /* Geraetenetzadresse */
                     RT_DYNAMIC,               /* eine dynamischer Routeneintrag */
                     (BYTE)frame->RouteInfo.BusDriverID,
-                    (frame->RouteInfo.BusDriverPeer));    
+                    (frame->RouteInfo.BusDriverPeer),
+                    frame->RouteInfo.bTransProtID);  /* answered with this transport prot. */
 
    /* Ist das Paket eine Anfrage (also anderer Master fragt an, Pkt ist keine Antwort (Anfrage) )
       auf weitere Folgepakete? Frage den Fragmentierer, ob er was mit dem Paket anfangen kann */
@@ -742,6 +760,7 @@ SHARED_FUNCTION void TSMAData_OnFrameReceived(struct TNetPacket * frame)
       struct TNetPacket * DeFragFrame; /* moegliches defrakmentiertes Paket */
       BYTE * FrameBuffer;
       DWORD dFrameSize;
+      enum { NO_COPY, POOL_COPY, HEAP_COPY } LinearCopy = NO_COPY; /* FrameBuffer is a copy? */
       BYTE Prozent;         /* prozentualer Fortschritt der Blockuebertragung... */
 
       /*
@@ -752,6 +771,18 @@ SHARED_FUNCTION void TSMAData_OnFrameReceived(struct TNetPacket * frame)
       /* IORequestTimer anhalten, wenn er noch lief... */
       if (req) TMinTimer_Stop( &req->Timer );
 
+      /* first answer: round trip time of the path to the device */
+      /* (answer time is the receive time of the bus driver, not "now")  */
+      if (req && req->RouteBusDriverID != INVALID_DRIVER_ID)
+      {
+         DWORD dRxTime = frame->RouteInfo.dRxTime ? frame->RouteInfo.dRxTime : 
+                                                    os_GetMonotonicTime();
+         TRouter_OnRequestResult( req->DestAddr, req->RouteBusDriverID, 
+                                  req->RouteBusDriverPeer, TRUE,
+                                  dRxTime - req->dRouteTxTime );
+         req->RouteBusDriverID = INVALID_DRIVER_ID;
+      }
+
       /* Wenn noetig mit Hilfe des Defragmentierer defragmentieren
       * (fragmente zusammenfuegen, Master Mode) */
       DeFragFrame = TDeFrag_Defrag( &smadata,
@@ -771,10 +802,26 @@ SHARED_FUNCTION void TSMAData_OnFrameReceived(struct TNetPacket * frame)
 
       /**
        ** Paketinhalt an naechst obere Schicht weitergeben...
+       ** Single frames are passed in place, only defragmented ones (several
+       ** fragments) are copied into a linear buffer
        */
-      dFrameSize = TNetPacket_GetFrameLength( DeFragFrame );
-      FrameBuffer = os_malloc( dFrameSize ); //Linearpuffer
-      TNetPacket_CopyFromBuffer( DeFragFrame, FrameBuffer );
+      FrameBuffer = TNetPacket_GetContiguousData( DeFragFrame, &dFrameSize );
+      if (!FrameBuffer)
+      {
+         dFrameSize = TNetPacket_GetFrameLength( DeFragFrame );
+         if (dFrameSize + 1 <= LINEAR_BUFFER_SIZE)
+         {
+            FrameBuffer = TMemPool_AllocElem( &LinearBufPool, MP_NOFLAGS ); //Linearpuffer
+            LinearCopy = POOL_COPY;
+         }
+         else
+         {
+            FrameBuffer = os_malloc( dFrameSize + 1 ); //Linearpuffer
+            LinearCopy = HEAP_COPY;
+         }
+         assert(FrameBuffer);
+         TNetPacket_CopyFromBuffer( DeFragFrame, FrameBuffer );
+      }
 
       /* IORequest Ereignis bedienen... */
       if(req && req->OnReceived)
@@ -811,7 +858,8 @@ SHARED_FUNCTION void TSMAData_OnFrameReceived(struct TNetPacket * frame)
       }
 
       //Linearpuffer wieder freigeben...
-      os_free( FrameBuffer );
+      if (LinearCopy == POOL_COPY) TMemPool_FreeElem( &LinearBufPool, FrameBuffer );
+      else if (LinearCopy == HEAP_COPY) os_free( FrameBuffer );
 
       /* Der Defragmentierer hat moeglicherweise das Paket vorher defragmentiert.
          Wenn dem so ist, muss dieses Paket noch freigegeben werden..*/
@@ -941,7 +989,12 @@ void TSMAData_StartIORequestNow( TIORequest * reqToStart )
       */
       if (reqToStart->TimeOut)
       {
-         TMinTimer_SetTime(      &reqToStart->Timer, reqToStart->TimeOut );
+         //timeout of the bus airtime model or the fixed one?
+         DWORD dAirtime = TSMAData_GetAirtimeTimeout( reqToStart );
+         if (dAirtime)
+            TMinTimer_SetTimeMilli( &reqToStart->Timer, dAirtime );
+         else
+            TMinTimer_SetTime(      &reqToStart->Timer, reqToStart->TimeOut );
          TMinTimer_SetAlarmFunc( &reqToStart->Timer, (VoidFunc)TSMAData_OnReqTimeout, (void*)reqToStart);
          TMinTimer_Start(        &reqToStart->Timer );
       }
@@ -971,6 +1024,37 @@ void TSMAData_StartIORequestNow( TIORequest * reqToStart )
 }
 
 
+/**************************************************************************
+   Description   : Derives the answer timeout of an IORequest from the
+                   airtime of the bus: time to send the request, the reply
+                   delay of the device and the time of the (expected) 
+                   answer on the wire...
+   Parameter     : req = the IORequest
+   Return-Value  : timeout in ms, never longer than the fixed timeout 
+                   "TimeOut". 0 => no airtime model for the request 
+                   (bus without line speed, several answers or no 
+                   "RxLength"). Use the fixed timeout "TimeOut"
+**************************************************************************/
+DWORD TSMAData_GetAirtimeTimeout( TIORequest * req )
+{
+   DWORD DriverID;
+   DWORD dwBusDriverPeer;
+   DWORD dAirtime;
+
+   if (!req->RxLength || req->Type != RT_MONORCV) return 0;
+
+   //Broadcasts and requests without route go out on all buses...
+   if ((req->TxFlags & TS_BROADCAST) || 
+       !TRoute_FindRoute(req->DestAddr, &DriverID, &dwBusDriverPeer))
+   {
+      DriverID = INVALID_DRIVER_ID;
+   }
+
+   dAirtime = TAirtime_GetRequestTime( DriverID, req->TxLength, req->RxLength );
+   return min( dAirtime, req->TimeOut * 1000 );
+}
+
+
 /**************************************************************************
    Description   : Fuegt einen neuen IORequest dem System zum Bearbeiten
                    hinzu...
@@ -1023,6 +1107,17 @@ void TSMAData_RequestServiceTask(void * nix)
 **************************************************************************/
 SHARED_FUNCTION void TSMAData_SendRequest( TIORequest * req)
 {
+   //device reachable over several paths: let the router choose one for 
+   //this request and remember it for the statistic of the answer...
+   req->RouteBusDriverID = INVALID_DRIVER_ID;
+   if (!(req->TxFlags & TS_BROADCAST) && (req->Type == RT_MONORCV))
+   {
+      TRouter_OnRequestStart( req->DestAddr, req->Repeats > 0 );
+      if (!TRoute_FindRoute( req->DestAddr, &req->RouteBusDriverID, &req->RouteBusDriverPeer ))
+         req->RouteBusDriverID = INVALID_DRIVER_ID;
+      req->dRouteTxTime = os_GetMonotonicTime();
+   }
+
    //Paket zerstueckeln???
    if (TFrag_MustBeFractionized(req->DestAddr, req->TxLength))
    {
@@ -1065,6 +1160,14 @@ SHARED_FUNCTION void TSMAData_SendRequest( TIORequest * req)
 SHARED_FUNCTION void TSMAData_OnReqTimeout( TIORequest * req )
 {
    YASDI_DEBUG((VERBOSE_SMADATALIB,"TSMAData::OnReqTimeout()...\n"));
+
+   //request lost on this path (the repetition may take an other one)...
+   if (req->RouteBusDriverID != INVALID_DRIVER_ID)
+   {
+      TRouter_OnRequestResult( req->DestAddr, req->RouteBusDriverID, 
+                               req->RouteBusDriverPeer, FALSE, 0 );
+      req->RouteBusDriverID = INVALID_DRIVER_ID;
+   }
    /*
    ** Das Herunterzaehlen des Wiederholungszaehlers macht nur Sinn
    ** bei Requests mit Einfachantwort.
@@ -1475,6 +1578,13 @@ SHARED_FUNCTION void TSMAData_OnNewEvent( TDevice * newdev,
    TGenDriverEvent * newevent;
    UNUSED_VAR(newdev);
    
+   //new input on an bus: no listener needed, only read it as soon as possible
+   if (event->eventType == DRE_NEW_INPUT)
+   {
+      TDriverLayer_OnNewInput();
+      return;
+   }
+
    YASDI_DEBUG((VERBOSE_SMADATALIB, "TSMAData_OnNewEvent( eventType=%d ). Event queued...",
                 (int)event->eventType ));
 
@@ -1548,6 +1658,7 @@ SHARED_FUNCTION void TSMAData_InitReqGetNet(TIORequest * req,
    req->TxLength   = 0;
    req->Repeats    = 0;
    req->TimeOut    = Timeout;
+   req->RxLength   = 12;                /* serial number + device type */
    //req->BusDriverID = INVALID_DRIVER_ID; //Keinen speziellen YASDI-Driver ansteuern
    req->TxFlags   |= transportprot; /* transport prot... */
    
@@ -1573,6 +1684,7 @@ SHARED_FUNCTION void TSMAData_InitReqCfgNetAddr( TIORequest * req, WORD SrcAddr,
    req->TxLength   = 6;
    req->Repeats    = BadRepeats;
    req->TimeOut    = Timeout;
+   req->RxLength   = 12;                     // serial number + device type
    req->Type       = RT_MONORCV;             // Auf genau EINE Antwort warten 
    req->TxFlags    |= transportProtID;       //the used transport protocol
 
@@ -1602,6 +1714,7 @@ SHARED_FUNCTION void TSMAData_InitReqGetChanInfo(TIORequest * req,
    req->TxLength   = 0;
    req->Repeats    = BadRepeats;
    req->TimeOut    = Timeout;
+   req->RxLength   = IOREQ_RXLENGTH_UNKNOWN;  /* the channel list: full packets */
    req->Type       = RT_MONORCV;            /* Auf genau EINE Antwort warten */
 
    //Default: Keinen speziellen YASDI-Driver ansteuern
@@ -1645,6 +1758,7 @@ SHARED_FUNCTION DWORD TSMAData_InitReqSendSyncOnline(TIORequest * req,
    //bereifen kann ich es nicht...
    req->Repeats    = 0;
    req->TimeOut    = WaitAfterSendSec;
+   req->RxLength   = 0;                 /* fixed waiting time, no airtime */
    if (WaitAfterSendSec)
       req->Type       = RT_MONORCV;       /* wait for an answer that never comes */
    else
@@ -1682,6 +1796,7 @@ SHARED_FUNCTION void TSMAData_InitReqGetOnlineChannels( TIORequest * req,
    req->SourceAddr = SrcAddr;
    req->Cmd        = CMD_GET_DATA;
    req->TxLength   = 3;
+   req->RxLength   = IOREQ_RXLENGTH_UNKNOWN; /* the master may know it better */
    req->Repeats    = BadRepeats;
    req->TimeOut    = Timeout;
    req->Type       = RT_MONORCV;            /* Auf genau EINE Antwort warten */
@@ -1715,6 +1830,7 @@ SHARED_FUNCTION void TSMAData_InitReqGetParamChannels( TIORequest * req,
    req->SourceAddr = SrcAddr;
    req->Cmd        = CMD_GET_DATA;
    req->TxLength   = 3;
+   req->RxLength   = IOREQ_RXLENGTH_UNKNOWN; /* the master may know it better */
    req->Repeats    = BadRepeats;
    req->TimeOut    = Timeout;
    req->Type       = RT_MONORCV;            /* Auf genau EINE Antwort warten */
@@ -1749,6 +1865,7 @@ SHARED_FUNCTION void TSMAData_InitReqSetChannel( TIORequest * req,
    req->TxLength   = ValLength + 5; /* Channel-Maske[2] + Index[] + Datensatzanzahl) */
    req->Repeats    = BadRepeats;
    req->TimeOut    = Timeout;
+   req->RxLength   = req->TxLength; /* the device answers with the new value */
    req->Type       = RT_MONORCV; /* Auf genau EINE Antwort warten! */
 
 
@@ -1792,6 +1909,7 @@ SHARED_FUNCTION void TSMAData_InitReqGetTestChannels( TIORequest * req,
    req->SourceAddr = SrcAddr;
    req->Cmd        = CMD_GET_DATA;
    req->TxLength   = 3;
+   req->RxLength   = IOREQ_RXLENGTH_UNKNOWN; /* the master may know it better */
    req->Repeats      = BadRepeats;
    req->TimeOut    = Timeout;
    req->Type        = RT_MONORCV;            /* Auf genau EINE Antwort warten */
@@ -46,6 +46,7 @@
 #include "scheduler.h"
 #include "repository.h"
 #include "netpacket.h"
+#include "airtime.h"
 
 
 #undef TStatisticWriter_Constructor
@@ -94,6 +95,9 @@ void TStatisticWriter_Constructor( void )
    TStatisticWriter_AddNewStatistic("UsedMemory","Bytes", (func)os_GetUsedMem);
    
    TStatisticWriter_AddNewStatistic("UnusedBufferFrags","Count", TNetPacketManagement_GetFragmentCount );
+   TStatisticWriter_AddNewStatistic("UsedBufferFragsMax","Count", TNetPacketManagement_GetFragmentHighWater );
+
+   TStatisticWriter_AddNewStatistic("BusLoad","Percent", TAirtime_GetMaxBusLoad );
 
    
    TRepository_GetElementStr( "Misc.StatisticOutput",
@@ -104,6 +108,7 @@ void TStatisticWriter_Constructor( void )
       /* create new Task for output... */
        OutputTask.TaskFunc = TStatisticWriter_WriterTask;
       TTask_SetTimeInterval( &OutputTask, 3 ); /* activate all 3 seconds*/
+      TTask_SetDeadlineClass( &OutputTask, TDC_HOUSEKEEPING );
       TSchedule_AddTask( &OutputTask );
    }
 }
@@ -32,6 +32,14 @@
 SHARED_FUNCTION void TMinTimer_SetTime(TMinTimer * me, DWORD sec)
 {
    me->dRunTime  = sec;
+   me->dRunTimeMilli = 0;
+}
+
+//! Same as "TMinTimer_SetTime", but the run time is in milli seconds
+SHARED_FUNCTION void TMinTimer_SetTimeMilli(TMinTimer * me, DWORD msec)
+{
+   me->dRunTime      = msec / 1000;
+   me->dRunTimeMilli = msec % 1000;
 }
 
 SHARED_FUNCTION void TMinTimer_SetAlarmFunc(TMinTimer * me, void (*CallBack)(void*), void * data)
@@ -71,15 +79,24 @@ SHARED_FUNCTION void TMinTimer_Signal(TMinTimer * me)
    me->dStartTimeMilli = 0;
 }
 
+//! The point in time the timer expires (seconds and milli seconds)
+SHARED_FUNCTION void TMinTimer_GetEndTime(TMinTimer * me, DWORD * seconds, DWORD * milliseconds)
+{
+   DWORD msec = me->dStartTimeMilli + me->dRunTimeMilli;
+   *seconds      = me->dStartTime + me->dRunTime + msec / 1000;
+   *milliseconds = msec % 1000;
+}
+
 //Has timer expired? True => expired   False => not expired...
 SHARED_FUNCTION BOOL TMinTimer_IsExpired(TMinTimer * me, DWORD CurSeconds, DWORD CurMSec)
 {
-   DWORD endTimeSec = me->dStartTime + me->dRunTime;
+   DWORD endTimeSec, endTimeMSec;
+   TMinTimer_GetEndTime(me, &endTimeSec, &endTimeMSec);
    if (CurSeconds < endTimeSec) return FALSE; //definitiv nicht abgelaufen...
    if (CurSeconds > endTimeSec) return TRUE; //definitiv abgelaufen...
    
    //we are in the right second. Check the milli seconds only now...
-   return CurMSec >= me->dStartTimeMilli;
+   return CurMSec >= endTimeMSec;
 }
 
 
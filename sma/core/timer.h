@@ -37,16 +37,19 @@ typedef struct
 		DWORD dStartTime;					/* Startzeitpunkt des Timers in Sekunden (UNIX-Time, Systemzeit)*/
       DWORD dStartTimeMilli;        // milli seconds of start time
 		DWORD dRunTime;					/* Die Zeit in Sekunden, die der Timer laufen soll (im Bezug auf "dStartTime") */
+      DWORD dRunTimeMilli;          // ...plus these milli seconds
 		void * UserVal;					/* Wert, der der "Alarmfunktion" als Parameter �bergeben wird */
 		void (*AlarmFunc)(void *);		/* die Funktion , die beim Ablauf des Timers aufgerufen wird */
 } TMinTimer;
 
 SHARED_FUNCTION void TMinTimer_SetTime		(TMinTimer * me, DWORD sec);
+SHARED_FUNCTION void TMinTimer_SetTimeMilli(TMinTimer * me, DWORD msec);
 SHARED_FUNCTION void TMinTimer_SetAlarmFunc(TMinTimer * me, TMinTimerCallBackFunc callback, void * data);
 SHARED_FUNCTION void TMinTimer_Start		(TMinTimer * me);
 SHARED_FUNCTION void TMinTimer_Stop			(TMinTimer * me);
 SHARED_FUNCTION void TMinTimer_Restart		(TMinTimer * me);
 SHARED_FUNCTION void TMinTimer_Signal     (TMinTimer * me);
 SHARED_FUNCTION BOOL TMinTimer_IsExpired  (TMinTimer * me, DWORD seconds, DWORD milliseconds);
+SHARED_FUNCTION void TMinTimer_GetEndTime  (TMinTimer * me, DWORD * seconds, DWORD * milliseconds);
 
 #endif
@@ -0,0 +1,132 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ * 
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ * 
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+/**************************************************************************
+*         SMA Technologie AG, 34266 Niestetal, Germany
+***************************************************************************
+* Project       : yasdi
+***************************************************************************
+* Project-no.   :
+***************************************************************************
+* Filename      : vclock.c
+***************************************************************************
+* Description   : Virtual clock source for deterministic simulations
+***************************************************************************
+* Preconditions : 
+***************************************************************************
+* Changes       : Author, Date, Version, Reason
+*                 *********************************************************
+**************************************************************************/
+#include "os.h"
+
+#include "debug.h"
+#include "vclock.h"
+
+
+/**************************************************************************
+********** L O C A L E ****************************************************
+**************************************************************************/
+
+static BOOL  bEnabled  = FALSE;
+static BOOL  bMutexInit = FALSE;
+static DWORD dCurSec   = 0;     //current virtual time (seconds since 1970)
+static DWORD dCurMSec  = 0;     //...and the milliseconds of the current second
+static T_MUTEX ClockMutex;      //time is read by more than one thread
+
+
+
+/**************************************************************************
+***** IMPLEMENTATION ******************************************************
+**************************************************************************/
+
+/**************************************************************************
+   Description   : Installs the virtual clock as clock source of the
+                   OS layer. From now on the time stands still until it
+                   is advanced...
+   Parameter     : startTime = the start time (seconds since 1970).
+                               0 => start with the current wall clock time
+   Return-Value  : ---
+**************************************************************************/
+SHARED_FUNCTION void TVirtualClock_Enable( DWORD startTime )
+{
+   if (!bMutexInit)
+   {
+      os_thread_MutexInit( &ClockMutex );
+      bMutexInit = TRUE;
+   }
+
+   os_thread_MutexLock( &ClockMutex );
+   dCurSec  = startTime ? startTime : os_GetWallClockTime( NULL );
+   dCurMSec = 0;
+   bEnabled = TRUE;
+   os_thread_MutexUnlock( &ClockMutex );
+
+   os_SetClockSource( TVirtualClock_GetTime );
+
+   YASDI_DEBUG((VERBOSE_SCHEDULER,"TVirtualClock: enabled, start time = %lu\n", dCurSec));
+}
+
+//! Use the wall clock again
+SHARED_FUNCTION void TVirtualClock_Disable( void )
+{
+   os_SetClockSource( NULL );
+   bEnabled = FALSE;
+}
+
+SHARED_FUNCTION BOOL TVirtualClock_IsEnabled( void )
+{
+   return bEnabled;
+}
+
+//! The clock source function (see "os_SetClockSource")
+SHARED_FUNCTION DWORD TVirtualClock_GetTime( DWORD * milliseconds )
+{
+   DWORD sec;
+   os_thread_MutexLock( &ClockMutex );
+   sec = dCurSec;
+   if (milliseconds)
+      *milliseconds = dCurMSec;
+   os_thread_MutexUnlock( &ClockMutex );
+   return sec;
+}
+
+//! Let the virtual time run for some milliseconds
+SHARED_FUNCTION void TVirtualClock_Advance( DWORD milliseconds )
+{
+   os_thread_MutexLock( &ClockMutex );
+   dCurMSec += milliseconds;
+   dCurSec  += dCurMSec / 1000;
+   dCurMSec  = dCurMSec % 1000;
+   os_thread_MutexUnlock( &ClockMutex );
+}
+
+//! Set the virtual time to an absolute time. The clock never runs backwards,
+//! an time in the past is ignored...
+SHARED_FUNCTION void TVirtualClock_AdvanceTo( DWORD sec, DWORD msec )
+{
+   os_thread_MutexLock( &ClockMutex );
+   if ( (sec > dCurSec) || ((sec == dCurSec) && (msec > dCurMSec)) )
+   {
+      dCurSec  = sec + msec / 1000;
+      dCurMSec = msec % 1000;
+   }
+   os_thread_MutexUnlock( &ClockMutex );
+}
@@ -0,0 +1,40 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ * 
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ * 
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+#ifndef VCLOCK_H
+#define VCLOCK_H
+
+/*
+** Virtual clock: A clock source for the OS layer which does not run by itself.
+** The time only moves forward when someone advances it (normally the
+** scheduler, which jumps directly to the next pending deadline).
+** Used for simulations and replays where timeouts and retries should
+** be processed much faster than real time and always in the same order...
+*/
+
+SHARED_FUNCTION void  TVirtualClock_Enable   ( DWORD startTime );
+SHARED_FUNCTION void  TVirtualClock_Disable  ( void );
+SHARED_FUNCTION BOOL  TVirtualClock_IsEnabled( void );
+SHARED_FUNCTION DWORD TVirtualClock_GetTime  ( DWORD * milliseconds );
+SHARED_FUNCTION void  TVirtualClock_Advance  ( DWORD milliseconds );
+SHARED_FUNCTION void  TVirtualClock_AdvanceTo( DWORD sec, DWORD msec );
+
+#endif
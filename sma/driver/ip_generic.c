@@ -47,6 +47,9 @@
 ***** INCLUDES ************************************************************
 ***************************************************************************/
 
+#ifdef __linux__
+#define _GNU_SOURCE     /* recvmmsg() and sendmmsg() */
+#endif
 
 #include "os.h"
 #include "debug.h"
@@ -59,15 +62,27 @@
 #include "ip_generic.h"
 #include "copyright.h"
 
+//linked into YASDI itself ("YASDI_STATIC_DRIVERS")? Then the module entries
+//need unique names...
+#ifdef YASDI_STATIC_DRIVERS
+#define InitYasdiModule    ip_InitYasdiModule
+#define CleanupYasdiModule ip_CleanupYasdiModule
+#endif
+
+#if IP_USE_MMSG
+#include <sys/epoll.h>
+#include <time.h>
+#endif
+
 
 /*************************************************************************/
 
 //Test of Bus Driver Events? (for Debugging)
 //#define TEST_BUS_DRIVER_EVENTS
 
-int dBytesReadTotal = 0;
-int (*RegisterDevice) (TDevice * newdev);
-TOnDriverEvent SendEventCallback;
+static int dBytesReadTotal = 0;
+static int (*RegisterDevice) (TDevice * newdev);
+static TOnDriverEvent SendEventCallback;
 
 #ifdef TEST_BUS_DRIVER_EVENTS
 int lastCreatedDriverID = 0;
@@ -91,13 +106,21 @@ DWORD Address2Ip(char * pdot);
 DWORD inetAddr2DriverDeviceHandle(struct sockaddr_in * addr);
 void printIPAddress(struct sockaddr_in * addr, char * buffer );
 
+#if IP_USE_MMSG
+static BOOL ip_rx_start(TDevice * dev);
+static void ip_rx_stop(TDevice * dev);
+static DWORD ip_rx_read(TDevice * dev, BYTE * DestBuffer, DWORD dBufferSize,
+                        DWORD * DeviceHandle);
+static BOOL ip_send_batch(TDevice * dev, struct mmsghdr * msgs, 
+                          TPeerListEntry ** peers, int count, int buffersize);
+#endif
 
 
 /**************************************************************************
 ***** Global Variables ***************************************************
 ***************************************************************************/
 
-TMemPool MemPoolPeerList;        // an memory pool for peer list elements
+static TMemPool MemPoolPeerList;        // an memory pool for peer list elements
 
 
 
@@ -161,6 +184,29 @@ BOOL ip_Open(TDevice *dev)
       goto err;
    }
 
+   /* Speedwire: join the group of the device discovery, the own 
+      requests are not looped back */
+   if (me->bSpeedwire)
+   {
+      struct ip_mreq mreq;
+      BYTE loop = 0;
+      mreq.imr_multiaddr        = me->McastPeer.addr.sin_addr;
+      mreq.imr_interface.s_addr = htonl( INADDR_ANY );
+      if (setsockopt(me->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, 
+                     (void*)&mreq, sizeof(mreq)) == SOCKET_ERROR)
+      {
+         YASDI_DEBUG((VERBOSE_WARNING, 
+                      "IP::Open(): Can't join the Speedwire multicast group!\n"));
+      }
+      setsockopt(me->fd, IPPROTO_IP, IP_MULTICAST_LOOP, (void*)&loop, sizeof(loop));
+   }
+
+   #if IP_USE_MMSG
+   /* start the receive thread */
+   if (!ip_rx_start( dev ))
+      goto err;
+   #endif
+
    /* device in state online now */
    dev->DeviceState = DS_ONLINE;
    return TRUE;
@@ -209,6 +255,10 @@ void ip_Close(TDevice *dev)
 {
    INSTANCE_POINTER(dev, TIPPrivate *);
 
+   #if IP_USE_MMSG
+   ip_rx_stop( dev );
+   #endif
+
    if (me->fd != INVALID_SOCKET)
    {
       closesocket( me->fd);
@@ -331,6 +381,12 @@ DWORD ip_Read(TDevice * dev,
       goto end;
    }
 
+   #if IP_USE_MMSG
+   //datagrams are already received by the receive thread...
+   res = ip_rx_read(dev, DestBuffer, dBufferSize, DeviceHandle);
+   goto end;
+   #endif
+
    //YASDI_DEBUG((VERBOSE_HWL, "IP::Read() step2 \n"));
 
    //Is there still something in the receive buffer? return them....
@@ -426,10 +482,28 @@ int ip_GetMTU(TDevice *dev)
    return 65507;
 }
 
-//!Do ioctrl: In this driver there is no function defined...
+//!Do ioctrl: Only the receive time of the datagrams is known...
 int ip_IoCtrl(TDevice *dev, int cmd, BYTE * params)
 {
    YASDI_DEBUG((VERBOSE_HWL,"IP::IoCtrl()...\n"));
+
+   //"Protocol=auto" in Speedwire mode
+   if (cmd == IOCTRL_GET_PROTOCOL)
+   {
+      INSTANCE_POINTER(dev, TIPPrivate *);
+      if (!me->bSpeedwire) return IOCTRL_UNKNOWN_CMD;
+      strcpy((char*)params, "Speedwire");
+      return 0;
+   }
+
+   #if IP_USE_MMSG
+   if (cmd == IOCTRL_GET_RX_TIMESTAMP)
+   {
+      INSTANCE_POINTER(dev, TIPPrivate *);
+      *((DWORD*)params) = me->dRxTimestamp;
+      return 0;
+   }
+   #endif
    
    #ifdef TEST_BUS_DRIVER_EVENTS
    {
@@ -462,10 +536,13 @@ int ip_IoCtrl(TDevice *dev, int cmd, BYTE * params)
 **************************************************************************/
 void ip_Destroy(TDevice *dev)
 {
-   INSTANCE_POINTER(dev, struct TIPPrivate *);
+   INSTANCE_POINTER(dev, TIPPrivate *);
    assert( dev );
 
    assert(me);
+   #if IP_USE_MMSG
+   pthread_mutex_destroy( &me->RxMutex );
+   #endif
    free(me);
 }
 
@@ -483,8 +560,10 @@ TDevice * ip_Create( DWORD dUnit )
    char AddressString[30];
    TIPPrivate *priv;
    int i;
+   WORD wPeerPort;
 
-   char cConfigPath[50];
+   //driver name (TDevice.cName) + the longest key (".PeerTimeout", ".Device<n>")
+   char cConfigPath[sizeof(((TDevice*)0)->cName) + 20];
    struct sockaddr_in addr;
 
 
@@ -502,6 +581,14 @@ TDevice * ip_Create( DWORD dUnit )
       priv->fd                 = INVALID_SOCKET;
       priv->dBytesSendTotal    = 0;
       priv->dBytesinRecvBuffer = 0;
+      #if IP_USE_MMSG
+      priv->epfd               = -1;
+      priv->bRxThreadRun       = FALSE;
+      priv->dRxFirst           = 0;
+      priv->dRxCount           = 0;
+      priv->dRxTimestamp       = 0;
+      pthread_mutex_init( &priv->RxMutex, NULL );
+      #endif
 
       /* Treiber-Struktur initialisieren */
       interfaces->Open               = ip_Open;
@@ -514,6 +601,9 @@ TDevice * ip_Create( DWORD dUnit )
       sprintf(interfaces->cName, "IP%lu", (unsigned long)dUnit);  /* Treibername */
 
       INITLIST(&priv->comPeerList);
+      memset(priv->PeerHash, 0, sizeof(priv->PeerHash));
+      priv->dPeerCount     = 0;
+      priv->dLastPeerAging = 0;
 
 
       /* Read Settings from Repository (Registry) */
@@ -534,18 +624,40 @@ TDevice * ip_Create( DWORD dUnit )
 
       }
 
+      /*
+      ** Speedwire devices (protocol "Speedwire"): all use port 9522,
+      ** the devices are found with a multicast
+      */
+      sprintf(cConfigPath, "%s.Speedwire", interfaces->cName);
+      priv->bSpeedwire = TRepository_GetElementInt( cConfigPath, 0 ) ? TRUE : FALSE;
+      wPeerPort = DEFAULT_SMADATAPORT;
+      if (priv->bSpeedwire)
+      {
+         priv->LocalPort = DEFAULT_SPEEDWIREPORT;
+         wPeerPort       = DEFAULT_SPEEDWIREPORT;
+      }
+      memset(&priv->McastPeer, 0, sizeof(priv->McastPeer));
+      priv->McastPeer.addr.sin_family      = AF_INET;
+      priv->McastPeer.addr.sin_addr.s_addr = htonl(Address2Ip(SPEEDWIRE_DISCOVERY_GROUP));
+      priv->McastPeer.addr.sin_port        = htons(DEFAULT_SPEEDWIREPORT);
+      priv->McastPeer.bStatic              = TRUE;
+
       /*
       * Richte die Adresse des Server-Socket-Ports ein...
       * Das ist der eigene lokale UDP-Port fuer die Kommunikation
       */
-      //sprintf(cConfigPath, "%s.LocalPort", interfaces->cName);
-      //priv->LocalPort = Repo->GetElementInt(Repo, cConfigPath, DEFAULT_SMADATAPORT );
+      sprintf(cConfigPath, "%s.LocalPort", interfaces->cName);
+      priv->LocalPort = TRepository_GetElementInt( cConfigPath, priv->LocalPort );
       YASDI_DEBUG((VERBOSE_HWL,"IP::Create(): Using local server port = %d\n",
                                priv->LocalPort));
       priv->ClientAddr.sin_family       = AF_INET;
       priv->ClientAddr.sin_addr.s_addr  = htonl( INADDR_ANY ); /* 127.0.0.1 */
       priv->ClientAddr.sin_port         = htons( priv->LocalPort );
 
+      /* Forget learned peers silent since ... seconds (0 = never) */
+      sprintf(cConfigPath, "%s.PeerTimeout", interfaces->cName);
+      priv->dPeerTimeout = TRepository_GetElementInt( cConfigPath, IP_PEER_TIMEOUT );
+
 
 
 
@@ -563,11 +675,12 @@ TDevice * ip_Create( DWORD dUnit )
 
          addr.sin_family      = AF_INET;
          addr.sin_addr.s_addr = htonl(Address2Ip(AddressString));
-         addr.sin_port        = htons(Address2Port(AddressString, DEFAULT_SMADATAPORT));
+         addr.sin_port        = htons(Address2Port(AddressString, wPeerPort));
 
          /* The only one remote address (all packet send to him ) */
-         ip_addNewPeer( interfaces,
-                        &addr );
+         ip_addPeer( interfaces,
+                     &addr,
+                     TRUE );
       }
 
        /* ** register this new device */
@@ -583,40 +696,178 @@ TDevice * ip_Create( DWORD dUnit )
 }
 
 
+//! slot of an ip address (network byte order) in the peer table
+static DWORD ip_peerHash(DWORD ipaddr)
+{
+   return (DWORD)(ipaddr * 2654435761U) >> (32 - IP_PEER_HASH_BITS);
+}
+
+
 /**************************************************************************
-*
-* NAME        : <Name>
-*
-* DESCRIPTION :
-*
-*
-***************************************************************************
-*
-* IN     : ---
-*
-* OUT    : ---
-*
-* RETURN : ---
-*
-* THROWS : ---
-*
+   Description   : Find an peer (ip address and port) in the peer table
+   Parameter     : dev = driver instance
+                   addr = address of the peer
+   Return-Value  : the peer or NULL if unknown
 **************************************************************************/
-void ip_addNewPeer(TDevice *dev, struct sockaddr_in * addr)
+TPeerListEntry * ip_findPeer(TDevice *dev, struct sockaddr_in * addr)
 {
    INSTANCE_POINTER(dev, TIPPrivate *);
    TPeerListEntry * entry;
-   char buffer[20];
+   DWORD slot;
 
    assert(dev);
    assert(addr);
 
-   /* is peer already in list? */
-   foreach_f(&me->comPeerList, entry)
+   /* the table is never full, so there is always an free slot at the end */
+   slot = ip_peerHash( addr->sin_addr.s_addr );
+   while((entry = me->PeerHash[slot]) != NULL)
    {
       if (entry->addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
           entry->addr.sin_port        == addr->sin_port)
       {
-         return; //already in list...
+         return entry;
+      }
+      slot = (slot + 1) & (IP_PEER_HASH_SIZE - 1);
+   }
+
+   return NULL;
+}
+
+
+/**************************************************************************
+   Description   : Remove an peer from the peer list and the peer table
+   Parameter     : dev = driver instance
+                   entry = the peer
+   Return-Value  : ---
+**************************************************************************/
+void ip_removePeer(TDevice *dev, TPeerListEntry * entry)
+{
+   INSTANCE_POINTER(dev, TIPPrivate *);
+   DWORD slot, next, home;
+   char buffer[20];
+
+   assert(dev);
+   assert(entry);
+
+   slot = ip_peerHash( entry->addr.sin_addr.s_addr );
+   while(me->PeerHash[slot] != entry)
+   {
+      assert(me->PeerHash[slot]);
+      slot = (slot + 1) & (IP_PEER_HASH_SIZE - 1);
+   }
+   me->PeerHash[slot] = NULL;
+
+   /* close the gap: move back all following peers of the probe sequence 
+      which would not be found anymore (no "deleted" markers needed) */
+   next = slot;
+   for(;;)
+   {
+      next = (next + 1) & (IP_PEER_HASH_SIZE - 1);
+      if (me->PeerHash[next] == NULL) break;
+
+      home = ip_peerHash( me->PeerHash[next]->addr.sin_addr.s_addr );
+      /* is "home" cyclic in (slot, next]? Then the peer stays there... */
+      if (slot <= next ? (slot < home && home <= next) 
+                       : (slot < home || home <= next))
+         continue;
+
+      me->PeerHash[slot] = me->PeerHash[next];
+      me->PeerHash[next] = NULL;
+      slot = next;
+   }
+   me->dPeerCount--;
+
+   printIPAddress(&entry->addr, buffer);
+   YASDI_DEBUG((VERBOSE_HWL, "IP: Removed peer: %s\n", buffer));
+
+   REMOVE( &entry->Node );
+   TMemPool_FreeElem( &MemPoolPeerList, entry );
+}
+
+
+/**************************************************************************
+   Description   : Forget all learned peers which are silent since the 
+                   configured time ("IPx.PeerTimeout"). Configured peers 
+                   are never removed.
+   Parameter     : dev = driver instance
+                   bForce = check now (otherwise only all 
+                            IP_PEER_AGING_INTERVAL seconds)
+   Return-Value  : ---
+**************************************************************************/
+void ip_agePeers(TDevice *dev, BOOL bForce)
+{
+   INSTANCE_POINTER(dev, TIPPrivate *);
+   TPeerListEntry * entry;
+   TPeerListEntry * next;
+   DWORD dNow;
+
+   if (!me->dPeerTimeout) return;
+
+   dNow = os_GetSystemTime( NULL );
+   if (!bForce && (dNow - me->dLastPeerAging) < IP_PEER_AGING_INTERVAL)
+      return;
+   me->dLastPeerAging = dNow;
+
+   for(entry = (TPeerListEntry*)GETFIRST(&me->comPeerList); 
+       ISELEMENTVALID(entry); 
+       entry = next)
+   {
+      next = (TPeerListEntry*)GETNEXT(&entry->Node);
+      if (!entry->bStatic && (dNow - entry->dLastSeen) >= me->dPeerTimeout)
+         ip_removePeer(dev, entry);
+   }
+}
+
+
+/**************************************************************************
+   Description   : Add an peer to the peer list (or refresh it, if it is 
+                   already known). When the table is full the oldest 
+                   learned peer is removed.
+   Parameter     : dev = driver instance
+                   addr = address of the peer
+                   bStatic = configured peer (never aged out)
+   Return-Value  : ---
+**************************************************************************/
+void ip_addPeer(TDevice *dev, struct sockaddr_in * addr, BOOL bStatic)
+{
+   INSTANCE_POINTER(dev, TIPPrivate *);
+   TPeerListEntry * entry;
+   TPeerListEntry * oldest = NULL;
+   DWORD slot;
+   char buffer[20];
+
+   assert(dev);
+   assert(addr);
+
+   /* is peer already in list? */
+   entry = ip_findPeer(dev, addr);
+   if (entry)
+   {
+      entry->dLastSeen = os_GetSystemTime( NULL );
+      if (bStatic) entry->bStatic = TRUE;
+      return; //already in list...
+   }
+
+   /* table full? Make room... */
+   if (me->dPeerCount >= IP_PEER_MAX)
+   {
+      ip_agePeers(dev, TRUE);
+      if (me->dPeerCount >= IP_PEER_MAX)
+      {
+         foreach_f(&me->comPeerList, entry)
+         {
+            if (!entry->bStatic && 
+                (!oldest || (entry->dLastSeen < oldest->dLastSeen)))
+               oldest = entry;
+         }
+         if (!oldest)
+         {
+            printIPAddress(addr, buffer);
+            YASDI_DEBUG((VERBOSE_WARNING, 
+                         "IP: Peer table is full, ignoring peer %s\n", buffer));
+            return;
+         }
+         ip_removePeer(dev, oldest);
       }
    }
 
@@ -626,13 +877,45 @@ void ip_addNewPeer(TDevice *dev, struct sockaddr_in * addr)
    entry->addr.sin_family       = AF_INET;
    entry->addr.sin_addr.s_addr  = addr->sin_addr.s_addr ; 
    entry->addr.sin_port         = addr->sin_port;
+   entry->dLastSeen             = os_GetSystemTime( NULL );
+   entry->bStatic               = bStatic;
    ADDHEAD( &me->comPeerList, &entry->Node );
 
+   /* ...and index it */
+   slot = ip_peerHash( entry->addr.sin_addr.s_addr );
+   while(me->PeerHash[slot] != NULL)
+      slot = (slot + 1) & (IP_PEER_HASH_SIZE - 1);
+   me->PeerHash[slot] = entry;
+   me->dPeerCount++;
 
    printIPAddress(& entry->addr, buffer);
    YASDI_DEBUG((VERBOSE_HWL,
                 "IP: Added new peer: %s\n", buffer));
+}
+
 
+/**************************************************************************
+*
+* NAME        : <Name>
+*
+* DESCRIPTION : An datagram was received from an peer: Add it to the 
+*               peers (or refresh the known one)
+*
+*
+***************************************************************************
+*
+* IN     : ---
+*
+* OUT    : ---
+*
+* RETURN : ---
+*
+* THROWS : ---
+*
+**************************************************************************/
+void ip_addNewPeer(TDevice *dev, struct sockaddr_in * addr)
+{
+   ip_addPeer(dev, addr, FALSE);
 }
 
 
@@ -661,42 +944,94 @@ void ip_SendToPeer(TDevice *dev,
                    int buffersize )
 {
    INSTANCE_POINTER(dev, TIPPrivate *);
+   TPeerListEntry * targets[IP_PEER_MAX];
    TPeerListEntry * entry;
+   int iTargets = 0;
+   int i;
+   DWORD slot;
    BOOL bSendToSomeone = false;
+   #if IP_USE_MMSG
+   struct mmsghdr msgs[IP_TX_BATCH];
+   struct iovec iov;
+   int count = 0;
+   #else
    char ipaddr_buffer[20] = {0};
+   #endif
 
    assert(dev);
    assert(buffer);
 
-   /* for all in the peer list do: */
-   foreach_f(&me->comPeerList, entry)
+   /* send it as an broadcast to all devices or to an particulary device ? */
+   if (flags == DSF_MONOCAST)
    {
-      /* send it as an broadcast to all devices or to an particulary device ? */
-      if (flags == DSF_BROADCAST_ALLKNOWN ||
-          flags == DSF_BROADCAST ||
-          (flags == DSF_MONOCAST && 
-           (inetAddr2DriverDeviceHandle(&entry->addr) == DriverDeviceHandle)))
+      /* all peers of this ip address are in the same probe sequence */
+      slot = ip_peerHash( htonl( DriverDeviceHandle ) );
+      while((entry = me->PeerHash[slot]) != NULL && iTargets < IP_PEER_MAX)
       {
-         /* Packet to that peer */
-         if ( sendto(me->fd,
-                     buffer, buffersize,
-                     0, (void*)&entry->addr, sizeof(entry->addr) ) == SOCKET_ERROR)
-         {
-            YASDI_DEBUG((VERBOSE_WARNING,
-                         "IP::ip_SendToPeer(): Error writing to socket! Last error code = %d!\n",
-                         WSAGetLastError() ));
-         }
-         else
-         { 
-            printIPAddress(&entry->addr, ipaddr_buffer);
-            YASDI_DEBUG((VERBOSE_HWL,
-                         "IP::ip_SendToPeer(): Send packet to peer %s\n", ipaddr_buffer 
-                       ));
-            /* calculate total send bytes */
-            me->dBytesSendTotal += buffersize;
+         if (inetAddr2DriverDeviceHandle(&entry->addr) == DriverDeviceHandle)
+            targets[iTargets++] = entry;
+         slot = (slot + 1) & (IP_PEER_HASH_SIZE - 1);
+      }
+   }
+   else if (flags == DSF_BROADCAST_ALLKNOWN || flags == DSF_BROADCAST)
+   {
+      ip_agePeers(dev, FALSE);
+      foreach_f(&me->comPeerList, entry)
+      {
+         if (iTargets < IP_PEER_MAX)
+            targets[iTargets++] = entry;
+      }
+
+      /* Speedwire: a real broadcast reaches the unknown devices too */
+      if (flags == DSF_BROADCAST && me->bSpeedwire && iTargets < IP_PEER_MAX)
+         targets[iTargets++] = &me->McastPeer;
+   }
+
+   #if IP_USE_MMSG
+   /* all peers share the same packet... */
+   iov.iov_base = buffer;
+   iov.iov_len  = buffersize;
+   #endif
+
+   for(i = 0; i < iTargets; i++)
+   {
+      entry = targets[i];
+
+      #if IP_USE_MMSG
+      /* collect the peers and send to all of them with one syscall */
+      memset(&msgs[count], 0, sizeof(msgs[count]));
+      msgs[count].msg_hdr.msg_name    = &entry->addr;
+      msgs[count].msg_hdr.msg_namelen = sizeof(entry->addr);
+      msgs[count].msg_hdr.msg_iov     = &iov;
+      msgs[count].msg_hdr.msg_iovlen  = 1;
+      count++;
+      if (count == IP_TX_BATCH || i == iTargets - 1)
+      {
+         if (ip_send_batch(dev, msgs, &targets[i + 1 - count], count, buffersize))
             bSendToSomeone = true;
-         }
+         count = 0;
+      }
+      #else
+      /* Packet to that peer */
+      if ( sendto(me->fd,
+                  buffer, buffersize,
+                  0, (void*)&entry->addr, sizeof(entry->addr) ) == SOCKET_ERROR)
+      {
+         YASDI_DEBUG((VERBOSE_WARNING,
+                      "IP::ip_SendToPeer(): Error writing to socket! Last error code = %d!\n",
+                      WSAGetLastError() ));
       }
+      else
+      { 
+         printIPAddress(&entry->addr, ipaddr_buffer);
+         YASDI_DEBUG((VERBOSE_HWL,
+                      "IP::ip_SendToPeer(): Send packet to peer %s\n", ipaddr_buffer 
+                    ));
+         /* calculate total send bytes */
+         me->dBytesSendTotal += buffersize;
+         bSendToSomeone = true;
+      }
+      #endif
    }
 
    if (!bSendToSomeone)
@@ -710,6 +1045,324 @@ void ip_SendToPeer(TDevice *dev,
 }
 
 
+#if IP_USE_MMSG
+
+/**************************************************************************
+   Description   : Send one packet to some peers with "sendmmsg()". 
+                   When the packet can't be send to one peer this 
+                   peer is skipped and the rest is send.
+   Parameter     : dev = driver instance
+                   msgs = the prepared messages (one for each peer)
+                   peers = the peers of the messages
+                   count = count of messages
+                   buffersize = size of the packet
+   Return-Value  : true if the packet was send to at least one peer
+**************************************************************************/
+static BOOL ip_send_batch(TDevice * dev, struct mmsghdr * msgs, 
+                          TPeerListEntry ** peers, int count, int buffersize)
+{
+   INSTANCE_POINTER(dev, TIPPrivate *);
+   char ipaddr_buffer[20] = {0};
+   BOOL bSend = false;
+   int sent = 0;
+   int ires, i;
+
+   while(sent < count)
+   {
+      ires = sendmmsg(me->fd, msgs + sent, count - sent, 0);
+      if (ires <= 0)
+      {
+         if (ires < 0 && errno == EINTR) continue;
+
+         /* the first message failed: skip this peer... */
+         printIPAddress(&peers[sent]->addr, ipaddr_buffer);
+         YASDI_DEBUG((VERBOSE_WARNING,
+                      "IP::ip_SendToPeer(): Error writing to socket (peer %s)! "
+                      "Last error code = %d!\n", ipaddr_buffer, WSAGetLastError() ));
+         sent++;
+         continue;
+      }
+
+      for(i = sent; i < sent + ires; i++)
+      { 
+         printIPAddress(&peers[i]->addr, ipaddr_buffer);
+         YASDI_DEBUG((VERBOSE_HWL,
+                      "IP::ip_SendToPeer(): Send packet to peer %s\n", ipaddr_buffer 
+                    ));
+         /* calculate total send bytes */
+         me->dBytesSendTotal += buffersize;
+      }
+      sent += ires;
+      bSend = true;
+   }
+
+   return bSend;
+}
+
+
+//! Inform the YASDI core, that new datagrams are available now
+static void ip_signal_input(TDevice * dev)
+{
+   TGenDriverEvent event;
+   if (!SendEventCallback) return;
+
+   memset(&event, 0, sizeof(event));
+   event.eventType = DRE_NEW_INPUT;
+   event.DriverID  = dev->DriverID;
+   SendEventCallback( dev, &event );
+}
+
+//! The kernel stamps the datagrams with the system time: 
+//! convert it to monotonic time (by the age of the datagram)
+static DWORD ip_kernel_time2monotonic(struct timespec * rxtime)
+{
+   struct timespec now;
+   long long age;
+
+   clock_gettime( CLOCK_REALTIME, &now );
+   age = (long long)(now.tv_sec - rxtime->tv_sec) * 1000 + 
+         (now.tv_nsec - rxtime->tv_nsec) / 1000000;
+   if (age < 0) age = 0;
+   return os_GetMonotonicTime() - (DWORD)age;
+}
+
+
+/**************************************************************************
+   Description   : The receive thread of the socket. Waits with "epoll" 
+                   for datagrams and fetches all waiting datagrams with 
+                   one "recvmmsg()" call directly into the free slots of
+                   the receive ring. The receive time of each datagram 
+                   is taken from the kernel (SO_TIMESTAMPNS).
+                   The YASDI core is informed to read them at once.
+   Parameter     : param = the driver instance
+   Return-Value  : ---
+**************************************************************************/
+static void * ip_rx_thread(void * param)
+{
+   TDevice * dev = (TDevice*)param;
+   INSTANCE_POINTER(dev, TIPPrivate *);
+   struct mmsghdr msgs[IP_RX_BATCH];
+   struct iovec iov[IP_RX_BATCH];
+   BYTE ctrl[IP_RX_BATCH][CMSG_SPACE(sizeof(struct timespec))];
+   TIPDatagram * slots[IP_RX_BATCH];
+   struct epoll_event ev;
+   struct cmsghdr * cmsg;
+   struct timespec ts;
+   DWORD dFree, dPos, dNow, i;
+   int ires;
+
+   while( me->bRxThreadRun )
+   {
+      ires = epoll_wait( me->epfd, &ev, 1, IP_RX_WAIT_TIMEOUT );
+      if (ires < 0)
+      {
+         if (errno == EINTR) continue;
+         break;
+      }
+      if (ires == 0) continue;
+
+      /* free slots of the ring (only "ip_Read" releases slots) */
+      pthread_mutex_lock( &me->RxMutex );
+      dFree = IP_RX_SLOTS - me->dRxCount;
+      dPos  = (me->dRxFirst + me->dRxCount) % IP_RX_SLOTS;
+      pthread_mutex_unlock( &me->RxMutex );
+      if (dFree == 0)
+      {
+         /* ring is full: wait until the YASDI core has read some... */
+         ip_signal_input( dev );
+         os_thread_sleep( 10 );
+         continue;
+      }
+      dFree = min(dFree, IP_RX_BATCH);
+
+      memset(msgs, 0, sizeof(msgs));
+      for(i = 0; i < dFree; i++)
+      {
+         slots[i] = &me->RxSlots[ (dPos + i) % IP_RX_SLOTS ];
+         iov[i].iov_base                 = slots[i]->Data;
+         iov[i].iov_len                  = sizeof(slots[i]->Data);
+         msgs[i].msg_hdr.msg_name        = &slots[i]->addr;
+         msgs[i].msg_hdr.msg_namelen     = sizeof(slots[i]->addr);
+         msgs[i].msg_hdr.msg_iov         = &iov[i];
+         msgs[i].msg_hdr.msg_iovlen      = 1;
+         msgs[i].msg_hdr.msg_control     = ctrl[i];
+         msgs[i].msg_hdr.msg_controllen  = sizeof(ctrl[i]);
+      }
+
+      ires = recvmmsg( me->fd, msgs, dFree, MSG_DONTWAIT, NULL );
+      if (ires < 0)
+      {
+         /* "ICMP: Port Unreachable" of an sent packet: ignore it */
+         if (errno == EINTR || errno == EAGAIN || errno == ECONNREFUSED) 
+            continue;
+         break;
+      }
+
+      dNow = os_GetMonotonicTime();
+      for(i = 0; i < (DWORD)ires; i++)
+      {
+         slots[i]->dLen     = msgs[i].msg_len;
+         slots[i]->dReadPos = 0;
+         slots[i]->dTime    = dNow;
+         for(cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); 
+             cmsg; 
+             cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg))
+         {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+            {
+               memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+               slots[i]->dTime = ip_kernel_time2monotonic( &ts );
+            }
+         }
+      }
+
+      pthread_mutex_lock( &me->RxMutex );
+      me->dRxCount += ires;
+      pthread_mutex_unlock( &me->RxMutex );
+
+      if (ires > 0)
+         ip_signal_input( dev );
+   }
+
+   if (me->bRxThreadRun)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "IP: Error receiving from socket: %d\n",
+                   WSAGetLastError() ));
+   }
+
+   return NULL;
+}
+
+//! Start the receive thread of the socket
+static BOOL ip_rx_start(TDevice * dev)
+{
+   INSTANCE_POINTER(dev, TIPPrivate *);
+   struct epoll_event ev;
+   int on = 1;
+
+   /* the kernel should stamp all datagrams (not fatal if not possible) */
+   if (setsockopt(me->fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) != 0)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "IP::Open(): No kernel receive timestamps!\n"));
+   }
+
+   me->epfd = epoll_create1( EPOLL_CLOEXEC );
+   if (me->epfd < 0)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "IP::Open(): Can't create epoll instance!\n"));
+      return FALSE;
+   }
+   memset(&ev, 0, sizeof(ev));
+   ev.events  = EPOLLIN;
+   ev.data.fd = me->fd;
+   if (epoll_ctl(me->epfd, EPOLL_CTL_ADD, me->fd, &ev) != 0)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "IP::Open(): Can't add socket to epoll!\n"));
+      return FALSE;
+   }
+
+   /* forget all old datagrams */
+   pthread_mutex_lock( &me->RxMutex );
+   me->dRxFirst = me->dRxCount = 0;
+   pthread_mutex_unlock( &me->RxMutex );
+
+   me->bRxThreadRun = TRUE;
+   if (pthread_create( &me->RxThread, NULL, ip_rx_thread, dev ) != 0)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "IP::Open(): Can't create receive thread!\n"));
+      me->bRxThreadRun = FALSE;
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+//! Stop the receive thread of the socket (and wait until it has ended)
+static void ip_rx_stop(TDevice * dev)
+{
+   INSTANCE_POINTER(dev, TIPPrivate *);
+
+   if (me->bRxThreadRun)
+   {
+      me->bRxThreadRun = FALSE;
+      pthread_join( me->RxThread, NULL );
+   }
+
+   if (me->epfd >= 0)
+   {
+      close( me->epfd );
+      me->epfd = -1;
+   }
+}
+
+
+/**************************************************************************
+   Description   : Read the bytes of the oldest received datagram. An 
+                   datagram is never mixed with the next one.
+   Parameter     : dev = driver instance
+                   DestBuffer = pointer to buffer to store bytes in
+                   dBufferSize = max size of buffer
+                   DeviceHandle = the sender of the datagram
+   Return-Value  : count of bytes read
+**************************************************************************/
+static DWORD ip_rx_read(TDevice * dev, BYTE * DestBuffer, DWORD dBufferSize,
+                        DWORD * DeviceHandle)
+{
+   INSTANCE_POINTER(dev, TIPPrivate *);
+   TIPDatagram * slot = NULL;
+   char ip_buffer[20];
+   DWORD len;
+
+   /* skip empty datagrams */
+   pthread_mutex_lock( &me->RxMutex );
+   while(me->dRxCount)
+   {
+      slot = &me->RxSlots[ me->dRxFirst ];
+      if (slot->dReadPos < slot->dLen) break;
+      me->dRxFirst = (me->dRxFirst + 1) % IP_RX_SLOTS;
+      me->dRxCount--;
+      slot = NULL;
+   }
+   pthread_mutex_unlock( &me->RxMutex );
+   if (!slot) return 0; //nothing received...
+
+   /* the slot is not touched by the receive thread until it's released */
+   if (slot->dReadPos == 0)
+   {
+      me->lastRcvPkt = slot->addr;
+
+      /* put the received remote address into my list of available peers...*/
+      ip_addNewPeer(dev, &slot->addr);
+
+      printIPAddress(&slot->addr, ip_buffer);
+      YASDI_DEBUG((VERBOSE_HWL, "IP::Read(): read %d bytes from peer %s\n",
+                                slot->dLen, ip_buffer ));
+      dBytesReadTotal += slot->dLen;
+   }
+
+   if (DeviceHandle != NULL)
+      *DeviceHandle = inetAddr2DriverDeviceHandle( &slot->addr );
+
+   len = min(dBufferSize, slot->dLen - slot->dReadPos);
+   memcpy(DestBuffer, slot->Data + slot->dReadPos, len);
+   slot->dReadPos += len;
+   me->dRxTimestamp = slot->dTime;
+
+   /* datagram complete read? release the slot */
+   if (slot->dReadPos >= slot->dLen)
+   {
+      pthread_mutex_lock( &me->RxMutex );
+      me->dRxFirst = (me->dRxFirst + 1) % IP_RX_SLOTS;
+      me->dRxCount--;
+      pthread_mutex_unlock( &me->RxMutex );
+   }
+
+   return len;
+}
+
+#endif /* IP_USE_MMSG */
+
+
 /**************************************************************************
 *
 * NAME        : <Name>
@@ -43,12 +43,36 @@
 #define GET_IP_ADDR_AS_DWORD(addr) ((DWORD)addr->sin_addr.S_un.S_addr)
 #endif
 
+//the multicast group of the Speedwire device discovery
+#define SPEEDWIRE_DISCOVERY_GROUP "239.12.255.254"
+
+//Linux: an receive thread waits with "epoll" and fetches all waiting 
+//datagrams with one "recvmmsg()" call. Broadcasts are sent to all peers
+//with one "sendmmsg()" call. Other systems poll the socket...
+#if defined(__linux__)
+#define IP_USE_MMSG 1
+#else
+#define IP_USE_MMSG 0
+#endif
+
 
 
 enum
 {
    RECVBUFFERSIZE       = 1500,   /* Size of the send and receive packet buffer */
    DEFAULT_SMADATAPORT  = 24272,  /* official SMAData over IP port */
+   DEFAULT_SPEEDWIREPORT= 9522,   /* Speedwire (SMA Data2+) port             */
+
+   IP_RX_SLOTS          = 64,     /* received datagrams waiting for "ip_Read"   */
+   IP_RX_BATCH          = 16,     /* max. datagrams of one "recvmmsg()" call    */
+   IP_TX_BATCH          = 32,     /* max. peers of one "sendmmsg()" call        */
+   IP_RX_WAIT_TIMEOUT   = 200,    /* ms, receive thread checks for his end      */
+
+   IP_PEER_HASH_BITS    = 8,      
+   IP_PEER_HASH_SIZE    = 1 << IP_PEER_HASH_BITS, /* slots of the peer table  */
+   IP_PEER_MAX          = 192,    /* max. peers (3/4 of the table slots)        */
+   IP_PEER_TIMEOUT      = 3600,   /* s, default: forget silent learned peers    */
+   IP_PEER_AGING_INTERVAL = 60,   /* s, check of the peer ages                  */
 };
 
 
@@ -57,9 +81,24 @@ typedef struct
 {
    TMinNode Node;
    struct sockaddr_in addr;
+   DWORD dLastSeen;                 /* time of the last datagram (s)          */
+   BOOL bStatic;                    /* configured peer (never aged out)       */
 } TPeerListEntry;
 
 
+#if IP_USE_MMSG
+/* One received datagram (slot of the receive ring) */
+typedef struct
+{
+   struct sockaddr_in addr;         /* sender of the datagram                 */
+   DWORD dTime;                     /* monotonic receive time (ms, kernel)    */
+   DWORD dLen;                      /* size of the datagram                   */
+   DWORD dReadPos;                  /* bytes already read by "ip_Read"        */
+   BYTE Data[RECVBUFFERSIZE];
+} TIPDatagram;
+#endif
+
+
 /* Private driver area */
 typedef struct
 {
@@ -72,6 +111,28 @@ typedef struct
    BYTE recvBuffer[RECVBUFFERSIZE]; /* Receive Buffer                         */
    BYTE SendBuffer[RECVBUFFERSIZE]; /* Sendepuffer                            */
    TMinList comPeerList;            /* List of all communication partner      */
+
+   /* index of the peer list: open addressing (linear probing), hashed 
+      with the ip address only, so all peers of one "DriverDeviceHandle"
+      are found in one probe sequence */
+   TPeerListEntry * PeerHash[IP_PEER_HASH_SIZE];
+   DWORD dPeerCount;                /* peers in table                         */
+   DWORD dPeerTimeout;              /* s, age of learned peers, 0 = never     */
+   DWORD dLastPeerAging;            /* time of the last aging check           */
+
+   BOOL bSpeedwire;                 /* Speedwire mode: port 9522, multicast   */
+   TPeerListEntry McastPeer;        /* Speedwire: the discovery group         */
+
+   #if IP_USE_MMSG
+   int epfd;                        /* epoll instance of the receive thread   */
+   pthread_t RxThread;              /* the receive thread                     */
+   BOOL bRxThreadRun;               /* thread should run                      */
+   pthread_mutex_t RxMutex;         /* access to the receive ring             */
+   TIPDatagram RxSlots[IP_RX_SLOTS];/* ring of received datagrams             */
+   DWORD dRxFirst;                  /* the oldest datagram                    */
+   DWORD dRxCount;                  /* datagrams in ring                      */
+   DWORD dRxTimestamp;              /* receive time of the last read bytes    */
+   #endif
 } TIPPrivate;
 
 
@@ -86,6 +147,10 @@ TDriverEvent ip_GetSupportedEvents(TDevice * dev);
 
 /* private: */
 void ip_addNewPeer(TDevice *dev, struct sockaddr_in * addr );
+void ip_addPeer(TDevice *dev, struct sockaddr_in * addr, BOOL bStatic );
+TPeerListEntry * ip_findPeer(TDevice *dev, struct sockaddr_in * addr );
+void ip_removePeer(TDevice *dev, TPeerListEntry * entry );
+void ip_agePeers(TDevice *dev, BOOL bForce );
 void ip_SendToPeer(TDevice *dev,
                    DWORD DriverDeviceHandle,
                    TDriverSendFlags flags,
@@ -0,0 +1,890 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ * 
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ * 
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+/**************************************************************************
+*             SMA Technologie AG, 34266 Niestetal, Germany
+***************************************************************************
+* Project       : YASDI
+***************************************************************************
+* Project-no.   :
+***************************************************************************
+* Filename      : recorder.c
+***************************************************************************
+* Description   : Bus recorder and replay driver
+***************************************************************************
+* Preconditions :
+***************************************************************************
+* Changes       : Author, Date, Version, Reason
+*                 *********************************************************
+***************************************************************************/
+
+/**
+  This YASDI Bus Driver works in two modes (configuration "Recorder.Mode"):
+
+  "Record": The driver modules "Recorder.DriverX" are loaded by this 
+            module instead of by YASDI. Each of their bus drivers is 
+            wrapped by an driver with the same name, which writes all 
+            sent and received bytes with a time stamp to the log file 
+            "Recorder.File".
+
+  "Replay": The bus drivers of the log file are created again and work as
+            an stand-in bus: An transmission of YASDI is matched with 
+            the recorded ones and the bytes received after it are 
+            returned at the recorded times (or faster, see 
+            "Recorder.Speed").
+ */
+
+
+/**************************************************************************
+***** INCLUDES ************************************************************
+***************************************************************************/
+
+#include "os.h"
+#include "debug.h"
+#include "smadef.h"
+#include "repository.h"
+#include "device.h"
+#include "driver_layer.h"
+#include "recorder.h"
+#include "copyright.h"
+#include "version.h"
+
+//linked into YASDI itself ("YASDI_STATIC_DRIVERS")? Then the module entries
+//need unique names...
+#ifdef YASDI_STATIC_DRIVERS
+#define InitYasdiModule    recorder_InitYasdiModule
+#define CleanupYasdiModule recorder_CleanupYasdiModule
+#endif
+
+
+/*************************************************************************/
+
+#define CREATE_VAR_THIS(d,interface) interface this = (void*)((d)->priv)
+
+//max. count of wrapped driver modules
+#define RECORDER_MAX_MODULES 8
+
+static int (*RegisterDevice)(TDevice * newdev);
+static TOnDriverEvent SendEventCallback;
+
+static TRecorderMode Mode;
+static char  cLogFile[256];
+static DWORD dSpeed;                          //replay speed factor (0 => no delays)
+
+static TDevice * Devices[RECORDER_MAX_DEVICES]; //all devices (index = number in log)
+static int iDeviceCount;
+
+//record mode
+static FILE * LogFile;
+static T_MUTEX LogMutex;
+static DWORD dLastRecordTime;
+static DLLHANDLE Modules[RECORDER_MAX_MODULES];
+static struct TStaticDriverModule * StaticModules[RECORDER_MAX_MODULES]; //built-in modules
+static int iModuleCount;
+
+//replay mode
+static BYTE * LogBuffer;                       //the complete log file
+
+
+static int (*FktInitModule)( void * RegFuncPtr, TOnDriverEvent eventCallback );
+static void (*FktCleanupModule)( void );
+
+
+/**************************************************************************
+***** IMPLEMENTATION ******************************************************
+**************************************************************************/
+
+
+//! Store a number as "varint". Returns the count of bytes used (max. 5)
+static int recorder_put_varint(BYTE * dest, DWORD value)
+{
+   int i = 0;
+   while(value >= 0x80)
+   {
+      dest[i++] = (BYTE)(value | 0x80);
+      value >>= 7;
+   }
+   dest[i++] = (BYTE)value;
+   return i;
+}
+
+//! Read a "varint". Returns FALSE if the buffer ends before
+static BOOL recorder_get_varint(BYTE ** pos, BYTE * end, DWORD * value)
+{
+   int shift = 0;
+   *value = 0;
+   while(*pos < end && shift < 35)
+   {
+      BYTE b = *(*pos)++;
+      *value |= (DWORD)(b & 0x7f) << shift;
+      if (!(b & 0x80)) return TRUE;
+      shift += 7;
+   }
+   return FALSE;
+}
+
+
+/**************************************************************************
+   Description   : Writes one record to the log file
+   Parameter     : bIndex = device number
+                   type   = record type
+                   dValue1, dValue2 = record values (see "recorder.h")
+                   data, dLen = the record bytes (or the device name)
+                   frame = if not NULL the record bytes are taken from
+                           this packet (dLen must be the packet length)
+   Return-Value  : ---
+**************************************************************************/
+static void recorder_log(BYTE bIndex, TRecordType type, 
+                         DWORD dValue1, DWORD dValue2,
+                         BYTE * data, DWORD dLen,
+                         struct TNetPacket * frame)
+{
+   BYTE head[24];
+   BYTE tail[10];
+   int iHead = 0;
+   int iTail = 0;
+   DWORD now;
+
+   if (!LogFile) return;
+
+   os_thread_MutexLock( &LogMutex );
+
+   now = os_GetMonotonicTime();
+   head[iHead++] = (BYTE)((type << 5) | (bIndex & 0x1f));
+   iHead += recorder_put_varint( &head[iHead], now - dLastRecordTime );
+   dLastRecordTime = now;
+
+   switch(type)
+   {
+      case REC_DEVICE:
+         iHead += recorder_put_varint( &head[iHead], dLen );
+         iTail += recorder_put_varint( &tail[iTail], dValue1 );
+         iTail += recorder_put_varint( &tail[iTail], dValue2 );
+         break;
+
+      case REC_TX:
+      case REC_RX:
+         iHead += recorder_put_varint( &head[iHead], dValue1 );
+         iHead += recorder_put_varint( &head[iHead], dLen );
+         break;
+
+      case REC_EVENT:
+         iHead += recorder_put_varint( &head[iHead], dValue1 );
+         iHead += recorder_put_varint( &head[iHead], dValue2 );
+         break;
+
+      default:
+         break;
+   }
+
+   fwrite( head, 1, iHead, LogFile );
+   if (frame)
+   {
+      BYTE * framedata = NULL;
+      WORD framedatasize = 0;
+      FOREACH_IN_BUFFER(frame, framedata, &framedatasize)
+      {
+         fwrite( framedata, 1, framedatasize, LogFile );
+      }
+   }
+   else if (dLen)
+   {
+      fwrite( data, 1, dLen, LogFile );
+   }
+   if (iTail) fwrite( tail, 1, iTail, LogFile );
+
+   //the log must be complete when YASDI is killed...
+   fflush( LogFile );
+
+   os_thread_MutexUnlock( &LogMutex );
+}
+
+
+/**************************************************************************
+   Description   : Creates a new device of this module 
+   Parameter     : name = bus driver name 
+   Return-Value  : the new device or NULL
+**************************************************************************/
+static TDevice * recorder_create(char * name, DWORD dNameLen)
+{
+   TDevice * dev;
+   struct TRecorderPriv * priv;
+
+   if (iDeviceCount >= RECORDER_MAX_DEVICES)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "Recorder: Too many bus drivers. Max. %d.\n",
+                   RECORDER_MAX_DEVICES ));
+      return NULL;
+   }
+
+   dev  = os_malloc( sizeof(TDevice) );
+   priv = os_malloc( sizeof(struct TRecorderPriv) );
+   if (!dev || !priv)
+   {
+      if (dev) os_free( dev );
+      if (priv) os_free( priv );
+      return NULL;
+   }
+   memset( dev,  0, sizeof(TDevice) );
+   memset( priv, 0, sizeof(struct TRecorderPriv) );
+
+   dNameLen = min(dNameLen, sizeof(dev->cName)-1);
+   os_memcpy( dev->cName, name, dNameLen );
+   dev->cName[ dNameLen ] = 0;
+   dev->priv = priv;
+   dev->DeviceState = DS_OFFLINE;
+   priv->bIndex = (BYTE)iDeviceCount;
+
+   Devices[ iDeviceCount++ ] = dev;
+   return dev;
+}
+
+
+
+/**************************************************************************
+***** Record mode *********************************************************
+**************************************************************************/
+
+static BOOL recorder_open(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   BOOL bRes = this->inner->Open( this->inner );
+   
+   dev->DeviceState = this->inner->DeviceState;
+   if (bRes) recorder_log( this->bIndex, REC_OPEN, 0, 0, NULL, 0, NULL );
+   return bRes;
+}
+
+static void recorder_close(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   
+   this->inner->Close( this->inner );
+   dev->DeviceState = this->inner->DeviceState;
+   recorder_log( this->bIndex, REC_CLOSE, 0, 0, NULL, 0, NULL );
+}
+
+static DWORD recorder_read(TDevice * dev, BYTE * DestBuffer, DWORD dBufferSize,
+                           DWORD * DriverDevHandle)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   DWORD dRead = this->inner->Read( this->inner, DestBuffer, dBufferSize, 
+                                    DriverDevHandle );
+   if (dRead)
+   {
+      recorder_log( this->bIndex, REC_RX, DriverDevHandle ? *DriverDevHandle : 0, 0,
+                    DestBuffer, dRead, NULL );
+   }
+   return dRead;
+}
+
+static void recorder_write(TDevice * dev, struct TNetPacket * frame,
+                           DWORD DriverDeviceHandle, TDriverSendFlags flags)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+
+   //log it before the bus driver changes the packet (e.g. powerline marks)
+   if (dev->DeviceState == DS_ONLINE)
+   {
+      recorder_log( this->bIndex, REC_TX, DriverDeviceHandle, 0,
+                    NULL, TNetPacket_GetFrameLength( frame ), frame );
+   }
+   this->inner->Write( this->inner, frame, DriverDeviceHandle, flags );
+}
+
+static int recorder_GetMTU(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   return this->inner->GetMTU( this->inner );
+}
+
+static TDriverEvent recorder_GetSupportedEvents(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   return this->inner->GetSupportedEvents( this->inner );
+}
+
+static int recorder_IoCtrl(TDevice * dev, int cmd, BYTE * params)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   return this->inner->IoCtrl( this->inner, cmd, params );
+}
+
+
+/**************************************************************************
+   Description   : Registration function for the wrapped driver modules:
+                   Wraps the new bus driver by an recorder driver with the
+                   same name and registers this one in YASDI.
+   Parameter     : inner = the new bus driver of the wrapped module
+   Return-Value  : == 0 : ok, > 0 : error code
+**************************************************************************/
+static int recorder_register_device(TDevice * inner)
+{
+   TDevice * dev;
+   struct TRecorderPriv * priv;
+   int ires;
+
+   dev = recorder_create( inner->cName, strlen(inner->cName) );
+   if (!dev) return PHY_ERROR_DEV_TWICE;
+   priv = dev->priv;
+   priv->inner = inner;
+
+   dev->Open      = recorder_open;
+   dev->Close     = recorder_close;
+   dev->Read      = recorder_read;
+   dev->Write     = recorder_write;
+   dev->GetMTU    = recorder_GetMTU;
+   dev->GetSupportedEvents = recorder_GetSupportedEvents;
+   dev->IoCtrl    = recorder_IoCtrl;
+
+   ires = (*RegisterDevice)( dev );
+   if (ires != PHY_OK)
+   {
+      Devices[ --iDeviceCount ] = NULL;
+      os_free( priv );
+      os_free( dev );
+      return ires;
+   }
+   
+   //events of the wrapped driver are sent with the ID of this one 
+   inner->DriverID = dev->DriverID;
+
+   recorder_log( priv->bIndex, REC_DEVICE, 
+                 (DWORD)inner->GetMTU( inner ), inner->GetSupportedEvents( inner ),
+                 (BYTE*)inner->cName, strlen(inner->cName), NULL );
+
+   YASDI_DEBUG((VERBOSE_HWL, "Recorder: Recording bus driver '%s'.\n", dev->cName ));
+   return PHY_OK;
+}
+
+//! Events of the wrapped driver modules: send them for the wrapping driver
+static void recorder_on_event(TDevice * inner, TGenDriverEvent * event)
+{
+   TDevice * dev = NULL;
+   int i;
+
+   //(driver events without an bus driver are not recorded)
+   for(i = 0; inner && i < iDeviceCount; i++)
+   {
+      if (((struct TRecorderPriv *)Devices[i]->priv)->inner == inner)
+      {
+         dev = Devices[i];
+         event->DriverID = dev->DriverID;
+         if (event->eventType != DRE_NEW_INPUT)
+         {
+            recorder_log( (BYTE)i, REC_EVENT, event->eventType,
+                          event->EventData.DriverDeviceHandle, NULL, 0, NULL );
+         }
+         break;
+      }
+   }
+
+   if (SendEventCallback) SendEventCallback( dev, event );
+}
+
+
+/**************************************************************************
+   Description   : Record mode: Opens the log file and loads all driver 
+                   modules to record ("Recorder.DriverX")
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+static void recorder_start_record(void)
+{
+   char ConfigPath[50];
+   char DriverPath[100];
+   DLLHANDLE handle;
+   int i;
+
+   os_thread_MutexInit( &LogMutex );
+   LogFile = fopen( cLogFile, "wb" );
+   if (LogFile)
+   {
+      fwrite( RECORDER_MAGIC, 1, 4, LogFile );
+      fputc( RECORDER_VERSION, LogFile );
+      dLastRecordTime = os_GetMonotonicTime();
+   }
+   else
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "Recorder: Can't create log file '%s'. "
+                   "Nothing is recorded.\n", cLogFile ));
+   }
+
+   for(i = 0; i < RECORDER_MAX_MODULES; i++)
+   {
+      sprintf(ConfigPath, "Recorder.Driver%d", i );
+      TRepository_GetElementStr(ConfigPath, "?", DriverPath, sizeof(DriverPath) );
+      if (strcmp(DriverPath,"?")==0) break;
+
+      //wrapped module is linked into YASDI?
+      StaticModules[ iModuleCount ] = TDriverLayer_FindStaticModule( DriverPath );
+      if (StaticModules[ iModuleCount ])
+      {
+         (*StaticModules[ iModuleCount ]->InitModule)( recorder_register_device,
+                                                       recorder_on_event );
+         Modules[ iModuleCount++ ] = (DLLHANDLE)NULL;
+         continue;
+      }
+
+      handle = os_LoadLibrary( DriverPath );
+      if (handle == (DLLHANDLE)NULL)
+      {
+         YASDI_DEBUG((VERBOSE_WARNING, "Recorder: Can't load yasdi module '%s'!\n",
+                      DriverPath ));
+         continue;
+      }
+      FktInitModule = os_GetSymbolRef( handle, InitYasdiModule );
+      if (!FktInitModule)
+      {
+         YASDI_DEBUG((VERBOSE_WARNING, "Recorder: Module '%s' seems not to be a "
+                      "Yasdi Driver!\n", DriverPath ));
+         os_UnloadLibrary( handle );
+         continue;
+      }
+      
+      //the module registers its drivers with us...
+      (*FktInitModule)( recorder_register_device, recorder_on_event );
+      Modules[ iModuleCount++ ] = handle;
+   }
+}
+
+
+
+/**************************************************************************
+***** Replay mode *********************************************************
+**************************************************************************/
+
+//! Replay time of an recorded time (relative to the last transmission)
+static DWORD recorder_replay_time(struct TRecorderPriv * this, DWORD dRecTime)
+{
+   DWORD dDelay = 0;
+   if (dSpeed) dDelay = (dRecTime - this->dAnchorRec) / dSpeed;
+   return this->dAnchorNow + dDelay;
+}
+
+static BOOL replay_open(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   DWORD i;
+
+   //continue after the next recorded "open"
+   if (this->dCursor < this->dEntryCount)
+      this->dAnchorRec = this->entries[ this->dCursor ].dTime;
+   for(i = this->dCursor; i < this->dEntryCount; i++)
+   {
+      if (this->entries[i].type == REC_OPEN)
+      {
+         this->dCursor    = i + 1;
+         this->dAnchorRec = this->entries[i].dTime;
+         break;
+      }
+   }
+   this->dAnchorNow = os_GetMonotonicTime();
+   this->dReadPos = 0;
+
+   dev->DeviceState = DS_ONLINE;
+   return TRUE;
+}
+
+static void replay_close(TDevice * dev)
+{
+   dev->DeviceState = DS_OFFLINE;
+}
+
+
+/**************************************************************************
+   Description   : Replay: Returns the recorded bytes which were received
+                   after the last transmission as soon as their (scaled) 
+                   receive time is reached. Recorded events are sent at 
+                   their time, too.
+   Parameter     : see "Read" of TDevice
+   Return-Value  : count of bytes read
+**************************************************************************/
+static DWORD replay_read(TDevice * dev, BYTE * DestBuffer, DWORD dBufferSize,
+                         DWORD * DriverDevHandle)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   DWORD now = os_GetMonotonicTime();
+   DWORD dDue, dRead;
+   TRecEntry * entry;
+
+   if (dev->DeviceState != DS_ONLINE) return 0;
+
+   while(this->dCursor < this->dEntryCount)
+   {
+      entry = &this->entries[ this->dCursor ];
+      
+      //the next transmission (or session) must be done by YASDI first
+      if (entry->type == REC_TX || entry->type == REC_OPEN) break;
+      if (entry->type == REC_CLOSE)
+      {
+         this->dCursor++;
+         continue;
+      }
+
+      dDue = recorder_replay_time( this, entry->dTime );
+      if ((int)(now - dDue) < 0) break;
+
+      if (entry->type == REC_EVENT)
+      {
+         TGenDriverEvent event;
+         memset( &event, 0, sizeof(event) );
+         event.eventType = (TDriverEvent)entry->dEventType;
+         event.DriverID  = dev->DriverID;
+         event.EventData.DriverDeviceHandle = entry->dHandle;
+         this->dCursor++;
+         if (SendEventCallback) SendEventCallback( dev, &event );
+         continue;
+      }
+
+      //REC_RX
+      dRead = min(entry->dLen - this->dReadPos, dBufferSize);
+      os_memcpy( DestBuffer, entry->data + this->dReadPos, dRead );
+      this->dReadPos += dRead;
+      if (this->dReadPos >= entry->dLen)
+      {
+         this->dReadPos = 0;
+         this->dCursor++;
+      }
+      this->dRxTimestamp = dDue;
+      if (DriverDevHandle) *DriverDevHandle = entry->dHandle;
+      return dRead;
+   }
+
+   return 0;
+}
+
+
+/**************************************************************************
+   Description   : Replay: Searches the recorded transmission of the 
+                   packet. The bytes received after it are replayed from
+                   now on. Not yet replayed bytes before are dropped.
+   Parameter     : see "Write" of TDevice
+   Return-Value  : ---
+**************************************************************************/
+static void replay_write(TDevice * dev, struct TNetPacket * frame,
+                         DWORD DriverDeviceHandle, TDriverSendFlags flags)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   DWORD dLen = TNetPacket_GetFrameLength( frame );
+   DWORD i, dFirst = this->dEntryCount;
+   int iTxCount = 0;
+   BOOL bFound = FALSE;
+   BYTE * buffer;
+
+   UNUSED_VAR( DriverDeviceHandle );
+   UNUSED_VAR( flags );
+
+   if (dev->DeviceState != DS_ONLINE) return;
+
+   buffer = os_malloc( dLen );
+   if (!buffer) return;
+   TNetPacket_CopyFromBuffer( frame, buffer );
+
+   //search the same bytes in the next recorded transmissions. If not 
+   //found use the next one...
+   for(i = this->dCursor; i < this->dEntryCount && iTxCount < RECORDER_TX_LOOKAHEAD; i++)
+   {
+      TRecEntry * entry = &this->entries[i];
+      if (entry->type != REC_TX) continue;
+      if (iTxCount++ == 0) dFirst = i;
+      if (entry->dLen == dLen && memcmp(entry->data, buffer, dLen) == 0)
+      {
+         bFound = TRUE;
+         break;
+      }
+   }
+   if (!bFound) i = dFirst;
+   os_free( buffer );
+
+   if (i >= this->dEntryCount)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "Replay: '%s': End of log reached. Nothing to answer.\n",
+                   dev->cName ));
+      this->dCursor = this->dEntryCount;
+      return;
+   }
+   if (!bFound)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "Replay: '%s': Transmission not recorded. "
+                   "Using the next one.\n", dev->cName ));
+   }
+   else if (i != dFirst)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "Replay: '%s': %d recorded transmissions skipped.\n",
+                   dev->cName, iTxCount - 1 ));
+   }
+
+   this->dCursor    = i + 1;
+   this->dReadPos   = 0;
+   this->dAnchorRec = this->entries[i].dTime;
+   this->dAnchorNow = os_GetMonotonicTime();
+}
+
+static int replay_GetMTU(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   return this->mtu;
+}
+
+static TDriverEvent replay_GetSupportedEvents(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+   //new input is only found when polled
+   return (TDriverEvent)(this->events & ~DRE_NEW_INPUT);
+}
+
+static int replay_IoCtrl(TDevice * dev, int cmd, BYTE * params)
+{
+   CREATE_VAR_THIS(dev,struct TRecorderPriv *);
+
+   switch(cmd)
+   {
+      case IOCTRL_GET_RX_TIMESTAMP:
+         *((DWORD*)params) = this->dRxTimestamp;
+         return 0;
+
+      default:
+         return IOCTRL_UNKNOWN_CMD;
+   }
+}
+
+
+/**************************************************************************
+   Description   : Parses the loaded log file. The first pass creates the
+                   bus drivers and counts the records of each, the second
+                   one stores them. An incomplete last record (YASDI was 
+                   killed while recording) is ignored.
+   Parameter     : dSize = size of the loaded log
+                   bFill = FALSE => first pass, TRUE => second pass
+   Return-Value  : ---
+**************************************************************************/
+static void recorder_parse_log(DWORD dSize, BOOL bFill)
+{
+   BYTE * pos = LogBuffer + 5;
+   BYTE * end = LogBuffer + dSize;
+   DWORD dTime = 0;
+   DWORD dDelta, dMTU, dEvents;
+   TRecEntry entry;
+   BYTE bHead, bIndex;
+   struct TRecorderPriv * priv;
+
+   while(pos < end)
+   {
+      bHead  = *pos++;
+      bIndex = (BYTE)(bHead & 0x1f);
+      memset( &entry, 0, sizeof(entry) );
+      entry.type = (TRecordType)(bHead >> 5);
+      if (!recorder_get_varint(&pos, end, &dDelta)) break;
+      dTime += dDelta;
+      entry.dTime = dTime;
+
+      switch(entry.type)
+      {
+         case REC_DEVICE:
+            if (!recorder_get_varint(&pos, end, &entry.dLen) ||
+                (DWORD)(end - pos) < entry.dLen) goto truncated;
+            entry.data = pos;
+            pos += entry.dLen;
+            if (!recorder_get_varint(&pos, end, &dMTU) ||
+                !recorder_get_varint(&pos, end, &dEvents)) goto truncated;
+            if (!bFill && bIndex == iDeviceCount)
+            {
+               TDevice * dev = recorder_create( (char*)entry.data, entry.dLen );
+               if (dev)
+               {
+                  priv = dev->priv;
+                  priv->mtu    = (int)dMTU;
+                  priv->events = (TDriverEvent)dEvents;
+               }
+            }
+            continue;
+
+         case REC_OPEN:
+         case REC_CLOSE:
+            break;
+
+         case REC_TX:
+         case REC_RX:
+            if (!recorder_get_varint(&pos, end, &entry.dHandle) ||
+                !recorder_get_varint(&pos, end, &entry.dLen) ||
+                (DWORD)(end - pos) < entry.dLen) goto truncated;
+            entry.data = pos;
+            pos += entry.dLen;
+            break;
+
+         case REC_EVENT:
+            if (!recorder_get_varint(&pos, end, &entry.dEventType) ||
+                !recorder_get_varint(&pos, end, &entry.dHandle)) goto truncated;
+            break;
+
+         default:
+            YASDI_DEBUG((VERBOSE_WARNING, "Replay: Log file '%s' is corrupt.\n",
+                         cLogFile ));
+            return;
+      }
+
+      if (bIndex >= iDeviceCount || !Devices[bIndex]) continue;
+      priv = Devices[bIndex]->priv;
+      if (bFill) priv->entries[ priv->dEntryCount ] = entry;
+      priv->dEntryCount++;
+   }
+   return;
+
+   truncated:
+   YASDI_DEBUG((VERBOSE_HWL, "Replay: Last record of log file '%s' is incomplete.\n",
+                cLogFile ));
+}
+
+
+/**************************************************************************
+   Description   : Replay mode: Loads the log file and creates all bus 
+                   drivers which were recorded.
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+static void recorder_start_replay(void)
+{
+   FILE * fd;
+   long lSize;
+   int i;
+
+   fd = fopen( cLogFile, "rb" );
+   if (!fd)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "Replay: Can't open log file '%s'.\n", cLogFile ));
+      return;
+   }
+   fseek( fd, 0, SEEK_END );
+   lSize = ftell( fd );
+   fseek( fd, 0, SEEK_SET );
+   if (lSize >= 5) LogBuffer = os_malloc( lSize );
+   if (!LogBuffer || fread( LogBuffer, 1, lSize, fd ) != (size_t)lSize ||
+       memcmp( LogBuffer, RECORDER_MAGIC, 4 ) != 0 || 
+       LogBuffer[4] != RECORDER_VERSION)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "Replay: '%s' is no valid log file.\n", cLogFile ));
+      fclose( fd );
+      if (LogBuffer) os_free( LogBuffer );
+      LogBuffer = NULL;
+      return;
+   }
+   fclose( fd );
+
+   //count the records of all drivers, than store them
+   recorder_parse_log( (DWORD)lSize, FALSE );
+   for(i = 0; i < iDeviceCount; i++)
+   {
+      struct TRecorderPriv * priv = Devices[i]->priv;
+      priv->entries = os_malloc( max(priv->dEntryCount, 1) * sizeof(TRecEntry) );
+      priv->dEntryCount = 0;
+   }
+   recorder_parse_log( (DWORD)lSize, TRUE );
+
+   for(i = 0; i < iDeviceCount; i++)
+   {
+      TDevice * dev = Devices[i];
+      dev->Open      = replay_open;
+      dev->Close     = replay_close;
+      dev->Read      = replay_read;
+      dev->Write     = replay_write;
+      dev->GetMTU    = replay_GetMTU;
+      dev->GetSupportedEvents = replay_GetSupportedEvents;
+      dev->IoCtrl    = replay_IoCtrl;
+      
+      YASDI_DEBUG((VERBOSE_HWL, "Replay: Bus driver '%s' with %lu records.\n",
+                   dev->cName, (unsigned long)((struct TRecorderPriv *)dev->priv)->dEntryCount ));
+      (*RegisterDevice)( dev );
+   }
+}
+
+
+/**************************************************************************
+   Description   : Init driver module
+   Parameter     : ---
+   Return-Value  : == 0 => ok
+                   != 0 => Fehler
+**************************************************************************/
+int SHARED_FUNCTION InitYasdiModule( void * RegFuncPtr, TOnDriverEvent eventCallback )
+{
+   char cMode[20];
+
+   YASDI_DEBUG((VERBOSE_MESSAGE,"YASDI Recorder Driver for %s V" LIB_YASDI_VERSION "\n"
+                SMA_COPYRIGHT "\n"
+                "Compile time: " __TIME__  " " __DATE__ "\n\n", 
+                os_GetOSIdentifier()));
+
+   /* store functions for registration and events... */
+   RegisterDevice    = RegFuncPtr;
+   SendEventCallback = eventCallback;
+
+   TRepository_GetElementStr("Recorder.Mode", "Record", cMode, sizeof(cMode) );
+   Mode = (strcasecmp(cMode, "Replay") == 0) ? RECMODE_REPLAY : RECMODE_RECORD;
+   TRepository_GetElementStr("Recorder.File", "yasdi-bus.rec", cLogFile, sizeof(cLogFile) );
+   dSpeed = TRepository_GetElementInt("Recorder.Speed", 1 );
+   YASDI_DEBUG((VERBOSE_HWL, "Recorder: Mode = '%s', File = '%s'\n", cMode, cLogFile ));
+
+   if (Mode == RECMODE_RECORD)
+      recorder_start_record();
+   else
+      recorder_start_replay();
+
+   return 0; /* 0 => ok */
+}
+
+
+/**************************************************************************
+   Description   : Deinitialisieren des Moduls
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+void SHARED_FUNCTION CleanupYasdiModule(void)
+{
+   int i;
+
+   //cleanup the wrapped modules
+   for(i = 0; i < iModuleCount; i++)
+   {
+      if (StaticModules[i])
+      {
+         (*StaticModules[i]->CleanupModule)( );
+         continue;
+      }
+      FktCleanupModule = os_GetSymbolRef( Modules[i], CleanupYasdiModule );
+      if (FktCleanupModule) (*FktCleanupModule)( );
+      os_UnloadLibrary( Modules[i] );
+   }
+   iModuleCount = 0;
+
+   if (LogFile)
+   {
+      fclose( LogFile );
+      LogFile = NULL;
+      os_thread_MutexDestroy( &LogMutex );
+   }
+   if (LogBuffer)
+   {
+      os_free( LogBuffer );
+      LogBuffer = NULL;
+   }
+   
+   YASDI_DEBUG((VERBOSE_HWL, "Recorder Driver: bye bye...\n"));
+}
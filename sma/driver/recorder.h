@@ -0,0 +1,101 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ * 
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ * 
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+
+/*
+** The bus log file:
+**
+**   Header : "YREC" <version>
+**   Record : <type:3 bits | device:5 bits> <delta time> <type specific>
+**
+** All numbers are stored as "varint" (7 bits per byte, LSB first, bit 7
+** set => more bytes follow). The delta time is the time in ms since the
+** previous record (of any device).
+**
+**   REC_DEVICE : <name length> <name> <mtu> <supported events>
+**   REC_OPEN   : -
+**   REC_CLOSE  : -
+**   REC_TX     : <driver device handle> <length> <bytes>
+**   REC_RX     : <driver device handle> <length> <bytes>
+**   REC_EVENT  : <event type> <driver device handle>
+*/
+#define RECORDER_MAGIC   "YREC"
+#define RECORDER_VERSION 1
+
+typedef enum
+{
+   REC_DEVICE = 0, //a new device (the device number is the index)
+   REC_OPEN   = 1, //device was opened
+   REC_CLOSE  = 2, //device was closed
+   REC_TX     = 3, //bytes sent
+   REC_RX     = 4, //bytes received
+   REC_EVENT  = 5  //driver event (but not "DRE_NEW_INPUT")
+} TRecordType;
+
+//max. count of devices in one log file (5 bits device number)
+#define RECORDER_MAX_DEVICES 32
+
+//count of sent frames which are compared with an transmission during 
+//replay to find the matching one (when the master sends other frames 
+//as recorded, e.g. because of an time stamp)
+#define RECORDER_TX_LOOKAHEAD 16
+
+//mode of the module
+typedef enum { RECMODE_RECORD, RECMODE_REPLAY } TRecorderMode;
+
+
+//One record of an loaded log file (replay)
+typedef struct
+{
+   TRecordType type;
+   DWORD dTime;         //time since start of the log (ms)
+   DWORD dHandle;       //driver device handle (REC_TX, REC_RX, REC_EVENT)
+   DWORD dEventType;    //REC_EVENT only
+   DWORD dLen;          //length of data
+   BYTE * data;         //the bytes (points into the loaded file)
+} TRecEntry;
+
+
+/* private area of one device */
+struct TRecorderPriv
+{
+   BYTE bIndex;            //device number in the log
+   
+   //record mode:
+   TDevice * inner;        //the wrapped device of the real bus driver
+
+   //replay mode:
+   TRecEntry * entries;    //all records of this device 
+   DWORD dEntryCount;      
+   DWORD dCursor;          //next record to replay
+   DWORD dReadPos;         //read position in the current REC_RX record
+   DWORD dAnchorRec;       //log time of the last matched transmission...
+   DWORD dAnchorNow;       //...and the time when it was replayed
+   DWORD dRxTimestamp;     //replay time of the bytes of the last read
+   int   mtu;              //recorded values of the device
+   TDriverEvent events;
+};
+
+
+#endif
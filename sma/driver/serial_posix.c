@@ -65,11 +65,29 @@
 #include "repository.h"
 #include "device.h"
 #include "driver_layer.h"
+#include "smadata_layer.h"
+#include "smadata_cmd.h"
+#include "byteorder.h"
+#include "tools.h"
 #include <aio.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/file.h>
+#include <signal.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
 #include "serial_posix.h"
 #include "copyright.h"
 #include "version.h"
 
+//linked into YASDI itself ("YASDI_STATIC_DRIVERS")? Then the module entries
+//need unique names...
+#ifdef YASDI_STATIC_DRIVERS
+#define InitYasdiModule    serial_InitYasdiModule
+#define CleanupYasdiModule serial_CleanupYasdiModule
+#endif
+
 
 
 
@@ -89,14 +107,35 @@ void serial_writeAsync(TDevice * dev,
                        DWORD DriverDeviceHandle, 
                        TDriverSendFlags flags);
 
-int (*RegisterDevice)(TDevice * newdev);
+void serial_prepare_send(TDevice * dev);
+SHARED_FUNCTION void serial_prepare_recv(TDevice * dev);
+BOOL serial_set_kernel_rs485(TDevice * dev);
+BOOL serial_echo_detect(TDevice * dev);
+static void serial_echo_expect(TDevice * dev, struct iovec * iov, int iovcnt);
+static int serial_echo_cancel(TDevice * dev, BYTE * data, int len, DWORD dTime);
+void serial_rx_start(TDevice * dev);
+void serial_rx_stop(TDevice * dev);
+static void * serial_rx_thread(void * param);
+BOOL serial_open_port(TDevice * dev);
+static BOOL serial_port_is_locked(char * cPort);
+static void serial_autodetect(TDevice * dev, char * cBaudrate, char * cProtocol);
+
+static int (*RegisterDevice)(TDevice * newdev);
+static TOnDriverEvent SendEventCallback;
 
 
 /**************************************************************************
 ***** Global Variables  ***************************************************
 ***************************************************************************/
 
-int dBytesReadTotal = 0;
+static int dBytesReadTotal = 0;
+
+//all created drivers (their ports are not probed by the autodetection 
+//of the next ones)
+#define SERIAL_MAX_DRIVERS 32
+static struct TSerialPosixPriv * SerialDrivers[SERIAL_MAX_DRIVERS];
+static int iSerialDriverCount = 0;
+
 
 /**************************************************************************
 ***** Global Constants ****************************************************
@@ -105,6 +144,10 @@ int dBytesReadTotal = 0;
 static BYTE bPowerlineSyncPre []={0xaa,0xaa};
 static BYTE bPowerlineSyncPost[]={0x55,0x55};
 
+//max. count of frame fragments written with one "writev()". Frames with
+//more fragments are copied into one buffer first
+#define SERIAL_MAX_IOV 16
+
 
 /**************************************************************************
 ***** MACROS  *************************************************************
@@ -141,9 +184,6 @@ void aio_completion_handler( sigval_t sigval );
 **************************************************************************/
 SHARED_FUNCTION BOOL serial_open(TDevice * dev)
 {
-   int iBytesInBuffer;
-   struct termios options;
-   int rate;
    CREATE_VAR_THIS(dev, struct TSerialPosixPriv *);
 
    YASDI_DEBUG((VERBOSE_HWL,"Serial::open('%s')\n",dev->cName));
@@ -155,10 +195,65 @@ SHARED_FUNCTION BOOL serial_open(TDevice * dev)
       return TRUE;
    }
 
+   if (serial_open_port(dev))
+   {
+      // does the adapter echo all sent bytes? Detected only on the first
+      // open, not again on an reopen (in the middle of an transaction)...
+      if (SERECHO_AUTO != this->echomode)
+      {
+         this->bEchoSuppress = (SERECHO_ON == this->echomode);
+      }
+      else if (!this->bEchoDetected)
+      {
+         this->bEchoSuppress = serial_echo_detect(dev);
+         this->bEchoDetected = TRUE;
+         YASDI_DEBUG((VERBOSE_HWL, "Serial: Port '%s' echoes sent bytes: %s\n", 
+                      this->cPort, this->bEchoSuppress ? "yes" : "no"));
+      }
+      this->dEchoCount = this->dEchoPos = 0;
+
+      // device is now online
+      dev->DeviceState = DS_ONLINE;
+
+      //start waiting for incoming bytes...
+      serial_rx_start(dev);
+      return TRUE;
+   }
+
+   return FALSE;
+}
+
+
+/**************************************************************************
+   Description   : Opens the serial port of the device in raw mode with 
+                   the baud rate and the direction control of the device
+   Parameter     : dev = driver instance
+   Return-Value  : TRUE if the port is usable
+**************************************************************************/
+BOOL serial_open_port(TDevice * dev)
+{
+   int iBytesInBuffer;
+   struct termios options;
+   int rate;
+   CREATE_VAR_THIS(dev, struct TSerialPosixPriv *);
+
    //open serial port in non blocking mode
    this->fd = open( this->cPort, O_RDWR | O_NOCTTY | O_NDELAY );
    if (this->fd >= 0)
    {
+      //Never touch the settings of a port which is used by an other 
+      //process (UUCP lock file or "flock()"). Lock it and prevent any 
+      //further open (TIOCEXCL) while we are using it...
+      if (serial_port_is_locked(this->cPort) ||
+          flock(this->fd, LOCK_EX | LOCK_NB) < 0 ||
+          ioctl(this->fd, TIOCEXCL) < 0)
+      {
+         YASDI_DEBUG((VERBOSE_WARNING, "Serial: Port '%s' is used by an other process\n", this->cPort));
+         close(this->fd);
+         this->fd = -1;
+         return FALSE;
+      }
+
       // don't block 
       fcntl(this->fd, F_SETFL, FNDELAY);
 
@@ -204,6 +299,17 @@ SHARED_FUNCTION BOOL serial_open(TDevice * dev)
       // set new parameter
       tcsetattr(this->fd, TCSANOW, &options);
 
+      // RS485 direction switching by the UART driver? 
+      if (SERMT_RS485 == this->media && SERDIR_KERNEL == this->dirctrl)
+      {
+         if (!serial_set_kernel_rs485(dev))
+         {
+            YASDI_DEBUG((VERBOSE_WARNING, "Serial: Port '%s' does not support kernel RS485 "
+                         "direction control. Using RTS/DTR.\n", this->cPort));
+            this->dirctrl = SERDIR_MODEM;
+         }
+      }
+
       //some serial ports seams to be mirical because 
       //you can open it but you cant use it (e.g. when an port is not available)
       //So after open it try to check for incomming data. If this fails the port is not ready
@@ -211,11 +317,11 @@ SHARED_FUNCTION BOOL serial_open(TDevice * dev)
       if (ioctl(this->fd, FIONREAD, &iBytesInBuffer) < 0)
       {
          YASDI_DEBUG((VERBOSE_WARNING, "Serial: Unable to open serial port '%s' (ioctrl/FIOREAD had failed)\n", this->cPort));
+         close(this->fd);
+         this->fd = -1;
          return FALSE;
       }
 
-      // device is now online
-      dev->DeviceState = DS_ONLINE;
       return TRUE;
    }
    else
@@ -227,6 +333,202 @@ SHARED_FUNCTION BOOL serial_open(TDevice * dev)
 
 
 
+/**************************************************************************
+   Description   : Checks the UUCP lock file of the port ("LCK..ttyS0")
+   Parameter     : cPort = the port ("/dev/ttyS0")
+   Return-Value  : TRUE if an other (running) process has locked the port
+**************************************************************************/
+static BOOL serial_port_is_locked(char * cPort)
+{
+   static const char * LockDirs[] = { SERIAL_LOCK_DIRS };
+   char cPath[64];
+   char * name;
+   long pid;
+   FILE * fd;
+   int i;
+
+   name = strrchr(cPort, '/');
+   name = name ? name + 1 : cPort;
+
+   for(i = 0; i < (int)(sizeof(LockDirs) / sizeof(LockDirs[0])); i++)
+   {
+      if (strlen(LockDirs[i]) + strlen(name) + 6 >= sizeof(cPath)) continue;
+      sprintf(cPath, "%s/LCK..%s", LockDirs[i], name);
+      fd = fopen(cPath, "r");
+      if (!fd) continue;
+
+      //the pid of the owner (ASCII). Stale lock files are ignored
+      if (fscanf(fd, "%ld", &pid) != 1) pid = 0;
+      fclose(fd);
+      if (pid > 0 && pid != (long)getpid() && 
+          (kill((pid_t)pid, 0) == 0 || errno == EPERM))
+         return TRUE;
+   }
+
+   return FALSE;
+}
+
+
+/**************************************************************************
+   Description   : Let the UART driver switch the RS485 direction 
+                   ("TIOCSRS485"): RTS is set while sending, with the 
+                   configured delays before and after sending.
+   Parameter     : dev = driver instance
+   Return-Value  : TRUE if the port supports it
+**************************************************************************/
+BOOL serial_set_kernel_rs485(TDevice * dev)
+{
+#ifdef TIOCSRS485
+   struct serial_rs485 rs485conf;
+   CREATE_VAR_THIS(dev, struct TSerialPosixPriv *);
+
+   memset(&rs485conf, 0, sizeof(rs485conf));
+   if (ioctl(this->fd, TIOCGRS485, &rs485conf) < 0)
+      return FALSE;
+
+   rs485conf.flags |= SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;
+   rs485conf.flags &= ~(SER_RS485_RTS_AFTER_SEND | SER_RS485_RX_DURING_TX);
+   rs485conf.delay_rts_before_send = this->dRtsDelayBeforeSend;
+   rs485conf.delay_rts_after_send  = this->dRtsDelayAfterSend;
+
+   return ioctl(this->fd, TIOCSRS485, &rs485conf) >= 0;
+#else
+   UNUSED_VAR( dev );
+   return FALSE;
+#endif
+}
+
+
+/**************************************************************************
+   Description   : Checks if the adapter echoes the sent bytes: Sends 
+                   some bytes which are not the start of an SMANet or
+                   SunnyNet frame and waits for them. Must be called 
+                   before the receive thread is started.
+   Parameter     : dev = driver instance
+   Return-Value  : TRUE if the bytes were received again
+**************************************************************************/
+BOOL serial_echo_detect(TDevice * dev)
+{
+   static const BYTE probe[] = {0x00, 0xff, 0x00, 0xff};
+   BYTE Buffer[sizeof(probe)];
+   DWORD dRead = 0;
+   int ires;
+   struct pollfd pfd;
+   CREATE_VAR_THIS(dev, struct TSerialPosixPriv *);
+
+   //only on an RS485 bus, RS232 and Powerline do not echo
+   if (this->media != SERMT_RS485) return FALSE;
+
+   tcflush(this->fd, TCIOFLUSH);
+   serial_prepare_send(dev);
+   ires = write(this->fd, probe, sizeof(probe));
+   serial_prepare_recv(dev);
+   if (ires != sizeof(probe)) return FALSE;
+
+   //wait for the echo: sending time plus 50 ms
+   pfd.fd     = this->fd;
+   pfd.events = POLLIN;
+   while(dRead < sizeof(probe) &&
+         poll(&pfd, 1, 50 + (sizeof(probe) * 10000) / max(this->dBaudrate,1)) > 0)
+   {
+      ires = read(this->fd, Buffer + dRead, sizeof(probe) - dRead);
+      if (ires <= 0) break;
+      dRead += ires;
+   }
+   tcflush(this->fd, TCIFLUSH);
+
+   return dRead == sizeof(probe) && memcmp(Buffer, probe, sizeof(probe)) == 0;
+}
+
+/**************************************************************************
+   Description   : Remember the bytes which are sent now. Their echo is
+                   removed from the received bytes.
+   Parameter     : dev = driver instance
+                   iov, iovcnt = the bytes to send
+   Return-Value  : ---
+**************************************************************************/
+static void serial_echo_expect(TDevice * dev, struct iovec * iov, int iovcnt)
+{
+   CREATE_VAR_THIS(dev, struct TSerialPosixPriv *);
+   DWORD dLen = 0;
+   int i;
+
+   if (!this->bEchoSuppress) return;
+
+   pthread_mutex_lock( &this->RxMutex );
+   for(i = 0; i < iovcnt; i++)
+   {
+      if (this->dEchoCount + iov[i].iov_len > sizeof(this->EchoBuffer))
+      {
+         //too much. The echo of this frame can't be removed completly
+         YASDI_DEBUG((VERBOSE_HWL, "Serial: Echo buffer of '%s' is full!\n", dev->cName));
+         break;
+      }
+      os_memcpy(this->EchoBuffer + this->dEchoCount, iov[i].iov_base, iov[i].iov_len);
+      this->dEchoCount += iov[i].iov_len;
+      dLen             += iov[i].iov_len;
+   }
+
+   //echo must be received in sending time plus 100 ms
+   this->dEchoDeadline = os_GetMonotonicTime() + 100 +
+                         (this->dEchoCount - this->dEchoPos) * 10000 / max(this->dBaudrate,1);
+   pthread_mutex_unlock( &this->RxMutex );
+}
+
+/**************************************************************************
+   Description   : Removes the echo of sent bytes from the received bytes.
+                   Bytes received before the echo are not changed. If an 
+                   received byte differs from the expected echo (collision
+                   on the bus) all remaining echo bytes are discarded.
+   Parameter     : dev = driver instance
+                   data, len = received bytes (changed!)
+                   dTime = receive time
+   Return-Value  : count of remaining bytes in "data"
+**************************************************************************/
+static int serial_echo_cancel(TDevice * dev, BYTE * data, int len, DWORD dTime)
+{
+   CREATE_VAR_THIS(dev, struct TSerialPosixPriv *);
+   int i, iOut = 0;
+
+   pthread_mutex_lock( &this->RxMutex );
+
+   //echo not received in time? Forget it...
+   if (this->dEchoPos < this->dEchoCount &&
+       (int)(dTime - this->dEchoDeadline) > 0)
+   {
+      this->dEchoPos = this->dEchoCount = 0;
+   }
+
+   for(i = 0; i < len; i++)
+   {
+      if (this->dEchoPos < this->dEchoCount)
+      {
+         if (data[i] == this->EchoBuffer[ this->dEchoPos ])
+         {
+            //own echo: remove it
+            this->dEchoPos++;
+            this->dEchoBytesTotal++;
+            continue;
+         }
+
+         //not the echo: when the echo has already started it's an collision
+         if (this->dEchoPos > 0)
+         {
+            this->dEchoPos = this->dEchoCount = 0;
+         }
+      }
+      data[iOut++] = data[i];
+   }
+
+   //all echo bytes received?
+   if (this->dEchoPos == this->dEchoCount)
+      this->dEchoPos = this->dEchoCount = 0;
+
+   pthread_mutex_unlock( &this->RxMutex );
+   return iOut;
+}
+
+
 /**************************************************************************
    Description   : Close Bus Driver
    Parameter     :
@@ -239,6 +541,9 @@ SHARED_FUNCTION void serial_release(TDevice * dev)
 {
    CREATE_VAR_THIS(dev,struct TSerialPosixPriv *);
 
+   //stop the receive thread before the port is closed
+   serial_rx_stop(dev);
+
    if (this->fd >=0)
    {
       close(this->fd);
@@ -312,6 +617,10 @@ SHARED_FUNCTION void serial_prepare_recv(TDevice * dev)
    switch(this->media)
    {
       case SERMT_RS485:
+         //direction is switched by the UART driver or the adapter itself?
+         if (this->dirctrl != SERDIR_MODEM) break;
+         //...no break: switch with RTS/DTR
+
       case SERMT_POWERLINE:
 
          //HP: 26.10.07: FEP-Problem: RS485-Umschaltung fehlerhaft            
@@ -342,8 +651,12 @@ void serial_prepare_send(TDevice * dev)
 
    switch( this->media )
    {
-      case SERMT_POWERLINE:
       case SERMT_RS485:           
+         //direction is switched by the UART driver or the adapter itself?
+         if (this->dirctrl != SERDIR_MODEM) break;
+         //...no break: switch with RTS/DTR
+
+      case SERMT_POWERLINE:
          SET_RTS(dev);  
          CLR_DTR(dev);  
          os_thread_sleep(5);
@@ -357,6 +670,55 @@ void serial_prepare_send(TDevice * dev)
 
 
 
+/**************************************************************************
+   Description   : Write all fragments with "writev()". The port is 
+                   non blocking: Continue with the rest after an 
+                   partial write and wait when the output buffer is full.
+   Parameter     : fd = port, iov/iovcnt = the fragments (will be changed!)
+   Return-Value  : bytes written or -1 on error
+**************************************************************************/
+static int serial_writev_all(int fd, struct iovec * iov, int iovcnt)
+{
+   int total = 0;
+   ssize_t ires;
+   struct pollfd pfd;
+
+   while(iovcnt > 0)
+   {
+      ires = writev(fd, iov, iovcnt);
+      if (ires < 0)
+      {
+         if (errno == EINTR) continue;
+         if (errno == EAGAIN)
+         {
+            //output buffer full: wait until there is space again
+            pfd.fd     = fd;
+            pfd.events = POLLOUT;
+            if (poll(&pfd, 1, 1000) > 0) continue;
+         }
+         return -1;
+      }
+      total += ires;
+
+      //skip the written fragments...
+      while(iovcnt > 0 && (size_t)ires >= iov->iov_len)
+      {
+         ires -= iov->iov_len;
+         iov++;
+         iovcnt--;
+      }
+      //...and the written part of the next one
+      if (iovcnt > 0)
+      {
+         iov->iov_base = (BYTE*)iov->iov_base + ires;
+         iov->iov_len -= ires;
+      }
+   }
+
+   return total;
+}
+
+
 /**************************************************************************
    Description   : Write data to bus
    Parameter     :
@@ -396,20 +758,44 @@ SHARED_FUNCTION void serial_write(TDevice * dev,
       TNetPacket_AddTail(frame, bPowerlineSyncPost,sizeof(bPowerlineSyncPost));
    }
 
-   // transmit all buffer fragments 
+   // transmit all buffer fragments at once (no gaps between the fragments)
    startagain: 
    {
+      struct iovec iov[SERIAL_MAX_IOV];
+      int iovcnt = 0;
       BYTE * framedata=NULL;
+      BYTE * linearframe=NULL;
       WORD framedatasize=0;
       FOREACH_IN_BUFFER(frame, framedata, &framedatasize)
       {
-         ires = write(this->fd, framedata, framedatasize);
-         if (ires < 0)
-         {
-            YASDI_DEBUG((VERBOSE_HWL, "serial_write: Write error: %d code = %s\n", 
-                         ires, serial_decode_posix_error(errno) ));
-            if (serial_reopen(dev)) goto startagain;
-         }
+         if (iovcnt == SERIAL_MAX_IOV) break;
+         iov[iovcnt].iov_base = framedata;
+         iov[iovcnt].iov_len  = framedatasize;
+         iovcnt++;
+      }
+
+      //too many fragments: copy the whole frame in one buffer
+      if (framedata)
+      {
+         linearframe = os_malloc( TNetPacket_GetFrameLength(frame) );
+         TNetPacket_CopyFromBuffer( frame, linearframe );
+         iov[0].iov_base = linearframe;
+         iov[0].iov_len  = TNetPacket_GetFrameLength(frame);
+         iovcnt = 1;
+      }
+
+      //the echo may be received before "writev()" returns...
+      serial_echo_expect(dev, iov, iovcnt);
+      ires = serial_writev_all(this->fd, iov, iovcnt);
+      if (linearframe) os_free( linearframe );
+      if (ires < 0)
+      {
+         YASDI_DEBUG((VERBOSE_HWL, "serial_write: Write error: %d code = %s\n", 
+                      ires, serial_decode_posix_error(errno) ));
+         if (serial_reopen(dev)) goto startagain;
+      }
+      else
+      {
          dBytesSend += ires; 
       }
    }
@@ -458,7 +844,10 @@ BOOL serial_reopen(TDevice * dev)
 
 
 /**************************************************************************
-   Description   : Read bytes form serial port as much as possible
+   Description   : Read received bytes. The bytes are received by the 
+                   receive thread of the port. Only bytes of one 
+                   received chunk are returned, so that the receive time
+                   of them is known (see "IOCTRL_GET_RX_TIMESTAMP")
    Parameter     : dev = Drivce Instance
                    DestBuffer = pointer to buffer to store bytes in
                    dBufferSize = max size of buffer
@@ -473,64 +862,229 @@ SHARED_FUNCTION DWORD serial_read(TDevice * dev,
                                   DWORD * DriverDevHandle)
 {
    CREATE_VAR_THIS(dev,struct TSerialPosixPriv *);
-   int BytesRead;
+   DWORD BytesRead = 0;
+   DWORD dAvail;
+   TSerialRxChunk * chunk;
 
-   if ( dev->DeviceState == DS_ONLINE )
+   if ( dev->DeviceState != DS_ONLINE )
+   {
+      YASDI_DEBUG((VERBOSE_HWL,"serial_read: Can't read because driver '%s' is not online.\n", dev->cName));
+      return 0;
+   }
+
+   //receive thread had stopped because of an port error? 
+   if (this->bRxError)
    {
-      int iBytesInBuffer;
-      int ires;
+      YASDI_DEBUG((VERBOSE_HWL, 
+                  "serial_read: Error reading from serial port '%s'. Reopen it...\n",
+                  this->cPort ));
+      if (!serial_reopen(dev)) return 0;
+   }
+
+   pthread_mutex_lock( &this->RxMutex );
+   if (this->dRxChunkCount > 0)
+   {
+      //read only from the oldest chunk
+      chunk  = &this->RxChunks[ this->dRxChunkFirst ];
+      dAvail = (chunk->dEnd + SERIAL_RX_BUFFER_SIZE - this->dRxReadPos) % SERIAL_RX_BUFFER_SIZE;
+      BytesRead = min(dAvail, dBufferSize);
       
-      // is there something to read?
-      ires = ioctl(this->fd, FIONREAD, &iBytesInBuffer);
-      if (ires < 0)
+      //copy (maybe in two parts, when the ring buffer wraps around)
+      dAvail = min(BytesRead, SERIAL_RX_BUFFER_SIZE - this->dRxReadPos);
+      os_memcpy( DestBuffer, &this->RxBuffer[ this->dRxReadPos ], dAvail );
+      os_memcpy( DestBuffer + dAvail, this->RxBuffer, BytesRead - dAvail );
+      this->dRxReadPos = (this->dRxReadPos + BytesRead) % SERIAL_RX_BUFFER_SIZE;
+
+      this->dRxTimestamp = chunk->dTime;
+      
+      //chunk completly read?
+      if (this->dRxReadPos == chunk->dEnd)
       {
-         YASDI_DEBUG((VERBOSE_HWL, 
-                   "serial_read: Error checking for incoming data '%s'. errno=%s\n",
-                   this->cPort, serial_decode_posix_error(errno) )); 
-         if (!serial_reopen(dev)) return 0;  
+         this->dRxChunkFirst = (this->dRxChunkFirst + 1) % SERIAL_RX_CHUNKS;
+         this->dRxChunkCount--;
       }
-      if (iBytesInBuffer == 0) return 0;
-	
-      //limit the read for the maximum destination buffer size
-      dBufferSize = min( (int)dBufferSize, iBytesInBuffer);
+   }
+   pthread_mutex_unlock( &this->RxMutex );
+
+   dBytesReadTotal += BytesRead;   
+   UNUSED_VAR( DriverDevHandle );
+	return BytesRead;
+}
+
+
+/**************************************************************************
+   Description   : Stores received bytes from the receive thread in the 
+                   receive buffer as new chunk. If the buffer is full 
+                   the bytes are lost.
+   Parameter     : dev = Driver instance
+                   data, len = the received bytes
+                   dTime = monotonic receive time (ms)
+   Return-Value  : count of bytes stored
+**************************************************************************/
+static DWORD serial_rx_store(TDevice * dev, BYTE * data, DWORD len, DWORD dTime)
+{
+   CREATE_VAR_THIS(dev,struct TSerialPosixPriv *);
+   DWORD dUsed, i;
+   TSerialRxChunk * chunk;
 
-      //Read now 
-      BytesRead = read(this->fd, DestBuffer, dBufferSize );
-      if (BytesRead < 0)
+   pthread_mutex_lock( &this->RxMutex );
+
+   dUsed = (this->dRxWritePos + SERIAL_RX_BUFFER_SIZE - this->dRxReadPos) % SERIAL_RX_BUFFER_SIZE;
+   if (len > SERIAL_RX_BUFFER_SIZE - 1 - dUsed)
+   {
+      YASDI_DEBUG((VERBOSE_HWL,"serial: Receive buffer of '%s' is full. Bytes are lost!\n", dev->cName));
+      len = SERIAL_RX_BUFFER_SIZE - 1 - dUsed;
+   }
+
+   for(i = 0; i < len; i++)
+   {
+      this->RxBuffer[ this->dRxWritePos ] = data[i];
+      this->dRxWritePos = (this->dRxWritePos + 1) % SERIAL_RX_BUFFER_SIZE;
+   }
+
+   if (len)
+   {
+      if (this->dRxChunkCount < SERIAL_RX_CHUNKS)
       {
-         YASDI_DEBUG((VERBOSE_HWL, 
-			          "serial_read: Error reading from serial port '%s'. errno=%s\n",
-                   this->cPort, serial_decode_posix_error(errno) ));
-         BytesRead = 0;
-         serial_reopen(dev);
+         //new chunk...
+         chunk = &this->RxChunks[ (this->dRxChunkFirst + this->dRxChunkCount) % SERIAL_RX_CHUNKS ];
+         chunk->dTime = dTime;
+         this->dRxChunkCount++;
       }
       else
-	   {
-         dBytesReadTotal += BytesRead;   
-         //YASDI_DEBUG((VERBOSE_HWL, "serial_read: Read %d bytes from serial port %s\n", BytesRead, this->cPort ));
-      }
-	  
-	  //print received bytes for debug...
-#if 0
-		{
-			int i;
-			if (BytesRead) YASDI_DEBUG((VERBOSE_HWL, "Received Data:\n"));
-			for(i = 0 ; i < BytesRead; i++)
-			{
-				YASDI_DEBUG((VERBOSE_HWL, "[%2x]", DestBuffer[i]));
-			}
-			if (BytesRead) YASDI_DEBUG((VERBOSE_HWL, "\n"));
-		}
-#endif
-		
-	}
-	else
-	{
-		YASDI_DEBUG((VERBOSE_HWL,"serial_read: Can't read because driver '%s' is not online.\n", dev->cName));
-		BytesRead = 0;
-	}
+      {
+         //all chunks used: append to the newest one
+         chunk = &this->RxChunks[ (this->dRxChunkFirst + this->dRxChunkCount - 1) % SERIAL_RX_CHUNKS ];
+      }
+      chunk->dEnd = this->dRxWritePos;
+   }
 
-	return BytesRead;
+   pthread_mutex_unlock( &this->RxMutex );
+   return len;
+}
+
+
+//! Inform the YASDI core, that new input is available now
+static void serial_signal_input(TDevice * dev)
+{
+   TGenDriverEvent event;
+   if (!SendEventCallback) return;
+
+   memset(&event, 0, sizeof(event));
+   event.eventType = DRE_NEW_INPUT;
+   event.DriverID  = dev->DriverID;
+   SendEventCallback( dev, &event );
+}
+
+
+/**************************************************************************
+   Description   : The receive thread of one port. Blocks in "poll()" 
+                   until bytes are received and stores them with the 
+                   receive time. When no more bytes are received for the 
+                   inter character gap time the frame is complete and 
+                   the YASDI core is informed to read it at once.
+   Parameter     : param = the driver instance
+   Return-Value  : ---
+**************************************************************************/
+static void * serial_rx_thread(void * param)
+{
+   TDevice * dev = (TDevice*)param;
+   CREATE_VAR_THIS(dev,struct TSerialPosixPriv *);
+   struct pollfd pfd;
+   BYTE Buffer[256];
+   BOOL bFramePending = FALSE;
+   DWORD dTime;
+   int ires;
+
+   pfd.fd     = this->fd;
+   pfd.events = POLLIN;
+
+   while( this->bRxThreadRun )
+   {
+      //wait for bytes. While an frame is pending wait only for the gap time
+      ires = poll( &pfd, 1, bFramePending ? (int)this->dFrameGap : SERIAL_RX_POLL_TIMEOUT );
+      if (ires < 0)
+      {
+         if (errno == EINTR) continue;
+         break;
+      }
+
+      if (ires == 0)
+      {
+         //no more bytes: frame is complete now
+         if (bFramePending)
+         {
+            bFramePending = FALSE;
+            serial_signal_input( dev );
+         }
+         continue;
+      }
+
+      if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+         break;
+
+      dTime = os_GetMonotonicTime();
+      ires = read( this->fd, Buffer, sizeof(Buffer) );
+      if (ires < 0)
+      {
+         if (errno == EINTR || errno == EAGAIN) continue;
+         break;
+      }
+      //remove the echo of our own sent bytes
+      if (ires > 0 && this->bEchoSuppress)
+      {
+         ires = serial_echo_cancel( dev, Buffer, ires, dTime );
+      }
+      if (ires > 0)
+      {
+         serial_rx_store( dev, Buffer, ires, dTime );
+         bFramePending = TRUE;
+      }
+   }
+
+   //thread ended because of an error? Reopen is done in "serial_read"...
+   if (this->bRxThreadRun)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "serial: Error receiving from '%s' errno=%s\n",
+                   this->cPort, serial_decode_posix_error(errno) ));
+      this->bRxError = TRUE;
+      serial_signal_input( dev );
+   }
+
+   return NULL;
+}
+
+//! Start the receive thread of the port
+void serial_rx_start(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TSerialPosixPriv *);
+
+   //forget all old bytes...
+   pthread_mutex_lock( &this->RxMutex );
+   this->dRxReadPos = this->dRxWritePos = 0;
+   this->dRxChunkFirst = this->dRxChunkCount = 0;
+   pthread_mutex_unlock( &this->RxMutex );
+
+   this->bRxError     = FALSE;
+   this->bRxThreadRun = TRUE;
+   if (pthread_create( &this->RxThread, NULL, serial_rx_thread, dev ) != 0)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "serial: Can't create receive thread for '%s'!\n", dev->cName));
+      this->bRxThreadRun = FALSE;
+      this->bRxError     = TRUE;
+   }
+}
+
+//! Stop the receive thread of the port (and wait until it has ended)
+void serial_rx_stop(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TSerialPosixPriv *);
+
+   if (this->bRxThreadRun)
+   {
+      this->bRxThreadRun = FALSE;
+      pthread_join( this->RxThread, NULL );
+   }
 }
 
 
@@ -609,6 +1163,39 @@ int serial_GetMTU(TDevice * dev)
 }
 
 
+//! The events supported by this driver
+TDriverEvent serial_GetSupportedEvents(TDevice * dev)
+{
+   UNUSED_VAR( dev );
+   return DRE_NEW_INPUT;
+}
+
+//! Driver specific io control
+int serial_IoCtrl(TDevice * dev, int cmd, BYTE * params)
+{
+   CREATE_VAR_THIS(dev,struct TSerialPosixPriv *);
+
+   switch(cmd)
+   {
+      case IOCTRL_GET_RX_TIMESTAMP:
+         *((DWORD*)params) = this->dRxTimestamp;
+         return 0;
+
+      case IOCTRL_GET_PROTOCOL:
+         if (!this->cProtocol[0]) return IOCTRL_UNKNOWN_CMD; 
+         strcpy((char*)params, this->cProtocol);
+         return 0;
+
+      case IOCTRL_GET_BAUDRATE:
+         *((DWORD*)params) = this->dBaudrate;
+         return 0;
+
+      default:
+         return IOCTRL_UNKNOWN_CMD;
+   }
+}
+
+
 /**************************************************************************
    Description   : Destructor of the bus driver
    Parameter     : dev = Zeiger auf Treiber-Instanz
@@ -627,6 +1214,7 @@ void serial_destroy(TDevice * dev)
    #endif
 
    assert( this );
+   pthread_mutex_destroy( &this->RxMutex );
    free( this );
 }
 
@@ -668,6 +1256,451 @@ char * serial_decode_posix_error(int errcode)
    return code;
 }
 
+/**************************************************************************
+   Description   : Autodetection: Builds the GET_NET request (broadcast) 
+                   in the framing of all protocols to probe. They are 
+                   sent together, a device ignores the frames of the 
+                   other protocol.
+   Parameter     : iProtocols = protocols to probe (SERPROBE_xxx)
+                   dst = buffer for the requests (64 bytes)
+   Return-Value  : size of all requests
+**************************************************************************/
+static DWORD serial_probe_request(int iProtocols, BYTE * dst)
+{
+   BYTE pkt[7];
+   BYTE raw[4 + sizeof(pkt) + 2];
+   DWORD dSize = 0;
+   WORD wCheck;
+   DWORD i;
+
+   //SMAData packet head: Src=0, Dst=0, Ctrl=Group, PktCnt=0, Cmd
+   memset(pkt, 0, sizeof(pkt));
+   pkt[4] = ctrlGroup;
+   pkt[6] = CMD_GET_NET;
+
+   if (iProtocols & SERPROBE_SMANET)
+   {
+      raw[0] = HDLC_ADR_BROADCAST;
+      raw[1] = 0x03;
+      hostToBe16( PROT_PPP_SMADATA1, &raw[2] );
+      memcpy( &raw[4], pkt, sizeof(pkt) );
+      wCheck = (WORD)(TSMANet_CalcFCSRaw( 0xffff, raw, 4 + sizeof(pkt) ) ^ 0xffff);
+      hostToLe16( wCheck, &raw[4 + sizeof(pkt)] );
+
+      dst[dSize++] = HDLC_SYNC;
+      dSize += TSMANet_CharMapper( &dst[dSize], raw, sizeof(raw) );
+      dst[dSize++] = HDLC_SYNC;
+   }
+
+   if (iProtocols & SERPROBE_SUNNYNET)
+   {
+      dst[dSize++] = SERPROBE_SUNNYNET_START;
+      dst[dSize++] = 0; //no data
+      dst[dSize++] = 0;
+      dst[dSize++] = SERPROBE_SUNNYNET_START;
+      for(wCheck = 0, i = 0; i < sizeof(pkt); i++)
+      {
+         dst[dSize++] = pkt[i];
+         wCheck = (WORD)(wCheck + pkt[i]);
+      }
+      hostToLe16( wCheck, &dst[dSize] );
+      dSize += 2;
+      dst[dSize++] = SERPROBE_SUNNYNET_STOP;
+   }
+
+   return dSize;
+}
+
+//! Autodetection: Is the SMAData packet an answer of the GET_NET request?
+static BOOL serial_probe_is_answer(BYTE * pkt, DWORD dSize)
+{
+   //packet head and the serial number at least
+   return dSize >= 7 + 4 && (pkt[4] & ctrlAck) && pkt[6] == CMD_GET_NET;
+}
+
+/**************************************************************************
+   Description   : Autodetection: Searches an valid answer of the GET_NET
+                   request in the received bytes (SMANet and SunnyNet 
+                   framing)
+   Parameter     : buf, dSize = the received bytes
+   Return-Value  : the protocol of the answer (SERPROBE_xxx) or 0
+**************************************************************************/
+static int serial_probe_check_answer(BYTE * buf, DWORD dSize)
+{
+   BYTE frame[SERIAL_PROBE_BUFFER_SIZE];
+   DWORD i, k, dLen, dFrame;
+   WORD wCheck;
+
+   //SMANet: every complete HDLC frame with an valid FCS
+   for(i = 0; i < dSize; i++)
+   {
+      if (buf[i] != HDLC_SYNC) continue;
+      for(dFrame = 0, k = i + 1; k < dSize && buf[k] != HDLC_SYNC; k++)
+      {
+         if (buf[k] == HDLC_ESC && k + 1 < dSize && buf[k + 1] != HDLC_SYNC)
+            frame[dFrame++] = (BYTE)(buf[++k] ^ 0x20);
+         else
+            frame[dFrame++] = buf[k];
+      }
+      if (k >= dSize) break; //frame not complete
+      
+      if (dFrame > 6 && 
+          TSMANet_CalcFCSRaw( 0xffff, frame, (WORD)dFrame ) == 0xf0b8 &&
+          frame[0] == HDLC_ADR_BROADCAST && frame[1] == 0x03 &&
+          be16ToHost( &frame[2] ) == PROT_PPP_SMADATA1 &&
+          serial_probe_is_answer( &frame[4], dFrame - 6 ))
+         return SERPROBE_SMANET;
+
+      //the end flag may be the start flag of the next frame
+      i = k - 1;
+   }
+
+   //SunnyNet: 0x68 <len> <len> 0x68 <packet> <checksum> 0x16
+   for(i = 0; i + 4 + 7 + 3 <= dSize; i++)
+   {
+      if (buf[i]   != SERPROBE_SUNNYNET_START || buf[i+3] != SERPROBE_SUNNYNET_START ||
+          buf[i+1] != buf[i+2]) continue;
+      dLen = 4 + 7 + buf[i+1] + 3;
+      if (i + dLen > dSize || buf[i + dLen - 1] != SERPROBE_SUNNYNET_STOP) continue;
+
+      for(wCheck = 0, k = i + 4; k < i + dLen - 3; k++)
+         wCheck = (WORD)(wCheck + buf[k]);
+      if (wCheck == le16ToHost( &buf[i + dLen - 3] ) &&
+          serial_probe_is_answer( &buf[i + 4], dLen - 7 ))
+         return SERPROBE_SUNNYNET;
+   }
+
+   return 0;
+}
+
+
+/**************************************************************************
+   Description   : Autodetection: The thread of one port. Tries all baud
+                   rates until the first answer (of any port) is received.
+   Parameter     : param = the port (TSerialProbePort)
+   Return-Value  : ---
+**************************************************************************/
+static void * serial_probe_thread(void * param)
+{
+   TSerialProbePort * port = param;
+   struct TSerialProbe * probe = port->probe;
+   TDevice * dev = &port->dev;
+   BYTE Request[64];
+   BYTE Buffer[SERIAL_PROBE_BUFFER_SIZE];
+   DWORD dReqSize, dRead, dDeadline;
+   struct pollfd pfd;
+   int iBaud, iRepeat, iProt, ires;
+   CREATE_VAR_THIS(dev, struct TSerialPosixPriv *);
+
+   dReqSize = serial_probe_request( probe->iProtocols, Request );
+
+   for(iBaud = 0; iBaud < probe->iBaudrateCount && !probe->bFound; iBaud++)
+   {
+      this->dBaudrate = probe->Baudrates[iBaud];
+      if (!serial_open_port(dev)) break; //port not available
+
+      for(iRepeat = 0; iRepeat < probe->iRepeats && !probe->bFound; iRepeat++)
+      {
+         tcflush(this->fd, TCIOFLUSH);
+         serial_prepare_send(dev);
+         ires = write(this->fd, Request, dReqSize);
+         serial_prepare_recv(dev);
+         if (ires != (int)dReqSize) break;
+
+         //wait for the answer: sending time of the request + answer time
+         dRead = 0;
+         dDeadline = os_GetMonotonicTime() + probe->dTimeout +
+                     (dReqSize * 10000) / max(this->dBaudrate,1);
+         pfd.fd     = this->fd;
+         pfd.events = POLLIN;
+         while(!probe->bFound && (int)(dDeadline - os_GetMonotonicTime()) > 0)
+         {
+            if (poll(&pfd, 1, 50) <= 0) continue;
+            ires = read(this->fd, Buffer + dRead, sizeof(Buffer) - dRead);
+            if (ires <= 0) break;
+            dRead += ires;
+
+            iProt = serial_probe_check_answer(Buffer, dRead);
+            if (iProt)
+            {
+               pthread_mutex_lock( &probe->Mutex );
+               if (!probe->bFound)
+               {
+                  probe->bFound         = TRUE;
+                  probe->pFoundPort     = port;
+                  probe->dFoundBaudrate = this->dBaudrate;
+                  probe->iFoundProtocol = iProt;
+               }
+               pthread_mutex_unlock( &probe->Mutex );
+               break;
+            }
+            if (dRead == sizeof(Buffer)) dRead = 0; //only garbage...
+         }
+      }
+
+      close(this->fd);
+      this->fd = -1;
+   }
+
+   return NULL;
+}
+
+//! Autodetection: Probes all ports at once. Returns TRUE if found
+static BOOL serial_probe_run(struct TSerialProbe * probe)
+{
+   BOOL bStarted[SERIAL_PROBE_MAX_PORTS];
+   int i;
+
+   probe->bFound = FALSE;
+   for(i = 0; i < probe->iPortCount; i++)
+   {
+      bStarted[i] = pthread_create( &probe->Ports[i]->thread, NULL, 
+                                    serial_probe_thread, probe->Ports[i] ) == 0;
+   }
+   for(i = 0; i < probe->iPortCount; i++)
+   {
+      if (bStarted[i]) pthread_join( probe->Ports[i]->thread, NULL );
+   }
+   return probe->bFound;
+}
+
+
+/**************************************************************************
+   Description   : Autodetection: Reads the last found settings of the 
+                   driver from the cache file
+   Parameter     : cName = driver name
+                   cPort, dBaudrate, cProtocol = the settings
+   Return-Value  : TRUE if found
+**************************************************************************/
+static BOOL serial_probe_cache_read(char * cName, char * cPort, 
+                                    DWORD * dBaudrate, char * cProtocol)
+{
+   char cPath[YASDI_PROGRAM_PATH + 32];
+   char line[200];
+   char name[50];
+   char port[30];
+   char prot[IOCTRL_PROTNAME_SIZE];
+   unsigned long baud;
+   BOOL bFound = FALSE;
+   FILE * fd;
+
+   strcpy(cPath, ProgPath);
+   Tools_PathAdd(cPath, SERIAL_PROBE_CACHE_FILE);
+   fd = fopen(cPath, "r");
+   if (!fd) return FALSE;
+
+   while(!bFound && fgets(line, sizeof(line), fd))
+   {
+      if (sscanf(line, "%49s %29s %lu %19s", name, port, &baud, prot) == 4 &&
+          strcmp(name, cName) == 0)
+      {
+         strcpy(cPort, port);
+         *dBaudrate = baud;
+         strcpy(cProtocol, prot);
+         bFound = TRUE;
+      }
+   }
+   fclose(fd);
+   return bFound;
+}
+
+//! Autodetection: Stores the found settings of the driver in the cache 
+//! file (the settings of the other drivers are kept)
+static void serial_probe_cache_write(char * cName, char * cPort, 
+                                     DWORD dBaudrate, char * cProtocol)
+{
+   char cPath[YASDI_PROGRAM_PATH + 32];
+   char name[50];
+   char * old = NULL;
+   char * line;
+   size_t size = 0;
+   FILE * fd;
+
+   strcpy(cPath, ProgPath);
+   Tools_PathAdd(cPath, SERIAL_PROBE_CACHE_FILE);
+
+   fd = fopen(cPath, "r");
+   if (fd)
+   {
+      old = malloc( 4096 );
+      if (old) 
+      {
+         size = fread(old, 1, 4095, fd);
+         old[size] = 0;
+      }
+      fclose(fd);
+   }
+
+   fd = fopen(cPath, "w");
+   if (fd)
+   {
+      fprintf(fd, "%s %s %lu %s\n", cName, cPort, (unsigned long)dBaudrate, cProtocol);
+      for(line = old ? strtok(old, "\n") : NULL; line; line = strtok(NULL, "\n"))
+      {
+         if (sscanf(line, "%49s", name) == 1 && strcmp(name, cName) != 0)
+            fprintf(fd, "%s\n", line);
+      }
+      fclose(fd);
+   }
+   else
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "Serial: Can't write '%s'.\n", cPath));
+   }
+
+   if (old) free(old);
+}
+
+
+/**************************************************************************
+   Description   : Autodetection of the port ("Device=auto"), the baud rate
+                   ("Baudrate=auto") and the transport protocol 
+                   ("Protocol=auto"): All candidate ports are probed at 
+                   once with GET_NET requests. The first valid answer wins.
+                   The last found settings are probed first (cache file).
+                   Not found: the first candidates are used.
+   Parameter     : dev = driver instance (with the configuration)
+                   cBaudrate, cProtocol = configured baud rate and protocol
+   Return-Value  : ---
+**************************************************************************/
+static void serial_autodetect(TDevice * dev, char * cBaudrate, char * cProtocol)
+{
+   struct TSerialProbe * probe;
+   TSerialProbePort * port;
+   char cConfigPath[100];
+   char cList[256];
+   char cCachePort[30];
+   char cCacheProt[IOCTRL_PROTNAME_SIZE];
+   DWORD dCacheBaud, dTmp;
+   char * token;
+   int i, k, iProtocols;
+   BOOL bFound;
+   CREATE_VAR_THIS(dev, struct TSerialPosixPriv *);
+
+   probe = malloc( sizeof(struct TSerialProbe) );
+   if (!probe) return;
+   memset(probe, 0, sizeof(struct TSerialProbe));
+   pthread_mutex_init( &probe->Mutex, NULL );
+
+   //the candidate ports (without the ports of the other drivers)
+   strcpy(cList, this->cPort);
+   if (strcasecmp(this->cPort, "auto") == 0)
+   {
+      sprintf(cConfigPath,"%s.ProbePorts", dev->cName);
+      TRepository_GetElementStr(cConfigPath, SERIAL_PROBE_PORTS, cList, sizeof(cList) );
+   }
+   for(token = strtok(cList, " ,;"); token && probe->iPortCount < SERIAL_PROBE_MAX_PORTS;
+       token = strtok(NULL, " ,;"))
+   {
+      for(k = 0; k < iSerialDriverCount; k++)
+         if (strcmp(SerialDrivers[k]->cPort, token) == 0) break;
+      if (k < iSerialDriverCount) continue;
+
+      port = malloc( sizeof(TSerialProbePort) );
+      if (!port) break;
+      memset(port, 0, sizeof(TSerialProbePort));
+      strcpy(port->dev.cName, dev->cName);
+      port->dev.priv = &port->priv;
+      port->probe    = probe;
+      port->priv.fd  = -1;
+      strncpy(port->priv.cPort, token, sizeof(port->priv.cPort) - 1);
+      port->priv.media               = this->media;
+      port->priv.dirctrl             = this->dirctrl;
+      port->priv.dRtsDelayBeforeSend = this->dRtsDelayBeforeSend;
+      port->priv.dRtsDelayAfterSend  = this->dRtsDelayAfterSend;
+      probe->Ports[ probe->iPortCount++ ] = port;
+   }
+
+   //the candidate baud rates
+   sprintf(cList, "%lu", (unsigned long)this->dBaudrate);
+   if (strcasecmp(cBaudrate, "auto") == 0)
+   {
+      sprintf(cConfigPath,"%s.ProbeBaudrates", dev->cName);
+      TRepository_GetElementStr(cConfigPath, SERIAL_PROBE_BAUDRATES, cList, sizeof(cList) );
+   }
+   for(token = strtok(cList, " ,;"); token && probe->iBaudrateCount < SERIAL_PROBE_MAX_BAUDRATES;
+       token = strtok(NULL, " ,;"))
+   {
+      dTmp = strtoul(token, NULL, 10);
+      if (dTmp) probe->Baudrates[ probe->iBaudrateCount++ ] = dTmp;
+   }
+
+   //the candidate protocols
+   if (strcasecmp(cProtocol, "auto") == 0)
+      probe->iProtocols = SERPROBE_SMANET | SERPROBE_SUNNYNET;
+   else
+      probe->iProtocols = strstr(cProtocol, "SunnyNet") ? SERPROBE_SUNNYNET : SERPROBE_SMANET;
+
+   sprintf(cConfigPath,"%s.ProbeTimeout", dev->cName);
+   probe->dTimeout = TRepository_GetElementInt( cConfigPath, 1000 );
+   sprintf(cConfigPath,"%s.ProbeRepeats", dev->cName);
+   probe->iRepeats = TRepository_GetElementInt( cConfigPath, 2 );
+
+   YASDI_DEBUG((VERBOSE_MESSAGE, "Serial: Autodetection for '%s' (%d ports, %d baud rates)...\n",
+                dev->cName, probe->iPortCount, probe->iBaudrateCount ));
+
+   bFound = FALSE;
+   if (probe->iPortCount > 0 && probe->iBaudrateCount > 0)
+   {
+      //try the last found settings first (if they are candidates)
+      if (serial_probe_cache_read(dev->cName, cCachePort, &dCacheBaud, cCacheProt))
+      {
+         for(i = 0; i < probe->iPortCount; i++)
+            if (strcmp(probe->Ports[i]->priv.cPort, cCachePort) == 0) break;
+         for(k = 0; k < probe->iBaudrateCount; k++)
+            if (probe->Baudrates[k] == dCacheBaud) break;
+         iProtocols = probe->iProtocols;
+         probe->iProtocols &= strstr(cCacheProt, "SunnyNet") ? SERPROBE_SUNNYNET : SERPROBE_SMANET;
+
+         if (i < probe->iPortCount && k < probe->iBaudrateCount && probe->iProtocols)
+         {
+            //move them to the front and probe them alone...
+            port = probe->Ports[i];
+            probe->Ports[i] = probe->Ports[0];
+            probe->Ports[0] = port;
+            dTmp = probe->Baudrates[k];
+            probe->Baudrates[k] = probe->Baudrates[0];
+            probe->Baudrates[0] = dTmp;
+
+            i = probe->iPortCount;
+            k = probe->iBaudrateCount;
+            probe->iPortCount = probe->iBaudrateCount = 1;
+            bFound = serial_probe_run( probe );
+            probe->iPortCount     = i;
+            probe->iBaudrateCount = k;
+         }
+         probe->iProtocols = iProtocols;
+      }
+
+      //...and than all
+      if (!bFound) bFound = serial_probe_run( probe );
+   }
+
+   if (bFound)
+   {
+      strcpy(this->cPort, probe->pFoundPort->priv.cPort);
+      this->dBaudrate = probe->dFoundBaudrate;
+      strcpy(this->cProtocol, 
+             (probe->iFoundProtocol == SERPROBE_SUNNYNET) ? "SunnyNet" : "SMANet");
+      YASDI_DEBUG((VERBOSE_MESSAGE, "Serial: Found devices on '%s' with %lu baud (%s).\n",
+                   this->cPort, (unsigned long)this->dBaudrate, this->cProtocol ));
+
+      serial_probe_cache_write(dev->cName, this->cPort, this->dBaudrate, this->cProtocol);
+   }
+   else
+   {
+      //use the first candidates 
+      if (probe->iPortCount > 0)     strcpy(this->cPort, probe->Ports[0]->priv.cPort);
+      if (probe->iBaudrateCount > 0) this->dBaudrate = probe->Baudrates[0];
+      YASDI_DEBUG((VERBOSE_WARNING, "Serial: Autodetection for '%s' has not found any "
+                   "device. Using '%s' with %lu baud.\n", dev->cName,
+                   this->cPort, (unsigned long)this->dBaudrate ));
+   }
+
+   for(i = 0; i < probe->iPortCount; i++) free( probe->Ports[i] );
+   pthread_mutex_destroy( &probe->Mutex );
+   free( probe );
+}
+
 /**************************************************************************
    Description   : Device constructor: Create ONE instance of device
    Parameter     : Unit (for identification in profile section)
@@ -683,6 +1716,8 @@ TDevice * serial_create(DWORD dUnit)
 
    char cDefaultDev[10];
    char cMedia[20];
+   char cBaudrate[20];
+   char cProtocol[IOCTRL_PROTNAME_SIZE];
    char cConfigPath[100];
 
 
@@ -703,6 +1738,7 @@ TDevice * serial_create(DWORD dUnit)
       interface->DeviceState = DS_OFFLINE;
       priv->fd = -1;
       priv->dBytesSendTotal = 0;
+      pthread_mutex_init( &priv->RxMutex, NULL );
 
       #if (1 == USING_POSIX_AIO)
       //Init the posix async IO request struct for sending...
@@ -724,6 +1760,8 @@ TDevice * serial_create(DWORD dUnit)
       interface->Write     = serial_write; 
       interface->Read      = serial_read;
       interface->GetMTU    = serial_GetMTU;
+      interface->GetSupportedEvents = serial_GetSupportedEvents;
+      interface->IoCtrl    = serial_IoCtrl;
 
       //Using Posix AIO for sending?
       #if (1 == USING_POSIX_AIO)
@@ -744,8 +1782,13 @@ TDevice * serial_create(DWORD dUnit)
       /* Baudrate */
       sprintf(cConfigPath,"%s.Baudrate", interface->cName);
       priv->dBaudrate = TRepository_GetElementInt( cConfigPath, 19200 );
+      TRepository_GetElementStr(cConfigPath, "", cBaudrate, sizeof(cBaudrate) );
       YASDI_DEBUG((VERBOSE_HWL, "Baudrate = %ld\n", priv->dBaudrate));
 
+      /* Transport protocol (used by the protocol layer) */
+      sprintf(cConfigPath,"%s.Protocol", interface->cName);
+      TRepository_GetElementStr(cConfigPath, "SMANet", cProtocol, sizeof(cProtocol) );
+
       /* Medium: RS232, RS485 or Powerline */
       cMedia[0]=0;
       sprintf(cConfigPath,"%s.Media", interface->cName);
@@ -758,6 +1801,49 @@ TDevice * serial_create(DWORD dUnit)
          priv->media = SERMT_POWERLINE;
       YASDI_DEBUG((VERBOSE_HWL, "Media = '%s'\n",cMedia));
 
+      /* RS485 direction control: "Modem" (RTS/DTR, default), 
+         "Kernel" (UART driver, "TIOCSRS485") or "Auto" (adapter) */
+      cMedia[0]=0;
+      sprintf(cConfigPath,"%s.RS485Direction", interface->cName);
+      TRepository_GetElementStr(cConfigPath, "Modem", cMedia, sizeof(cMedia) );
+      priv->dirctrl = SERDIR_MODEM;
+      if (strcasecmp(cMedia,"Kernel")==0)
+         priv->dirctrl = SERDIR_KERNEL;
+      if (strcasecmp(cMedia,"Auto")==0)
+         priv->dirctrl = SERDIR_AUTO;
+      sprintf(cConfigPath,"%s.RtsDelayBeforeSend", interface->cName);
+      priv->dRtsDelayBeforeSend = TRepository_GetElementInt( cConfigPath, 0 );
+      sprintf(cConfigPath,"%s.RtsDelayAfterSend", interface->cName);
+      priv->dRtsDelayAfterSend  = TRepository_GetElementInt( cConfigPath, 0 );
+      YASDI_DEBUG((VERBOSE_HWL, "RS485Direction = '%s'\n",cMedia));
+
+      /* Echo of sent bytes: "Off" (default), "On" or "Auto" (check on open) */
+      cMedia[0]=0;
+      sprintf(cConfigPath,"%s.EchoSuppression", interface->cName);
+      TRepository_GetElementStr(cConfigPath, "Off", cMedia, sizeof(cMedia) );
+      priv->echomode = SERECHO_OFF;
+      if (strcasecmp(cMedia,"On")==0)
+         priv->echomode = SERECHO_ON;
+      if (strcasecmp(cMedia,"Auto")==0)
+         priv->echomode = SERECHO_AUTO;
+      YASDI_DEBUG((VERBOSE_HWL, "EchoSuppression = '%s'\n",cMedia));
+
+      /* Port, baud rate or protocol are "auto": search the devices */
+      if (strcasecmp(priv->cPort, "auto") == 0 || strcasecmp(cBaudrate, "auto") == 0 ||
+          strcasecmp(cProtocol, "auto") == 0)
+      {
+         serial_autodetect(interface, cBaudrate, cProtocol);
+      }
+
+      /* Inter character gap which ends an frame (ms). Default: 3.5 characters */
+      sprintf(cConfigPath,"%s.FrameGap", interface->cName);
+      priv->dFrameGap = TRepository_GetElementInt( cConfigPath, 
+                              max(2, (35000 + priv->dBaudrate - 1) / max(priv->dBaudrate,1)) );
+      YASDI_DEBUG((VERBOSE_HWL, "FrameGap = %ld ms\n", priv->dFrameGap));
+
+      if (iSerialDriverCount < SERIAL_MAX_DRIVERS)
+         SerialDrivers[ iSerialDriverCount++ ] = priv;
+
       /*
       ** register this new bus device driver in the YASDI core
       */
@@ -819,8 +1905,9 @@ int InitYasdiModule( void * RegFuncPtr, TOnDriverEvent eventCallback )
                   os_GetOSIdentifier()));
 
 
-   /* store functions for registration... */
-   RegisterDevice = RegFuncPtr;
+   /* store functions for registration and events... */
+   RegisterDevice    = RegFuncPtr;
+   SendEventCallback = eventCallback;
 
    /*
    ** Create all drivers
@@ -839,7 +1926,7 @@ int InitYasdiModule( void * RegFuncPtr, TOnDriverEvent eventCallback )
                    ********************************************************
                    PRUESSING, 10.04.2001, 1.0, Created
 **************************************************************************/
-void CleanupYasdiModul(void)
+void CleanupYasdiModule(void)
 {
    YASDI_DEBUG((VERBOSE_HWL,"Serial POSIX Driver: bye bye...\n"));
 }
@@ -10,6 +10,70 @@
 //the serial bus driver media types
 typedef enum {SERMT_RS232, SERMT_RS485, SERMT_POWERLINE} TSerialMedia;
 
+//How the RS485 transceiver direction is switched
+typedef enum 
+{
+   SERDIR_MODEM,  //by YASDI with RTS/DTR (with delays, default)
+   SERDIR_KERNEL, //by the UART driver ("TIOCSRS485")
+   SERDIR_AUTO    //by the adapter itself (auto direction): nothing to do
+} TSerialDirCtrl;
+
+//Suppression of the local echo of RS485 adapters (own sent bytes are
+//received again)
+typedef enum 
+{
+   SERECHO_OFF,   //no echo (default)
+   SERECHO_ON,    //adapter echoes all bytes
+   SERECHO_AUTO   //check it on open
+} TSerialEchoMode;
+
+//max. count of sent bytes waiting for their echo
+#define SERIAL_ECHO_BUFFER_SIZE 1024
+
+//receive buffer of the receive thread (bytes) and max. count of 
+//timestamped byte chunks in it
+#define SERIAL_RX_BUFFER_SIZE 4096
+#define SERIAL_RX_CHUNKS      64
+
+//poll timeout of the receive thread when no frame is pending (ms)
+#define SERIAL_RX_POLL_TIMEOUT 100
+
+//An received byte chunk: end position in the receive buffer and
+//the monotonic receive time of the first byte
+typedef struct
+{
+   DWORD dEnd;
+   DWORD dTime;
+} TSerialRxChunk;
+
+//Autodetection ("Device", "Baudrate" or "Protocol" is "auto"): 
+//the ports and baud rates tried by default (in this order). Only USB RS485
+//adapters, onboard UARTs (ttyS, ttyACM) are often used by other programs
+//and must be listed in "ProbePorts"
+#define SERIAL_PROBE_PORTS     "/dev/ttyUSB0 /dev/ttyUSB1 /dev/ttyUSB2 /dev/ttyUSB3"
+#define SERIAL_PROBE_BAUDRATES "1200 19200 9600 4800 2400 38400"
+#define SERIAL_PROBE_MAX_PORTS     16
+#define SERIAL_PROBE_MAX_BAUDRATES 12
+
+//directories of the UUCP lock files ("LCK..ttyS0") of the ports
+#define SERIAL_LOCK_DIRS "/var/lock", "/run/lock"
+
+//file in the YASDI config directory with the last found settings 
+#define SERIAL_PROBE_CACHE_FILE "serialprobe.cache"
+
+//receive buffer for the answers of one port
+#define SERIAL_PROBE_BUFFER_SIZE 512
+
+//the transport protocols of the autodetection (bit mask)
+enum
+{
+   SERPROBE_SMANET   = 1,
+   SERPROBE_SUNNYNET = 2,
+
+   SERPROBE_SUNNYNET_START = 0x68, //SunnyNet framing
+   SERPROBE_SUNNYNET_STOP  = 0x16
+};
+
 /* unit structure (Instance of class) */
 struct TSerialPosixPriv
 {
@@ -18,6 +82,36 @@ struct TSerialPosixPriv
    TSerialMedia media;  	/* Media (RS232,RS485,Powerline) */
    DWORD dBaudrate;			/* Bit / sec. */
    DWORD dBytesSendTotal;	/* total bytes send */
+   TSerialDirCtrl dirctrl;  /* RS485 direction control */
+   DWORD dRtsDelayBeforeSend; /* kernel RS485: delay after RTS on before sending (ms) */
+   DWORD dRtsDelayAfterSend;  /* kernel RS485: delay after sending before RTS off (ms) */
+
+   //receive thread: waits with "poll()" on the port and stores all 
+   //received bytes. "serial_read" reads only from this buffer...
+   pthread_t RxThread;
+   BOOL bRxThreadRun;           /* thread should run */
+   BOOL bRxError;               /* thread ended because of an port error */
+   pthread_mutex_t RxMutex;     /* access to the receive buffer */
+   BYTE RxBuffer[SERIAL_RX_BUFFER_SIZE];
+   DWORD dRxWritePos;           /* write position in "RxBuffer" */
+   DWORD dRxReadPos;            /* read position in "RxBuffer" */
+   TSerialRxChunk RxChunks[SERIAL_RX_CHUNKS]; /* ring of received chunks */
+   DWORD dRxChunkFirst;         /* the oldest chunk */
+   DWORD dRxChunkCount;         /* chunks in ring */
+   DWORD dRxTimestamp;          /* receive time of the last read bytes */
+   DWORD dFrameGap;             /* inter character gap (ms) which ends an frame */
+
+   //echo suppression (protected by "RxMutex")
+   TSerialEchoMode echomode;    /* configured mode */
+   BOOL bEchoSuppress;          /* echo is removed from the received bytes */
+   BOOL bEchoDetected;          /* "Auto": "bEchoSuppress" is already detected */
+   BYTE EchoBuffer[SERIAL_ECHO_BUFFER_SIZE]; /* sent bytes, echo expected */
+   DWORD dEchoCount;            /* bytes in "EchoBuffer" */
+   DWORD dEchoPos;              /* next expected echo byte */
+   DWORD dEchoDeadline;         /* monotonic time (ms) the echo must be received */
+   DWORD dEchoBytesTotal;       /* count of suppressed echo bytes */
+
+   char cProtocol[IOCTRL_PROTNAME_SIZE]; /* protocol found by the autodetection */
 
    //for async IO
    #if 1 == USING_POSIX_AIO
@@ -26,4 +120,37 @@ struct TSerialPosixPriv
    #endif
 };
 
+
+struct TSerialProbe;
+
+//One port of the autodetection: An temporary driver instance which is 
+//probed by an own thread
+typedef struct
+{
+   TDevice dev;
+   struct TSerialPosixPriv priv;
+   pthread_t thread;
+   struct TSerialProbe * probe;
+} TSerialProbePort;
+
+//The autodetection of one driver: All ports are probed at once, each one
+//with all baud rates. The requests of all protocols are sent together. 
+//The first valid answer wins.
+struct TSerialProbe
+{
+   TSerialProbePort * Ports[SERIAL_PROBE_MAX_PORTS];
+   int iPortCount;
+   DWORD Baudrates[SERIAL_PROBE_MAX_BAUDRATES];
+   int iBaudrateCount;
+   int iProtocols;              /* SERPROBE_xxx */
+   DWORD dTimeout;              /* max. answer time of the devices (ms) */
+   int iRepeats;                /* requests per baud rate */
+   
+   pthread_mutex_t Mutex;       /* access to the result */
+   volatile BOOL bFound;        
+   TSerialProbePort * pFoundPort; /* the result */
+   DWORD dFoundBaudrate;
+   int iFoundProtocol;
+};
+
 #endif
@@ -57,13 +57,20 @@
 #include "version.h"
 #include "copyright.h"
 
+//linked into YASDI itself ("YASDI_STATIC_DRIVERS")? Then the module entries
+//need unique names...
+#ifdef YASDI_STATIC_DRIVERS
+#define InitYasdiModule    serial_InitYasdiModule
+#define CleanupYasdiModule serial_CleanupYasdiModule
+#endif
+
 #include <commctrl.h>
 
 
 
-int dBytesReadTotal = 0;
-int (*RegisterDevice)(TDevice * newdev);
-TOnDriverEvent SendEventCallback;
+static int dBytesReadTotal = 0;
+static int (*RegisterDevice)(TDevice * newdev);
+static TOnDriverEvent SendEventCallback;
 
 #ifdef DEBUG
 int lastCreatedDriverID = 0;
@@ -0,0 +1,814 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ * 
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ * 
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+/**************************************************************************
+*             SMA Technologie AG, 34266 Niestetal, Germany
+***************************************************************************
+* Project       : YASDI
+***************************************************************************
+* Project-no.   :
+***************************************************************************
+* Filename      : tcp_posix.c
+***************************************************************************
+* Description   : TCP Bus Driver for serial servers (RS485 to Ethernet)
+***************************************************************************
+* Preconditions : POSIX system
+***************************************************************************
+* Changes       : Author, Date, Version, Reason
+*                 *********************************************************
+***************************************************************************/
+
+/**
+  This YASDI Bus Driver talks to an serial server ("device server", e.g. 
+  an Moxa NPort in mode "TCP server") over one persistent TCP connection.
+  The RS485 bus behind the server is an own YASDI bus like an local 
+  serial port ("TCPx.Baudrate" and "TCPx.ReplyDelay" give his timing).
+
+  An connection thread connects the socket (non blocking, with timeout),
+  receives all bytes and reconnects at once when an working connection 
+  is lost. Failed connects are repeated with an growing delay 
+  ("TCPx.ReconnectMin" doubled up to "TCPx.ReconnectMax").
+ */
+
+
+/**************************************************************************
+***** INCLUDES ************************************************************
+***************************************************************************/
+
+#include "os.h"
+#include "debug.h"
+#include "smadef.h"
+#include "repository.h"
+#include "device.h"
+#include "driver_layer.h"
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/uio.h>
+#include "tcp_posix.h"
+#include "copyright.h"
+#include "version.h"
+
+//linked into YASDI itself ("YASDI_STATIC_DRIVERS")? Then the module entries
+//need unique names...
+#ifdef YASDI_STATIC_DRIVERS
+#define InitYasdiModule    tcp_InitYasdiModule
+#define CleanupYasdiModule tcp_CleanupYasdiModule
+#endif
+
+
+/*************************************************************************/
+
+#define CREATE_VAR_THIS(d,interface) interface this = (void*)((d)->priv)
+
+//max. count of driver instances ("TCP0" - "TCP31")
+#define TCP_MAX_DRIVERS 32
+
+static int (*RegisterDevice)(TDevice * newdev);
+static TOnDriverEvent SendEventCallback;
+
+
+/**************************************************************************
+***** LOCAL - Prototyps ***************************************************
+***************************************************************************/
+
+static void * tcp_thread(void * param);
+static void tcp_wakeup(TDevice * dev);
+static void tcp_disconnect(TDevice * dev, BOOL bFastReconnect);
+
+
+/**************************************************************************
+***** IMPLEMENTATION ******************************************************
+***************************************************************************/
+
+//! Inform the YASDI core, that new input is available now
+static void tcp_signal_input(TDevice * dev)
+{
+   TGenDriverEvent event;
+   if (!SendEventCallback) return;
+
+   memset(&event, 0, sizeof(event));
+   event.eventType = DRE_NEW_INPUT;
+   event.DriverID  = dev->DriverID;
+   SendEventCallback( dev, &event );
+}
+
+//! Wake up the connection thread (it checks his state)
+static void tcp_wakeup(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+   BYTE b = 0;
+   if (write(this->WakeupPipe[1], &b, 1) < 0) { /* pipe full: is awake */ }
+}
+
+
+/**************************************************************************
+   Description   : Open the bus driver: start the connection thread and 
+                   wait some time for the first connect. The driver is 
+                   online even without connection (it connects later).
+   Parameter     : dev = driver instance
+   Return-Value  : TRUE => ok
+**************************************************************************/
+BOOL tcp_open(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+   DWORD dStart;
+
+   YASDI_DEBUG((VERBOSE_HWL, "TCP::Open('%s') %s:%d\n", 
+                dev->cName, this->cHost, this->wPort));
+
+   if (dev->DeviceState == DS_ONLINE)
+      return TRUE;
+
+   if (pipe(this->WakeupPipe) != 0)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "TCP::Open(): Can't create pipe!\n"));
+      return FALSE;
+   }
+   fcntl(this->WakeupPipe[0], F_SETFL, O_NONBLOCK);
+   fcntl(this->WakeupPipe[1], F_SETFL, O_NONBLOCK);
+
+   //forget all old bytes...
+   pthread_mutex_lock( &this->RxMutex );
+   this->dRxReadPos = this->dRxWritePos = 0;
+   this->dRxChunkFirst = this->dRxChunkCount = 0;
+   pthread_mutex_unlock( &this->RxMutex );
+
+   this->state        = TCPST_DISCONNECTED;
+   this->dNextConnect = os_GetMonotonicTime();
+   this->dBackoff     = this->dReconnectMin;
+   this->bThreadRun   = TRUE;
+   if (pthread_create( &this->Thread, NULL, tcp_thread, dev ) != 0)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, "TCP::Open(): Can't create thread for '%s'!\n", dev->cName));
+      this->bThreadRun = FALSE;
+      close(this->WakeupPipe[0]);
+      close(this->WakeupPipe[1]);
+      return FALSE;
+   }
+
+   //wait for the first connect (the first requests should not get lost)
+   dStart = os_GetMonotonicTime();
+   while(this->state != TCPST_CONNECTED &&
+         (os_GetMonotonicTime() - dStart) < this->dConnectTimeout)
+   {
+      os_thread_sleep( 10 );
+   }
+
+   dev->DeviceState = DS_ONLINE;
+   return TRUE;
+}
+
+
+/**************************************************************************
+   Description   : Close the bus driver: stop the connection thread and 
+                   close the connection
+   Parameter     : dev = driver instance
+   Return-Value  : ---
+**************************************************************************/
+void tcp_close(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+
+   if (this->bThreadRun)
+   {
+      this->bThreadRun = FALSE;
+      tcp_wakeup( dev );
+      pthread_join( this->Thread, NULL );
+      close(this->WakeupPipe[0]);
+      close(this->WakeupPipe[1]);
+   }
+   tcp_disconnect( dev, FALSE );
+
+   dev->DeviceState = DS_OFFLINE;
+}
+
+
+/**************************************************************************
+   Description   : Close the socket. The next connect is started at once
+                   (lost connection) or after the current backoff delay 
+                   (failed connect), which is doubled then.
+   Parameter     : dev = driver instance
+                   bFastReconnect = reconnect at once
+   Return-Value  : ---
+**************************************************************************/
+static void tcp_disconnect(TDevice * dev, BOOL bFastReconnect)
+{
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+
+   pthread_mutex_lock( &this->ConnMutex );
+   if (this->fd >= 0)
+   {
+      close( this->fd );
+      this->fd = -1;
+   }
+   this->state = TCPST_DISCONNECTED;
+   pthread_mutex_unlock( &this->ConnMutex );
+
+   if (bFastReconnect)
+   {
+      this->dNextConnect = os_GetMonotonicTime();
+   }
+   else
+   {
+      this->dNextConnect = os_GetMonotonicTime() + this->dBackoff;
+      this->dBackoff = min(this->dBackoff * 2, this->dReconnectMax);
+   }
+}
+
+
+/**************************************************************************
+   Description   : Start an non blocking connect to the serial server
+   Parameter     : dev = driver instance
+   Return-Value  : ---
+**************************************************************************/
+static void tcp_connect_start(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+   struct addrinfo hints;
+   struct addrinfo * res = NULL;
+   char cPort[10];
+   int fd, ires;
+
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family   = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+   sprintf(cPort, "%u", this->wPort);
+   if (getaddrinfo(this->cHost, cPort, &hints, &res) != 0 || !res)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "TCP: Can't resolve '%s'!\n", this->cHost));
+      tcp_disconnect( dev, FALSE );
+      return;
+   }
+
+   fd = socket(res->ai_family, SOCK_STREAM, 0);
+   if (fd < 0)
+   {
+      freeaddrinfo( res );
+      tcp_disconnect( dev, FALSE );
+      return;
+   }
+   fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+   ires = connect(fd, res->ai_addr, res->ai_addrlen);
+   freeaddrinfo( res );
+   if (ires != 0 && errno != EINPROGRESS)
+   {
+      close( fd );
+      tcp_disconnect( dev, FALSE );
+      return;
+   }
+
+   pthread_mutex_lock( &this->ConnMutex );
+   this->fd    = fd;
+   this->state = TCPST_CONNECTING;
+   pthread_mutex_unlock( &this->ConnMutex );
+   this->dConnectDeadline = os_GetMonotonicTime() + this->dConnectTimeout;
+}
+
+
+/**************************************************************************
+   Description   : The connect has ended: check the result
+   Parameter     : dev = driver instance
+   Return-Value  : ---
+**************************************************************************/
+static void tcp_connect_done(TDevice * dev)
+{
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+   int err = 0;
+   int on = 1;
+   socklen_t len = sizeof(err);
+
+   if (getsockopt(this->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0)
+   {
+      YASDI_DEBUG((VERBOSE_HWL, "TCP: Connect to %s:%d failed (%d). Retry in %lu ms\n",
+                   this->cHost, this->wPort, err, (unsigned long)this->dBackoff));
+      tcp_disconnect( dev, FALSE );
+      return;
+   }
+
+   //send each frame at once (no Nagle) and detect dead servers
+   setsockopt(this->fd, IPPROTO_TCP, TCP_NODELAY,  &on, sizeof(on));
+   setsockopt(this->fd, SOL_SOCKET,  SO_KEEPALIVE, &on, sizeof(on));
+
+   pthread_mutex_lock( &this->ConnMutex );
+   this->state = TCPST_CONNECTED;
+   pthread_mutex_unlock( &this->ConnMutex );
+   this->dBackoff = this->dReconnectMin;
+   this->dConnectCount++;
+
+   YASDI_DEBUG((VERBOSE_HWL, "TCP: Connected to %s:%d\n", this->cHost, this->wPort));
+}
+
+
+/**************************************************************************
+   Description   : Stores received bytes in the receive buffer as new 
+                   chunk. If the buffer is full the bytes are lost.
+   Parameter     : dev = Driver instance
+                   data, len = the received bytes
+                   dTime = monotonic receive time (ms)
+   Return-Value  : ---
+**************************************************************************/
+static void tcp_rx_store(TDevice * dev, BYTE * data, DWORD len, DWORD dTime)
+{
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+   DWORD dUsed, i;
+   TTcpRxChunk * chunk;
+
+   pthread_mutex_lock( &this->RxMutex );
+
+   dUsed = (this->dRxWritePos + TCP_RX_BUFFER_SIZE - this->dRxReadPos) % TCP_RX_BUFFER_SIZE;
+   if (len > TCP_RX_BUFFER_SIZE - 1 - dUsed)
+   {
+      YASDI_DEBUG((VERBOSE_HWL,"TCP: Receive buffer of '%s' is full. Bytes are lost!\n", dev->cName));
+      len = TCP_RX_BUFFER_SIZE - 1 - dUsed;
+   }
+
+   for(i = 0; i < len; i++)
+   {
+      this->RxBuffer[ this->dRxWritePos ] = data[i];
+      this->dRxWritePos = (this->dRxWritePos + 1) % TCP_RX_BUFFER_SIZE;
+   }
+
+   if (len)
+   {
+      if (this->dRxChunkCount < TCP_RX_CHUNKS)
+      {
+         //new chunk...
+         chunk = &this->RxChunks[ (this->dRxChunkFirst + this->dRxChunkCount) % TCP_RX_CHUNKS ];
+         chunk->dTime = dTime;
+         this->dRxChunkCount++;
+      }
+      else
+      {
+         //all chunks used: append to the newest one
+         chunk = &this->RxChunks[ (this->dRxChunkFirst + this->dRxChunkCount - 1) % TCP_RX_CHUNKS ];
+      }
+      chunk->dEnd = this->dRxWritePos;
+   }
+
+   pthread_mutex_unlock( &this->RxMutex );
+}
+
+
+/**************************************************************************
+   Description   : The connection thread of one serial server. Connects 
+                   the socket, waits with "poll()" for received bytes and
+                   stores them with the receive time. The YASDI core is
+                   informed to read them at once (the serial server has
+                   already collected the bytes of the line).
+   Parameter     : param = the driver instance
+   Return-Value  : ---
+**************************************************************************/
+static void * tcp_thread(void * param)
+{
+   TDevice * dev = (TDevice*)param;
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+   struct pollfd pfd[2];
+   BYTE Buffer[512];
+   DWORD dNow;
+   int iTimeout, nfds, ires;
+
+   while( this->bThreadRun )
+   {
+      dNow = os_GetMonotonicTime();
+
+      //time for the next connect?
+      if (this->state == TCPST_DISCONNECTED && (int)(this->dNextConnect - dNow) <= 0)
+      {
+         tcp_connect_start( dev );
+         continue;
+      }
+
+      pfd[0].fd      = this->WakeupPipe[0];
+      pfd[0].events  = POLLIN;
+      pfd[0].revents = 0;
+      nfds     = 1;
+      iTimeout = TCP_POLL_TIMEOUT;
+      switch(this->state)
+      {
+         case TCPST_DISCONNECTED:
+            iTimeout = min(iTimeout, (int)(this->dNextConnect - dNow));
+            break;
+
+         case TCPST_CONNECTING:
+            pfd[1].fd = this->fd;
+            pfd[1].events = POLLOUT;
+            nfds = 2;
+            iTimeout = max(0, min(iTimeout, (int)(this->dConnectDeadline - dNow)));
+            break;
+
+         case TCPST_CONNECTED:
+            pfd[1].fd = this->fd;
+            pfd[1].events = POLLIN;
+            nfds = 2;
+            break;
+      }
+      pfd[1].revents = 0;
+
+      ires = poll( pfd, nfds, iTimeout );
+      if (ires < 0)
+      {
+         if (errno == EINTR) continue;
+         break;
+      }
+
+      //woken up: the writer may have closed the connection
+      if (pfd[0].revents & POLLIN)
+      {
+         while(read(this->WakeupPipe[0], Buffer, sizeof(Buffer)) > 0) {}
+         continue;
+      }
+
+      if (this->state == TCPST_CONNECTING)
+      {
+         if (pfd[1].revents)
+            tcp_connect_done( dev );
+         else if ((int)(this->dConnectDeadline - os_GetMonotonicTime()) <= 0)
+         {
+            YASDI_DEBUG((VERBOSE_HWL, "TCP: Connect to %s:%d timed out. Retry in %lu ms\n",
+                         this->cHost, this->wPort, (unsigned long)this->dBackoff));
+            tcp_disconnect( dev, FALSE );
+         }
+         continue;
+      }
+
+      if (this->state == TCPST_CONNECTED && pfd[1].revents)
+      {
+         dNow = os_GetMonotonicTime();
+         ires = recv( this->fd, Buffer, sizeof(Buffer), 0 );
+         if (ires < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+         if (ires <= 0)
+         {
+            //lost connection: try it again at once
+            YASDI_DEBUG((VERBOSE_HWL, "TCP: Connection to %s:%d lost. Reconnect...\n",
+                         this->cHost, this->wPort));
+            tcp_disconnect( dev, TRUE );
+            continue;
+         }
+         tcp_rx_store( dev, Buffer, ires, dNow );
+         tcp_signal_input( dev );
+      }
+   }
+
+   return NULL;
+}
+
+
+/**************************************************************************
+   Description   : Write all fragments. The socket is non blocking: 
+                   Continue with the rest after an partial write and wait 
+                   when the send buffer is full.
+   Parameter     : fd = socket, iov/iovcnt = the fragments (will be changed!)
+   Return-Value  : bytes written or -1 on error
+**************************************************************************/
+static int tcp_sendv_all(int fd, struct iovec * iov, int iovcnt)
+{
+   int total = 0;
+   ssize_t ires;
+   struct pollfd pfd;
+   struct msghdr msg;
+
+   while(iovcnt > 0)
+   {
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov    = iov;
+      msg.msg_iovlen = iovcnt;
+      ires = sendmsg(fd, &msg, MSG_NOSIGNAL);
+      if (ires < 0)
+      {
+         if (errno == EINTR) continue;
+         if (errno == EAGAIN)
+         {
+            //send buffer full: wait until there is space again
+            pfd.fd     = fd;
+            pfd.events = POLLOUT;
+            if (poll(&pfd, 1, TCP_SEND_TIMEOUT) > 0) continue;
+         }
+         return -1;
+      }
+      total += ires;
+
+      //skip the written fragments...
+      while(iovcnt > 0 && (size_t)ires >= iov->iov_len)
+      {
+         ires -= iov->iov_len;
+         iov++;
+         iovcnt--;
+      }
+      //...and the written part of the next one
+      if (iovcnt > 0)
+      {
+         iov->iov_base = (BYTE*)iov->iov_base + ires;
+         iov->iov_len -= ires;
+      }
+   }
+
+   return total;
+}
+
+
+/**************************************************************************
+   Description   : Write an frame to the serial server. Without connection
+                   the frame is lost (like on an bus without devices).
+   Parameter     : dev = driver instance
+                   frame = the frame
+   Return-Value  : ---
+**************************************************************************/
+void tcp_write(TDevice * dev, 
+               struct TNetPacket * frame,
+               DWORD DriverDeviceHandle, 
+               TDriverSendFlags flags)
+{
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+   struct iovec iov[TCP_MAX_IOV];
+   int iovcnt = 0;
+   BYTE * framedata = NULL;
+   BYTE * linearframe = NULL;
+   WORD framedatasize = 0;
+   int ires;
+
+   UNUSED_VAR( DriverDeviceHandle );
+   UNUSED_VAR( flags );
+
+   if ( dev->DeviceState != DS_ONLINE )
+   {
+      YASDI_DEBUG((VERBOSE_HWL,"TCP: Nothing send. Bus driver '%s' is offline.\n", dev->cName ));
+      return;
+   }
+
+   // transmit all buffer fragments at once
+   FOREACH_IN_BUFFER(frame, framedata, &framedatasize)
+   {
+      if (iovcnt == TCP_MAX_IOV) break;
+      iov[iovcnt].iov_base = framedata;
+      iov[iovcnt].iov_len  = framedatasize;
+      iovcnt++;
+   }
+
+   //too many fragments: copy the whole frame in one buffer
+   if (framedata)
+   {
+      linearframe = os_malloc( TNetPacket_GetFrameLength(frame) );
+      TNetPacket_CopyFromBuffer( frame, linearframe );
+      iov[0].iov_base = linearframe;
+      iov[0].iov_len  = TNetPacket_GetFrameLength(frame);
+      iovcnt = 1;
+   }
+
+   pthread_mutex_lock( &this->ConnMutex );
+   if (this->state != TCPST_CONNECTED)
+   {
+      pthread_mutex_unlock( &this->ConnMutex );
+      YASDI_DEBUG((VERBOSE_HWL,"TCP: Nothing send. '%s' is not connected.\n", dev->cName ));
+      if (linearframe) os_free( linearframe );
+      return;
+   }
+   ires = tcp_sendv_all(this->fd, iov, iovcnt);
+   if (ires < 0)
+   {
+      //the connection thread reconnects it
+      YASDI_DEBUG((VERBOSE_HWL, "TCP: Write error on '%s' (%d). Reconnect...\n", 
+                   dev->cName, errno ));
+      shutdown(this->fd, SHUT_RDWR);
+   }
+   else
+   {
+      this->dBytesSendTotal += ires;
+   }
+   pthread_mutex_unlock( &this->ConnMutex );
+
+   if (ires < 0) tcp_wakeup( dev );
+   if (linearframe) os_free( linearframe );
+}
+
+
+/**************************************************************************
+   Description   : Read received bytes (from the buffer of the connection
+                   thread). Bytes of different chunks are never mixed to
+                   keep their receive time.
+   Parameter     : dev = Drivce Instance
+                   DestBuffer = pointer to buffer to store bytes in
+                   dBufferSize = max size of buffer
+   Return-Value  : count of bytes read
+**************************************************************************/
+DWORD tcp_read(TDevice * dev, 
+               BYTE * DestBuffer, 
+               DWORD dBufferSize,
+               DWORD * DriverDevHandle)
+{
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+   DWORD BytesRead = 0;
+   DWORD dAvail;
+   TTcpRxChunk * chunk;
+
+   UNUSED_VAR( DriverDevHandle );
+
+   if ( dev->DeviceState != DS_ONLINE )
+      return 0;
+
+   pthread_mutex_lock( &this->RxMutex );
+   if (this->dRxChunkCount > 0)
+   {
+      //read only from the oldest chunk
+      chunk  = &this->RxChunks[ this->dRxChunkFirst ];
+      dAvail = (chunk->dEnd + TCP_RX_BUFFER_SIZE - this->dRxReadPos) % TCP_RX_BUFFER_SIZE;
+      BytesRead = min(dAvail, dBufferSize);
+      
+      //copy (maybe in two parts, when the ring buffer wraps around)
+      dAvail = min(BytesRead, TCP_RX_BUFFER_SIZE - this->dRxReadPos);
+      os_memcpy( DestBuffer, &this->RxBuffer[ this->dRxReadPos ], dAvail );
+      os_memcpy( DestBuffer + dAvail, this->RxBuffer, BytesRead - dAvail );
+      this->dRxReadPos = (this->dRxReadPos + BytesRead) % TCP_RX_BUFFER_SIZE;
+
+      this->dRxTimestamp = chunk->dTime;
+      
+      //chunk completly read?
+      if (this->dRxReadPos == chunk->dEnd)
+      {
+         this->dRxChunkFirst = (this->dRxChunkFirst + 1) % TCP_RX_CHUNKS;
+         this->dRxChunkCount--;
+      }
+   }
+   pthread_mutex_unlock( &this->RxMutex );
+
+   return BytesRead;
+}
+
+
+//! Max. packet size: the same as on an serial RS485 bus
+int tcp_GetMTU(TDevice * dev)
+{
+   UNUSED_VAR( dev );
+   return 255;
+}
+
+//! The events supported by this driver
+TDriverEvent tcp_GetSupportedEvents(TDevice * dev)
+{
+   UNUSED_VAR( dev );
+   return DRE_NEW_INPUT;
+}
+
+//! Driver specific io control
+int tcp_IoCtrl(TDevice * dev, int cmd, BYTE * params)
+{
+   CREATE_VAR_THIS(dev,struct TTcpPosixPriv *);
+
+   switch(cmd)
+   {
+      case IOCTRL_GET_RX_TIMESTAMP:
+         *((DWORD*)params) = this->dRxTimestamp;
+         return 0;
+
+      case IOCTRL_GET_BAUDRATE:
+         //line speed behind the serial server (0 = unknown: no airtime model)
+         if (!this->dBaudrate) return IOCTRL_UNKNOWN_CMD;
+         *((DWORD*)params) = this->dBaudrate;
+         return 0;
+
+      default:
+         return IOCTRL_UNKNOWN_CMD;
+   }
+}
+
+
+/**************************************************************************
+   Description   : Device constructor: Create ONE instance of the driver
+   Parameter     : dUnit = number of the instance ("TCPx")
+   Return-Value  : Pointer to instance or zero
+**************************************************************************/
+TDevice * tcp_create(DWORD dUnit)
+{
+   TDevice * interface;
+   struct TTcpPosixPriv * priv;
+   char cConfigPath[100];
+
+   interface = (void*)malloc(sizeof( TDevice ));
+   priv      = (void*)malloc(sizeof( struct TTcpPosixPriv ));
+   if (!interface || !priv)
+   {
+      free( interface );
+      free( priv );
+      return NULL;
+   }
+
+   memset(interface, 0, sizeof(TDevice));
+   memset(priv, 0, sizeof(struct TTcpPosixPriv));
+   interface->priv        = priv;
+   interface->DeviceState = DS_OFFLINE;
+   priv->fd               = -1;
+   priv->state            = TCPST_DISCONNECTED;
+   pthread_mutex_init( &priv->ConnMutex, NULL );
+   pthread_mutex_init( &priv->RxMutex, NULL );
+
+   interface->Open               = tcp_open;
+   interface->Close              = tcp_close;
+   interface->Write              = tcp_write; 
+   interface->Read               = tcp_read;
+   interface->GetMTU             = tcp_GetMTU;
+   interface->GetSupportedEvents = tcp_GetSupportedEvents;
+   interface->IoCtrl             = tcp_IoCtrl;
+   sprintf(interface->cName, "TCP%lu", (unsigned long)dUnit); // bus driver name
+
+   /*
+    * Read Settings from configuration
+    */
+   sprintf(cConfigPath, "%s.Address", interface->cName);
+   TRepository_GetElementStr(cConfigPath, "", priv->cHost, sizeof(priv->cHost) );
+   sprintf(cConfigPath, "%s.Port", interface->cName);
+   priv->wPort = (WORD)TRepository_GetElementInt( cConfigPath, TCP_DEFAULT_PORT );
+   sprintf(cConfigPath, "%s.Baudrate", interface->cName);
+   priv->dBaudrate = TRepository_GetElementInt( cConfigPath, TCP_DEFAULT_BAUDRATE );
+   sprintf(cConfigPath, "%s.ConnectTimeout", interface->cName);
+   priv->dConnectTimeout = TRepository_GetElementInt( cConfigPath, TCP_CONNECT_TIMEOUT );
+   sprintf(cConfigPath, "%s.ReconnectMin", interface->cName);
+   priv->dReconnectMin = max(1, TRepository_GetElementInt( cConfigPath, TCP_RECONNECT_MIN ));
+   sprintf(cConfigPath, "%s.ReconnectMax", interface->cName);
+   priv->dReconnectMax = max(priv->dReconnectMin, 
+                             TRepository_GetElementInt( cConfigPath, TCP_RECONNECT_MAX ));
+
+   YASDI_DEBUG((VERBOSE_HWL, "TCP: '%s' => %s:%d (%lu baud)\n", interface->cName,
+                priv->cHost, priv->wPort, (unsigned long)priv->dBaudrate));
+
+   /*
+   ** register this new bus device driver in the YASDI core
+   */
+   (*RegisterDevice)( interface );
+
+   return interface;
+}
+
+
+/**************************************************************************
+   Description   : Create all instances of the driver from the 
+                   configuration ("TCP0.Address" - "TCP31.Address")
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+void tcp_create_all(void)
+{
+   int i;
+
+   for(i = 0; i < TCP_MAX_DRIVERS; i++)
+   {
+      char ConfigPath[50];
+      sprintf(ConfigPath, "TCP%d.Address", i);
+      if (TRepository_GetIsElementExist( ConfigPath ))
+      {
+         tcp_create( i );
+      }
+   }
+}
+
+
+/**************************************************************************
+   Description   : Init driver module
+   Parameter     : ---
+   Return-Value  : == 0 => ok
+                   != 0 => Fehler
+**************************************************************************/
+int InitYasdiModule( void * RegFuncPtr, TOnDriverEvent eventCallback )
+{
+   YASDI_DEBUG((VERBOSE_MESSAGE,"YASDI TCP Driver for %s V" LIB_YASDI_VERSION "\n"
+                  SMA_COPYRIGHT "\n"
+                  "Compile time: " __TIME__  " " __DATE__ "\n\n", 
+                  os_GetOSIdentifier()));
+
+   /* store functions for registration and events... */
+   RegisterDevice    = RegFuncPtr;
+   SendEventCallback = eventCallback;
+
+   tcp_create_all();
+
+   return 0; /* 0 => ok */
+}
+
+
+/**************************************************************************
+   Description   : Deinitialisieren des Moduls
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+void CleanupYasdiModule(void)
+{
+   YASDI_DEBUG((VERBOSE_HWL,"TCP POSIX Driver: bye bye...\n"));
+}
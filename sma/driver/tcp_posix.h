@@ -0,0 +1,82 @@
+#ifndef TCP_POSIX_H
+#define TCP_POSIX_H
+
+
+//default TCP port of the serial servers (mode "TCP server" / "raw")
+#define TCP_DEFAULT_PORT 4001
+
+//receive buffer of the connection thread (bytes) and max. count of 
+//timestamped byte chunks in it
+#define TCP_RX_BUFFER_SIZE 4096
+#define TCP_RX_CHUNKS      64
+
+//Timing of the connection (ms): max. time of an connect, first and max.
+//delay between failed connects (doubled after each one)
+#define TCP_CONNECT_TIMEOUT 3000
+#define TCP_RECONNECT_MIN   100
+#define TCP_RECONNECT_MAX   10000
+
+//max. wait time when the send buffer of the socket is full (ms)
+#define TCP_SEND_TIMEOUT    1000
+
+//poll timeout of the connection thread (ms)
+#define TCP_POLL_TIMEOUT    200
+
+//default line speed of the bus behind the serial server (airtime model)
+#define TCP_DEFAULT_BAUDRATE 1200
+
+//max. fragments of one frame written at once
+#define TCP_MAX_IOV 16
+
+//state of the connection
+typedef enum
+{
+   TCPST_DISCONNECTED,  //waiting for the next connect
+   TCPST_CONNECTING,    //non blocking connect is running
+   TCPST_CONNECTED
+} TTcpState;
+
+//An received byte chunk: end position in the receive buffer and
+//the monotonic receive time of the first byte
+typedef struct
+{
+   DWORD dEnd;
+   DWORD dTime;
+} TTcpRxChunk;
+
+/* unit structure (Instance of class) */
+struct TTcpPosixPriv
+{
+   char cHost[64];              /* address of the serial server */
+   WORD wPort;                  /* TCP port of the serial server */
+   DWORD dBaudrate;             /* line speed of the bus behind the server */
+   DWORD dConnectTimeout;       /* ms */
+   DWORD dReconnectMin;         /* ms */
+   DWORD dReconnectMax;         /* ms */
+   DWORD dBytesSendTotal;       /* total bytes send */
+   DWORD dConnectCount;         /* successful connects */
+
+   //connection thread: connects (and reconnects) the socket, waits with 
+   //"poll()" on it and stores all received bytes. "tcp_read" reads only 
+   //from this buffer...
+   pthread_t Thread;
+   BOOL bThreadRun;             /* thread should run */
+   int WakeupPipe[2];           /* wakes the thread (end, send error) */
+   pthread_mutex_t ConnMutex;   /* access to "fd" and "state" */
+   int fd;                      /* the socket */
+   TTcpState state;
+   DWORD dNextConnect;          /* monotonic time of the next connect (ms) */
+   DWORD dConnectDeadline;      /* end of the running connect (ms) */
+   DWORD dBackoff;              /* delay after the next failed connect (ms) */
+
+   pthread_mutex_t RxMutex;     /* access to the receive buffer */
+   BYTE RxBuffer[TCP_RX_BUFFER_SIZE];
+   DWORD dRxWritePos;           /* write position in "RxBuffer" */
+   DWORD dRxReadPos;            /* read position in "RxBuffer" */
+   TTcpRxChunk RxChunks[TCP_RX_CHUNKS]; /* ring of received chunks */
+   DWORD dRxChunkFirst;         /* the oldest chunk */
+   DWORD dRxChunkCount;         /* chunks in ring */
+   DWORD dRxTimestamp;          /* receive time of the last read bytes */
+};
+
+#endif
@@ -23,9 +23,24 @@ struct TNetPacket;
 
 enum
 {
-   IOCTRL_UNKNOWN_CMD = -1 //invalid command for driver "ioctrl"
+   IOCTRL_UNKNOWN_CMD = -1, //invalid command for driver "ioctrl"
+
+   IOCTRL_GET_RX_TIMESTAMP = 1, //get the receive time (monotonic, in ms) of the
+                                //bytes returned by the last "Read" call.
+                                //"params" points to an DWORD
+                                
+   IOCTRL_GET_PROTOCOL = 2,     //get the transport protocol found by the driver
+                                //itself (configuration "Protocol=auto").
+                                //"params" points to an buffer of 
+                                //IOCTRL_PROTNAME_SIZE chars
+
+   IOCTRL_GET_BAUDRATE = 3      //get the line speed of the bus (bit/s, one start 
+                                //and stop bit). Used for the airtime model of 
+                                //the bus. "params" points to an DWORD
 };
 
+#define IOCTRL_PROTNAME_SIZE 20
+
 
 /**
  * Interface of an YASDI Bus Driver Device
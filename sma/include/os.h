@@ -76,6 +76,8 @@ typedef void (*THREADSTARTFUNC)( DWORD param ); //Entry point of an Thread
 SHARED_FUNCTION THREAD_HANDLE os_thread_create( THREADSTARTFUNC, XPOINT userData );
 SHARED_FUNCTION void os_thread_WaitFor( THREAD_HANDLE handle );
 SHARED_FUNCTION void os_thread_sleep(int iMillisec);
+SHARED_FUNCTION void os_thread_SleepWakeable(int iMillisec);
+SHARED_FUNCTION void os_thread_WakeUp( void );
 SHARED_FUNCTION void os_thread_MutexInit( T_MUTEX * mutex );
 SHARED_FUNCTION void os_thread_MutexDestroy( T_MUTEX * mutex );
 SHARED_FUNCTION void os_thread_MutexLock( T_MUTEX * mutex );
@@ -92,8 +94,18 @@ SHARED_FUNCTION const char * os_GetOSIdentifier( void );
 SHARED_FUNCTION DWORD os_rand(DWORD start, DWORD end);
 SHARED_FUNCTION DWORD os_GetSystemTime( DWORD * milliseconds );
 SHARED_FUNCTION struct tm* os_GetSystemTimeTm(DWORD * milliseconds);
+SHARED_FUNCTION DWORD os_GetWallClockTime( DWORD * milliseconds );
+//Monotonic time in milliseconds (not changed when the system time is set, 
+//wraps after 49 days). Use it for time differences (timeouts, RTT)...
+SHARED_FUNCTION DWORD os_GetMonotonicTime( void );
 SHARED_FUNCTION void os_memset(void *, BYTE value, DWORD size);
 
+//Clock source. "os_GetSystemTime" reads the wall clock unless an other
+//clock source was installed (e.g. the virtual clock in "core/vclock.c").
+//NULL restores the wall clock...
+typedef DWORD (*TOSClockFunc)( DWORD * milliseconds );
+SHARED_FUNCTION void os_SetClockSource( TOSClockFunc clockfunc );
+
 //Path file functions...
 SHARED_FUNCTION int os_GetUserHomeDir(char * destbuffer, int maxlen);
 SHARED_FUNCTION int os_mkdir(char * directoryname);
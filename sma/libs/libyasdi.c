@@ -41,6 +41,7 @@
 #include "smadata_layer.h"
 #include "driver_layer.h"
 #include "statistic_writer.h"
+#include "airtime.h"
 #include "version.h"
 #include "repository.h"
 #include "tools.h"
@@ -262,6 +263,17 @@ SHARED_FUNCTION BOOL yasdiGetDriverName(DWORD DriverID,
 }
 
 
+/**************************************************************************
+   Description   : returns the utilisation of an bus (percent)
+   Parameter     : DriverID = Driver ID
+   Return-Value  : 0...100, -1 => unknown
+**************************************************************************/
+SHARED_FUNCTION int yasdiGetDriverLoad(DWORD DriverID)
+{
+   return TAirtime_GetBusLoad( DriverID );
+}
+
+
 /**************************************************************************
    Description   : Add a async IO Request
    Parameter     : req = IORequest to add
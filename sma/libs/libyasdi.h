@@ -133,6 +133,16 @@ SHARED_FUNCTION BOOL yasdiGetDriverName(DWORD DriverID,
                                         char * DestBuffer,
                                         DWORD MaxBufferSize);
 
+/**************************************************************************
+   Description   : Returns the utilisation of an bus: airtime of the frames 
+                   sent and received during the last seconds
+   Parameter     : DriverID = Driver ID
+   Return-Value  : 0...100 (percent)
+                   -1 => unknown driver or the bus has no airtime model 
+                         (line speed unknown, e.g. IP)
+**************************************************************************/
+SHARED_FUNCTION int yasdiGetDriverLoad(DWORD DriverID);
+
 /**************************************************************************
    Description   : Do "IOCtrl" on an yasdi bus driver
    Parameter     : DriverID : DriverID of yasdis bus driver
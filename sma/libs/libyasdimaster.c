@@ -1489,6 +1489,9 @@ SHARED_FUNCTION void yasdiMasterShutdown( void )
       //signal that yasdi is now shutdown...
       bIsMasterLibInit = false;
 
+      /* free the unused master commands (while the IORequest pool exists) */
+      TMasterCmdFactory_Destroy();
+
       /* Yasdi runterfahren... */
       yasdiShutdown();
 
@@ -1568,6 +1571,15 @@ SHARED_FUNCTION BOOL yasdiMasterGetDriverName(DWORD DriverID,
    return yasdiGetDriverName(DriverID, DestBuffer, MaxBufferSize );
 }
 
+//! See header file...
+SHARED_FUNCTION int yasdiMasterGetDriverLoad(DWORD DriverID)
+{
+   // API shutdown?
+   if (!bIsMasterLibInit) return -1;
+
+   return yasdiGetDriverLoad( DriverID );
+}
+
 
 //! See header file...
 SHARED_FUNCTION BOOL yasdiMasterSetAccessLevel(char * user, char * passwd)
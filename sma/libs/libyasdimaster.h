@@ -751,6 +751,13 @@ SHARED_FUNCTION BOOL yasdiMasterGetDriverName(DWORD DriverID,
                                               char * DestBuffer, 
                                               DWORD MaxBufferSize);
 
+/**************************************************************************
+   Description   : Same as function (yasdiGetDriverLoad(...)) in YASDI.lib
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+SHARED_FUNCTION int yasdiMasterGetDriverLoad(DWORD DriverID);
+
 
                                               
 /**************************************************************************
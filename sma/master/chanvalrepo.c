@@ -70,26 +70,44 @@ int TChanValRepo_CompareEntry(const void * e1, const void * e2)
 //###### impl ##############################################################
 
  
+//!memory size of an repo with an value block of "dValueBytes"
+DWORD TChanValRepo_GetMemSize(DWORD dValueBytes)
+{
+   return MP_ALIGN( MP_ALIGN( sizeof(TChanValRepo) ) + dValueBytes );
+}
+
 //!Constructs an new repo...
-TChanValRepo * TChanValRepo_Constructor( TChanList * channelList )
+TChanValRepo * TChanValRepo_Constructor( TChanList * channelList, TMemArena * arena )
 {
    int i=0;
    TChannel * c;
-   TChanValRepo * this;
+   TChanValRepo * this = NULL;
    int channelCnt = 0;
-
-   
-   this = os_malloc( sizeof(TChanValRepo) );
+   WORD sizeOfBlock = 0;
 
    //calc the size of all values to get the right memory size...
    i=0;
    FOREACH_CHANNEL(i, channelList->ChanList, c, NULL)
    {
-      this->sizeOfBlock = this->sizeOfBlock + 
-                          TChannel_GetValCnt(c) * TChannel_GetValueWidth(c);
-   	//printf("%u: '%s' size=%d\n", channelCnt, TChannel_GetName(c), this->sizeOfBlock);
+      sizeOfBlock = sizeOfBlock + 
+                    TChannel_GetValCnt(c) * TChannel_GetValueWidth(c);
+   	//printf("%u: '%s' size=%d\n", channelCnt, TChannel_GetName(c), sizeOfBlock);
       channelCnt++;
    }
+   
+   //the repo and the block of values are one piece of memory
+   //(from the arena of the device if possible)...
+   if (arena) this = TMemArena_Alloc( arena, TChanValRepo_GetMemSize(sizeOfBlock) );
+   if (this)
+   {
+      memset(this, 0, sizeof(TChanValRepo) );
+      this->bInArena = TRUE;
+   }
+   else
+   {
+      this = os_malloc( TChanValRepo_GetMemSize(sizeOfBlock) );
+   }
+   this->sizeOfBlock = sizeOfBlock;
     
    TMap_Init(&this->map, 
              sizeof(TObjectHandle), 
@@ -97,7 +115,7 @@ TChanValRepo * TChanValRepo_Constructor( TChanList * channelList )
              channelCnt, 
              TChanValRepo_CompareEntry);
 
-   this->chanvalueblock = os_malloc( this->sizeOfBlock );
+   this->chanvalueblock = (BYTE*)this + MP_ALIGN( sizeof(TChanValRepo) );
    
    //create the offsets and init map...
    TChanValRepo_CalculateOffsets(this, channelList);
@@ -112,8 +130,8 @@ void TChanValRepo_Destructor(TChanValRepo * this)
 {
    assert(this);
    TMap_Free( &this->map );
-   os_free( this->chanvalueblock ); this->chanvalueblock = NULL;
-   os_free(this);
+   this->chanvalueblock = NULL;
+   if (!this->bInArena) os_free(this);
 }
 
 
@@ -25,6 +25,7 @@
 #include "netdevice.h"
 #include "objman.h"
 #include "minmap.h"
+#include "mempool.h"
 
 
 
@@ -60,6 +61,8 @@ typedef struct _TChanValRepo
    DWORD timeParamChannels;
    DWORD timeTestChannels;
    
+   BOOL bInArena;         //repo (with value block) is part of an memory arena
+   
 } TChanValRepo;
 
 DWORD TChanValRepo_GetTimeStamp(TChanValRepo * this, TChannel * chan);
@@ -67,8 +70,11 @@ void TChanValRepo_SetTimeStamp(TChanValRepo * this, TChannel * chan, DWORD time)
 
 
 
-//!Constructs an new repo...
-TChanValRepo * TChanValRepo_Constructor(TChanList * chanList);
+//!Constructs an new repo (from "arena" if possible, may be NULL)...
+TChanValRepo * TChanValRepo_Constructor(TChanList * chanList, TMemArena * arena);
+
+//!memory size of an repo with an value block of "dValueBytes"
+DWORD TChanValRepo_GetMemSize(DWORD dValueBytes);
 
 //!Frees all cached channel values...
 void TChanValRepo_Destructor(struct _TChanValRepo * this);
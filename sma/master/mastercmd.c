@@ -73,6 +73,7 @@ void TMasterCmd_Init( TMasterCmdReq * me, TMasterCmdType cmd);
 TMasterCmdReq * TMasterCmd_Constructor( TMasterCmdType cmd )
 {
    TMasterCmdReq * me  = os_malloc(sizeof(TMasterCmdReq));
+   assert(me);
    me->IOReq           = TIORequest_Constructor();
    //me->IOReq2          = TIORequest_Constructor(); 
    me->NewFoundDevList = TDeviceList_Constructor();
@@ -165,6 +166,16 @@ void TMasterCmdFactory_Init( void )
 
 void TMasterCmdFactory_Destroy( void )
 {
+   TMasterCmdReq * mc;
+   
+   //delete all unused master commands (the ones in use are lost here)...
+   os_thread_MutexLock(&unusedMasterCmdList.Mutex);
+   while(ISELEMENTVALID(mc = (TMasterCmdReq *)GETFIRST(&unusedMasterCmdList)))
+   {
+      REMOVE(&mc->Node);
+      TMasterCmd_Destructor( mc );
+   }
+   os_thread_MutexUnlock(&unusedMasterCmdList.Mutex);
 }
 
 static int usedcmd=0;
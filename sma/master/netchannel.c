@@ -109,12 +109,13 @@ void TChanFactory_Init( void )
    
    //add an dummy channel for later: Needed to compare channels because
    //the map contains only handles not pointers..
-   blaupauseKanal = TChannel_Constructor(0,0,0,0,NULLSTRING,NULLSTRING,NULL,0);
+   blaupauseKanal = TChannel_Constructor(0,0,0,0,NULLSTRING,NULLSTRING,NULL,0,NULL);
 }
 
 TChannel * TChanFactory_GetChannel(BYTE Index, WORD cType, WORD nType, 
                                    WORD Level, char * name, char * unit,
-                                   char * pStatText, int sizestattext)
+                                   char * pStatText, int sizestattext,
+                                   TMemArena * arena)
 {
    TObjectHandle * pHandle;
    char n[17]={0};
@@ -156,6 +157,8 @@ TChannel * TChanFactory_GetChannel(BYTE Index, WORD cType, WORD nType,
    //Offset and factor not compaired, must be still fixed
    //Must be real fixed in near future...currently only an workaround
    //HP040108
+   //(Note: channels of an device arena can't be shared, they are freed 
+   // with the device)
    pHandle = NULL;
    //pHandle = (TObjectHandle*)TMap_Find( globalChannelList, &blaupauseKanal->Handle );
    //POINTER_MUST_EVEN(pHandle);
@@ -173,7 +176,7 @@ TChannel * TChanFactory_GetChannel(BYTE Index, WORD cType, WORD nType,
    else
    {
       //no channel with same items found. Create an new one...
-      TChannel * chan = TChannel_Constructor(Index, cType, nType, Level, name, unit, pStatText, sizestattext);
+      TChannel * chan = TChannel_Constructor(Index, cType, nType, Level, name, unit, pStatText, sizestattext, arena);
       POINTER_MUST_EVEN(chan);
       POINTER_MUST_EVEN(&chan->Handle);
       TMap_Add(globalChannelList,&chan->Handle,&chan->Handle);
@@ -182,6 +185,36 @@ TChannel * TChanFactory_GetChannel(BYTE Index, WORD cType, WORD nType,
    }
 }
 
+/**************************************************************************
+   Description   : Size-only variant of "TChanFactory_GetChannel()": the
+                   memory of the channel it would create (see
+                   TChannel_Constructor()) without creating it
+   Parameters    : nType, name, unit, sizestattext = see TChanFactory_GetChannel()
+                   pdValueBytes = the bytes of the channel values are added
+                                  here (see TChanValRepo_Constructor())
+   Return-Value  : size of the channel in bytes
+**************************************************************************/
+DWORD TChanFactory_GetChannelMemSize(WORD nType, char * name, char * unit, 
+                                     int sizestattext, DWORD * pdValueBytes)
+{
+   char n[17]={0};
+   char u[9]={0};
+   
+   if (!globalChannelList)
+      TChanFactory_Init();
+
+   //(trim the strings like the constructor does)
+   strncpy(n,name,sizeof(n));
+   Trim(n,strlen(n));
+   strncpy(u,unit,sizeof(u));
+   Trim(u,strlen(u));
+
+   blaupauseKanal->wNType = nType;
+   *pdValueBytes += TChannel_GetValCnt(blaupauseKanal) * TChannel_GetValueWidth(blaupauseKanal);
+
+   return TChannel_GetMemSize(strlen(n), strlen(u), sizestattext);
+}
+
 void TChanFactory_FreeChannel(struct _TChannel * chan)
 {
    assert(chan);
@@ -236,14 +269,24 @@ void printList(void )
 //################# TChannel ###################################################
 
 
+//! The channel, its name, unit and status texts are in one memory block
+DWORD TChannel_GetMemSize(int namelen, int unitlen, int sizestattextblock)
+{
+   return MP_ALIGN( sizeof(TChannel) + (namelen + 1) + (unitlen + 1) + sizestattextblock );
+}
+
 TChannel * TChannel_Constructor(BYTE Index, WORD cType, WORD nType, WORD Level, 
                                 char * name, char * unit,
-                                char * stattexts, int sizestattextblock )
+                                char * stattexts, int sizestattextblock,
+                                TMemArena * arena )
 {
    //int iArraySize;
    char c[17]={0};
    char u[9]={0};
-   TChannel * me;
+   TChannel * me = NULL;
+   DWORD dMemSize;
+   char * strings;
+   int i;
 
    //trim name string
    strncpy(c,name,sizeof(c));
@@ -253,7 +296,21 @@ TChannel * TChannel_Constructor(BYTE Index, WORD cType, WORD nType, WORD Level,
    strncpy(u,unit,sizeof(u));
    Trim(u,strlen(u));
 
-   me = os_malloc(sizeof(TChannel));
+   if (!stattexts) sizestattextblock = 0;
+
+   //take it from the arena of the device (if any), else from the heap...
+   dMemSize = TChannel_GetMemSize(strlen(c), strlen(u), sizestattextblock);
+   if (arena) me = TMemArena_Alloc(arena, dMemSize);
+   if (me)
+   {
+      me->bMemFlags = CHAN_MEM_ARENA;
+   }
+   else
+   {
+      me = os_malloc( dMemSize );
+      if (me) me->bMemFlags = 0;
+   }
+   
    if (me)
    {
       me->ref = 0;
@@ -265,21 +322,34 @@ TChannel * TChannel_Constructor(BYTE Index, WORD cType, WORD nType, WORD Level,
       me->wCType  = cType;
       me->wNType  = nType;
       me->wLevel  = Level;
-      me->Name = os_malloc(strlen(c)+1);
-      strncpy( me->Name, c, strlen(c)+1);
+      
+      //the strings are behind the channel structure...
+      strings = (char*)(me + 1);
+      me->Name = strings;
+      strcpy( me->Name, c );
+      strings += strlen(c) + 1;
 
       //Some Channels does nit have an unit string
       if (strlen(u)>0)
       {
-         me->CUnit = os_malloc(strlen(u)+1);
-         strncpy( me->CUnit, u, strlen(u)+1);
+         me->CUnit = strings;
+         strcpy( me->CUnit, u );
+         strings += strlen(u) + 1;
       }
       else
          me->CUnit = NULLSTRING; //no unit string...
 
-      //Insert Statustexte...
+      //Insert Statustexte (and count them)...
       if (stattexts)
-         TChannel_AddStatTexts(me, stattexts, sizestattextblock);
+      {
+         me->StatText = strings;
+         memcpy(me->StatText, stattexts, sizestattextblock );
+         for(i = 0; i < sizestattextblock; i++)
+         {
+            if (stattexts[i] == 0)
+               me->bStatTextCnt++;
+         }
+      }
      
 
       /* Handle fuer dieses Objekt besorgen */
@@ -303,17 +373,14 @@ void TChannel_Destructor(TChannel * me)
 	/* Handle fuer dieses Objekt freigeben */
 	TObjManager_FreeHandle( me->Handle );
 
-   if (me->CUnit != NULLSTRING) 
-      os_free(me->CUnit);
-   
-   assert(me->Name);
-   os_free(me->Name);
-   
-   if (me->StatText) os_free(me->StatText);
+   //(name and unit are part of the channel memory)
+   if (me->bMemFlags & CHAN_MEM_STATTEXT) os_free(me->StatText);
    me->StatText = NULL;
    me->bStatTextCnt = 0;
    
-	os_free( me );
+   //the memory of an arena is freed with the arena (device)
+   if (!(me->bMemFlags & CHAN_MEM_ARENA))
+      os_free( me );
 }
 
 //!compares channel with an other channel...needed for sorting...
@@ -417,7 +484,9 @@ void TChannel_AddStatTexts( struct _TChannel * me, char * StatText, WORD wArrayS
 {
 	int i;
 	assert( me );
+	if (me->bMemFlags & CHAN_MEM_STATTEXT) os_free(me->StatText);
 	me->StatText = os_malloc( wArraySize );
+	me->bMemFlags |= CHAN_MEM_STATTEXT;
 	memcpy(me->StatText, StatText, wArraySize );
 	
 	/* Statustexte zaehlen... */
@@ -28,6 +28,7 @@
 #include "netdevice.h"
 #include "netchannel.h"
 #include "tools.h"
+#include "mempool.h"
 
 
 #define CHANVAL_INVALID -1
@@ -55,12 +56,21 @@ typedef struct _TChannel
    BYTE bStatTextCnt;    /* Anzahl der nachfolgenden Kanaltexte (anzahl der texte!)*/
    char * StatText;      /* Statustexte (die einzelnen Texte sind
                             jeweils NULL-Terminiert) */
+   BYTE bMemFlags;       /* where the memory comes from (CHAN_MEM_xxx) */
    
 } TChannel;
 
+//! the channel (with its strings) is part of an memory arena (don't free it)
+#define CHAN_MEM_ARENA     1
+//! the status texts were allocated separately
+#define CHAN_MEM_STATTEXT  2
+
 TChannel * TChannel_Constructor(BYTE Index, WORD cType, WORD nType, 
                                 WORD Level, char * name, char * unit,
-                                char * stattexts, int sizestattextblock);
+                                char * stattexts, int sizestattextblock,
+                                TMemArena * arena);
+//! the memory size of one channel (all in one block)
+DWORD TChannel_GetMemSize(int namelen, int unitlen, int sizestattextblock);
 
 void TChannel_Destructor(TChannel * channel);
 //!compares channels with an other one...
@@ -122,7 +132,8 @@ int TChannel_GetStatTextIndex(TChannel * me, const char * texttosearch);
 //##### Channel Factory #######
 
 void TChanFactory_Init( void );
-TChannel * TChanFactory_GetChannel(BYTE Index, WORD cType, WORD nType, WORD Level, char * name, char * unit, char * pStatText, int sizestattext);
+TChannel * TChanFactory_GetChannel(BYTE Index, WORD cType, WORD nType, WORD Level, char * name, char * unit, char * pStatText, int sizestattext, TMemArena * arena);
+DWORD TChanFactory_GetChannelMemSize(WORD nType, char * name, char * unit, int sizestattext, DWORD * pdValueBytes);
 void TChanFactory_FreeChannel(struct _TChannel * chan);
 
 
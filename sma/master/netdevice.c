@@ -74,6 +74,7 @@ TNetDevice * TNetDevice_Constructor(char * Type, DWORD SerNr, WORD NetAddr)
 
 		/* (leere) Kanalliste fr das Geraet erzeugen */
 		me->ChanList = TChanList_Constructor();
+      TMemArena_Init( &me->ChanArena, 0 ); //(sized with the channel list)
 
       /* per default , ask with all available protcols... */
       me->prodID = PROT_ALL_AVAILABLE;
@@ -117,20 +118,10 @@ void TNetDevice_AddNewChannel(TNetDevice * me, TChannel * newchan)
 
 void TNetDevice_Destructor(TNetDevice * me)
 {
-	TChannel * CurChan;
-   int ii;
 	assert(me);
 
-   //Free area for all channel values...
-   if (me->chanValRepo)
-      TChanValRepo_Destructor( me->chanValRepo ); 
-
-	/* Kanallistenobjekte wirklich loeschen.... */
-   //TODO: Gefaehlich so! 
-   FOREACH_CHANNEL(ii, TNetDevice_GetChannelList(me), CurChan, NULL)
-	{
-		TChanFactory_FreeChannel( CurChan );
-	}
+   //Free all channels and the area for all channel values...
+   TNetDevice_FreeChannels( me );
 	   
 	/* Kanalliste selbst entsorgen */
    TChanList_Destructor( me->ChanList );
@@ -266,8 +257,32 @@ void TNetDevice_RebuildChanValRepo(TNetDevice * this)
       TChanValRepo_Destructor( this->chanValRepo );
    
    //create an new chanvalrepo...
-   this->chanValRepo = TChanValRepo_Constructor( this->ChanList );
+   this->chanValRepo = TChanValRepo_Constructor( this->ChanList, &this->ChanArena );
+   
+}
+
+//! Frees all channels of the device (the list remains empty), the channel
+//values and the memory arena of both...
+void TNetDevice_FreeChannels(TNetDevice * this)
+{
+	TChannel * CurChan;
+   int ii;
+
+   //Free area for all channel values...
+   if (this->chanValRepo)
+      TChanValRepo_Destructor( this->chanValRepo ); 
+   this->chanValRepo = NULL;
+
+	/* Kanallistenobjekte wirklich loeschen.... */
+   //TODO: Gefaehlich so! 
+   FOREACH_CHANNEL(ii, TNetDevice_GetChannelList(this), CurChan, NULL)
+	{
+		TChanFactory_FreeChannel( CurChan );
+	}
+   TChanList_Clear( this->ChanList );
    
+   //...all at once
+   TMemArena_Free( &this->ChanArena );
 }
 
 /**************************************************************************
@@ -24,6 +24,7 @@
 
 #include "lists.h"
 #include "objman.h"
+#include "mempool.h"
 #include "netchannel.h"
 
 struct _TChanList;
@@ -74,6 +75,8 @@ typedef struct _TNetDevice
                                           // and represents an device in the bus driver
                                           // => used for routing in the bus driver 
       struct _TChanValRepo * chanValRepo; // the storage of the channel values of this device
+      TMemArena ChanArena;                // memory of the channels and channel values 
+                                          // (sized from the channel list)
 
 
 	//public items
@@ -114,6 +117,7 @@ struct _THandleList * TNetDevice_GetChannelList(TNetDevice * me);
 void 			 TNetDevice_ClearChannelValues( TNetDevice * me, WORD ChanMask, int ChanIndex  );
 void         TNetDevice_AddNewChannel(TNetDevice * me, struct _TChannel * newchan); 
 void         TNetDevice_RebuildChanValRepo(TNetDevice * me);
+void         TNetDevice_FreeChannels(TNetDevice * me);
 
 WORD         TNetDevice_GetNetAddr(TNetDevice * me);
 void			 TNetDevice_SetNetAddr(TNetDevice * me, WORD netAddr);
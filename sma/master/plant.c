@@ -50,6 +50,7 @@
 #include "prot_layer.h"
 #include "smadata_layer.h"
 #include "router.h"
+#include "chanvalrepo.h"
 
 
 
@@ -433,7 +434,7 @@ int TPlant_StoreChanList( BYTE * Buffer, DWORD BufferSize, char * DevType)
 
 	/* Kontrolliere die Kanalliste, ob diese gueltig ist.... */
 	TempChanList = TChanList_Constructor();
-	iRes = TPlant_ScanChanInfoBuf(Buffer, BufferSize, TempChanList );
+	iRes = TPlant_ScanChanInfoBuf(Buffer, BufferSize, TempChanList, NULL, NULL );
 	TChanList_Destructor( TempChanList );
 	if (iRes < 0)
 	{
@@ -470,6 +471,31 @@ end:
 	return iRes;	
 }
 
+/**************************************************************************
+   Description   : (PRIVATE)
+                   Creates a channel for TPlant_ScanChanInfoBuf(). In the
+                   size-only pass (pdChanMem != NULL) only the memory of
+                   the channel is added to "*pdChanMem" (and of its values
+                   to "*pdValueBytes") and NULL is returned.
+   Parameters    : see TChanFactory_GetChannel()
+   Return-Value  : the new channel or NULL
+**************************************************************************/
+static TChannel * TPlant_NewChannel(BYTE Index, WORD cType, WORD nType, WORD Level,
+                                    char * name, char * unit,
+                                    char * pStatText, int sizestattext,
+                                    TMemArena * arena,
+                                    DWORD * pdChanMem, DWORD * pdValueBytes)
+{
+   if (pdChanMem)
+   {
+      *pdChanMem += TChanFactory_GetChannelMemSize( nType, name, unit, 
+                                                    sizestattext, pdValueBytes );
+      return NULL;
+   }
+   return TChanFactory_GetChannel( Index, cType, nType, Level, name, unit,
+                                   pStatText, sizestattext, arena );
+}
+
 /**************************************************************************
    Description   : Interpretiert eine von einem SWR gelieferte Kanallisten-Struktur
                    und Fuegt anhand dieser neue Kanal-Objekte ein.
@@ -481,6 +507,11 @@ end:
                    dSize = Groesse des Datenbereichs
                    SN    = Seriennummer des Geraetes, fuer das die
                            Kanallistenstruktur interpretiert werden soll.
+                   arena = memory arena for the channels (or NULL)
+                   pdMemSize = size-only pass (or NULL): No channels are 
+                               created, the memory they and their values 
+                               would take (the size of the arena) is 
+                               returned here. "NewChanList" may be NULL.
 
    Return-Value  : == 0  ==> Alles OK
                    == -1 ==>
@@ -494,9 +525,12 @@ end:
                    ********************************************************
                    PRUESSING, 06.06.2001, 1.0, Created
 **************************************************************************/
-int TPlant_ScanChanInfoBuf( BYTE * data, DWORD dSize, TChanList * NewChanList)
+int TPlant_ScanChanInfoBuf( BYTE * data, DWORD dSize, TChanList * NewChanList, 
+                            TMemArena * arena, DWORD * pdMemSize)
 {
    DWORD bufPos = 0;
+   DWORD dChanMem = 0;     /* size-only pass: memory of the channels...  */
+   DWORD dValueBytes = 0;  /* ...and of their values                     */
    WORD sizeStates;
    BYTE  No;
    WORD  cType;
@@ -517,7 +551,7 @@ int TPlant_ScanChanInfoBuf( BYTE * data, DWORD dSize, TChanList * NewChanList)
 
 	YASDI_DEBUG((VERBOSE_CHANNELLIST, "TPlant::ScanChanInfoBuf()....\n"));
 
-   if (!NewChanList) return -1;
+   if (!NewChanList && !pdMemSize) return -1;
 
    while ( bufPos < dSize )
    {
@@ -549,10 +583,14 @@ int TPlant_ScanChanInfoBuf( BYTE * data, DWORD dSize, TChanList * NewChanList)
          Offset = le32fToHost( &data[bufPos + 12] );
 
          /* Analogkanal */
-         NewChannel = TChanFactory_GetChannel(No, cType, nType, nLevel, Name, Unit, NULL, 0);
-         if (!NewChannel) return -3;
-         TChannel_SetGain  ( NewChannel, Gain);
-         TChannel_SetOffset( NewChannel, Offset);
+         NewChannel = TPlant_NewChannel(No, cType, nType, nLevel, Name, Unit, NULL, 0, arena,
+                                        pdMemSize ? &dChanMem : NULL, &dValueBytes);
+         if (NewChannel)
+         {
+            TChannel_SetGain  ( NewChannel, Gain);
+            TChannel_SetOffset( NewChannel, Offset);
+         }
+         else if (!pdMemSize) return -3;
 
          #ifdef DEBUG_CHAN_LIST
          YASDI_DEBUG((VERBOSE_CHANNELLIST,",%s,%f(Gain),%f(Offset)\n", Unit, Gain, Offset));
@@ -580,8 +618,9 @@ int TPlant_ScanChanInfoBuf( BYTE * data, DWORD dSize, TChanList * NewChanList)
          bufPos += 32;
 
          /* Digitalkanal */
-         NewChannel = TChanFactory_GetChannel(No, cType, nType, nLevel, Name, "", TmpBuffer, 16*2);
-         if (!NewChannel) return -3;
+         NewChannel = TPlant_NewChannel(No, cType, nType, nLevel, Name, "", TmpBuffer, 16*2, arena,
+                                        pdMemSize ? &dChanMem : NULL, &dValueBytes);
+         if (!NewChannel && !pdMemSize) return -3;
          
          #ifdef DEBUG_CHAN_LIST
          YASDI_DEBUG((VERBOSE_CHANNELLIST,",,%s,%s\n",loTxt,hiTxt));
@@ -597,9 +636,10 @@ int TPlant_ScanChanInfoBuf( BYTE * data, DWORD dSize, TChanList * NewChanList)
          Gain = le32fToHost( &data[bufPos +  8] );
          bufPos += 12;
          
-         NewChannel = TChanFactory_GetChannel( No, cType, nType, nLevel, Name, Unit, NULL, 0);
-         if (!NewChannel) return -3;
-         TChannel_SetGain(NewChannel, Gain);
+         NewChannel = TPlant_NewChannel( No, cType, nType, nLevel, Name, Unit, NULL, 0, arena,
+                                         pdMemSize ? &dChanMem : NULL, &dValueBytes);
+         if (NewChannel) TChannel_SetGain(NewChannel, Gain);
+         else if (!pdMemSize) return -3;
          
          #ifdef DEBUG_CHAN_LIST
          YASDI_DEBUG((VERBOSE_CHANNELLIST,",%s,%f(Gain)\n",Unit,Gain));
@@ -611,10 +651,12 @@ int TPlant_ScanChanInfoBuf( BYTE * data, DWORD dSize, TChanList * NewChanList)
          sizeStates = le16ToHost(&data[bufPos]);
 
          bufPos += 2;
-         NewChannel = TChanFactory_GetChannel( No, cType, nType, nLevel, Name,"",(char*)&data[bufPos], sizeStates);
-         if (!NewChannel) return -3;
+         NewChannel = TPlant_NewChannel( No, cType, nType, nLevel, Name,"",(char*)&data[bufPos], sizeStates, arena,
+                                         pdMemSize ? &dChanMem : NULL, &dValueBytes);
+         if (!NewChannel && !pdMemSize) return -3;
 
          #ifdef DEBUG_CHAN_LIST
+         if (NewChannel)
          {
 				int i;
          	int iTxtCnt = TChannel_GetStatTextCnt( NewChannel );
@@ -694,6 +736,8 @@ int TPlant_ScanChanInfoBuf( BYTE * data, DWORD dSize, TChanList * NewChanList)
       }
    }/*end while*/
 
+   if (pdMemSize) *pdMemSize = dChanMem + TChanValRepo_GetMemSize( dValueBytes );
+
    /* Kanallisten-Laenge korrekt??? */
    if (bufPos != dSize) return -2;
    else 						return 0;
@@ -724,8 +768,13 @@ int TPlant_CreateChannels(TNetDevice * dev)
    if (TRepository_LoadChannelList(TNetDevice_GetType( dev ), &Buffer, &iFileSize)==0)
    {
       /* prima hat geklappt... */
-      dev->ChanList = TChanList_Constructor();
-      iRes = TPlant_ScanChanInfoBuf(Buffer, iFileSize, dev->ChanList );
+      //remove the old channels (if any) and take the memory of all new
+      //channels (and their values) from one arena...
+      DWORD dMemSize = 0;
+      TNetDevice_FreeChannels( dev );
+      TPlant_ScanChanInfoBuf(Buffer, iFileSize, NULL, NULL, &dMemSize ); //size only
+      TMemArena_Init( &dev->ChanArena, dMemSize );
+      iRes = TPlant_ScanChanInfoBuf(Buffer, iFileSize, dev->ChanList, &dev->ChanArena, NULL );
 
       /*
       ** Die Fkt "TRepository_LoadChannelList" hat im Erfolgsfall Speicher fuer die
@@ -68,7 +68,7 @@ int  TPlant_CreateChannels(TNetDevice * dev);
 THandleList * TPlant_GetDeviceList( void );
 
 /* private */
-int TPlant_ScanChanInfoBuf(BYTE * Buffer, DWORD BufferSize, TChanList * ChanList);
+int TPlant_ScanChanInfoBuf(BYTE * Buffer, DWORD BufferSize, TChanList * ChanList, TMemArena * arena, DWORD * pdMemSize);
 
 
 
@@ -46,6 +46,7 @@ DWORD lastSyncOnlineTime; //The timeoutstamp of the last send SyncOnline from he
 extern TSMADataMaster Master;
 BOOL TStateChanReader_checkAndSendSyncOnline( TMasterCmdReq * mc, TNetDevice * Device );
 void TStateChanReader_OnSyncSend( TMasterCmdReq * mc, struct _TIORequest * req);
+DWORD TStateChanReader_GetAnswerLength(TNetDevice * me, TIORequest * req);
 
 /**************************************************************************
 ***************************************************************************
@@ -248,6 +249,9 @@ void TStateChanReader_OnEnter   (TMasterCmdReq * mc)
           TNetDevice_GetName( Device ),
           TNetDevice_GetNetAddr( Device) ));
 
+   //size of the answer is known from the channel list (timeout of the request)
+   mc->IOReq->RxLength = TStateChanReader_GetAnswerLength(Device, mc->IOReq);
+
    TIORequest_SetOnStarting( mc->IOReq, NULL); //Keine Benachrichtigung falls Data-Abfrage...
    //Add the GET_DATA IORequest...
    TSMAData_AddIORequest( mc->IOReq );
@@ -399,6 +403,52 @@ BOOL TStateChanReader_checkAndSendSyncOnline( TMasterCmdReq * mc, TNetDevice * D
 
 
 
+/**************************************************************************
+*
+* NAME        : TStateChanReader_GetAnswerLength
+*
+* DESCRIPTION : Expected size of the answer of an CMD_GET_DATA request 
+*               (see "TStateChanReader_ScanUpdateValue" for the format)
+*
+*
+***************************************************************************
+*
+* IN     : me  = the device
+*          req = the CMD_GET_DATA request (channel mask and index)
+*
+* OUT    : ---
+*
+* RETURN : size of the answer in bytes or IOREQ_RXLENGTH_UNKNOWN
+*
+* THROWS : ---
+*
+**************************************************************************/
+DWORD TStateChanReader_GetAnswerLength(TNetDevice * me, TIORequest * req)
+{
+   WORD Mask = (WORD)(req->TxData[0] | (req->TxData[1] << 8));
+   BYTE ChanNr = req->TxData[2];
+   DWORD dLen = 5; //channel mask, channel index and data set count
+   DWORD dValues = 0;
+   TChannel * ActChan = NULL;
+   TNewChanListFilter filter;
+   int ii;
+
+   //online channels got time and time base
+   if (Mask & CH_SPOT) dLen += 8;
+
+   TNewChanListFilter_Init(&filter, Mask, ChanNr, LEV_IGNORE);
+   FOREACH_CHANNEL(ii, TNetDevice_GetChannelList(me), ActChan, &filter)
+   {
+      dValues += TChannel_GetValueWidth( ActChan ) * TChannel_GetValArraySize( ActChan );
+   }
+   
+   //no channel list (yet)?
+   if (!dValues) return IOREQ_RXLENGTH_UNKNOWN;
+
+   return dLen + dValues;
+}
+
+
 /**************************************************************************
 *
 * NAME        : TStateChanReader_ScanUpdateValue
@@ -47,6 +47,13 @@ static DWORD CurUsedMem = 0; //abolute allocated memory by YASDI in bytes
 
 static FILE * DebugOutputHandle = NULL; //Debug output file handle
 
+static TOSClockFunc ClockSource = NULL; //installed clock source (NULL => wall clock)
+
+//wake up of the (one) thread sleeping in "os_thread_SleepWakeable"
+static pthread_mutex_t WakeUpMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  WakeUpCond  = PTHREAD_COND_INITIALIZER;
+static BOOL bWakeUpPending = FALSE;
+
 
 /**************************************************************************
    Description   : Funktion erzeugt einen Thread
@@ -75,6 +82,39 @@ void os_thread_sleep(int iMillisec)
 	usleep( iMillisec * 1000 );
 }
 
+//! Sleep like "os_thread_sleep", but return as soon as someone 
+//! calls "os_thread_WakeUp" (also when it was called before)
+void os_thread_SleepWakeable(int iMillisec)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_REALTIME, &ts);
+   ts.tv_sec  += iMillisec / 1000;
+   ts.tv_nsec += (iMillisec % 1000) * 1000000L;
+   if (ts.tv_nsec >= 1000000000L)
+   {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+   }
+
+   pthread_mutex_lock( &WakeUpMutex );
+   while( !bWakeUpPending )
+   {
+      if (pthread_cond_timedwait( &WakeUpCond, &WakeUpMutex, &ts ) == ETIMEDOUT)
+         break;
+   }
+   bWakeUpPending = FALSE;
+   pthread_mutex_unlock( &WakeUpMutex );
+}
+
+//! Wake up the thread sleeping in "os_thread_SleepWakeable"
+void os_thread_WakeUp( void )
+{
+   pthread_mutex_lock( &WakeUpMutex );
+   bWakeUpPending = TRUE;
+   pthread_cond_signal( &WakeUpCond );
+   pthread_mutex_unlock( &WakeUpMutex );
+}
+
 void os_thread_WaitFor( THREAD_HANDLE handle )
 {
 	int iError;
@@ -210,7 +250,8 @@ DWORD os_rand(DWORD start, DWORD end)
 	return j;
 }
 
-DWORD os_GetSystemTime(DWORD * milliseconds)
+//! Read the real system time (wall clock), independent of the clock source
+DWORD os_GetWallClockTime(DWORD * milliseconds)
 {
    //get nano seconds if possible
    struct timeval tv ={0};
@@ -223,10 +264,32 @@ DWORD os_GetSystemTime(DWORD * milliseconds)
 	return tv.tv_sec;
 }
 
+//! Monotonic time in milliseconds (independent of changes of the system time)
+DWORD os_GetMonotonicTime( void )
+{
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return (DWORD)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+//! Current time of the installed clock source (seconds since 1970)
+DWORD os_GetSystemTime(DWORD * milliseconds)
+{
+   if (ClockSource)
+      return ClockSource( milliseconds );
+
+   return os_GetWallClockTime( milliseconds );
+}
+
+//! Install an other clock source (NULL => use the wall clock again)
+void os_SetClockSource( TOSClockFunc clockfunc )
+{
+   ClockSource = clockfunc;
+}
+
 struct tm* os_GetSystemTimeTm(DWORD * milliseconds)
 {
-   os_GetSystemTime(milliseconds);
-   time_t t = time(NULL);
+   time_t t = os_GetSystemTime(milliseconds);
    return localtime(&t);
 }
 
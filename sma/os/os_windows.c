@@ -57,6 +57,8 @@
 
 static DWORD CurUsedMem = 0; //Absolut angeforderter Speicher von Yasdi in Bytes
 static FILE * DebugOutputHandle = NULL; //logging to file?
+static TOSClockFunc ClockSource = NULL; //installed clock source (NULL => wall clock)
+static HANDLE WakeUpEvent = NULL; //wakes up "os_thread_SleepWakeable" (auto reset)
 
 
 
@@ -161,6 +163,22 @@ SHARED_FUNCTION void os_thread_sleep(int iMillisec)
 	Sleep(iMillisec);
 }
 
+//! Sleep like "os_thread_sleep", but return as soon as someone 
+//! calls "os_thread_WakeUp" (also when it was called before)
+SHARED_FUNCTION void os_thread_SleepWakeable(int iMillisec)
+{
+   if (!WakeUpEvent)
+      WakeUpEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+   WaitForSingleObject( WakeUpEvent, iMillisec );
+}
+
+//! Wake up the thread sleeping in "os_thread_SleepWakeable"
+SHARED_FUNCTION void os_thread_WakeUp( void )
+{
+   if (WakeUpEvent)
+      SetEvent( WakeUpEvent );
+}
+
 void * os_malloc(DWORD size)
 {
    #ifndef DEBUG
@@ -313,7 +331,8 @@ SHARED_FUNCTION DWORD os_rand(DWORD start, DWORD end)
 	return j;
 }
 
-SHARED_FUNCTION DWORD os_GetSystemTime( DWORD * milliseconds )
+//! Read the real system time (wall clock), independent of the clock source
+SHARED_FUNCTION DWORD os_GetWallClockTime( DWORD * milliseconds )
 {
    struct timeb tb;
    ftime(&tb);
@@ -322,6 +341,27 @@ SHARED_FUNCTION DWORD os_GetSystemTime( DWORD * milliseconds )
 	return (DWORD)tb.time - (tb.timezone * 60);
 }
 
+//! Monotonic time in milliseconds (independent of changes of the system time)
+SHARED_FUNCTION DWORD os_GetMonotonicTime( void )
+{
+   return GetTickCount();
+}
+
+//! Current time of the installed clock source
+SHARED_FUNCTION DWORD os_GetSystemTime( DWORD * milliseconds )
+{
+   if (ClockSource)
+      return ClockSource( milliseconds );
+
+   return os_GetWallClockTime( milliseconds );
+}
+
+//! Install an other clock source (NULL => use the wall clock again)
+SHARED_FUNCTION void os_SetClockSource( TOSClockFunc clockfunc )
+{
+   ClockSource = clockfunc;
+}
+
 SHARED_FUNCTION struct tm* os_GetSystemTimeTm( DWORD * milliseconds )
 {
       time_t t = os_GetSystemTime( milliseconds );
@@ -0,0 +1,10 @@
+#
+# The TCP driver "yasdi_drv_tcp": serial servers (RS485 to Ethernet)
+# connected with an persistent TCP connection (POSIX systems only)
+#
+if (UNIX)
+   set(tcpdriver_src ../../driver/tcp_posix.c)
+   set(tcpdriver_add_lib pthread)
+else (UNIX)
+   MESSAGE(STATUS "The TCP driver is only available on POSIX systems")
+endif (UNIX)
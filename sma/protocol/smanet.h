@@ -32,7 +32,8 @@ enum
    ACCM_XOFF				  = 0x00040000L,  /* Bit 19 ACCM */
    ACCM_XON					  = 0x00010000L,  /* Bit 17 ACCM */
    ACCM_BIT0				  = 0x00000001L,  /* Bit 0*/
-   SIZE_PKTBUFFER_SMANET  = 0x1000,       /* internal RX buffer size */
+   SIZE_PKTBUFFER_SMANET  = 500,          /* internal RX buffer size (frames up
+                                             to 255 bytes user data escaped) */
 };
    
 
@@ -46,6 +47,7 @@ DWORD TSMANet_GetMTU( void );
 
 WORD TSMANet_CalcFCS(WORD fcs, BYTE* pCh, WORD wLen);
 WORD TSMANet_CalcFCSRaw(WORD fcs, BYTE* pCh, WORD wLen);
+WORD TSMANet_CharMapper(BYTE* pDest, BYTE* pSrc, WORD wDatLen);
 
 typedef struct
 {
@@ -61,7 +63,8 @@ struct TSMANetPriv
 {
 	BOOL bEscRcv;							       /* Ist ein HDLC-Startzeichen empfangen worden? */
 	WORD FCS_In;							       /* Zwischenwert der Checksummenberechung */	
-	BYTE PktBuffer[SIZE_PKTBUFFER_SMANET];  /* Empfangszwischenpuffer */
+	struct TNetPacket * RxPacket;           /* the frame is received into this packet */
+	BYTE * PktBuffer;                       /* Empfangspuffer (tailroom of "RxPacket") */
 	DWORD dWritePos;						       /* aktuelle Schreibposition im Puffer */
 };
 
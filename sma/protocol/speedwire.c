@@ -0,0 +1,1049 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ * 
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ * 
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+/**************************************************************************
+* Project       : YASDI
+***************************************************************************
+* Project-no.   :
+***************************************************************************
+* Filename      : speedwire.c
+***************************************************************************
+* Description   : Implementation of the "Speedwire" protocol (SMA Data2+
+*                 in UDP datagrams, port 9522).
+*
+*                 The master speaks SMAData1 only. This protocol object
+*                 maps the SMAData1 requests of the master to SMA Data2+
+*                 requests and builds the SMAData1 answers out of the
+*                 Data2+ replies of the devices:
+*
+*                 CMD_GET_NET(_START) => discovery (multicast) and login
+*                                        of all devices, type label query
+*                 CMD_CFG_NETADR      => the address is stored here only
+*                 CMD_GET_CINFO       => a fixed channel list of the spot
+*                                        values below
+*                 CMD_GET_DATA        => all spot value queries of the
+*                                        requested channels at once
+*                 CMD_SYN_ONLINE      => (nothing, values are read with
+*                                        CMD_GET_DATA)
+*
+*                 Every answer is built when the replies of the device
+*                 arrive, so the timeouts and repeats of the master stay
+*                 valid. The answers are passed as SMANet packets to the
+*                 upper layer.
+***************************************************************************
+* Preconditions : ---
+***************************************************************************
+* Changes       : Author, Date, Version, Reason
+*                 *********************************************************
+***************************************************************************/
+
+#include "os.h"
+#include "debug.h"
+#include "smadef.h"
+#include "device.h"
+#include "netpacket.h"
+#include "protocol.h"
+#include "prot_layer.h"
+#include "driver_layer.h"
+#include "repository.h"
+#include "chandef.h"
+#include "smadata_cmd.h"
+#include "smadata_layer.h"
+#include "speedwire.h"
+
+
+#define CREATE_VAR_THIS(d,interface) register interface this = (void*)((d)->priv)
+
+
+/* the SMA Data2+ queries */
+enum
+{
+   SW_QUERY_AC_POWER,
+   SW_QUERY_DC,
+   SW_QUERY_AC_VOLTAGE,
+   SW_QUERY_GRID_FREQ,
+   SW_QUERY_ENERGY,
+   SW_QUERY_TYPELABEL,
+   SW_QUERY_COUNT
+};
+
+static const struct
+{
+   DWORD Cmd;
+   DWORD First;  /* first and last "LRI" (value id) of the query */
+   DWORD Last;
+} SpeedwireQueries[SW_QUERY_COUNT] =
+{
+   { 0x51000200UL, 0x00263f00UL, 0x00263fffUL }, /* AC power (total) */
+   { 0x53800200UL, 0x00451f00UL, 0x004521ffUL }, /* DC voltage and current */
+   { 0x51000200UL, 0x00464800UL, 0x004655ffUL }, /* AC voltage and current */
+   { 0x51000200UL, 0x00465700UL, 0x004657ffUL }, /* grid frequency */
+   { 0x54000200UL, 0x00260100UL, 0x002622ffUL }, /* energy counters */
+   { 0x58000200UL, 0x00821e00UL, 0x008220ffUL }, /* type label */
+};
+
+/* LRI of the device name in the type label */
+#define SW_LRI_NAMEPLATE 0x00821e00UL
+
+/* the channels of a Speedwire device (for the master) */
+static const struct
+{
+   BYTE  No;
+   WORD  CType;
+   char * Name;
+   char * Unit;
+   float Gain;
+   DWORD Lri;       /* value id of the Data2+ record */
+   BYTE  Class;     /* class of the record (string, phase), 0 = any */
+   BYTE  Query;     /* SW_QUERY_xxx */
+} SpeedwireChannels[SPEEDWIRE_VAL_COUNT] =
+{
+   { 1, CH_ANALOG  | CH_SPOT | CH_IN, "Pac",     "W",   1.0f,   0x00263f00UL, 0, SW_QUERY_AC_POWER   },
+   { 2, CH_ANALOG  | CH_SPOT | CH_IN, "Upv-Ist", "V",   0.01f,  0x00451f00UL, 1, SW_QUERY_DC         },
+   { 3, CH_ANALOG  | CH_SPOT | CH_IN, "Ipv",     "A",   0.001f, 0x00452100UL, 1, SW_QUERY_DC         },
+   { 4, CH_ANALOG  | CH_SPOT | CH_IN, "Uac",     "V",   0.01f,  0x00464800UL, 0, SW_QUERY_AC_VOLTAGE },
+   { 5, CH_ANALOG  | CH_SPOT | CH_IN, "Fac",     "Hz",  0.01f,  0x00465700UL, 0, SW_QUERY_GRID_FREQ  },
+   { 6, CH_COUNTER | CH_SPOT | CH_IN, "E-Total", "kWh", 0.001f, 0x00260100UL, 0, SW_QUERY_ENERGY     },
+   { 7, CH_COUNTER | CH_SPOT | CH_IN, "E-Today", "kWh", 0.001f, 0x00262200UL, 0, SW_QUERY_ENERGY     },
+};
+
+
+/* Packets are built in this and sent to the bus driver */
+typedef struct
+{
+   TDevice * driver;
+   struct TNetPacket * frame;
+   BOOL bDirect; /* receive path: the driver is already locked, 
+                    write directly */
+} TSpeedwireTx;
+
+
+/**************************************************************************
+   Description   : Konstruktor der Klasse TSpeedwire
+   Parameter     : ---  
+   Return-Value  : initialized class structure (this pointer)   
+**************************************************************************/
+struct TProtocol * TSpeedwire_constructor( void )
+{
+   struct TProtocol * newprot    = (void*)os_malloc(sizeof(struct TProtocol));
+   struct TSpeedwirePriv * priv  = (void*)os_malloc(sizeof(struct TSpeedwirePriv));
+   if (newprot && priv)
+   {
+      memset(newprot,0, sizeof(struct TProtocol));
+      memset(priv   ,0, sizeof(struct TSpeedwirePriv));
+         
+      newprot->encapsulate = TSpeedwire_encapsulate;
+      newprot->Scan        = TSpeedwire_scan_input;
+      newprot->GetMTU      = TSpeedwire_GetMTU; 
+      newprot->priv        = priv;
+      //the master sees the Speedwire devices as SMANet devices
+      newprot->TransportProtID = PROT_SMANET;
+
+      INITLIST(&priv->Devices);
+      priv->wPktId   = 1;
+      priv->AppSerNr = 900000000UL + (os_GetSystemTime(NULL) % 100000000UL);
+   }
+   else
+      newprot = NULL;
+
+   return newprot;   
+}
+
+/**************************************************************************
+   Description   : Destruktor der Klasse TSpeedwire
+   Parameter     : this = Zeiger auf die eigene Instanz (this pointer)  
+   Return-Value  : ---   
+**************************************************************************/
+void TSpeedwire_destructor(struct TProtocol * prot)
+{
+   struct TSpeedwirePriv * this = prot->priv;
+   TSpeedwireDevice * swdev;
+
+   if (this)
+   {
+      restart:
+      foreach_f(&this->Devices, swdev)
+      {
+         REMOVE( &swdev->Node );
+         os_free( swdev );
+         goto restart;
+      }
+      os_free(this);
+   }
+   os_free(prot);
+}
+
+/**************************************************************************
+   Description   : The maximum size of an SMAData1 packet
+**************************************************************************/
+DWORD TSpeedwire_GetMTU()
+{
+   return 255;
+}
+
+
+/**************************************************************************
+*********** S E N D I N G *************************************************
+**************************************************************************/
+
+/**************************************************************************
+   Description   : Sends the packet in the transmit buffer and clears it
+   Parameter     : tx = transmit buffer
+   Return-Value  : ---
+**************************************************************************/
+static void TSpeedwire_TxFlush(TSpeedwireTx * tx)
+{
+   if (TNetPacket_GetFrameLength( tx->frame ) == 0) return;
+
+   if (tx->bDirect)
+      tx->driver->Write( tx->driver,
+                         tx->frame,
+                         tx->frame->RouteInfo.BusDriverPeer,
+                         tx->frame->RouteInfo.Flags );
+   else
+      TDriverLayer_write( tx->frame );
+
+   TNetPacket_Clear( tx->frame );
+}
+
+/**************************************************************************
+   Description   : Puts a datagram in the transmit buffer. A datagram
+                   still in the buffer is sent before. The last datagram
+                   stays in the buffer (in "encapsulate()" it is sent by 
+                   the protocol layer).
+   Parameter     : tx = transmit buffer
+                   DriverDeviceHandle = destination (ip address)
+                   flags = DSF_xxx
+                   buffer, size = the datagram
+   Return-Value  : ---
+**************************************************************************/
+static void TSpeedwire_TxDatagram(TSpeedwireTx * tx, 
+                                  DWORD DriverDeviceHandle,
+                                  TDriverSendFlags flags,
+                                  BYTE * buffer, WORD size)
+{
+   TSpeedwire_TxFlush( tx );
+
+   tx->frame->RouteInfo.BusDriverPeer = DriverDeviceHandle;
+   tx->frame->RouteInfo.Flags         = flags;
+   TNetPacket_AddTail( tx->frame, buffer, size );
+}
+
+/**************************************************************************
+   Description   : Builds an SMA Data2+ packet (with the Speedwire head)
+   Parameter     : this = protocol instance
+                   buffer = destination (head + 28 + size bytes)
+                   swdev = destination device or NULL (broadcast)
+                   ctrl2 = second control word
+                   pktid = packet id
+                   cmd = command
+                   data, size = parameters of the command
+   Return-Value  : size of the packet
+**************************************************************************/
+static WORD TSpeedwire_BuildPacket(struct TSpeedwirePriv * this,
+                                   BYTE * buffer,
+                                   TSpeedwireDevice * swdev,
+                                   WORD ctrl2,
+                                   WORD pktid,
+                                   DWORD cmd,
+                                   BYTE * data, WORD size)
+{
+   static const BYTE head[] = { 'S', 'M', 'A', 0,
+                                0x00, 0x04, 0x02, 0xa0,
+                                0x00, 0x00, 0x00, 0x01 };
+   BYTE * data2 = buffer + SPEEDWIRE_HEAD_SIZE;
+   WORD data2size = (WORD)(SPEEDWIRE_DATA2_HEAD + 4 + size);
+
+   memcpy(buffer, head, sizeof(head));
+   hostToBe16( (WORD)(data2size + 2), &buffer[12] );
+   hostToBe16( SPEEDWIRE_TAG_DATA2,   &buffer[14] );
+   hostToBe16( SPEEDWIRE_PROTID_DATA2,&buffer[16] );
+
+   data2[0] = (BYTE)(data2size / 4);
+   data2[1] = 0xa0;
+   hostToLe16( swdev ? swdev->SUSyID : 0xffff,   &data2[2] );
+   hostToLe32( swdev ? swdev->SerNr : 0xffffffffUL, &data2[4] );
+   hostToLe16( ctrl2,                 &data2[8] );
+   hostToLe16( SPEEDWIRE_APP_SUSYID,  &data2[10] );
+   hostToLe32( this->AppSerNr,        &data2[12] );
+   hostToLe16( ctrl2,                 &data2[16] );
+   hostToLe16( 0,                     &data2[18] ); /* error code */
+   hostToLe16( 0,                     &data2[20] ); /* fragment id */
+   hostToLe16( (WORD)(pktid | 0x8000),&data2[22] );
+   hostToLe32( cmd,                   &data2[24] );
+   if (size) memcpy(&data2[28], data, size);
+
+   /* end tag */
+   memset(&data2[data2size], 0, 4);
+
+   return (WORD)(SPEEDWIRE_HEAD_SIZE + data2size + 4);
+}
+
+/**************************************************************************
+   Description   : Next packet id (range of "count" ids)
+**************************************************************************/
+static WORD TSpeedwire_NextPktId(struct TSpeedwirePriv * this, WORD count)
+{
+   WORD pktid;
+
+   if (this->wPktId + count > 0x7fff) this->wPktId = 1;
+   pktid = this->wPktId;
+   this->wPktId = (WORD)(this->wPktId + count);
+   return pktid;
+}
+
+/**************************************************************************
+   Description   : Sends the discovery request to the multicast group
+**************************************************************************/
+static void TSpeedwire_SendDiscovery(TSpeedwireTx * tx)
+{
+   BYTE discovery[] = { 'S', 'M', 'A', 0,
+                        0x00, 0x04, 0x02, 0xa0,
+                        0xff, 0xff, 0xff, 0xff,
+                        0x00, 0x00, 0x00, 0x20,
+                        0x00, 0x00, 0x00, 0x00 };
+
+   TSpeedwire_TxDatagram( tx, INVALID_DRIVER_DEVICE_HANDLE, DSF_BROADCAST,
+                          discovery, sizeof(discovery) );
+}
+
+/**************************************************************************
+   Description   : Sends a login request
+   Parameter     : this = protocol instance
+                   tx = transmit buffer
+                   swdev = device or NULL (all devices behind the handle)
+                   DriverDeviceHandle = destination, 
+                                        INVALID_DRIVER_DEVICE_HANDLE = all
+                   pktid = packet id
+   Return-Value  : ---
+**************************************************************************/
+static void TSpeedwire_SendLogin(struct TSpeedwirePriv * this, 
+                                 TSpeedwireTx * tx,
+                                 TSpeedwireDevice * swdev,
+                                 DWORD DriverDeviceHandle,
+                                 WORD pktid)
+{
+   BYTE buffer[SPEEDWIRE_HEAD_SIZE + SPEEDWIRE_DATA2_HEAD + 4 + 28 + 4];
+   BYTE login[28];
+   char ConfigPath[sizeof(((TDevice*)0)->cName) + 10]; //driver name + ".Password"
+   char Password[13];
+   WORD size;
+   int i;
+
+   /* the password of the user group, the same for all devices */
+   sprintf(ConfigPath, "%s.Password", tx->driver->cName);
+   TRepository_GetElementStr(ConfigPath, "0000", Password, sizeof(Password));
+
+   hostToLe32( SPEEDWIRE_USER_GROUP,    &login[0] );
+   hostToLe32( SPEEDWIRE_LOGIN_TIMEOUT, &login[4] );
+   hostToLe32( os_GetSystemTime(NULL),  &login[8] );
+   hostToLe32( 0,                       &login[12] );
+   memset(&login[16], 0, 12);
+   for(i = 0; i < 12 && Password[i]; i++)
+      login[16 + i] = Password[i];
+   for(i = 0; i < 12; i++)
+      login[16 + i] = (BYTE)(login[16 + i] + 0x88);
+
+   size = TSpeedwire_BuildPacket( this, buffer, swdev, 0x0100, pktid,
+                                  SPEEDWIRE_CMD_LOGIN, login, sizeof(login) );
+   TSpeedwire_TxDatagram( tx, DriverDeviceHandle,
+                          DriverDeviceHandle == INVALID_DRIVER_DEVICE_HANDLE ?
+                          DSF_BROADCAST_ALLKNOWN : DSF_MONOCAST,
+                          buffer, size );
+}
+
+/**************************************************************************
+   Description   : Starts an SMAData1 request of the master: sends the 
+                   Data2+ queries (all at once). The answer is built
+                   when the replies to all queries were received.
+   Parameter     : this = protocol instance
+                   tx = transmit buffer
+                   swdev = device
+                   cmd, pktcnt, source = the SMAData1 request
+                   queries = bit mask of the queries (1 << SW_QUERY_xxx)
+   Return-Value  : ---
+**************************************************************************/
+static void TSpeedwire_StartRequest(struct TSpeedwirePriv * this, 
+                                    TSpeedwireTx * tx,
+                                    TSpeedwireDevice * swdev,
+                                    BYTE cmd, BYTE pktcnt, WORD source,
+                                    DWORD queries)
+{
+   BYTE buffer[SPEEDWIRE_HEAD_SIZE + SPEEDWIRE_DATA2_HEAD + 4 + 8 + 4];
+   BYTE range[8];
+   WORD size;
+   int i;
+
+   swdev->ReqCmd      = cmd;
+   swdev->ReqPktCnt   = pktcnt;
+   swdev->ReqSource   = source;
+   swdev->ReqPktId    = TSpeedwire_NextPktId( this, SW_QUERY_COUNT );
+   swdev->dReqQueries = queries;
+
+   /* session expired or never logged in: login first */
+   if (!swdev->bLoggedIn)
+      TSpeedwire_SendLogin( this, tx, swdev, swdev->DriverDeviceHandle,
+                            TSpeedwire_NextPktId( this, 1 ) );
+
+   for(i = 0; i < SW_QUERY_COUNT; i++)
+   {
+      if (!(queries & (1UL << i))) continue;
+
+      hostToLe32( SpeedwireQueries[i].First, &range[0] );
+      hostToLe32( SpeedwireQueries[i].Last,  &range[4] );
+      size = TSpeedwire_BuildPacket( this, buffer, swdev, 0,
+                                     (WORD)(swdev->ReqPktId + i),
+                                     SpeedwireQueries[i].Cmd,
+                                     range, sizeof(range) );
+      TSpeedwire_TxDatagram( tx, swdev->DriverDeviceHandle, DSF_MONOCAST,
+                             buffer, size );
+   }
+}
+
+
+/**************************************************************************
+*********** S M A D A T A 1   V I E W *************************************
+**************************************************************************/
+
+/**************************************************************************
+   Description   : Does a channel match the channel mask and index of a
+                   request? (same rules as TNewChanListFilter_CheckChannel())
+**************************************************************************/
+static BOOL TSpeedwire_ChannelMatch(int i, WORD mask, BYTE index)
+{
+   WORD mask1 = CH_PARA | CH_SPOT | CH_MEAN;
+   WORD ctype = SpeedwireChannels[i].CType;
+
+   if (mask == 0xffff) return TRUE;
+   return ((ctype & CH_TEST) == (mask & CH_TEST)) &&
+          ((ctype & mask1)  & (mask & mask1)) &&
+          ((ctype & CH_ALL) & (mask & CH_ALL)) &&
+          (index == 0 || SpeedwireChannels[i].No == index);
+}
+
+/**************************************************************************
+   Description   : Builds the channel list (answer of CMD_GET_CINFO) in the
+                   format parsed by TPlant_ScanChanInfoBuf()
+   Parameter     : buffer = destination (SPEEDWIRE_MAX_ANSWER bytes)
+   Return-Value  : size of the channel list
+**************************************************************************/
+static DWORD TSpeedwire_BuildChanInfo(BYTE * buffer)
+{
+   DWORD pos = 0;
+   int i;
+
+   for(i = 0; i < SPEEDWIRE_VAL_COUNT; i++)
+   {
+      buffer[pos] = SpeedwireChannels[i].No;
+      hostToLe16( SpeedwireChannels[i].CType,  &buffer[pos + 1] );
+      hostToLe16( 0x0100 | CH_DWORD,           &buffer[pos + 3] );
+      hostToLe16( 0,                           &buffer[pos + 5] );
+      memset(&buffer[pos + 7], 0, 16);
+      strcpy((char*)&buffer[pos + 7], SpeedwireChannels[i].Name);
+      pos += 23;
+
+      memset(&buffer[pos], 0, 8);
+      strcpy((char*)&buffer[pos], SpeedwireChannels[i].Unit);
+      hostToLe32f( SpeedwireChannels[i].Gain, &buffer[pos + 8] );
+      pos += 12;
+
+      /* analog channels: offset */
+      if (SpeedwireChannels[i].CType & CH_ANALOG)
+      {
+         hostToLe32f( 0.0f, &buffer[pos] );
+         pos += 4;
+      }
+   }
+
+   return pos;
+}
+
+/**************************************************************************
+   Description   : Builds the answer of CMD_GET_DATA
+                   (parsed by TStateChanReader_ScanUpdateValue())
+   Parameter     : swdev = device
+                   buffer = destination (SPEEDWIRE_MAX_ANSWER bytes)
+   Return-Value  : size of the answer
+**************************************************************************/
+static DWORD TSpeedwire_BuildData(TSpeedwireDevice * swdev, BYTE * buffer)
+{
+   DWORD pos = 0;
+   int i;
+
+   hostToLe16( swdev->ReqChanMask, &buffer[pos] ); pos += 2;
+   buffer[pos++] = swdev->ReqChanIndex;
+   hostToLe16( 1, &buffer[pos] );                  pos += 2; /* one data set */
+
+   /* spot values: time and time base */
+   if (swdev->ReqChanMask & CH_SPOT)
+   {
+      hostToLe32( os_GetSystemTime(NULL), &buffer[pos] ); pos += 4;
+      hostToLe32( 1,                      &buffer[pos] ); pos += 4;
+   }
+
+   for(i = 0; i < SPEEDWIRE_VAL_COUNT; i++)
+   {
+      if (!TSpeedwire_ChannelMatch(i, swdev->ReqChanMask, swdev->ReqChanIndex)) 
+         continue;
+      hostToLe32( swdev->Values[i], &buffer[pos] );
+      pos += 4;
+   }
+
+   return pos;
+}
+
+/**************************************************************************
+   Description   : Passes an SMAData1 answer of a device to the upper layer
+   Parameter     : dev = bus driver
+                   swdev = answering device
+                   cmd, pktcnt = command and packet counter
+                   data, size = user data of the answer
+   Return-Value  : ---
+**************************************************************************/
+static void TSpeedwire_Deliver(TDevice * dev, TSpeedwireDevice * swdev,
+                               BYTE cmd, BYTE pktcnt,
+                               BYTE * data, DWORD size)
+{
+   struct TSMADataHead head;
+   struct TNetPacket * frame = TNetPacketManagement_GetPacket();
+
+   hostToLe16( swdev->NetAddr,   (BYTE*)&head.SourceAddr );
+   hostToLe16( swdev->ReqSource, (BYTE*)&head.DestAddr   );
+   head.Ctrl   = ctrlAck;
+   head.PktCnt = pktcnt;
+   head.Cmd    = cmd;
+
+   frame->RouteInfo.BusDriverID   = dev->DriverID;
+   frame->RouteInfo.BusDriverPeer = swdev->DriverDeviceHandle;
+   frame->RouteInfo.bTransProtID  = PROT_SMANET;
+   TNetPacket_AddTail( frame, (BYTE*)&head, 7 );
+   if (size) TNetPacket_AddTail( frame, data, (WORD)size );
+
+   TProtLayer_NotifyFrameListener( frame, PROT_PPP_SMADATA1 );
+   TNetPacketManagement_FreeBuffer( frame );
+}
+
+/**************************************************************************
+   Description   : Sends one packet of the last (long) answer. The first 
+                   packet has the counter "count of packets - 1", the 
+                   master requests the others (see fractionizer.c).
+   Parameter     : dev = bus driver
+                   swdev = device
+                   pktcnt = 0: first packet, else counter of the request
+   Return-Value  : ---
+**************************************************************************/
+static void TSpeedwire_DeliverLong(TDevice * dev, TSpeedwireDevice * swdev,
+                                   BYTE pktcnt)
+{
+   DWORD pkts = (swdev->AnswerSize + SPEEDWIRE_PKT_DATA - 1) / SPEEDWIRE_PKT_DATA;
+   DWORD offset;
+   DWORD size;
+
+   if (pkts == 0) pkts = 1;
+   if (pktcnt == 0) pktcnt = (BYTE)pkts;
+   if (pktcnt > pkts) return;
+
+   /* request for counter "N" is answered with counter "N-1" */
+   offset = (pkts - pktcnt) * SPEEDWIRE_PKT_DATA;
+   size   = swdev->AnswerSize - offset;
+   if (size > SPEEDWIRE_PKT_DATA) size = SPEEDWIRE_PKT_DATA;
+
+   TSpeedwire_Deliver( dev, swdev, swdev->AnswerCmd, (BYTE)(pktcnt - 1),
+                       swdev->Answer + offset, size );
+}
+
+/**************************************************************************
+   Description   : All replies of the pending request were received: 
+                   answer the SMAData1 request
+   Parameter     : dev = bus driver
+                   swdev = device
+   Return-Value  : ---
+**************************************************************************/
+static void TSpeedwire_Answer(TDevice * dev, TSpeedwireDevice * swdev)
+{
+   BYTE data[12];
+   BYTE cmd = swdev->ReqCmd;
+
+   swdev->ReqCmd = 0;
+
+   switch(cmd)
+   {
+      case CMD_GET_NET:
+      case CMD_GET_NET_START:
+         hostToLe32( swdev->SerNr, &data[0] );
+         memset(&data[4], 0, 8);
+         memcpy(&data[4], swdev->Type, strlen(swdev->Type));
+         TSpeedwire_Deliver( dev, swdev, cmd, 0, data, 12 );
+         break;
+
+      case CMD_CFG_NETADR:
+         hostToLe32( swdev->SerNr, &data[0] );
+         TSpeedwire_Deliver( dev, swdev, cmd, 0, data, 4 );
+         break;
+
+      case CMD_GET_CINFO:
+      case CMD_GET_DATA:
+         if (swdev->ReqPktCnt == 0)
+         {
+            swdev->AnswerCmd  = cmd;
+            swdev->AnswerSize = (cmd == CMD_GET_CINFO) ?
+                                TSpeedwire_BuildChanInfo( swdev->Answer ) :
+                                TSpeedwire_BuildData( swdev, swdev->Answer );
+         }
+         else if (swdev->AnswerCmd != cmd)
+            break;
+         TSpeedwire_DeliverLong( dev, swdev, swdev->ReqPktCnt );
+         break;
+
+      default:
+         break;
+   }
+}
+
+/**************************************************************************
+   Description   : Finds a device by its serial number or by its SMAData1
+                   address
+**************************************************************************/
+static TSpeedwireDevice * TSpeedwire_FindSerNr(struct TSpeedwirePriv * this, 
+                                               DWORD SerNr)
+{
+   TSpeedwireDevice * swdev;
+   foreach_f(&this->Devices, swdev)
+   {
+      if (swdev->SerNr == SerNr) return swdev;
+   }
+   return NULL;
+}
+
+static TSpeedwireDevice * TSpeedwire_FindNetAddr(struct TSpeedwirePriv * this, 
+                                                 WORD NetAddr)
+{
+   TSpeedwireDevice * swdev;
+   foreach_f(&this->Devices, swdev)
+   {
+      if (swdev->NetAddr == NetAddr && swdev->NetAddr != 0) return swdev;
+   }
+   return NULL;
+}
+
+/**************************************************************************
+   Description   : Encapsulate an SMAData1 packet: maps it to SMA Data2+
+                   requests. The packet is empty afterwards, if there is
+                   nothing to send.
+   Parameter     : prot = "this"-Pointer
+                   frame = the packet
+                   protid = PPP protocol id of the packet
+   Return-Value  : ---
+**************************************************************************/
+void TSpeedwire_encapsulate(struct TProtocol * prot, struct TNetPacket * frame, 
+                            WORD protid)
+{
+   CREATE_VAR_THIS(prot, struct TSpeedwirePriv *);
+   BYTE pkt[7 + 255];
+   DWORD size = TNetPacket_GetFrameLength( frame );
+   BYTE * data = pkt + 7;
+   DWORD dataSize;
+   TSpeedwireDevice * swdev;
+   TSpeedwireTx tx;
+   WORD src, dst;
+   BYTE ctrl, pktcnt, cmd;
+   
+   tx.driver  = TDriverLayer_FindDriverID( frame->RouteInfo.BusDriverID );
+   tx.frame   = frame;
+   tx.bDirect = false;
+
+   if (protid != PROT_PPP_SMADATA1 || size < 7 || size > sizeof(pkt) || !tx.driver)
+   {
+      TNetPacket_Clear( frame );
+      return;
+   }
+
+   TNetPacket_CopyFromBuffer( frame, pkt );
+   TNetPacket_Clear( frame );
+   src      = le16ToHost( &pkt[0] );
+   dst      = le16ToHost( &pkt[2] );
+   ctrl     = pkt[4];
+   pktcnt   = pkt[5];
+   cmd      = pkt[6];
+   dataSize = size - 7;
+
+   /* answers (slave mode) are not mapped */
+   if (ctrl & ctrlAck) return;
+
+   switch(cmd)
+   {
+      case CMD_GET_NET:
+      case CMD_GET_NET_START:
+         /* all devices answering this login are answering the request */
+         this->GetNetCmd    = cmd;
+         this->GetNetSource = src;
+         this->GetNetPktId  = TSpeedwire_NextPktId( this, 1 );
+         this->dGetNetTime  = os_GetSystemTime(NULL);
+         TSpeedwire_SendDiscovery( &tx );
+         TSpeedwire_SendLogin( this, &tx, NULL, INVALID_DRIVER_DEVICE_HANDLE,
+                               this->GetNetPktId );
+         break;
+
+      case CMD_CFG_NETADR:
+         if (dataSize >= 6 && (swdev = TSpeedwire_FindSerNr(this, le32ToHost(&data[0]))) != NULL)
+         {
+            swdev->NetAddr = le16ToHost( &data[4] );
+            TSpeedwire_StartRequest( this, &tx, swdev, cmd, 0, src, 
+                                     1UL << SW_QUERY_TYPELABEL );
+         }
+         break;
+
+      case CMD_GET_CINFO:
+      case CMD_GET_DATA:
+         swdev = TSpeedwire_FindNetAddr( this, dst );
+         if (!swdev || (ctrl & ctrlGroup)) break;
+
+         /* follow up packet of a long answer (the device is asked
+            anyway, the master has to see the device online) */
+         if (pktcnt > 0 && dataSize == 0)
+         {
+            TSpeedwire_StartRequest( this, &tx, swdev, cmd, pktcnt, src,
+                                     1UL << SW_QUERY_TYPELABEL );
+         }
+         else if (cmd == CMD_GET_CINFO)
+         {
+            TSpeedwire_StartRequest( this, &tx, swdev, cmd, 0, src,
+                                     1UL << SW_QUERY_TYPELABEL );
+         }
+         else if (dataSize >= 3)
+         {
+            /* all queries for the requested channels at once */
+            DWORD queries = 0;
+            int i;
+
+            swdev->ReqChanMask  = le16ToHost( &data[0] );
+            swdev->ReqChanIndex = data[2];
+            for(i = 0; i < SPEEDWIRE_VAL_COUNT; i++)
+            {
+               if (TSpeedwire_ChannelMatch(i, swdev->ReqChanMask, swdev->ReqChanIndex))
+                  queries |= 1UL << SpeedwireChannels[i].Query;
+            }
+            if (queries == 0) queries = 1UL << SW_QUERY_TYPELABEL;
+            TSpeedwire_StartRequest( this, &tx, swdev, cmd, 0, src, queries );
+         }
+         break;
+
+      case CMD_SYN_ONLINE:
+         /* nothing to do, the values are read with CMD_GET_DATA */
+         break;
+
+      default:
+         YASDI_DEBUG((VERBOSE_MESSAGE, 
+                      "TSpeedwire: SMAData1 command %d not supported\n", cmd));
+         break;
+   }
+}
+
+
+/**************************************************************************
+*********** R E C E I V I N G *********************************************
+**************************************************************************/
+
+/**************************************************************************
+   Description   : A device has answered the login request
+   Parameter     : this = protocol instance
+                   tx = transmit buffer
+                   dev = bus driver
+                   DriverDeviceHandle = sender
+                   SUSyID, SerNr = the device
+                   error = error code of the reply
+                   pktid = packet id of the reply
+   Return-Value  : ---
+**************************************************************************/
+static void TSpeedwire_OnLogin(struct TSpeedwirePriv * this, 
+                               TSpeedwireTx * tx,
+                               TDevice * dev,
+                               DWORD DriverDeviceHandle,
+                               WORD SUSyID, DWORD SerNr, WORD error,
+                               WORD pktid)
+{
+   TSpeedwireDevice * swdev = TSpeedwire_FindSerNr( this, SerNr );
+
+   if (!swdev)
+   {
+      swdev = os_malloc( sizeof(TSpeedwireDevice) );
+      if (!swdev) return;
+      memset(swdev, 0, sizeof(TSpeedwireDevice));
+      swdev->SerNr = SerNr;
+      ADDTAIL( &this->Devices, &swdev->Node );
+      YASDI_DEBUG((VERBOSE_MESSAGE, 
+                   "TSpeedwire: New device SUSyID=%d SN=%lu\n", 
+                   SUSyID, (unsigned long)SerNr));
+   }
+   swdev->SUSyID             = SUSyID;
+   swdev->DriverDeviceHandle = DriverDeviceHandle;
+   swdev->bLoggedIn          = (error == 0);
+
+   if (error)
+   {
+      YASDI_DEBUG((VERBOSE_WARNING, 
+                   "TSpeedwire: Login of SN=%lu failed (error 0x%x). Wrong password?\n",
+                   (unsigned long)SerNr, error));
+      return;
+   }
+
+   /* login of a running CMD_GET_NET: answer it (type label needed) */
+   if (this->GetNetCmd && pktid == this->GetNetPktId &&
+       os_GetSystemTime(NULL) - this->dGetNetTime <= SPEEDWIRE_GETNET_WINDOW)
+   {
+      if (swdev->Type[0])
+      {
+         swdev->ReqCmd    = this->GetNetCmd;
+         swdev->ReqSource = this->GetNetSource;
+         TSpeedwire_Answer( dev, swdev );
+      }
+      else
+         TSpeedwire_StartRequest( this, tx, swdev, this->GetNetCmd, 0, 
+                                  this->GetNetSource, 
+                                  1UL << SW_QUERY_TYPELABEL );
+   }
+}
+
+/**************************************************************************
+   Description   : Takes the records of a query reply
+   Parameter     : swdev = device
+                   cmd = command of the reply
+                   records, size = the records
+   Return-Value  : ---
+**************************************************************************/
+static void TSpeedwire_OnRecords(TSpeedwireDevice * swdev, DWORD cmd,
+                                 BYTE * records, DWORD size)
+{
+   DWORD recsize;
+   DWORD pos;
+   int i;
+
+   switch(cmd >> 24)
+   {
+      case 0x54: recsize = 16; break; /* counter: 64 bit value */
+      case 0x58: recsize = 40; break; /* type label: attributes */
+      default:   recsize = 28; break; /* spot values: 32 bit values */
+   }
+
+   for(pos = 0; pos + recsize <= size; pos += recsize)
+   {
+      BYTE * rec = records + pos;
+      DWORD code = le32ToHost( rec );
+      DWORD lri  = code & 0x00ffff00UL;
+      BYTE  cls  = (BYTE)(code & 0xff);
+      DWORD value;
+
+      if ((cmd >> 24) == 0x58)
+      {
+         /* the device name is the type for the master */
+         if (lri == SW_LRI_NAMEPLATE)
+         {
+            memcpy(swdev->Type, &rec[8], sizeof(swdev->Type) - 1);
+            swdev->Type[sizeof(swdev->Type) - 1] = 0;
+         }
+         continue;
+      }
+
+      /* (low part of the counters) "NaN" is reported as zero */
+      value = le32ToHost( &rec[8] );
+      if (value == 0x80000000UL || value == 0xffffffffUL) value = 0;
+
+      for(i = 0; i < SPEEDWIRE_VAL_COUNT; i++)
+      {
+         if (SpeedwireChannels[i].Lri == lri &&
+             (SpeedwireChannels[i].Class == 0 || SpeedwireChannels[i].Class == cls))
+            swdev->Values[i] = value;
+      }
+   }
+}
+
+/**************************************************************************
+   Description   : A complete Speedwire datagram was received
+   Parameter     : this = protocol instance
+                   tx = transmit buffer
+                   dev = bus driver
+                   buffer, size = the datagram
+                   DriverDeviceHandle = the sender
+   Return-Value  : ---
+**************************************************************************/
+static void TSpeedwire_OnPacket(struct TSpeedwirePriv * this, 
+                                TSpeedwireTx * tx,
+                                TDevice * dev, BYTE * buffer, DWORD size,
+                                DWORD DriverDeviceHandle)
+{
+   BYTE * data2 = buffer + SPEEDWIRE_HEAD_SIZE;
+   DWORD data2size;
+   TSpeedwireDevice * swdev;
+   WORD SUSyID, error, pktid;
+   DWORD SerNr, cmd;
+
+   /* no Data2+ packet: answer of the discovery */
+   if (size < SPEEDWIRE_HEAD_SIZE + SPEEDWIRE_DATA2_HEAD + 4 ||
+       be16ToHost(&buffer[14]) != SPEEDWIRE_TAG_DATA2 ||
+       be16ToHost(&buffer[16]) != SPEEDWIRE_PROTID_DATA2)
+   {
+      /* (group 0xffffffff: the discovery request itself) */
+      if (be32ToHost(&buffer[8]) == 0xffffffffUL) return;
+
+      foreach_f(&this->Devices, swdev)
+      {
+         if (swdev->DriverDeviceHandle == DriverDeviceHandle) return;
+      }
+      TSpeedwire_SendLogin( this, tx, NULL, DriverDeviceHandle, this->GetNetPktId );
+      return;
+   }
+
+   data2size = be16ToHost(&buffer[12]) - 2;
+   if (data2size > size - SPEEDWIRE_HEAD_SIZE) return;
+
+   /* not for us (requests of other masters) */
+   if (le32ToHost(&data2[4]) != this->AppSerNr) return;
+
+   SUSyID = le16ToHost( &data2[10] );
+   SerNr  = le32ToHost( &data2[12] );
+   error  = le16ToHost( &data2[18] );
+   pktid  = (WORD)(le16ToHost( &data2[22] ) & 0x7fff);
+   cmd    = le32ToHost( &data2[24] );
+
+   if (cmd == SPEEDWIRE_CMD_LOGIN_REPLY)
+   {
+      TSpeedwire_OnLogin( this, tx, dev, DriverDeviceHandle, SUSyID, SerNr, 
+                          error, pktid );
+      return;
+   }
+
+   swdev = TSpeedwire_FindSerNr( this, SerNr );
+   if (!swdev) return;
+   swdev->DriverDeviceHandle = DriverDeviceHandle;
+
+   if (error)
+   {
+      /* e.g. the login has expired: login again with the next request 
+         (the master repeats it) */
+      YASDI_DEBUG((VERBOSE_MESSAGE, 
+                   "TSpeedwire: SN=%lu replied with error 0x%x\n",
+                   (unsigned long)SerNr, error));
+      swdev->bLoggedIn = false;
+      return;
+   }
+
+   if (data2size >= SPEEDWIRE_DATA2_HEAD + 12)
+      TSpeedwire_OnRecords( swdev, cmd, 
+                            data2 + SPEEDWIRE_DATA2_HEAD + 12,
+                            data2size - SPEEDWIRE_DATA2_HEAD - 12 );
+
+   /* reply of a query of the pending request? */
+   if (swdev->ReqCmd && 
+       pktid >= swdev->ReqPktId && pktid < swdev->ReqPktId + SW_QUERY_COUNT)
+   {
+      swdev->dReqQueries &= ~(1UL << (pktid - swdev->ReqPktId));
+      if (swdev->dReqQueries == 0)
+         TSpeedwire_Answer( dev, swdev );
+   }
+}
+
+/**************************************************************************
+   Description   : Size of the Speedwire datagram at the start of the 
+                   buffer. The datagram is a list of tags (size, tag, 
+                   contents) ending with an empty tag 0.
+   Parameter     : buffer, size = receive buffer
+   Return-Value  : size of the datagram, 0 = incomplete, 
+                   -1 = no Speedwire datagram
+**************************************************************************/
+static int TSpeedwire_GetDatagramSize(BYTE * buffer, DWORD size)
+{
+   static const BYTE magic[4] = { 'S', 'M', 'A', 0 };
+   DWORD pos = 4;
+
+   if (memcmp(buffer, magic, size < 4 ? size : 4) != 0) return -1;
+   
+   while(pos + 4 <= size)
+   {
+      WORD taglen = be16ToHost( &buffer[pos] );
+      WORD tag    = be16ToHost( &buffer[pos + 2] );
+
+      if (taglen == 0 && tag == 0) return (int)(pos + 4);
+      pos += 4 + taglen;
+      if (pos + 4 > SIZE_PKTBUFFER_SPEEDWIRE) return -1;
+   }
+   return 0;
+}
+
+/**************************************************************************
+   Description   : Liest den Datenstrom vom entsprechenden Device
+                   und setzt die Speedwire-Datagramme wieder zusammen
+   Parameter     : prot = "this"-Pointer
+                   dev  = Device, von dem gelesen wird
+                   buffer, dBytesRead = the read bytes
+                   DriverDeviceHandel = the sender of the bytes
+   Return-Value  : ---
+**************************************************************************/
+void TSpeedwire_scan_input(struct TProtocol * prot, TDevice * dev, 
+                           BYTE * buffer, DWORD dBytesRead, DWORD DriverDeviceHandel )
+{
+   CREATE_VAR_THIS(prot, struct TSpeedwirePriv *);
+   TSpeedwireTx tx;
+   int iSize;
+
+   /* new datagram */
+   if (this->dWritePos == 0)
+      this->RxDriverDeviceHandle = DriverDeviceHandel;
+
+   if (this->dWritePos + dBytesRead > sizeof(this->PktBuffer))
+      this->dWritePos = 0; /* Puffer ueberlauf! */
+   if (dBytesRead > sizeof(this->PktBuffer)) return;
+   memcpy(this->PktBuffer + this->dWritePos, buffer, dBytesRead);
+   this->dWritePos += dBytesRead;
+
+   tx.driver  = dev;
+   tx.frame   = NULL;
+   tx.bDirect = true;
+
+   while(this->dWritePos > 0 &&
+         (iSize = TSpeedwire_GetDatagramSize(this->PktBuffer, this->dWritePos)) != 0)
+   {
+      if (iSize < 0)
+      {
+         /* garbage: skip one byte and search the next datagram */
+         iSize = 1;
+      }
+      else
+      {
+         if (!tx.frame)
+         {
+            tx.frame = TNetPacketManagement_GetPacket();
+            tx.frame->RouteInfo.BusDriverID = dev->DriverID;
+         }
+         TSpeedwire_OnPacket( this, &tx, dev, this->PktBuffer, (DWORD)iSize,
+                              this->RxDriverDeviceHandle );
+      }
+
+      memmove(this->PktBuffer, this->PktBuffer + iSize, this->dWritePos - iSize);
+      this->dWritePos -= iSize;
+      this->RxDriverDeviceHandle = DriverDeviceHandel;
+   }
+
+   if (tx.frame)
+   {
+      TSpeedwire_TxFlush( &tx );
+      TNetPacketManagement_FreeBuffer( tx.frame );
+   }
+}
@@ -0,0 +1,126 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ * 
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ * 
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+/**************************************************************************
+* Project       : YASDI
+***************************************************************************
+* Filename      : speedwire.h
+***************************************************************************
+* Description   : "Speedwire" protocol (SMA Data2+ over UDP)
+***************************************************************************
+* Preconditions : GNU-C-Compiler, GNU-Tools
+***************************************************************************/
+
+#ifndef SPEEDWIRE_H
+#define SPEEDWIRE_H
+
+/* Some consts */
+enum
+{
+   SPEEDWIRE_PORT          = 9522,   /* UDP port of Speedwire */
+   SPEEDWIRE_TAG_GROUP     = 0x02a0, /* tag: group of the sender */
+   SPEEDWIRE_TAG_DATA2     = 0x0010, /* tag: SMA Data2+ packet */
+   SPEEDWIRE_PROTID_DATA2  = 0x6065, /* protocol id in tag "SPEEDWIRE_TAG_DATA2" */
+   SPEEDWIRE_HEAD_SIZE     = 18,     /* "SMA\0", group tag, data2 tag + prot id */
+   SPEEDWIRE_DATA2_HEAD    = 24,     /* Data2+ head in front of the command */
+   SPEEDWIRE_APP_SUSYID    = 125,    /* our own SUSyID (application) */
+   SPEEDWIRE_USER_GROUP    = 7,      /* login as "user" */
+   SPEEDWIRE_LOGIN_TIMEOUT = 900,    /* seconds a login is valid */
+   SPEEDWIRE_PKT_DATA      = 200,    /* user data of one SMAData1 answer packet */
+   SPEEDWIRE_MAX_ANSWER    = 1024,   /* largest SMAData1 answer (channel list) */
+   SPEEDWIRE_GETNET_WINDOW = 10,     /* seconds devices answer a CMD_GET_NET */
+   SIZE_PKTBUFFER_SPEEDWIRE= 0x800,  /* internal RX buffer size */
+};
+
+/* the multicast group of the device discovery */
+#define SPEEDWIRE_MULTICAST_GROUP "239.12.255.254"
+
+/* SMA Data2+ commands */
+#define SPEEDWIRE_CMD_LOGIN       0xfffd040cUL
+#define SPEEDWIRE_CMD_LOGIN_REPLY 0xfffd040dUL
+
+
+struct TProtocol * TSpeedwire_constructor( void );
+void TSpeedwire_destructor(struct TProtocol * prot);
+
+void TSpeedwire_encapsulate(struct TProtocol * prot, struct TNetPacket * frame, WORD protid);
+void TSpeedwire_scan_input (struct TProtocol * prot, TDevice * dev, BYTE * Buffer, DWORD len, DWORD DriverDeviceHandel );
+
+DWORD TSpeedwire_GetMTU( void );
+
+
+/* spot values of a device */
+enum
+{
+   SPEEDWIRE_VAL_PAC,
+   SPEEDWIRE_VAL_UPV,
+   SPEEDWIRE_VAL_IPV,
+   SPEEDWIRE_VAL_UAC,
+   SPEEDWIRE_VAL_FAC,
+   SPEEDWIRE_VAL_ETOTAL,
+   SPEEDWIRE_VAL_ETODAY,
+   SPEEDWIRE_VAL_COUNT
+};
+
+/* one Speedwire device seen through this bus driver */
+typedef struct
+{
+   TMinNode Node;
+   DWORD DriverDeviceHandle;          /* ip address of the device */
+   WORD  SUSyID;                      /* SMA Data2+ address: SUSyID...    */
+   DWORD SerNr;                       /* ...and serial number              */
+   WORD  NetAddr;                     /* SMAData1 address given by the master */
+   char  Type[9];                     /* device type (from the type label) */
+   BOOL  bLoggedIn;
+   DWORD Values[SPEEDWIRE_VAL_COUNT];
+
+   /* the SMAData1 request waiting for the answers of the device */
+   BYTE  ReqCmd;                      /* command (0 = nothing pending) */
+   BYTE  ReqPktCnt;
+   WORD  ReqSource;                   /* address of the master */
+   WORD  ReqChanMask;                 /* CMD_GET_DATA: requested channels */
+   BYTE  ReqChanIndex;
+   WORD  ReqPktId;                    /* packet id of the first query */
+   DWORD dReqQueries;                 /* bit mask of the unanswered queries */
+
+   /* the last answer, follow up packets are cut out of it */
+   BYTE  Answer[SPEEDWIRE_MAX_ANSWER];
+   DWORD AnswerSize;
+   BYTE  AnswerCmd;
+} TSpeedwireDevice;
+
+
+struct TSpeedwirePriv
+{
+   BYTE  PktBuffer[SIZE_PKTBUFFER_SPEEDWIRE]; /* Empfangszwischenpuffer */
+   DWORD dWritePos;                          /* aktuelle Schreibposition im Puffer */
+   DWORD RxDriverDeviceHandle;               /* sender of the datagram in the buffer */
+   TMinList Devices;                         /* the known devices (TSpeedwireDevice) */
+   DWORD AppSerNr;                           /* our own serial number */
+   WORD  wPktId;                             /* next Data2+ packet id */
+   BYTE  GetNetCmd;                          /* running CMD_GET_NET(_START)... */
+   WORD  GetNetSource;                       /* ...of this master... */
+   WORD  GetNetPktId;                        /* ...with this login... */
+   DWORD dGetNetTime;                        /* ...since (seconds) */
+};
+
+
+#endif
@@ -80,6 +80,7 @@ struct TProtocol * TSunnyNet_Constructor( void )
 		newprot->GetMTU		    = TSunnyNet_GetMTU;
 		newprot->priv            = priv;
       newprot->TransportProtID = PROT_SUNNYNET;
+      newprot->bCacheFrames    = true;
 
 		priv->bWaitSync    = true;
 		priv->bPktHeaderOk =	false;
@@ -243,17 +244,31 @@ void TSunnyNet_ScanInput(struct TProtocol * prot,
    DWORD dCurPos;
    //int i;
    struct TSunnyNetHead * pHead;
-   struct TSunnyNetTail * pTail;
-   WORD CS;
+   WORD CS, TailCS;
    //YASDI_DEBUG((0,"sunnynet_scan_input()\n"));
 
    /* passen die Daten noch in den Eingabepuffer? */
    if ((dBytesRead + this->dWritePos) >= sizeof(this->PktBuffer))
    {
-   	/* �berlauf des Eingabepuffers! => alles l�schen */
-   	this->bWaitSync = true;
-   	this->dWritePos = 0;
-		//return true;
+      if (!this->bWaitSync && 
+          (dBytesRead + this->dWritePos - this->dSyncPos) < sizeof(this->PktBuffer))
+      {
+         /* 
+         ** Frames without a gap between them: the buffer is never emptied.
+         ** Keep the frame currently received, move it to the begin... 
+         */
+         memmove(this->PktBuffer, &this->PktBuffer[this->dSyncPos], 
+                 this->dWritePos - this->dSyncPos);
+         this->dWritePos -= this->dSyncPos;
+         this->dSyncPos = 0;
+      }
+      else
+      {
+         /* �berlauf des Eingabepuffers! => alles l�schen */
+         this->bWaitSync = true;
+         this->dWritePos = 0;
+         //return true;
+      }
    }
 
    if (dBytesRead == 0)	return ; //false;
@@ -326,13 +341,14 @@ void TSunnyNet_ScanInput(struct TProtocol * prot,
                   // *****************************
                   //	Paketende erkannt: Auswertung
                   // *****************************
-                  pTail = (struct TSunnyNetTail*) &this->PktBuffer[dCurPos-2];
+                  //the tail (CS) is not aligned in the buffer
+                  os_memcpy(&TailCS, &this->PktBuffer[dCurPos-2], sizeof(TailCS));
                   pHead = (struct TSunnyNetHead*) &this->PktBuffer[this->dSyncPos];
 
                   //	Pruefsumme bilden und ueberpruefen
                   //YASDI_DEBUG((0," Pruefsumme von pos =%ld zeichen = %d\n",this->dSyncPos + CS_START, (WORD)(this->PktBytesExpected-7)));
                   CS = TSunnyNet_CS(0, (BYTE*)&this->PktBuffer[this->dSyncPos + CS_START],(WORD)(this->PktBytesExpected-7));
-                  if ( CS  == pTail->CS )
+                  if ( CS  == TailCS )
                   {
                   	/*
                   	** Frame ist in Ordnung !
@@ -353,7 +369,7 @@ void TSunnyNet_ScanInput(struct TProtocol * prot,
                   }
                   else
                   {
-                     //YASDI_DEBUG((VERBOSE_BUGFINDER,  TXT_BOLD TXT_RED "sunnynet_scan_input: falsche Checksumme! ist=0x%4x soll=0x%4x\n" TXT_NORM,CS, pTail->CS));
+                     //YASDI_DEBUG((VERBOSE_BUGFINDER,  TXT_BOLD TXT_RED "sunnynet_scan_input: falsche Checksumme! ist=0x%4x soll=0x%4x\n" TXT_NORM,CS, TailCS));
                   }
                   // warte auf neues Sync-Zeichen
                   this->bWaitSync = true;
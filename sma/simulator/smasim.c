@@ -0,0 +1,1542 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+/**************************************************************************
+*         SMA Technologie AG, 34266 Niestetal, Germany
+***************************************************************************
+* Project       : yasdi
+***************************************************************************
+* Project-no.   :
+***************************************************************************
+* Filename      : smasim.c
+***************************************************************************
+* Description   : Virtual SMAData1 devices behind a pseudo terminal.
+*
+*                 The simulator opens a pty pair and plays one or more
+*                 devices on the "bus" behind the slave side. Point the
+*                 serial driver (COMx.Device) to the slave (or to the
+*                 symbolic link created with "-l") and YASDI can detect,
+*                 identify, read and write the simulated devices like
+*                 real ones.
+*
+*                 Both transport protocols are spoken (SMANet and
+*                 SunnyNet), the framing mirrors protocol/smanet.c and
+*                 protocol/sunnynet.c. Answered commands are
+*                 CMD_GET_NET(_START), CMD_CFG_NETADR, CMD_GET_CINFO,
+*                 CMD_SYN_ONLINE, CMD_GET_DATA and CMD_SET_DATA, long
+*                 answers are split into follow up packets.
+*
+*                 Timing of the bus is modelled: the airtime of request
+*                 and answer at the configured baud rate, the reply
+*                 delay of each device and a packet loss rate.
+*
+*                 Usage: smasim [-c smasim.ini] [-l link] [-t port] 
+*                               [-w port] [-v]
+*
+*                 With "-t" the bus is served on a TCP port instead of 
+*                 the pty, like a serial server (RS485 to Ethernet) for
+*                 the TCP driver. A new connection replaces the old one.
+*
+*                 With "-w" the devices are Speedwire devices (SMA Data2+
+*                 on an UDP port) for the IP driver in Speedwire mode: 
+*                 discovery, login and the spot value queries are 
+*                 answered (see protocol/speedwire.c).
+*
+*                 Without a configuration file one built in device is
+*                 simulated. See "smasim.ini" for the file format.
+***************************************************************************
+* Preconditions : POSIX system with pseudo terminals (Unix98)
+***************************************************************************
+* Changes       : Author, Date, Version, Reason
+*                 *********************************************************
+**************************************************************************/
+
+#define _GNU_SOURCE   /* posix_openpt(), ptsname(), cfmakeraw() */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "os.h"
+#include "smadef.h"
+#include "chandef.h"
+#include "byteorder.h"
+#include "getini.h"
+#include "device.h"
+#include "smanet.h"
+#include "smadata_layer.h"
+#include "smadata_cmd.h"
+#include "speedwire.h"
+
+
+/**************************************************************************
+********** D E F I N E S **************************************************
+**************************************************************************/
+
+#define SIM_MAX_DEVICES       16
+#define SIM_MAX_CHANNELS      128
+#define SIM_MAX_STATTEXT      256
+#define SIM_MAX_ANSWER        8192     /* largest answer (channel list) */
+#define SIM_RX_BUFFER         1024     /* raw frame buffer per protocol */
+#define SIM_DEF_PKTSIZE       200      /* user data bytes per SMAData1 packet */
+#define SIM_SECTION           "Simulator"
+#define SIM_SPEEDWIRE_SUSYID  131      /* SUSyID of the Speedwire devices */
+
+#define SUNNYNET_START        0x68
+#define SUNNYNET_STOP         0x16
+
+/* transport protocols a device speaks */
+enum
+{
+   SIMPROT_SMANET   = 1,
+   SIMPROT_SUNNYNET = 2,
+   SIMPROT_BOTH     = SIMPROT_SMANET | SIMPROT_SUNNYNET
+};
+
+/* one channel of a simulated device */
+typedef struct
+{
+   BYTE  No;                        /* channel index */
+   WORD  CType;                     /* channel type (see chandef.h) */
+   WORD  NType;                     /* data format  (see chandef.h) */
+   WORD  Level;                     /* access level */
+   char  Name[17];
+   char  Unit[9];
+   float Gain;
+   float Offset;
+   char  Texts[SIM_MAX_STATTEXT];   /* digital/status texts, '\0' separated */
+   WORD  TextsSize;
+   double Value;                    /* current raw value */
+} TSimChannel;
+
+/* one simulated device */
+typedef struct
+{
+   char  Type[9];
+   DWORD SerNr;
+   WORD  NetAddr;
+   int   Protocols;                 /* SIMPROT_xxx */
+   int   ReplyDelay;                /* ms between request and answer */
+   TSimChannel Channels[SIM_MAX_CHANNELS];
+   int   ChannelCount;
+
+   /* the last answer, follow up packets are cut out of it */
+   BYTE  Answer[SIM_MAX_ANSWER];
+   DWORD AnswerSize;
+   BYTE  AnswerCmd;
+   WORD  AnswerDest;
+
+   BOOL  bLoggedIn;                 /* Speedwire: login done */
+} TSimDevice;
+
+/* the receive state of one transport protocol */
+typedef struct
+{
+   BYTE  Buffer[SIM_RX_BUFFER];
+   DWORD dWritePos;
+   BOOL  bEsc;                      /* SMANet: escape char received */
+   WORD  FCS;                       /* SMANet: running checksum */
+} TSimRx;
+
+
+/**************************************************************************
+********** L O C A L E ****************************************************
+**************************************************************************/
+
+static TSimDevice Devices[SIM_MAX_DEVICES];
+static int   DeviceCount  = 0;
+static int   Baudrate     = 1200;   /* 0 => follow the termios speed of the pty */
+static int   PacketLoss   = 0;      /* percent of lost answers */
+static int   MaxPktSize   = SIM_DEF_PKTSIZE;
+static BOOL  bVerbose     = FALSE;
+static BOOL  bRunning     = TRUE;
+static int   MasterFd     = -1;
+static int   SlaveFd      = -1;
+static int   ListenFd     = -1;     /* TCP mode ("-t"): server socket */
+static int   UdpFd        = -1;     /* Speedwire mode ("-w"): UDP socket */
+static char  SimPassword[13] = "0000"; /* Speedwire: password of the login */
+static TSimRx RxSMANet;
+static TSimRx RxSunnyNet;
+
+/* SMANet characters to escape, like in "smanet.c" (default ACCM) */
+static const DWORD SimAccm = 0x000E0000L;
+
+
+/**************************************************************************
+   Description   : Logging (only with "-v")
+   Parameter     : printf alike
+   Return-Value  : ---
+**************************************************************************/
+static void SimLog(char * fmt, ...)
+{
+   va_list args;
+   if (!bVerbose) return;
+   va_start(args, fmt);
+   vprintf(fmt, args);
+   va_end(args);
+   fflush(stdout);
+}
+
+/**************************************************************************
+   Description   : Terminates the main loop on SIGINT/SIGTERM
+**************************************************************************/
+static void SimOnSignal(int sig)
+{
+   UNUSED_VAR ( sig );
+   bRunning = FALSE;
+}
+
+
+/**************************************************************************
+********** C O N F I G U R A T I O N **************************************
+**************************************************************************/
+
+/**************************************************************************
+   Description   : Removes leading and trailing blanks
+   Parameter     : s = string (modified)
+   Return-Value  : trimmed string
+**************************************************************************/
+static char * SimTrim(char * s)
+{
+   char * end;
+   while (*s && isspace((unsigned char)*s)) s++;
+   end = s + strlen(s);
+   while (end > s && isspace((unsigned char)end[-1])) *--end = 0;
+   return s;
+}
+
+/**************************************************************************
+   Description   : Stores digital or status texts ("Text1|Text2|...") in
+                   the channel list format ('\0' separated)
+   Parameter     : chan = channel
+                   texts = texts separated by '|'
+   Return-Value  : ---
+**************************************************************************/
+static void SimSetTexts(TSimChannel * chan, char * texts)
+{
+   WORD pos = 0;
+   char * t;
+   char * next;
+
+   for (t = texts; t; t = next)
+   {
+      int len;
+      next = strchr(t, '|');
+      if (next) *next++ = 0;
+      t = SimTrim(t);
+      len = (int)strlen(t);
+
+      if ((chan->CType & CH_DIGITAL) && len > 15) len = 15;
+      if (pos + len + 1 > SIM_MAX_STATTEXT) break;
+      memcpy(&chan->Texts[pos], t, len);
+      chan->Texts[pos + len] = 0;
+      pos = (WORD)(pos + len + 1);
+   }
+   chan->TextsSize = pos;
+}
+
+/**************************************************************************
+   Description   : Adds a channel to a device. The description has the
+                   format of the "ChannelN" keys in the configuration file:
+
+                   No, CType, NType, Level, Name, Unit, Gain, Offset, Value, Texts
+
+                   The high byte of NType is the number of values (1 if
+                   not set). Parameter channels use Gain and Offset as
+                   value range (min, max) like the real devices do.
+   Parameter     : dev  = device
+                   desc = channel description (modified)
+   Return-Value  : 0 => ok, -1 => invalid description
+**************************************************************************/
+static int SimAddChannel(TSimDevice * dev, char * desc)
+{
+   char * field[10];
+   int fields = 0;
+   char * p = desc;
+   TSimChannel * chan;
+
+   if (dev->ChannelCount >= SIM_MAX_CHANNELS) return -1;
+
+   memset(field, 0, sizeof(field));
+   while (p && fields < 10)
+   {
+      field[fields++] = p;
+      p = (fields < 10) ? strchr(p, ',') : NULL;
+      if (p) *p++ = 0;
+   }
+   if (fields < 9) return -1;
+
+   chan = &dev->Channels[dev->ChannelCount];
+   memset(chan, 0, sizeof(*chan));
+   chan->No     = (BYTE)strtoul(SimTrim(field[0]), NULL, 0);
+   chan->CType  = (WORD)strtoul(SimTrim(field[1]), NULL, 0);
+   chan->NType  = (WORD)strtoul(SimTrim(field[2]), NULL, 0);
+   chan->Level  = (WORD)strtoul(SimTrim(field[3]), NULL, 0);
+   strncpy(chan->Name, SimTrim(field[4]), sizeof(chan->Name) - 1);
+   strncpy(chan->Unit, SimTrim(field[5]), sizeof(chan->Unit) - 1);
+   chan->Gain   = (float)atof(SimTrim(field[6]));
+   chan->Offset = (float)atof(SimTrim(field[7]));
+   chan->Value  = atof(SimTrim(field[8]));
+   if (field[9]) SimSetTexts(chan, field[9]);
+
+   /* the high byte of the data format is the number of values */
+   if ((chan->NType >> 8) == 0) chan->NType |= 0x0100;
+   if (!(chan->CType & CH_ALL)) return -1;
+
+   dev->ChannelCount++;
+   return 0;
+}
+
+/**************************************************************************
+   Description   : Creates the built in device used without a
+                   configuration file
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+static void SimCreateDefaultDevice(void)
+{
+   static const char * chans[] =
+   {
+      "1, 0x0901, 0x0101, 0x00, Upv-Ist,  V,   1,     0,    350",
+      "2, 0x0901, 0x0102, 0x00, Pac,      W,   1,     0,    1200",
+      "3, 0x0901, 0x0101, 0x00, Fac,      Hz,  0.01,  0,    5000",
+      "4, 0x0904, 0x0102, 0x00, E-Total,  kWh, 0.001, 0,    1234567",
+      "5, 0x0904, 0x0102, 0x00, h-Total,  h,   1,     0,    4711",
+      "6, 0x0908, 0x0100, 0x00, Status,   ,    0,     0,    1, Stop|Mpp|Netzueb|Fehler",
+      "7, 0x0401, 0x0101, 0x00, Vpv-Start,V,   150,   1000, 400",
+      "8, 0x0402, 0x0100, 0x00, Balancer, ,    0,     0,    1, Off|On",
+   };
+   TSimDevice * dev = &Devices[DeviceCount++];
+   unsigned i;
+
+   memset(dev, 0, sizeof(*dev));
+   strcpy(dev->Type, "SIM 2100");
+   dev->SerNr      = 2000000001UL;
+   dev->NetAddr    = 0;
+   dev->Protocols  = SIMPROT_BOTH;
+   dev->ReplyDelay = 30;
+   for (i = 0; i < sizeof(chans) / sizeof(chans[0]); i++)
+   {
+      char buf[128];
+      strcpy(buf, chans[i]);
+      SimAddChannel(dev, buf);
+   }
+}
+
+/**************************************************************************
+   Description   : Reads the configuration file
+   Parameter     : file = path of the configuration file
+                   link = gets the configured symbolic link name
+                   linkSize = size of "link"
+   Return-Value  : number of configured devices
+**************************************************************************/
+static int SimReadConfig(char * file, char * link, unsigned linkSize)
+{
+   char buf[256];
+   int defaultDelay;
+   int i;
+
+   Baudrate     = (int)GetPrivateProfileInt_(SIM_SECTION, "Baudrate",     1200, file);
+   PacketLoss   = (int)GetPrivateProfileInt_(SIM_SECTION, "PacketLoss",   0,    file);
+   MaxPktSize   = (int)GetPrivateProfileInt_(SIM_SECTION, "MaxPacketSize", SIM_DEF_PKTSIZE, file);
+   defaultDelay = (int)GetPrivateProfileInt_(SIM_SECTION, "ReplyDelay",   30,   file);
+   srand(GetPrivateProfileInt_(SIM_SECTION, "RandomSeed", 1, file));
+   if (MaxPktSize < 1 || MaxPktSize > 255) MaxPktSize = SIM_DEF_PKTSIZE;
+   if (!link[0]) GetPrivateProfileString_(SIM_SECTION, "Link", "", link, linkSize, file);
+   GetPrivateProfileString_(SIM_SECTION, "Password", "0000", SimPassword, sizeof(SimPassword), file);
+
+   for (i = 1; DeviceCount < SIM_MAX_DEVICES; i++)
+   {
+      char section[32];
+      char chanSection[64];
+      TSimDevice * dev;
+      int c;
+
+      sprintf(section, "Device%d", i);
+      if (!GetPrivateProfileCheck(section, "SerNr", file)) break;
+
+      dev = &Devices[DeviceCount];
+      memset(dev, 0, sizeof(*dev));
+      GetPrivateProfileString_(section, "Type", "SIM 2100", buf, sizeof(buf), file);
+      strncpy(dev->Type, buf, 8);
+      GetPrivateProfileString_(section, "SerNr", "0", buf, sizeof(buf), file);
+      dev->SerNr      = (DWORD)strtoul(buf, NULL, 0);
+      dev->NetAddr    = (WORD)GetPrivateProfileInt_(section, "NetAddr", 0, file);
+      dev->ReplyDelay = (int)GetPrivateProfileInt_(section, "ReplyDelay", defaultDelay, file);
+
+      GetPrivateProfileString_(section, "Protocol", "Both", buf, sizeof(buf), file);
+      if      (strcasecmp(buf, "SMANet")   == 0) dev->Protocols = SIMPROT_SMANET;
+      else if (strcasecmp(buf, "SunnyNet") == 0) dev->Protocols = SIMPROT_SUNNYNET;
+      else                                        dev->Protocols = SIMPROT_BOTH;
+
+      /* the channel list (may be shared by several devices) */
+      GetPrivateProfileString_(section, "Channels", section, chanSection, sizeof(chanSection), file);
+      for (c = 1; ; c++)
+      {
+         char key[32];
+         sprintf(key, "Channel%d", c);
+         GetPrivateProfileString_(chanSection, key, "", buf, sizeof(buf), file);
+         if (!buf[0]) break;
+         if (SimAddChannel(dev, buf) < 0)
+            fprintf(stderr, "smasim: [%s] %s is invalid, ignored.\n", chanSection, key);
+      }
+
+      DeviceCount++;
+   }
+
+   return DeviceCount;
+}
+
+
+/**************************************************************************
+********** B U S   T I M I N G ********************************************
+**************************************************************************/
+
+/**************************************************************************
+   Description   : Returns the baud rate the serial driver configured on
+                   the slave side of the pty
+   Parameter     : ---
+   Return-Value  : baud rate or 0 (unknown)
+**************************************************************************/
+static int SimGetTtyBaudrate(void)
+{
+   struct termios tio;
+
+   if (tcgetattr(SlaveFd, &tio) == 0)
+   {
+      switch (cfgetospeed(&tio))
+      {
+         case B1200:   return 1200;
+         case B2400:   return 2400;
+         case B4800:   return 4800;
+         case B9600:   return 9600;
+         case B19200:  return 19200;
+         case B38400:  return 38400;
+         case B57600:  return 57600;
+         case B115200: return 115200;
+         default:      break;
+      }
+   }
+   return 0;
+}
+
+/**************************************************************************
+   Description   : Returns the baud rate used for the airtime model
+   Parameter     : ---
+   Return-Value  : baud rate
+**************************************************************************/
+static int SimGetBaudrate(void)
+{
+   int tty;
+
+   if (Baudrate > 0) return Baudrate;
+
+   /* follow the speed the serial driver configured on the slave side */
+   tty = SimGetTtyBaudrate();
+   return tty ? tty : 1200;
+}
+
+/**************************************************************************
+   Description   : Sleeps some milliseconds
+**************************************************************************/
+static void SimSleep(DWORD ms)
+{
+   struct timespec ts;
+   ts.tv_sec  = ms / 1000;
+   ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+   while (nanosleep(&ts, &ts) < 0 && errno == EINTR && bRunning) {}
+}
+
+/**************************************************************************
+   Description   : Airtime of some bytes on the bus (8N1 => 10 bits each)
+   Parameter     : bytes = number of bytes
+   Return-Value  : time in ms
+**************************************************************************/
+static DWORD SimAirtime(DWORD bytes)
+{
+   return (bytes * 10 * 1000) / (DWORD)SimGetBaudrate();
+}
+
+/**************************************************************************
+   Description   : Writes a frame to the pty with the speed of the bus.
+                   The frame is written in slices of 10 ms airtime, so the
+                   receiver sees the bytes arrive like on a real line.
+   Parameter     : frame = raw frame
+                   size  = frame size
+   Return-Value  : ---
+**************************************************************************/
+static void SimWriteBus(BYTE * frame, DWORD size)
+{
+   DWORD slice = (DWORD)SimGetBaudrate() / 1000;   /* bytes per 10 ms */
+   DWORD pos = 0;
+
+   if (MasterFd < 0) return;   /* TCP mode: no client connected */
+   if (slice < 1) slice = 1;
+   while (pos < size && bRunning)
+   {
+      DWORD n = (size - pos) < slice ? (size - pos) : slice;
+      ssize_t res = write(MasterFd, frame + pos, n);
+      if (res < 0)
+      {
+         if (errno == EINTR || errno == EAGAIN) continue;
+         perror("smasim: write");
+         return;
+      }
+      pos += (DWORD)res;
+      SimSleep(SimAirtime((DWORD)res));
+   }
+}
+
+
+/**************************************************************************
+********** F R A M I N G **************************************************
+**************************************************************************/
+
+/**************************************************************************
+   Description   : Builds an SMANet (HDLC) frame around an SMAData1 packet
+                   (see TSMANet_encapsulate())
+   Parameter     : dst = destination buffer (2 * size + 16 bytes)
+                   pkt = SMAData1 packet
+                   size = packet size
+   Return-Value  : frame size
+**************************************************************************/
+static DWORD SimEncapsulateSMANet(BYTE * dst, BYTE * pkt, DWORD size)
+{
+   BYTE raw[SIM_RX_BUFFER];
+   DWORD rawSize = 0;
+   DWORD pos = 0;
+   DWORD i;
+   WORD fcs;
+
+   raw[rawSize++] = HDLC_ADR_BROADCAST;
+   raw[rawSize++] = 0x03;
+   hostToBe16(PROT_PPP_SMADATA1, &raw[rawSize]); rawSize += 2;
+   memcpy(&raw[rawSize], pkt, size);             rawSize += size;
+   fcs = (WORD)(TSMANet_CalcFCSRaw(0xffff, raw, (WORD)rawSize) ^ 0xffff);
+   hostToLe16(fcs, &raw[rawSize]);               rawSize += 2;
+
+   dst[pos++] = HDLC_SYNC;
+   for (i = 0; i < rawSize; i++)
+   {
+      BYTE c = raw[i];
+      if (c == HDLC_SYNC || c == HDLC_ESC || (c < 0x20 && (SimAccm & (1UL << c))))
+      {
+         dst[pos++] = HDLC_ESC;
+         dst[pos++] = (BYTE)(c ^ 0x20);
+      }
+      else
+      {
+         dst[pos++] = c;
+      }
+   }
+   dst[pos++] = HDLC_SYNC;
+   return pos;
+}
+
+/**************************************************************************
+   Description   : Builds an SunnyNet frame around an SMAData1 packet
+                   (see TSunnyNet_Encapsulate())
+   Parameter     : dst = destination buffer (size + 7 bytes)
+                   pkt = SMAData1 packet (7 bytes head + data)
+                   size = packet size
+   Return-Value  : frame size
+**************************************************************************/
+static DWORD SimEncapsulateSunnyNet(BYTE * dst, BYTE * pkt, DWORD size)
+{
+   WORD cs = 0;
+   DWORD i;
+
+   for (i = 0; i < size; i++) cs = (WORD)(cs + pkt[i]);
+
+   dst[0] = dst[3] = SUNNYNET_START;
+   dst[1] = dst[2] = (BYTE)(size - 7);
+   memcpy(&dst[4], pkt, size);
+   hostToLe16(cs, &dst[4 + size]);
+   dst[6 + size] = SUNNYNET_STOP;
+   return size + 7;
+}
+
+static void SimOnPacket(BYTE * pkt, DWORD size, int prot, DWORD rxBytes);
+
+/**************************************************************************
+   Description   : Scans received bytes for SMANet frames
+                   (see TSMANet_scan_input())
+   Parameter     : buf = received bytes
+                   size = number of bytes
+   Return-Value  : ---
+**************************************************************************/
+static void SimScanSMANet(BYTE * buf, DWORD size)
+{
+   TSimRx * rx = &RxSMANet;
+   DWORD i;
+
+   for (i = 0; i < size; i++)
+   {
+      BYTE c = buf[i];
+
+      if (c == HDLC_SYNC)
+      {
+         /* frame end: checksum ok and "SMAData1" protocol id? */
+         if (rx->FCS == 0xf0b8 && rx->dWritePos > 6 &&
+             rx->Buffer[0] == HDLC_ADR_BROADCAST && rx->Buffer[1] == 0x03 &&
+             be16ToHost(&rx->Buffer[2]) == PROT_PPP_SMADATA1)
+         {
+            SimOnPacket(&rx->Buffer[4], rx->dWritePos - 6, SIMPROT_SMANET,
+                        rx->dWritePos * 2);
+         }
+         rx->FCS = 0xffff;
+         rx->dWritePos = 0;
+         rx->bEsc = FALSE;
+         continue;
+      }
+      if (c == HDLC_ESC)
+      {
+         rx->bEsc = TRUE;
+         continue;
+      }
+      if (rx->bEsc)
+      {
+         c ^= 0x20;
+         rx->bEsc = FALSE;
+      }
+      rx->FCS = TSMANet_CalcFCSRaw(rx->FCS, &c, 1);
+      if (rx->dWritePos < sizeof(rx->Buffer))
+         rx->Buffer[rx->dWritePos++] = c;
+      else
+         rx->dWritePos = 0; /* overflow */
+   }
+}
+
+/**************************************************************************
+   Description   : Scans received bytes for SunnyNet frames
+                   (see TSunnyNet_ScanInput())
+   Parameter     : buf = received bytes
+                   size = number of bytes
+   Return-Value  : ---
+**************************************************************************/
+static void SimScanSunnyNet(BYTE * buf, DWORD size)
+{
+   TSimRx * rx = &RxSunnyNet;
+   DWORD i;
+
+   for (i = 0; i < size; i++)
+   {
+      DWORD expected;
+
+      /* wait for the start of a frame */
+      if (rx->dWritePos == 0 && buf[i] != SUNNYNET_START) continue;
+      rx->Buffer[rx->dWritePos++] = buf[i];
+
+      if (rx->dWritePos < 4) continue;
+      if (rx->Buffer[1] != rx->Buffer[2] || rx->Buffer[3] != SUNNYNET_START)
+      {
+         /* no valid head, resync behind the first start char */
+         DWORD n = rx->dWritePos - 1;
+         memmove(rx->Buffer, rx->Buffer + 1, n);
+         rx->dWritePos = 0;
+         SimScanSunnyNet(rx->Buffer, n);
+         continue;
+      }
+
+      /* head (4) + SMAData head (7) + data + tail (3) */
+      expected = 4 + 7 + rx->Buffer[1] + 3;
+      if (rx->dWritePos < expected) continue;
+
+      if (rx->Buffer[expected - 1] == SUNNYNET_STOP)
+      {
+         WORD cs = 0;
+         DWORD k;
+         for (k = 4; k < expected - 3; k++) cs = (WORD)(cs + rx->Buffer[k]);
+         if (cs == le16ToHost(&rx->Buffer[expected - 3]))
+            SimOnPacket(&rx->Buffer[4], expected - 7, SIMPROT_SUNNYNET, expected);
+      }
+      rx->dWritePos = 0;
+   }
+}
+
+
+/**************************************************************************
+********** D E V I C E S **************************************************
+**************************************************************************/
+
+/**************************************************************************
+   Description   : Sends an answer packet of a device
+   Parameter     : dev   = answering device
+                   dest  = destination address (the master)
+                   cmd   = command
+                   pktcnt = packet counter
+                   data  = user data of the packet
+                   size  = size of user data
+                   prot  = transport protocol (SIMPROT_xxx)
+   Return-Value  : ---
+**************************************************************************/
+static void SimSendAnswer(TSimDevice * dev, WORD dest, BYTE cmd, BYTE pktcnt,
+                          BYTE * data, DWORD size, int prot)
+{
+   BYTE pkt[7 + 255];
+   BYTE frame[2 * sizeof(pkt) + 16];
+   DWORD frameSize;
+
+   hostToLe16(dev->NetAddr, &pkt[0]);
+   hostToLe16(dest,         &pkt[2]);
+   pkt[4] = ctrlAck;
+   pkt[5] = pktcnt;
+   pkt[6] = cmd;
+   memcpy(&pkt[7], data, size);
+
+   if (prot == SIMPROT_SMANET)
+      frameSize = SimEncapsulateSMANet(frame, pkt, size + 7);
+   else
+      frameSize = SimEncapsulateSunnyNet(frame, pkt, size + 7);
+
+   /* the answer is lost on the bus? */
+   if (PacketLoss > 0 && (rand() % 100) < PacketLoss)
+   {
+      SimLog("   SN %lu: answer lost (cmd=%d, pktcnt=%d)\n",
+             (unsigned long)dev->SerNr, cmd, pktcnt);
+      return;
+   }
+
+   SimSleep((DWORD)dev->ReplyDelay);
+   SimLog("   SN %lu [0x%04x]: answer cmd=%d pktcnt=%d len=%lu (%s)\n",
+          (unsigned long)dev->SerNr, dev->NetAddr, cmd, pktcnt,
+          (unsigned long)size, prot == SIMPROT_SMANET ? "SMANet" : "SunnyNet");
+   SimWriteBus(frame, frameSize);
+}
+
+/**************************************************************************
+   Description   : Sends a (long) answer. Answers larger than the packet
+                   size are split, the first packet is sent now, the
+                   master requests the others (see fractionizer.c).
+   Parameter     : see SimSendAnswer()
+   Return-Value  : ---
+**************************************************************************/
+static void SimSendLongAnswer(TSimDevice * dev, WORD dest, BYTE cmd,
+                              BYTE * data, DWORD size, int prot)
+{
+   DWORD pkts = (size + MaxPktSize - 1) / MaxPktSize;
+   DWORD first = size < (DWORD)MaxPktSize ? size : (DWORD)MaxPktSize;
+
+   if (pkts == 0) pkts = 1;
+   if (pkts > 256) pkts = 256;
+
+   if (data != dev->Answer) memcpy(dev->Answer, data, size);
+   dev->AnswerSize = size;
+   dev->AnswerCmd  = cmd;
+   dev->AnswerDest = dest;
+
+   SimSendAnswer(dev, dest, cmd, (BYTE)(pkts - 1), dev->Answer, first, prot);
+}
+
+/**************************************************************************
+   Description   : Answers the request of a follow up packet
+   Parameter     : dev = device
+                   pktcnt = packet counter of the request
+                   prot = transport protocol
+   Return-Value  : ---
+**************************************************************************/
+static void SimSendFollowUp(TSimDevice * dev, BYTE cmd, BYTE pktcnt, int prot)
+{
+   DWORD pkts = (dev->AnswerSize + MaxPktSize - 1) / MaxPktSize;
+   DWORD offset;
+   DWORD size;
+
+   if (cmd != dev->AnswerCmd || pktcnt == 0 || pktcnt >= pkts) return;
+
+   /* request for counter "N" is answered with counter "N-1" */
+   offset = (pkts - pktcnt) * MaxPktSize;
+   size   = dev->AnswerSize - offset;
+   if (size > (DWORD)MaxPktSize) size = MaxPktSize;
+
+   SimSendAnswer(dev, dev->AnswerDest, cmd, (BYTE)(pktcnt - 1),
+                 dev->Answer + offset, size, prot);
+}
+
+/**************************************************************************
+   Description   : Builds the channel list (answer of CMD_GET_CINFO) in the
+                   format parsed by TPlant_ScanChanInfoBuf()
+   Parameter     : dev = device
+                   buf = destination (SIM_MAX_ANSWER bytes)
+   Return-Value  : size of the channel list
+**************************************************************************/
+static DWORD SimBuildChanInfo(TSimDevice * dev, BYTE * buf)
+{
+   DWORD pos = 0;
+   int i;
+
+   for (i = 0; i < dev->ChannelCount; i++)
+   {
+      TSimChannel * chan = &dev->Channels[i];
+
+      if (pos + 23 + 32 + chan->TextsSize + 2 > SIM_MAX_ANSWER) break;
+
+      buf[pos] = chan->No;
+      hostToLe16(chan->CType, &buf[pos + 1]);
+      hostToLe16(chan->NType, &buf[pos + 3]);
+      hostToLe16(chan->Level, &buf[pos + 5]);
+      memset(&buf[pos + 7], 0, 16);
+      memcpy(&buf[pos + 7], chan->Name, strlen(chan->Name));
+      pos += 23;
+
+      if (chan->CType & CH_ANALOG)
+      {
+         memset(&buf[pos], 0, 8);
+         memcpy(&buf[pos], chan->Unit, strlen(chan->Unit));
+         hostToLe32f(chan->Gain,   &buf[pos + 8]);
+         hostToLe32f(chan->Offset, &buf[pos + 12]);
+         pos += 16;
+      }
+      else if (chan->CType & CH_DIGITAL)
+      {
+         /* exactly two texts with 16 chars each */
+         char * hi = chan->Texts + strlen(chan->Texts) + 1;
+         memset(&buf[pos], 0, 32);
+         memcpy(&buf[pos], chan->Texts, strlen(chan->Texts));
+         if (hi < chan->Texts + chan->TextsSize)
+            memcpy(&buf[pos + 16], hi, strlen(hi));
+         pos += 32;
+      }
+      else if (chan->CType & CH_COUNTER)
+      {
+         memset(&buf[pos], 0, 8);
+         memcpy(&buf[pos], chan->Unit, strlen(chan->Unit));
+         hostToLe32f(chan->Gain, &buf[pos + 8]);
+         pos += 12;
+      }
+      else
+      {
+         hostToLe16(chan->TextsSize, &buf[pos]);
+         memcpy(&buf[pos + 2], chan->Texts, chan->TextsSize);
+         pos += 2 + chan->TextsSize;
+      }
+   }
+
+   return pos;
+}
+
+/**************************************************************************
+   Description   : Does a channel match the channel mask and index of a
+                   request? (same rules as TNewChanListFilter_CheckChannel())
+**************************************************************************/
+static BOOL SimChannelMatch(TSimChannel * chan, WORD mask, BYTE index)
+{
+   WORD mask1 = CH_PARA | CH_SPOT | CH_MEAN;
+
+   if (mask == 0xffff) return TRUE;
+   return ((chan->CType & CH_TEST) == (mask & CH_TEST)) &&
+          ((chan->CType & mask1)  & (mask & mask1)) &&
+          ((chan->CType & CH_ALL) & (mask & CH_ALL)) &&
+          (index == 0 || chan->No == index);
+}
+
+/**************************************************************************
+   Description   : Size of one channel value in bytes
+**************************************************************************/
+static DWORD SimValueSize(TSimChannel * chan)
+{
+   switch (chan->NType & CH_FORM & ~CH_ARRAY)
+   {
+      case CH_WORD:   return 2;
+      case CH_DWORD:
+      case CH_FLOAT4: return 4;
+      default:        return 1;
+   }
+}
+
+/**************************************************************************
+   Description   : Number of values of a channel (value arrays)
+**************************************************************************/
+static DWORD SimValueCount(TSimChannel * chan)
+{
+   return chan->NType >> 8;
+}
+
+/**************************************************************************
+   Description   : Builds the answer of CMD_GET_DATA
+                   (parsed by TStateChanReader_ScanUpdateValue())
+   Parameter     : dev = device
+                   mask, index = requested channels
+                   buf = destination (SIM_MAX_ANSWER bytes)
+   Return-Value  : size of the answer
+**************************************************************************/
+static DWORD SimBuildData(TSimDevice * dev, WORD mask, BYTE index, BYTE * buf)
+{
+   DWORD pos = 0;
+   int i;
+
+   hostToLe16(mask, &buf[pos]); pos += 2;
+   buf[pos++] = index;
+   hostToLe16(1, &buf[pos]);    pos += 2;   /* one data set */
+
+   /* spot values: time and time base */
+   if (mask & CH_SPOT)
+   {
+      hostToLe32((DWORD)time(NULL), &buf[pos]); pos += 4;
+      hostToLe32(1,                 &buf[pos]); pos += 4;
+   }
+
+   for (i = 0; i < dev->ChannelCount; i++)
+   {
+      TSimChannel * chan = &dev->Channels[i];
+      DWORD v;
+
+      if (!SimChannelMatch(chan, mask, index)) continue;
+
+      /* arrays: every element holds the channel value */
+      for (v = 0; v < SimValueCount(chan) && pos + 4 <= SIM_MAX_ANSWER; v++)
+      {
+         switch (chan->NType & CH_FORM & ~CH_ARRAY)
+         {
+            case CH_WORD:   hostToLe16 ((WORD)chan->Value,  &buf[pos]); break;
+            case CH_DWORD:  hostToLe32 ((DWORD)chan->Value, &buf[pos]); break;
+            case CH_FLOAT4: hostToLe32f((float)chan->Value, &buf[pos]); break;
+            default:        buf[pos] = (BYTE)chan->Value;                break;
+         }
+         pos += SimValueSize(chan);
+      }
+   }
+
+   return pos;
+}
+
+/**************************************************************************
+   Description   : Sets a channel value (CMD_SET_DATA)
+   Parameter     : dev = device
+                   data, size = user data of the request
+   Return-Value  : TRUE if a channel was written
+**************************************************************************/
+static BOOL SimSetData(TSimDevice * dev, BYTE * data, DWORD size)
+{
+   WORD mask;
+   BYTE index;
+   int i;
+
+   if (size < 6) return FALSE;
+   mask  = le16ToHost(&data[0]);
+   index = data[2];
+
+   for (i = 0; i < dev->ChannelCount; i++)
+   {
+      TSimChannel * chan = &dev->Channels[i];
+      if (chan->No != index || !SimChannelMatch(chan, mask, index)) continue;
+      if (size < 5 + SimValueSize(chan)) return FALSE;
+
+      switch (chan->NType & CH_FORM & ~CH_ARRAY)
+      {
+         case CH_WORD:   chan->Value = le16ToHost(&data[5]);  break;
+         case CH_DWORD:  chan->Value = le32ToHost(&data[5]);  break;
+         case CH_FLOAT4: chan->Value = le32fToHost(&data[5]); break;
+         default:        chan->Value = data[5];                break;
+      }
+      SimLog("   SN %lu: '%s' set to %g\n",
+             (unsigned long)dev->SerNr, chan->Name, chan->Value);
+      return TRUE;
+   }
+   return FALSE;
+}
+
+/**************************************************************************
+   Description   : A valid SMAData1 packet was received from the master.
+                   Let all addressed devices answer.
+   Parameter     : pkt  = SMAData1 packet (7 bytes head + data)
+                   size = packet size
+                   prot = transport protocol the packet was received with
+                   rxBytes = size of the frame on the bus
+   Return-Value  : ---
+**************************************************************************/
+static void SimOnPacket(BYTE * pkt, DWORD size, int prot, DWORD rxBytes)
+{
+   WORD src   = le16ToHost(&pkt[0]);
+   WORD dst   = le16ToHost(&pkt[2]);
+   BYTE ctrl  = pkt[4];
+   BYTE pktcnt= pkt[5];
+   BYTE cmd   = pkt[6];
+   BYTE * data = pkt + 7;
+   DWORD dataSize = size - 7;
+   BOOL bBroadcast = (ctrl & ctrlGroup) ? TRUE : FALSE;
+   BYTE answer[SIM_MAX_ANSWER];
+   int i;
+
+   /* answers of other devices are not for us */
+   if (ctrl & ctrlAck) return;
+
+   SimLog("<- %s cmd=%d src=0x%04x dst=0x%04x pktcnt=%d len=%lu\n",
+          prot == SIMPROT_SMANET ? "SMANet" : "SunnyNet",
+          cmd, src, dst, pktcnt, (unsigned long)dataSize);
+
+   /* the request itself needs its airtime before anyone can answer */
+   SimSleep(SimAirtime(rxBytes));
+
+   for (i = 0; i < DeviceCount && bRunning; i++)
+   {
+      TSimDevice * dev = &Devices[i];
+
+      if (!(dev->Protocols & prot)) continue;
+      if (!bBroadcast && dst != dev->NetAddr) continue;
+
+      /* request of a follow up packet */
+      if (!bBroadcast && pktcnt > 0 && dataSize == 0)
+      {
+         SimSendFollowUp(dev, cmd, pktcnt, prot);
+         continue;
+      }
+
+      switch (cmd)
+      {
+         case CMD_GET_NET:
+         case CMD_GET_NET_START:
+            hostToLe32(dev->SerNr, &answer[0]);
+            memset(&answer[4], 0, 8);
+            memcpy(&answer[4], dev->Type, strlen(dev->Type));
+            SimSendAnswer(dev, src, cmd, 0, answer, 12, prot);
+            break;
+
+         case CMD_CFG_NETADR:
+            if (dataSize >= 6 && le32ToHost(&data[0]) == dev->SerNr)
+            {
+               dev->NetAddr = le16ToHost(&data[4]);
+               hostToLe32(dev->SerNr, &answer[0]);
+               SimSendAnswer(dev, src, cmd, 0, answer, 4, prot);
+            }
+            break;
+
+         case CMD_GET_CINFO:
+            SimSendLongAnswer(dev, src, cmd, answer,
+                              SimBuildChanInfo(dev, answer), prot);
+            break;
+
+         case CMD_SYN_ONLINE:
+            /* no answer, the devices just freeze their spot values */
+            break;
+
+         case CMD_GET_DATA:
+            if (dataSize >= 3)
+               SimSendLongAnswer(dev, src, cmd, answer,
+                                 SimBuildData(dev, le16ToHost(&data[0]), data[2], answer),
+                                 prot);
+            break;
+
+         case CMD_SET_DATA:
+            if (SimSetData(dev, data, dataSize))
+               SimSendAnswer(dev, src, cmd, 0, data, dataSize, prot);
+            break;
+
+         default:
+            SimLog("   command %d is not simulated\n", cmd);
+            break;
+      }
+   }
+}
+
+
+/**************************************************************************
+********** S P E E D W I R E **********************************************
+**************************************************************************/
+
+/* the spot values a Speedwire device reports: channel name, value id
+   (LRI) and the factor of the Data2+ value to the physical value */
+static const struct
+{
+   char * Name;
+   DWORD Lri;
+   double Scale;
+} SimSpeedwireValues[] =
+{
+   { "Pac",     0x00263f00UL, 1    },
+   { "Upv-Ist", 0x00451f00UL, 100  },
+   { "Ipv",     0x00452100UL, 1000 },
+   { "Uac",     0x00464800UL, 100  },
+   { "Fac",     0x00465700UL, 100  },
+   { "E-Total", 0x00260100UL, 1000 },
+   { "E-Today", 0x00262200UL, 1000 },
+};
+
+/**************************************************************************
+   Description   : Opens the Speedwire UDP socket (instead of the pty)
+   Parameter     : port = UDP port
+   Return-Value  : 0 => ok, -1 => error
+**************************************************************************/
+static int SimOpenSpeedwire(int port)
+{
+   struct sockaddr_in addr;
+   int on = 1;
+
+   UdpFd = socket(AF_INET, SOCK_DGRAM, 0);
+   if (UdpFd < 0)
+   {
+      perror("smasim: socket");
+      return -1;
+   }
+   setsockopt(UdpFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_ANY);
+   addr.sin_port        = htons((unsigned short)port);
+   if (bind(UdpFd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+   {
+      perror("smasim: bind");
+      return -1;
+   }
+
+   /* the discovery group (not reachable in every network, try it) */
+   {
+      struct ip_mreq mreq;
+      mreq.imr_multiaddr.s_addr = inet_addr(SPEEDWIRE_MULTICAST_GROUP);
+      mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+      setsockopt(UdpFd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+   }
+
+   printf("smasim: %d Speedwire device(s) on UDP port %d\n", DeviceCount, port);
+   fflush(stdout);
+   return 0;
+}
+
+/**************************************************************************
+   Description   : Sends a Speedwire reply of a device
+   Parameter     : dev = answering device
+                   to = the requester
+                   req = Data2+ part of the request
+                   error = error code
+                   records, size = the records of the reply
+   Return-Value  : ---
+**************************************************************************/
+static void SimSendSpeedwire(TSimDevice * dev, struct sockaddr_in * to,
+                             BYTE * req, WORD error, BYTE * records, DWORD size)
+{
+   BYTE pkt[SPEEDWIRE_HEAD_SIZE + SPEEDWIRE_DATA2_HEAD + 12 + SIM_MAX_ANSWER];
+   BYTE * data2 = pkt + SPEEDWIRE_HEAD_SIZE;
+   DWORD data2size = SPEEDWIRE_DATA2_HEAD + 12 + size;
+
+   if (data2size + SPEEDWIRE_HEAD_SIZE + 4 > sizeof(pkt)) return;
+
+   memcpy(pkt, "SMA\0\x00\x04\x02\xa0\x00\x00\x00\x01", 12);
+   hostToBe16((WORD)(data2size + 2),   &pkt[12]);
+   hostToBe16(SPEEDWIRE_TAG_DATA2,     &pkt[14]);
+   hostToBe16(SPEEDWIRE_PROTID_DATA2,  &pkt[16]);
+
+   data2[0] = (BYTE)(data2size / 4);
+   data2[1] = 0xe0;
+   memcpy(&data2[2], &req[10], 6);                    /* to the requester */
+   memcpy(&data2[8], &req[8], 2);                     /* ctrl2 */
+   hostToLe16(SIM_SPEEDWIRE_SUSYID, &data2[10]);
+   hostToLe32(dev->SerNr,           &data2[12]);
+   memcpy(&data2[16], &req[16], 2);
+   hostToLe16(error,                &data2[18]);
+   hostToLe16(0,                    &data2[20]);
+   memcpy(&data2[22], &req[22], 2);                   /* packet id */
+   hostToLe32(le32ToHost(&req[24]) | 1, &data2[24]);  /* command of the reply */
+   memcpy(&data2[28], &req[28], 8);                   /* first and last LRI */
+   if (size) memcpy(&data2[36], records, size);
+   memset(&data2[data2size], 0, 4);
+
+   if (PacketLoss > 0 && (rand() % 100) < PacketLoss)
+   {
+      SimLog("   SN %lu: Speedwire reply lost\n", (unsigned long)dev->SerNr);
+      return;
+   }
+
+   SimSleep((DWORD)dev->ReplyDelay);
+   SimLog("   SN %lu: Speedwire reply cmd=0x%08lx error=0x%x len=%lu\n",
+          (unsigned long)dev->SerNr, (unsigned long)le32ToHost(&data2[24]),
+          error, (unsigned long)size);
+   sendto(UdpFd, pkt, SPEEDWIRE_HEAD_SIZE + data2size + 4, 0,
+          (struct sockaddr *)to, sizeof(*to));
+}
+
+/**************************************************************************
+   Description   : Builds the records of a query
+   Parameter     : dev = device
+                   cmd = command of the query
+                   first, last = range of the value ids
+                   buf = destination (SIM_MAX_ANSWER bytes)
+   Return-Value  : size of the records
+**************************************************************************/
+static DWORD SimBuildSpeedwireRecords(TSimDevice * dev, DWORD cmd,
+                                      DWORD first, DWORD last, BYTE * buf)
+{
+   DWORD pos = 0;
+   DWORD now = (DWORD)time(NULL);
+   unsigned i;
+   int c;
+
+   /* type label: the device name */
+   if ((cmd >> 24) == 0x58)
+   {
+      if (first <= 0x00821e00UL && last >= 0x00821e00UL)
+      {
+         memset(buf, 0, 40);
+         hostToLe32(0x10821e01UL, &buf[0]);
+         hostToLe32(now,          &buf[4]);
+         memcpy(&buf[8], dev->Type, strlen(dev->Type));
+         pos = 40;
+      }
+      return pos;
+   }
+
+   for (i = 0; i < sizeof(SimSpeedwireValues) / sizeof(SimSpeedwireValues[0]); i++)
+   {
+      DWORD lri = SimSpeedwireValues[i].Lri;
+      DWORD value;
+
+      if (lri < first || lri > last) continue;
+      for (c = 0; c < dev->ChannelCount; c++)
+         if (strcmp(dev->Channels[c].Name, SimSpeedwireValues[i].Name) == 0) break;
+      if (c == dev->ChannelCount) continue;
+
+      value = (DWORD)((dev->Channels[c].Value * dev->Channels[c].Gain + 
+                       dev->Channels[c].Offset) * SimSpeedwireValues[i].Scale + 0.5);
+
+      if ((cmd >> 24) == 0x54)
+      {
+         /* counter: 64 bit value */
+         hostToLe32(lri | 0x01,  &buf[pos]);
+         hostToLe32(now,         &buf[pos + 4]);
+         hostToLe32(value,       &buf[pos + 8]);
+         hostToLe32(0,           &buf[pos + 12]);
+         pos += 16;
+      }
+      else
+      {
+         /* spot value: value, min, max... */
+         hostToLe32(0x40000000UL | lri | 0x01, &buf[pos]);
+         hostToLe32(now,         &buf[pos + 4]);
+         hostToLe32(value,       &buf[pos + 8]);
+         hostToLe32(value,       &buf[pos + 12]);
+         hostToLe32(value,       &buf[pos + 16]);
+         hostToLe32(value,       &buf[pos + 20]);
+         hostToLe32(1,           &buf[pos + 24]);
+         pos += 28;
+      }
+   }
+   return pos;
+}
+
+/**************************************************************************
+   Description   : A Speedwire datagram was received: answer the 
+                   discovery, the login and the queries
+   Parameter     : pkt, size = the datagram
+                   from = sender
+   Return-Value  : ---
+**************************************************************************/
+static void SimOnSpeedwire(BYTE * pkt, DWORD size, struct sockaddr_in * from)
+{
+   BYTE * data2 = pkt + SPEEDWIRE_HEAD_SIZE;
+   BYTE records[SIM_MAX_ANSWER];
+   WORD dstSUSyID;
+   DWORD dstSerNr, cmd;
+   int i;
+
+   if (size < 12 || memcmp(pkt, "SMA\0", 4) != 0) return;
+
+   /* discovery: answer with the own ip address (tag 0x0030) */
+   if (be32ToHost(&pkt[8]) == 0xffffffffUL)
+   {
+      static const BYTE answer[] = { 'S', 'M', 'A', 0,
+                                     0x00, 0x04, 0x02, 0xa0, 0x00, 0x00, 0x00, 0x01,
+                                     0x00, 0x04, 0x00, 0x30, 0x7f, 0x00, 0x00, 0x01,
+                                     0x00, 0x00, 0x00, 0x00 };
+      SimLog("<- Speedwire discovery\n");
+      sendto(UdpFd, answer, sizeof(answer), 0, (struct sockaddr *)from, sizeof(*from));
+      return;
+   }
+
+   if (size < SPEEDWIRE_HEAD_SIZE + SPEEDWIRE_DATA2_HEAD + 4 ||
+       be16ToHost(&pkt[14]) != SPEEDWIRE_TAG_DATA2 ||
+       be16ToHost(&pkt[16]) != SPEEDWIRE_PROTID_DATA2) return;
+
+   dstSUSyID = le16ToHost(&data2[2]);
+   dstSerNr  = le32ToHost(&data2[4]);
+   cmd       = le32ToHost(&data2[24]);
+   SimLog("<- Speedwire cmd=0x%08lx to %u/%lu\n", (unsigned long)cmd, 
+          dstSUSyID, (unsigned long)dstSerNr);
+
+   for (i = 0; i < DeviceCount && bRunning; i++)
+   {
+      TSimDevice * dev = &Devices[i];
+
+      if (dstSerNr != 0xffffffffUL && dstSerNr != dev->SerNr) continue;
+
+      if (cmd == SPEEDWIRE_CMD_LOGIN)
+      {
+         char pw[13];
+         int k;
+
+         if (size < SPEEDWIRE_HEAD_SIZE + SPEEDWIRE_DATA2_HEAD + 4 + 28) return;
+         for (k = 0; k < 12; k++) pw[k] = (char)(data2[44 + k] - 0x88);
+         pw[12] = 0;
+         dev->bLoggedIn = (strcmp(pw, SimPassword) == 0);
+         SimSendSpeedwire(dev, from, data2, dev->bLoggedIn ? 0 : 0x0100, NULL, 0);
+      }
+      else if (size >= SPEEDWIRE_HEAD_SIZE + SPEEDWIRE_DATA2_HEAD + 12)
+      {
+         /* queries need a login */
+         if (!dev->bLoggedIn)
+            SimSendSpeedwire(dev, from, data2, 0x0017, NULL, 0);
+         else
+            SimSendSpeedwire(dev, from, data2, 0, records,
+                             SimBuildSpeedwireRecords(dev, cmd,
+                                                      le32ToHost(&data2[28]),
+                                                      le32ToHost(&data2[32]),
+                                                      records));
+      }
+   }
+}
+
+
+/**************************************************************************
+********** M A I N ********************************************************
+**************************************************************************/
+
+/**************************************************************************
+   Description   : Opens the pseudo terminal pair
+   Parameter     : link = optional symbolic link to the slave side
+   Return-Value  : 0 => ok, -1 => error
+**************************************************************************/
+static int SimOpenPty(char * link)
+{
+   struct termios tio;
+   char * slaveName;
+
+   MasterFd = posix_openpt(O_RDWR | O_NOCTTY);
+   if (MasterFd < 0 || grantpt(MasterFd) < 0 || unlockpt(MasterFd) < 0)
+   {
+      perror("smasim: posix_openpt");
+      return -1;
+   }
+   slaveName = ptsname(MasterFd);
+   if (!slaveName) return -1;
+
+   /* Keep the slave open, so the master side does not hang up while the
+      serial driver closes and reopens the port. The line is raw, no echo. */
+   SlaveFd = open(slaveName, O_RDWR | O_NOCTTY);
+   if (SlaveFd < 0 || tcgetattr(SlaveFd, &tio) < 0)
+   {
+      perror("smasim: open slave");
+      return -1;
+   }
+   cfmakeraw(&tio);
+   tcsetattr(SlaveFd, TCSANOW, &tio);
+
+   if (link && link[0])
+   {
+      unlink(link);
+      if (symlink(slaveName, link) < 0)
+         perror("smasim: symlink");
+   }
+
+   printf("smasim: %d device(s) on %s%s%s\n", DeviceCount, slaveName,
+          (link && link[0]) ? " => " : "", (link && link[0]) ? link : "");
+   fflush(stdout);
+   return 0;
+}
+
+/**************************************************************************
+   Description   : Opens the TCP server socket (instead of the pty)
+   Parameter     : port = TCP port
+   Return-Value  : 0 => ok, -1 => error
+**************************************************************************/
+static int SimOpenTcp(int port)
+{
+   struct sockaddr_in addr;
+   int on = 1;
+
+   ListenFd = socket(AF_INET, SOCK_STREAM, 0);
+   if (ListenFd < 0)
+   {
+      perror("smasim: socket");
+      return -1;
+   }
+   setsockopt(ListenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_ANY);
+   addr.sin_port        = htons((unsigned short)port);
+   if (bind(ListenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+       listen(ListenFd, 1) < 0)
+   {
+      perror("smasim: bind");
+      return -1;
+   }
+
+   printf("smasim: %d device(s) on TCP port %d\n", DeviceCount, port);
+   fflush(stdout);
+   return 0;
+}
+
+/**************************************************************************
+   Description   : TCP mode: accepts a new client. The old connection is 
+                   closed (a reconnecting driver replaces it).
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+static void SimAcceptTcp(void)
+{
+   int on = 1;
+   int fd = accept(ListenFd, NULL, NULL);
+
+   if (fd < 0) return;
+   if (MasterFd >= 0) close(MasterFd);
+   MasterFd = fd;
+   setsockopt(MasterFd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+   /* start with an empty deframer */
+   memset(&RxSMANet,   0, sizeof(RxSMANet));
+   memset(&RxSunnyNet, 0, sizeof(RxSunnyNet));
+   RxSMANet.FCS = 0xffff;
+   SimLog("TCP client connected\n");
+}
+
+int main(int argc, char ** argv)
+{
+   char config[256] = "";
+   char link[256] = "";
+   int tcpPort = 0;
+   int udpPort = 0;
+   int i;
+
+   for (i = 1; i < argc; i++)
+   {
+      if      (strcmp(argv[i], "-c") == 0 && i + 1 < argc) strncpy(config, argv[++i], sizeof(config) - 1);
+      else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) strncpy(link,   argv[++i], sizeof(link) - 1);
+      else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) tcpPort = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) udpPort = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-v") == 0) bVerbose = TRUE;
+      else
+      {
+         printf("Usage: %s [-c smasim.ini] [-l link] [-t port] [-w port] [-v]\n", argv[0]);
+         return 1;
+      }
+   }
+
+   if (config[0])
+   {
+      if (SimReadConfig(config, link, sizeof(link)) == 0)
+      {
+         fprintf(stderr, "smasim: no devices configured in '%s'\n", config);
+         return 1;
+      }
+   }
+   else
+   {
+      SimCreateDefaultDevice();
+   }
+
+   for (i = 0; i < DeviceCount; i++)
+      printf("smasim: device '%s' SN %lu NetAddr 0x%04x with %d channels\n",
+             Devices[i].Type, (unsigned long)Devices[i].SerNr,
+             Devices[i].NetAddr, Devices[i].ChannelCount);
+
+   if (udpPort > 0)
+   {
+      if (SimOpenSpeedwire(udpPort) < 0) return 1;
+      link[0] = 0;
+   }
+   else if (tcpPort > 0)
+   {
+      if (SimOpenTcp(tcpPort) < 0) return 1;
+      link[0] = 0;
+   }
+   else if (SimOpenPty(link) < 0) return 1;
+
+   signal(SIGINT,  SimOnSignal);
+   signal(SIGTERM, SimOnSignal);
+   signal(SIGPIPE, SIG_IGN);
+   RxSMANet.FCS = 0xffff;
+
+   while (bRunning)
+   {
+      struct pollfd pfd[3];
+      BYTE buf[256];
+      ssize_t n;
+
+      pfd[0].fd = MasterFd;
+      pfd[0].events = POLLIN;
+      pfd[0].revents = 0;
+      pfd[1].fd = ListenFd;
+      pfd[1].events = POLLIN;
+      pfd[1].revents = 0;
+      pfd[2].fd = UdpFd;
+      pfd[2].events = POLLIN;
+      pfd[2].revents = 0;
+      if (poll(pfd, 3, 200) <= 0) continue;
+
+      if (pfd[1].revents & POLLIN)
+      {
+         SimAcceptTcp();
+         continue;
+      }
+      if (pfd[2].revents & POLLIN)
+      {
+         BYTE dgram[1500];
+         struct sockaddr_in from;
+         socklen_t fromLen = sizeof(from);
+
+         n = recvfrom(UdpFd, dgram, sizeof(dgram), 0, (struct sockaddr *)&from, &fromLen);
+         if (n > 0) SimOnSpeedwire(dgram, (DWORD)n, &from);
+         continue;
+      }
+      if (!pfd[0].revents) continue;
+
+      n = read(MasterFd, buf, sizeof(buf));
+      if (n <= 0)
+      {
+         /* TCP mode: the client has gone */
+         if (ListenFd >= 0 && (n == 0 || errno != EINTR))
+         {
+            SimLog("TCP client disconnected\n");
+            close(MasterFd);
+            MasterFd = -1;
+         }
+         continue;
+      }
+
+      /* the driver uses an other baud rate: the bytes are garbled */
+      if (SlaveFd >= 0 && Baudrate > 0 && SimGetTtyBaudrate() != Baudrate)
+      {
+         SimLog("<- %d bytes with %d baud dropped (bus: %d baud)\n",
+                (int)n, SimGetTtyBaudrate(), Baudrate);
+         continue;
+      }
+
+      SimScanSMANet(buf, (DWORD)n);
+      SimScanSunnyNet(buf, (DWORD)n);
+   }
+
+   if (link[0]) unlink(link);
+   if (SlaveFd  >= 0) close(SlaveFd);
+   if (MasterFd >= 0) close(MasterFd);
+   if (ListenFd >= 0) close(ListenFd);
+   if (UdpFd    >= 0) close(UdpFd);
+   return 0;
+}
@@ -0,0 +1,799 @@
+/*
+ *      YASDI - (Y)et (A)nother (S)MA(D)ata (I)mplementation
+ *      Copyright(C) 2001-2008 SMA Solar Technology AG
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library in the file COPYING.LIB;
+ *      if not, write to the Free Software Foundation, Inc.,
+ *      59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ *
+ */
+
+/**************************************************************************
+*         SMA Technologie AG, 34266 Niestetal, Germany
+***************************************************************************
+* Project       : yasdi
+***************************************************************************
+* Project-no.   :
+***************************************************************************
+* Filename      : codecbench.c
+***************************************************************************
+* Description   : Benchmark and fuzz driver for the transport protocol
+*                 codecs (protocol/smanet.c and protocol/sunnynet.c).
+*
+*                 Benchmark (default): encodes and decodes frames of
+*                 different sizes and escape densities (share of bytes
+*                 which must be escaped in SMANet) with both protocols
+*                 and prints the throughput (MB/s of SMAData bytes)
+*                 and the time per frame. The decoder is fed in pieces
+*                 of "-c" bytes like the protocol layer does it.
+*
+*                 Fuzzing: "LLVMFuzzerTestOneInput()" feeds the input
+*                 into the decoder (it must not crash) and checks that
+*                 the input encoded and decoded again gives exactly one
+*                 frame with the same bytes. Build with
+*                 "-DCODECBENCH_LIBFUZZER -fsanitize=fuzzer" for
+*                 libFuzzer (the main function is omitted then).
+*                 Without libFuzzer "-z" runs it with random and mutated
+*                 frames, "-f" with the given input files (e.g. crash
+*                 files of libFuzzer).
+*
+*                 Reference mode ("-r", always on with libFuzzer): The
+*                 SMANet input is also decoded by a copy of the old
+*                 bytewise SMANet deframer (one table lookup per byte
+*                 for the FCS). Both must find the same frames with the
+*                 same bytes. The benchmark then also prints the
+*                 decoder throughput of the old deframer.
+*
+*                 Usage: codecbench [-p smanet|sunnynet] [-n rounds]
+*                                   [-c chunk] [-z runs] [-s seed]
+*                                   [-r] [-f file...]
+***************************************************************************
+* Preconditions : POSIX system (clock_gettime)
+***************************************************************************
+* Changes       : Author, Date, Version, Reason
+*                 *********************************************************
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "os.h"
+#include "smadef.h"
+#include "device.h"
+#include "netpacket.h"
+#include "protocol.h"
+#include "prot_layer.h"
+#include "frame_listener.h"
+#include "smanet.h"
+#include "sunnynet.h"
+#include "smadata_layer.h"
+
+
+/**************************************************************************
+********** D E F I N E S **************************************************
+**************************************************************************/
+
+#define BENCH_FRAMES          64       /* different frames per round */
+#define BENCH_DEF_ROUNDS      2000
+#define BENCH_DEF_CHUNK       40       /* see AMOUNT_TO_READ (prot_layer.c) */
+#define BENCH_MAX_CHUNK       1024
+#define CODEC_MAX_PAYLOAD     255      /* MTU of both protocols */
+#define CODEC_MAX_ENCODED     (2 * (CODEC_MAX_PAYLOAD + 6) + 2)
+#define SMADATA1_HEAD_SIZE    7        /* SunnyNet frames carry at least this */
+#define CODEC_LOG_SIZE        (2 << 20)  /* decoded frames of one fuzz input */
+
+/* one transport protocol under test */
+typedef struct
+{
+   const char * Name;
+   struct TProtocol * (*Constructor)(void);
+   void (*Destructor)(struct TProtocol *);
+   WORD wMinPayload;                /* smallest frame the codec can carry */
+} TCodec;
+
+static const TCodec Codecs[] =
+{
+   { "SMANet",   TSMANet_constructor,   TSMANet_destructor,   1                  },
+   { "SunnyNet", TSunnyNet_Constructor, TSunnyNet_Destructor, SMADATA1_HEAD_SIZE },
+};
+#define CODEC_COUNT (sizeof(Codecs) / sizeof(Codecs[0]))
+
+/* the frames decoded from one input: (2 bytes length + frame bytes)* */
+typedef struct
+{
+   BYTE Buf[CODEC_LOG_SIZE];
+   DWORD dUsed;
+   DWORD dFrames;
+   BOOL bOverflow;                  /* too many frames: not comparable */
+} TCodecFrameLog;
+
+/* the reference: SMANet deframer as it was before the deframing in runs */
+typedef struct
+{
+   BOOL bEscRcv;
+   WORD FCS_In;
+   BYTE PktBuffer[SIZE_PKTBUFFER_SMANET];
+   DWORD dWritePos;
+} TRefSMANet;
+
+
+/**************************************************************************
+********** V A R I A B L E S **********************************************
+**************************************************************************/
+
+static TDevice Bus;                 /* the (not existing) bus of the codecs */
+static TFrameListener Listener;
+static DWORD dFramesReceived;
+static BYTE RxFrame[CODEC_MAX_ENCODED];
+static int iRxFrameSize;
+static TCodecFrameLog * RxLog;      /* log of the received frames or NULL */
+
+#ifdef CODECBENCH_LIBFUZZER
+static BOOL bRefCheck = true;       /* compare SMANet with the reference? */
+#else
+static BOOL bRefCheck = false;
+#endif
+static TCodecFrameLog RxFrameLog;
+static TCodecFrameLog RefFrameLog;
+static WORD RefFcsTab[256];
+
+
+/**************************************************************************
+   Description   : Listener of the protocol layer: remember the decoded
+                   frame
+   Parameter     : frame = the decoded frame
+   Return-Value  : ---
+**************************************************************************/
+static void CodecOnFrame(struct TNetPacket * frame)
+{
+   dFramesReceived++;
+   iRxFrameSize = TNetPacket_GetFrameLength( frame );
+   if (iRxFrameSize <= (int)sizeof(RxFrame))
+      TNetPacket_CopyFromBuffer( frame, RxFrame );
+
+   if (RxLog)
+   {
+      BYTE * dest = RxLog->Buf + RxLog->dUsed;
+      if (RxLog->dUsed + 2 + iRxFrameSize > sizeof(RxLog->Buf))
+         RxLog->bOverflow = true;
+      else
+      {
+         dest[0] = (BYTE)(iRxFrameSize >> 8);
+         dest[1] = (BYTE)iRxFrameSize;
+         TNetPacket_CopyFromBuffer( frame, dest + 2 );
+         RxLog->dUsed += 2 + iRxFrameSize;
+      }
+      RxLog->dFrames++;
+   }
+}
+
+/**************************************************************************
+   Description   : Reference: Builds the FCS table of the old SMANet
+                   codec (CRC-CCITT, RFC 1662) bit by bit, so it does not
+                   depend on the tables in protocol/smanet.c
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+static void RefInitFCS(void)
+{
+   DWORD b, v;
+   int i;
+
+   for(b = 0; b < 256; b++)
+   {
+      v = b;
+      for(i = 0; i < 8; i++)
+         v = (v & 1) ? (v >> 1) ^ 0x8408 : v >> 1;
+      RefFcsTab[b] = (WORD)v;
+   }
+}
+
+/**************************************************************************
+   Description   : Reference: The old SMANet deframer (one byte after
+                   the other, FCS bytewise, frames copied into a new
+                   packet for the listeners). It differs from the old
+                   code only where that one read or wrote outside of its
+                   buffer: frames with good FCS shorter than HDLC head
+                   plus FCS are dropped and the receive buffer overflows
+                   at SIZE_PKTBUFFER_SMANET (not one byte later).
+   Parameter     : this   = reference deframer
+                   buffer = bytes from the bus
+                   dLen   = count of bytes
+   Return-Value  : ---
+**************************************************************************/
+static void RefScan(TRefSMANet * this, const BYTE * buffer, DWORD dLen)
+{
+   struct TNetPacket * frame;
+   DWORD dCurPos;
+   BYTE ch;
+
+   for (dCurPos = 0; dCurPos < dLen; dCurPos++)
+   {
+      ch = buffer[dCurPos];
+
+      if (ch == HDLC_SYNC)
+      {
+         if (this->FCS_In != 0xf0b8)
+         {
+            /* bad FCS: start of a frame */
+            this->FCS_In = 0xffff;
+         }
+         else if (this->dWritePos < sizeof(THDLCHead) + 2)
+         {
+            this->FCS_In = 0xffff;
+         }
+         else if (this->PktBuffer[0] == HDLC_ADR_BROADCAST &&
+                  this->PktBuffer[1] == 0x03)
+         {
+            frame = TNetPacketManagement_GetPacket();
+            frame->RouteInfo.BusDriverID   = Bus.DriverID;
+            frame->RouteInfo.bTransProtID  = PROT_SMANET;
+            TNetPacket_AddTail( frame, this->PktBuffer + sizeof(THDLCHead), 
+                                (WORD)(this->dWritePos - sizeof(THDLCHead) - 2) );
+            TProtLayer_NotifyFrameListener( frame, be16ToHost(&this->PktBuffer[2]) );
+            TNetPacketManagement_FreeBuffer( frame );
+            this->FCS_In = 0;
+         }
+         this->dWritePos = 0;
+         continue;
+      }
+
+      if (ch == HDLC_ESC)
+      {
+         this->bEscRcv = true;
+         continue;
+      }
+
+      if (this->bEscRcv)
+      {
+         ch ^= 0x20;
+         this->bEscRcv = false;
+      }
+
+      this->FCS_In = (WORD)((this->FCS_In >> 8) ^ RefFcsTab[(this->FCS_In ^ ch) & 0xff]);
+      if (this->dWritePos < sizeof(this->PktBuffer))
+         this->PktBuffer[ this->dWritePos++ ] = ch;
+      else
+         this->dWritePos = 0; /* Puffer ueberlauf! */
+   }
+}
+
+/**************************************************************************
+   Description   : Init the parts of YASDI needed by the codecs (packet
+                   management and the frame listeners of the protocol
+                   layer) once
+   Parameter     : ---
+   Return-Value  : ---
+**************************************************************************/
+static void CodecInit(void)
+{
+   static BOOL bInit = false;
+   TMinList noDevices;
+
+   if (bInit) return;
+   bInit = true;
+
+   INITLIST( &noDevices );
+   RefInitFCS();
+   TNetPacketManagement_Init();
+   TProtLayer_Constructor( &noDevices );
+
+   memset(&Bus, 0, sizeof(Bus));
+   strcpy(Bus.cName, "codecbench");
+   Bus.DriverID = 1;
+
+   Listener.ProtocolID       = 0xffff;
+   Listener.OnPacketReceived = CodecOnFrame;
+   TProtLayer_AddFrameListener( &Listener );
+}
+
+/**************************************************************************
+   Description   : Encodes one frame with the protocol
+   Parameter     : prot     = the protocol instance
+                   payload  = the SMAData frame
+                   wLen     = size of it
+                   protid   = the protocol ID of the frame
+                   dest     = buffer for the encoded frame
+                              (CODEC_MAX_ENCODED bytes)
+   Return-Value  : size of the encoded frame
+**************************************************************************/
+static int CodecEncode(struct TProtocol * prot, const BYTE * payload,
+                       WORD wLen, WORD protid, BYTE * dest)
+{
+   struct TNetPacket * pkt = TNetPacketManagement_GetPacket();
+   int iSize;
+
+   TNetPacket_AddTail( pkt, (BYTE*)payload, wLen );
+   prot->encapsulate( prot, pkt, protid );
+   iSize = TNetPacket_GetFrameLength( pkt );
+   if (iSize > CODEC_MAX_ENCODED) abort();
+   TNetPacket_CopyFromBuffer( pkt, dest );
+   TNetPacketManagement_FreeBuffer( pkt );
+   return iSize;
+}
+
+/**************************************************************************
+   Description   : Feeds a byte stream into the decoder in pieces, like
+                   the protocol layer reads it from the bus driver
+   Parameter     : prot    = the protocol instance
+                   stream  = the bytes
+                   dLen    = count of bytes
+                   dChunk  = max. size of one piece
+   Return-Value  : ---
+**************************************************************************/
+static void CodecDecode(struct TProtocol * prot, const BYTE * stream,
+                        DWORD dLen, DWORD dChunk)
+{
+   DWORD dPos = 0;
+
+   while (dPos < dLen)
+   {
+      DWORD dPiece = dLen - dPos < dChunk ? dLen - dPos : dChunk;
+      prot->Scan( prot, &Bus, (BYTE*)stream + dPos, dPiece, 0 );
+      dPos += dPiece;
+   }
+}
+
+/**************************************************************************
+   Description   : Decodes like "CodecDecode()". In reference mode the
+                   SMANet input is decoded before by an own instance of
+                   the codec and by the reference deframer, and the frames
+                   of both (any protocol ID) are compared byte for byte.
+                   A difference aborts.
+   Parameter     : codec   = the codec of "prot"
+                   prot    = the protocol instance
+                   stream  = the bytes
+                   dLen    = count of bytes
+                   dChunk  = max. size of one piece
+   Return-Value  : ---
+**************************************************************************/
+static void CodecDecodeChecked(const TCodec * codec, struct TProtocol * prot,
+                               const BYTE * stream, DWORD dLen, DWORD dChunk)
+{
+   static TRefSMANet ref;
+   struct TProtocol * refprot;
+   DWORD i, dPos;
+   DWORD dFramesBefore = dFramesReceived;
+   WORD wProtID = Listener.ProtocolID;
+
+   if (bRefCheck && codec->Constructor == TSMANet_constructor)
+   {
+      //the reference does not know the protocol IDs: all frames of both
+      RxFrameLog.dUsed = RefFrameLog.dUsed = 0;
+      RxFrameLog.dFrames = RefFrameLog.dFrames = 0;
+      RxFrameLog.bOverflow = RefFrameLog.bOverflow = false;
+      refprot = codec->Constructor();
+      RxLog = &RxFrameLog;
+      Listener.ProtocolID = 0xffff;
+      CodecDecode( refprot, stream, dLen, dChunk );
+      Listener.ProtocolID = wProtID;
+      RxLog = NULL;
+      codec->Destructor( refprot );
+      dFramesReceived = dFramesBefore;
+
+      memset(&ref, 0, sizeof(ref));
+      RxLog = &RefFrameLog;
+      Listener.ProtocolID = 0xffff;
+      for(dPos = 0; dPos < dLen; dPos += dChunk)
+         RefScan( &ref, stream + dPos, dLen - dPos < dChunk ? dLen - dPos : dChunk );
+      Listener.ProtocolID = wProtID;
+      RxLog = NULL;
+      dFramesReceived = dFramesBefore;
+
+      if (RxFrameLog.dFrames != RefFrameLog.dFrames ||
+          (!RxFrameLog.bOverflow && !RefFrameLog.bOverflow &&
+           (RxFrameLog.dUsed != RefFrameLog.dUsed ||
+            memcmp(RxFrameLog.Buf, RefFrameLog.Buf, RxFrameLog.dUsed) != 0)))
+      {
+         for(i = 0; i < RxFrameLog.dUsed && i < RefFrameLog.dUsed &&
+                    RxFrameLog.Buf[i] == RefFrameLog.Buf[i]; i++);
+         fprintf(stderr, "codecbench: SMANet differs from the reference (frames %lu/%lu, "
+                 "log bytes %lu/%lu, first difference at %lu)\n",
+                 (unsigned long)RxFrameLog.dFrames, (unsigned long)RefFrameLog.dFrames,
+                 (unsigned long)RxFrameLog.dUsed, (unsigned long)RefFrameLog.dUsed,
+                 (unsigned long)i);
+         abort();
+      }
+   }
+
+   CodecDecode( prot, stream, dLen, dChunk );
+}
+
+/**************************************************************************
+   Description   : Fuzz target:
+                   Byte 0 selects the protocol, byte 1 the size of the
+                   pieces fed to the decoder, the rest is the data. The
+                   data is decoded (must not crash) and afterwards
+                   encoded and decoded again (must give exactly the same
+                   frame). A failed check aborts.
+   Parameter     : data = fuzz input
+                   size = size of it
+   Return-Value  : always 0
+**************************************************************************/
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+   static BYTE encoded[CODEC_MAX_ENCODED];
+   const TCodec * codec;
+   struct TProtocol * prot;
+   const BYTE * payload;
+   DWORD dChunk, dLen;
+   WORD protid;
+   int iEncSize;
+
+   if (size < 2) return 0;
+   CodecInit();
+
+   codec   = &Codecs[ data[0] % CODEC_COUNT ];
+   dChunk  = 1 + data[1] % 64;
+   payload = data + 2;
+   dLen    = (DWORD)(size - 2);
+
+   /* anything on the bus... */
+   prot = codec->Constructor();
+   Listener.ProtocolID = 0xffff;
+   CodecDecodeChecked( codec, prot, payload, dLen, dChunk );
+   codec->Destructor( prot );
+
+   /* ...and the way back */
+   if (dLen > CODEC_MAX_PAYLOAD) dLen = CODEC_MAX_PAYLOAD;
+   if (dLen < codec->wMinPayload) return 0;
+
+   //SunnyNet carries SMAData1 only, SMANet any PPP protocol
+   protid = PROT_PPP_SMADATA1;
+   if (codec->Constructor == TSMANet_constructor)
+      protid = (WORD)((data[0] << 8) | data[1]);
+
+   prot = codec->Constructor();
+   iEncSize = CodecEncode( prot, payload, (WORD)dLen, protid, encoded );
+   dFramesReceived = 0;
+   Listener.ProtocolID = protid;
+   CodecDecodeChecked( codec, prot, encoded, (DWORD)iEncSize, dChunk );
+   codec->Destructor( prot );
+
+   if (dFramesReceived != 1 || iRxFrameSize != (int)dLen ||
+       memcmp(RxFrame, payload, dLen) != 0)
+   {
+      fprintf(stderr, "codecbench: %s round trip failed (len=%lu, frames=%lu, "
+              "decoded len=%d)\n", codec->Name, (unsigned long)dLen,
+              (unsigned long)dFramesReceived, iRxFrameSize);
+      abort();
+   }
+   return 0;
+}
+
+
+#ifndef CODECBENCH_LIBFUZZER
+
+static DWORD dRandState = 0x2545f491;
+
+/**************************************************************************
+   Description   : Reproducible pseudo random numbers (xorshift32)
+   Parameter     : ---
+   Return-Value  : next random number
+**************************************************************************/
+static DWORD CodecRand(void)
+{
+   dRandState ^= dRandState << 13;
+   dRandState ^= dRandState >> 17;
+   dRandState ^= dRandState << 5;
+   return dRandState;
+}
+
+/**************************************************************************
+   Description   : Monotonic time in nanoseconds
+   Parameter     : ---
+   Return-Value  : the time
+**************************************************************************/
+static double CodecNow(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**************************************************************************
+   Description   : Creates a random frame
+   Parameter     : dest    = the frame
+                   wLen    = size of it
+                   iEscPct = percentage of bytes which SMANet must escape
+   Return-Value  : ---
+**************************************************************************/
+static void CodecRandomFrame(BYTE * dest, WORD wLen, int iEscPct)
+{
+   static const BYTE escChars[] = { 0x7e, 0x7d, 0x11, 0x13 };
+   WORD i;
+
+   for(i = 0; i < wLen; i++)
+   {
+      if ((int)(CodecRand() % 100) < iEscPct)
+         dest[i] = escChars[ CodecRand() % sizeof(escChars) ];
+      else
+      {
+         do dest[i] = (BYTE)CodecRand();
+         while (dest[i] == 0x7e || dest[i] == 0x7d ||
+                dest[i] == 0x11 || dest[i] == 0x13);
+      }
+   }
+}
+
+/**************************************************************************
+   Description   : Benchmark of one codec with one frame size and escape
+                   density
+   Parameter     : codec   = the codec
+                   wLen    = frame size (SMAData bytes)
+                   iEscPct = escape density in percent
+                   dRounds = count of rounds (BENCH_FRAMES frames each)
+                   dChunk  = size of the pieces fed to the decoder
+   Return-Value  : 0 = ok, -1 = frames lost while decoding
+**************************************************************************/
+static int CodecBench(const TCodec * codec, WORD wLen, int iEscPct,
+                      DWORD dRounds, DWORD dChunk)
+{
+   static BYTE frames[BENCH_FRAMES][CODEC_MAX_PAYLOAD];
+   static BYTE stream[BENCH_FRAMES * CODEC_MAX_ENCODED];
+   struct TProtocol * prot = codec->Constructor();
+   struct TNetPacket * pkt = TNetPacketManagement_GetPacket();
+   DWORD dStreamLen = 0;
+   DWORD r;
+   double t0, tEnc, tDec, dBytes;
+   int i;
+
+   for(i = 0; i < BENCH_FRAMES; i++)
+   {
+      CodecRandomFrame( frames[i], wLen, iEscPct );
+      dStreamLen += CodecEncode( prot, frames[i], wLen, PROT_PPP_SMADATA1,
+                                 stream + dStreamLen );
+   }
+
+   /* encode */
+   t0 = CodecNow();
+   for(r = 0; r < dRounds; r++)
+   {
+      for(i = 0; i < BENCH_FRAMES; i++)
+      {
+         TNetPacket_Clear( pkt );
+         TNetPacket_AddTail( pkt, frames[i], wLen );
+         prot->encapsulate( prot, pkt, PROT_PPP_SMADATA1 );
+      }
+   }
+   tEnc = CodecNow() - t0;
+
+   /* decode */
+   dFramesReceived = 0;
+   Listener.ProtocolID = PROT_PPP_SMADATA1;
+   t0 = CodecNow();
+   for(r = 0; r < dRounds; r++)
+      CodecDecode( prot, stream, dStreamLen, dChunk );
+   tDec = CodecNow() - t0;
+
+   TNetPacketManagement_FreeBuffer( pkt );
+   codec->Destructor( prot );
+
+   dBytes = (double)wLen * BENCH_FRAMES * dRounds;
+   printf("%-9s %5u %4d%% %10.1f %10.1f %10.1f %10.1f\n",
+          codec->Name, wLen, iEscPct,
+          dBytes / tEnc * 1e3, tEnc / (BENCH_FRAMES * dRounds),
+          dBytes / tDec * 1e3, tDec / (BENCH_FRAMES * dRounds));
+
+   if (dFramesReceived != BENCH_FRAMES * dRounds)
+   {
+      fprintf(stderr, "codecbench: %s decoded %lu of %lu frames\n", codec->Name,
+              (unsigned long)dFramesReceived,
+              (unsigned long)(BENCH_FRAMES * dRounds));
+      return -1;
+   }
+   return 0;
+}
+
+/**************************************************************************
+   Description   : Benchmark of the reference SMANet deframer (decoding
+                   only) with one frame size and escape density
+   Parameter     : see "CodecBench()"
+   Return-Value  : 0 = ok, -1 = frames lost while decoding
+**************************************************************************/
+static int CodecBenchRef(WORD wLen, int iEscPct, DWORD dRounds, DWORD dChunk)
+{
+   static BYTE frame[CODEC_MAX_PAYLOAD];
+   static BYTE stream[BENCH_FRAMES * CODEC_MAX_ENCODED];
+   static TRefSMANet ref;
+   struct TProtocol * prot = TSMANet_constructor();
+   DWORD dStreamLen = 0;
+   DWORD r, dPos;
+   double t0, tDec, dBytes;
+   int i;
+
+   for(i = 0; i < BENCH_FRAMES; i++)
+   {
+      CodecRandomFrame( frame, wLen, iEscPct );
+      dStreamLen += CodecEncode( prot, frame, wLen, PROT_PPP_SMADATA1,
+                                 stream + dStreamLen );
+   }
+   TSMANet_destructor( prot );
+
+   memset(&ref, 0, sizeof(ref));
+   dFramesReceived = 0;
+   Listener.ProtocolID = PROT_PPP_SMADATA1;
+   t0 = CodecNow();
+   for(r = 0; r < dRounds; r++)
+   {
+      for(dPos = 0; dPos < dStreamLen; dPos += dChunk)
+         RefScan( &ref, stream + dPos,
+                  dStreamLen - dPos < dChunk ? dStreamLen - dPos : dChunk );
+   }
+   tDec = CodecNow() - t0;
+
+   dBytes = (double)wLen * BENCH_FRAMES * dRounds;
+   printf("%-9s %5u %4d%% %10s %10s %10.1f %10.1f\n",
+          "SMANetRef", wLen, iEscPct, "-", "-",
+          dBytes / tDec * 1e3, tDec / (BENCH_FRAMES * dRounds));
+
+   if (dFramesReceived != BENCH_FRAMES * dRounds)
+   {
+      fprintf(stderr, "codecbench: reference decoded %lu of %lu frames\n",
+              (unsigned long)dFramesReceived, (unsigned long)(BENCH_FRAMES * dRounds));
+      return -1;
+   }
+   return 0;
+}
+
+/**************************************************************************
+   Description   : Runs the fuzz target with random inputs: random bytes
+                   or valid frames with some bytes changed
+   Parameter     : dRuns = count of inputs
+   Return-Value  : ---
+**************************************************************************/
+static void CodecFuzzRandom(DWORD dRuns)
+{
+   static BYTE input[2 + CODEC_MAX_ENCODED * 2];
+   static BYTE frame[CODEC_MAX_PAYLOAD];
+   DWORD r;
+
+   for(r = 0; r < dRuns; r++)
+   {
+      DWORD dLen;
+      DWORD i;
+
+      input[0] = (BYTE)CodecRand();
+      input[1] = (BYTE)CodecRand();
+
+      if (CodecRand() % 4 == 0)
+      {
+         dLen = CodecRand() % (sizeof(input) - 2);
+         for(i = 0; i < dLen; i++) input[2 + i] = (BYTE)CodecRand();
+      }
+      else
+      {
+         /* one or two valid frames, partly damaged */
+         const TCodec * codec = &Codecs[ input[0] % CODEC_COUNT ];
+         struct TProtocol * prot = codec->Constructor();
+         int iFrames = 1 + CodecRand() % 2;
+         int f, iFlips;
+
+         dLen = 0;
+         for(f = 0; f < iFrames; f++)
+         {
+            WORD wLen = (WORD)(codec->wMinPayload +
+                               CodecRand() % (CODEC_MAX_PAYLOAD - codec->wMinPayload + 1));
+            CodecRandomFrame( frame, wLen, CodecRand() % 30 );
+            dLen += CodecEncode( prot, frame, wLen, PROT_PPP_SMADATA1,
+                                 input + 2 + dLen );
+         }
+         codec->Destructor( prot );
+
+         iFlips = CodecRand() % 4;
+         for(f = 0; f < iFlips; f++)
+            input[2 + CodecRand() % dLen] = (BYTE)CodecRand();
+         if (CodecRand() % 4 == 0) dLen = CodecRand() % (dLen + 1);
+      }
+
+      LLVMFuzzerTestOneInput( input, 2 + dLen );
+   }
+}
+
+/**************************************************************************
+   Description   : Runs the fuzz target with the content of a file
+   Parameter     : path = the file
+   Return-Value  : 0 = ok, -1 = can't read the file
+**************************************************************************/
+static int CodecFuzzFile(const char * path)
+{
+   static BYTE input[1 << 20];
+   size_t size;
+   FILE * fd = fopen(path, "rb");
+
+   if (!fd)
+   {
+      perror(path);
+      return -1;
+   }
+   size = fread(input, 1, sizeof(input), fd);
+   fclose(fd);
+   LLVMFuzzerTestOneInput( input, size );
+   return 0;
+}
+
+int main(int argc, char ** argv)
+{
+   static const WORD sizes[] = { 8, 16, 64, 128, 255 };
+   static const int escPct[] = { 0, 5, 50 };
+   const char * protName = NULL;
+   DWORD dRounds = BENCH_DEF_ROUNDS;
+   DWORD dChunk  = BENCH_DEF_CHUNK;
+   DWORD dFuzzRuns = 0;
+   int iFirstFile = 0;
+   int iResult = 0;
+   unsigned c, s, e;
+   int i;
+
+   for (i = 1; i < argc; i++)
+   {
+      if      (strcmp(argv[i], "-p") == 0 && i + 1 < argc) protName  = argv[++i];
+      else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) dRounds   = (DWORD)atol(argv[++i]);
+      else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) dChunk    = (DWORD)atol(argv[++i]);
+      else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) dFuzzRuns = (DWORD)atol(argv[++i]);
+      else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) dRandState = (DWORD)atol(argv[++i]) | 1;
+      else if (strcmp(argv[i], "-r") == 0) bRefCheck = true;
+      else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) { iFirstFile = i + 1; break; }
+      else
+      {
+         printf("Usage: %s [-p smanet|sunnynet] [-n rounds] [-c chunk] "
+                "[-z runs] [-s seed] [-r] [-f file...]\n", argv[0]);
+         return 1;
+      }
+   }
+   if (dChunk < 1 || dChunk > BENCH_MAX_CHUNK) dChunk = BENCH_DEF_CHUNK;
+
+   CodecInit();
+
+   if (iFirstFile)
+   {
+      for (i = iFirstFile; i < argc; i++)
+         if (CodecFuzzFile(argv[i]) < 0) iResult = 1;
+      printf("codecbench: %d input(s) ok\n", argc - iFirstFile);
+      return iResult;
+   }
+
+   if (dFuzzRuns)
+   {
+      CodecFuzzRandom( dFuzzRuns );
+      printf("codecbench: %lu fuzz input(s) ok\n", (unsigned long)dFuzzRuns);
+      return 0;
+   }
+
+   printf("%-9s %5s %5s %10s %10s %10s %10s\n", "protocol", "size", "esc",
+          "enc MB/s", "enc ns", "dec MB/s", "dec ns");
+   for(c = 0; c < CODEC_COUNT; c++)
+   {
+      if (protName && strcasecmp(protName, Codecs[c].Name) != 0) continue;
+      for(s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+      {
+         if (sizes[s] < Codecs[c].wMinPayload) continue;
+         for(e = 0; e < sizeof(escPct) / sizeof(escPct[0]); e++)
+         {
+            if (CodecBench(&Codecs[c], sizes[s], escPct[e], dRounds, dChunk) < 0)
+               iResult = 1;
+            if (bRefCheck && Codecs[c].Constructor == TSMANet_constructor &&
+                CodecBenchRef(sizes[s], escPct[e], dRounds, dChunk) < 0)
+               iResult = 1;
+         }
+      }
+   }
+   return iResult;
+}
+
+#endif